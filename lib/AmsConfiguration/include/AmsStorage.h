@@ -16,6 +16,13 @@
 #define FILE_DAYPLOT "/dayplot.bin"
 #define FILE_MONTHPLOT "/monthplot.bin"
 #define FILE_ENERGYACCOUNTING "/energyaccounting.bin"
+#define FILE_RECORD_LOG_0 "/records0.bin"
+#define FILE_RECORD_LOG_1 "/records1.bin"
+#define FILE_QUARTER_HOUR_0 "/quarter0.bin"
+#define FILE_QUARTER_HOUR_1 "/quarter1.bin"
+#define FILE_QUARTER_HOUR_2 "/quarter2.bin"
+#define FILE_HISTORY "/history%d%d.bin" // Tier and file
+#define FILE_HISTORY_TMP "/history.tmp"
 
 #define FILE_CFG "/configfile.cfg"
 #define FILE_PRICE_CONF "/priceconf.bin"
@@ -8,9 +8,50 @@
 #define _AMSDATA_H
 
 #include "Arduino.h"
+#include <limits>
 #include <Timezone.h>
 #include "OBIScodes.h"
 
+// Fixed size keeps AmsData free of heap allocations and cheap to copy, the decoders read strings into 64 byte buffers
+#define AMS_LIST_ID_SIZE 32
+#define AMS_METER_ID_SIZE 64
+#define AMS_METER_MODEL_SIZE 64
+
+/**
+ * Fixed point storage that reads and assigns like a double, so the decoders can keep doing arithmetic on the fields.
+ * Values are stored as round(value * scale) and clamped to the range of T.
+ */
+template <typename T, uint32_t scale>
+class AmsFixed {
+public:
+    AmsFixed& operator=(double value) {
+        value *= scale;
+        if(value != value) {
+            raw = 0;
+        } else if(value <= (double) std::numeric_limits<T>::min()) {
+            raw = std::numeric_limits<T>::min();
+        } else if(value >= (double) std::numeric_limits<T>::max()) {
+            raw = std::numeric_limits<T>::max();
+        } else {
+            raw = (T) (value < 0 ? value - 0.5 : value + 0.5);
+        }
+        return *this;
+    }
+    AmsFixed& operator+=(double value) { return *this = (double) *this + value; }
+    AmsFixed& operator*=(double value) { return *this = (double) *this * value; }
+    AmsFixed& operator/=(double value) { return *this = (double) *this / value; }
+    bool operator!=(const AmsFixed& other) const { return raw != other.raw; }
+    operator double() const { return raw / (double) scale; }
+
+    T raw = 0;
+};
+
+typedef AmsFixed<uint32_t, 10> AmsVoltage; // 0.1V, meters do not report any finer. 32 bit for voltage multipliers on MV/HV transformers
+typedef AmsFixed<int32_t, 1000> AmsCurrent; // mA
+typedef AmsFixed<int16_t, 100> AmsPowerFactor; // Everything publishes power factor with two decimals
+typedef AmsFixed<uint32_t, 1000> AmsPhaseCounter; // Wh, read as kWh
+typedef AmsFixed<uint64_t, 1000000> AmsCounter; // mWh, read as kWh. Finer than the meters so estimates can accumulate
+
 enum AmsType {
     AmsTypeAutodetect = 0x00,
     AmsTypeAidon = 0x01,
@@ -23,6 +64,50 @@ enum AmsType {
     AmsTypeUnknown = 0xFF
 };
 
+// Bit positions in the masks returned by getPresentFields(), getChangedFields() and diff()
+enum AmsField {
+    AmsFieldListId = 0,
+    AmsFieldMeterId,
+    AmsFieldMeterType,
+    AmsFieldMeterModel,
+    AmsFieldMeterTimestamp,
+    AmsFieldActiveImportPower,
+    AmsFieldReactiveImportPower,
+    AmsFieldActiveExportPower,
+    AmsFieldReactiveExportPower,
+    AmsFieldL1Voltage,
+    AmsFieldL2Voltage,
+    AmsFieldL3Voltage,
+    AmsFieldL1Current,
+    AmsFieldL2Current,
+    AmsFieldL3Current,
+    AmsFieldPhases, // threePhase, twoPhase and l2currentMissing
+    AmsFieldPowerFactor,
+    AmsFieldL1PowerFactor,
+    AmsFieldL2PowerFactor,
+    AmsFieldL3PowerFactor,
+    AmsFieldL1ActiveImportPower,
+    AmsFieldL2ActiveImportPower,
+    AmsFieldL3ActiveImportPower,
+    AmsFieldL1ActiveExportPower,
+    AmsFieldL2ActiveExportPower,
+    AmsFieldL3ActiveExportPower,
+    AmsFieldL1ActiveImportCounter,
+    AmsFieldL2ActiveImportCounter,
+    AmsFieldL3ActiveImportCounter,
+    AmsFieldL1ActiveExportCounter,
+    AmsFieldL2ActiveExportCounter,
+    AmsFieldL3ActiveExportCounter,
+    AmsFieldActiveImportCounter,
+    AmsFieldReactiveImportCounter,
+    AmsFieldActiveExportCounter,
+    AmsFieldReactiveExportCounter,
+    AmsFieldCount
+};
+
+#define AMS_FIELD(field) (((uint64_t) 1) << (field))
+#define AMS_FIELDS_ALL (AMS_FIELD(AmsFieldCount) - 1)
+
 class AmsData {
 public:
     AmsData();
@@ -30,16 +115,26 @@ public:
     void apply(AmsData& other);
     void apply(const OBIS_code_t obis, double value);
 
+    // Fields carried by this data, as marked by the decoders for each value they read. For data that others are
+    // applied to, the fields any of them had
+    uint64_t getPresentFields();
+    // Fields that the last apply(AmsData&) changed, including estimated counters
+    uint64_t getChangedFields();
+    // Fields that apply(other) would change, without touching this
+    uint64_t diff(AmsData& other);
+    // Incremented on every apply(AmsData&), lets polling consumers see if they missed a change mask
+    uint32_t getUpdateCount();
+
     uint64_t getLastUpdateMillis();
 
     time_t getPackageTimestamp();
 
     uint8_t getListType();
 
-    String getListId();
-    String getMeterId();
+    const char* getListId();
+    const char* getMeterId();
     uint8_t getMeterType();
-    String getMeterModel();
+    const char* getMeterModel();
 
     time_t getMeterTimestamp();
 
@@ -91,24 +186,34 @@ public:
     void setLastError(int8_t);
 
 protected:
+    // Ordered by size to avoid padding, there are several instances alive at any time
     uint64_t lastUpdateMillis = 0;
     uint64_t lastList2 = 0;
-    uint8_t listType = 0, meterType = AmsTypeUnknown;
+    uint64_t changedFields = 0;
+    uint64_t presentFields = 0; // Set by the decoders, and by apply(OBIS) and the setters below
     time_t packageTimestamp = 0;
-    String listId = "", meterId = "", meterModel = "";
     time_t meterTimestamp = 0;
+    AmsCounter activeImportCounter, reactiveImportCounter, activeExportCounter, reactiveExportCounter;
     uint32_t activeImportPower = 0, reactiveImportPower = 0, activeExportPower = 0, reactiveExportPower = 0;
-    float l1voltage = 0, l2voltage = 0, l3voltage = 0, l1current = 0, l2current = 0, l3current = 0;
     uint32_t l1activeImportPower = 0, l2activeImportPower = 0, l3activeImportPower = 0;
     uint32_t l1activeExportPower = 0, l2activeExportPower = 0, l3activeExportPower = 0;
-    double l1activeImportCounter = 0, l2activeImportCounter = 0, l3activeImportCounter = 0;
-    double l1activeExportCounter = 0, l2activeExportCounter = 0, l3activeExportCounter = 0;
-    float powerFactor = 0, l1PowerFactor = 0, l2PowerFactor = 0, l3PowerFactor = 0;
-    double activeImportCounter = 0, reactiveImportCounter = 0, activeExportCounter = 0, reactiveExportCounter = 0;
-    bool threePhase = false, twoPhase = false, counterEstimated = false, l2currentMissing = false;;
-
+    AmsPhaseCounter l1activeImportCounter, l2activeImportCounter, l3activeImportCounter;
+    AmsPhaseCounter l1activeExportCounter, l2activeExportCounter, l3activeExportCounter;
+    AmsCurrent l1current, l2current, l3current;
+    AmsVoltage l1voltage, l2voltage, l3voltage;
+    uint32_t updateCount = 0;
+    AmsPowerFactor powerFactor, l1PowerFactor, l2PowerFactor, l3PowerFactor;
+    uint8_t listType = 0, meterType = AmsTypeUnknown;
+    bool threePhase = false, twoPhase = false, counterEstimated = false, l2currentMissing = false;
     int8_t lastError = 0x00;
     uint8_t lastErrorCount = 0;
+    char listId[AMS_LIST_ID_SIZE] = "", meterId[AMS_METER_ID_SIZE] = "", meterModel[AMS_METER_MODEL_SIZE] = "";
+
+    uint64_t merge(AmsData& other, bool write);
+
+    void setListId(const char* value);
+    void setMeterId(const char* value);
+    void setMeterModel(const char* value);
 };
 
 #endif
@@ -46,36 +46,47 @@ const OBIS_code_t OBIS_METER_ID PROGMEM =              {  96,   1,   0 };
 const OBIS_code_t OBIS_METER_ID_2 PROGMEM =            {   0,   0,   5 };
 const OBIS_code_t OBIS_METER_TIMESTAMP PROGMEM =       {   1,   0,   0 };
 
-const OBIS_code_t OBIS_ACTIVE_IMPORT PROGMEM =         {   1,   7,   0 };
-const OBIS_code_t OBIS_ACTIVE_IMPORT_COUNT PROGMEM =   {   1,   8,   0 };
-const OBIS_code_t OBIS_ACTIVE_EXPORT PROGMEM =         {   2,   7,   0 };
-const OBIS_code_t OBIS_ACTIVE_EXPORT_COUNT PROGMEM =   {   2,   8,   0 };
-const OBIS_code_t OBIS_REACTIVE_IMPORT PROGMEM =       {   3,   7,   0 };
-const OBIS_code_t OBIS_REACTIVE_IMPORT_COUNT PROGMEM = {   3,   8,   0 };
-const OBIS_code_t OBIS_REACTIVE_EXPORT PROGMEM =       {   4,   7,   0 };
-const OBIS_code_t OBIS_REACTIVE_EXPORT_COUNT PROGMEM = {   4,   8,   0 };
-
-const OBIS_code_t OBIS_POWER_FACTOR PROGMEM =          {  13,   7,   0 };
-
-const OBIS_code_t OBIS_ACTIVE_IMPORT_L1 PROGMEM =      {  21,   7,   0 };
-const OBIS_code_t OBIS_ACTIVE_EXPORT_L1 PROGMEM =      {  22,   7,   0 };
-
-const OBIS_code_t OBIS_CURRENT_L1 PROGMEM =            {  31,   7,   0 };
-const OBIS_code_t OBIS_VOLTAGE_L1 PROGMEM =            {  32,   7,   0 };
-const OBIS_code_t OBIS_POWER_FACTOR_L1 PROGMEM =       {  33,   7,   0 };
-
-const OBIS_code_t OBIS_ACTIVE_IMPORT_L2 PROGMEM =      {  41,   7,   0 };
-const OBIS_code_t OBIS_ACTIVE_EXPORT_L2 PROGMEM =      {  42,   7,   0 };
-
-const OBIS_code_t OBIS_CURRENT_L2 PROGMEM =            {  51,   7,   0 };
-const OBIS_code_t OBIS_VOLTAGE_L2 PROGMEM =            {  52,   7,   0 };
-const OBIS_code_t OBIS_POWER_FACTOR_L2 PROGMEM =       {  53,   7,   0 };
-
-const OBIS_code_t OBIS_ACTIVE_IMPORT_L3 PROGMEM =      {  61,   7,   0 };
-const OBIS_code_t OBIS_ACTIVE_EXPORT_L3 PROGMEM =      {  62,   7,   0 };
-
-const OBIS_code_t OBIS_CURRENT_L3 PROGMEM =            {  71,   7,   0 };
-const OBIS_code_t OBIS_VOLTAGE_L3 PROGMEM =            {  72,   7,   0 };
-const OBIS_code_t OBIS_POWER_FACTOR_L3 PROGMEM =       {  73,   7,   0 };
+/**
+ * Value registers decoded into AmsData, in the order they are read from a list. Adding a register only takes
+ * an entry here, it gets an OBIS_<name> constant, a case in AmsData::apply and a lookup in the DLMS decoder.
+ *
+ * name, C, D, E, AmsData field, its AmsField bit, minimum list type, divisor from meter unit to field unit
+ */
+#define OBIS_VALUE_REGISTERS(X) \
+    X(ACTIVE_IMPORT,            1,  7, 0, activeImportPower,     AmsFieldActiveImportPower,     1,    1) \
+    X(ACTIVE_EXPORT,            2,  7, 0, activeExportPower,     AmsFieldActiveExportPower,     1,    1) \
+    X(REACTIVE_IMPORT,          3,  7, 0, reactiveImportPower,   AmsFieldReactiveImportPower,   1,    1) \
+    X(REACTIVE_EXPORT,          4,  7, 0, reactiveExportPower,   AmsFieldReactiveExportPower,   1,    1) \
+    X(VOLTAGE_L1,              32,  7, 0, l1voltage,             AmsFieldL1Voltage,             2,    1) \
+    X(VOLTAGE_L2,              52,  7, 0, l2voltage,             AmsFieldL2Voltage,             2,    1) \
+    X(VOLTAGE_L3,              72,  7, 0, l3voltage,             AmsFieldL3Voltage,             2,    1) \
+    X(CURRENT_L1,              31,  7, 0, l1current,             AmsFieldL1Current,             2,    1) \
+    X(CURRENT_L2,              51,  7, 0, l2current,             AmsFieldL2Current,             2,    1) \
+    X(CURRENT_L3,              71,  7, 0, l3current,             AmsFieldL3Current,             2,    1) \
+    X(ACTIVE_IMPORT_COUNT,      1,  8, 0, activeImportCounter,   AmsFieldActiveImportCounter,   3, 1000) \
+    X(ACTIVE_EXPORT_COUNT,      2,  8, 0, activeExportCounter,   AmsFieldActiveExportCounter,   3, 1000) \
+    X(REACTIVE_IMPORT_COUNT,    3,  8, 0, reactiveImportCounter, AmsFieldReactiveImportCounter, 3, 1000) \
+    X(REACTIVE_EXPORT_COUNT,    4,  8, 0, reactiveExportCounter, AmsFieldReactiveExportCounter, 3, 1000) \
+    X(POWER_FACTOR,            13,  7, 0, powerFactor,           AmsFieldPowerFactor,           4,    1) \
+    X(POWER_FACTOR_L1,         33,  7, 0, l1PowerFactor,         AmsFieldL1PowerFactor,         4,    1) \
+    X(POWER_FACTOR_L2,         53,  7, 0, l2PowerFactor,         AmsFieldL2PowerFactor,         4,    1) \
+    X(POWER_FACTOR_L3,         73,  7, 0, l3PowerFactor,         AmsFieldL3PowerFactor,         4,    1) \
+    X(ACTIVE_IMPORT_L1,        21,  7, 0, l1activeImportPower,   AmsFieldL1ActiveImportPower,   4,    1) \
+    X(ACTIVE_IMPORT_L2,        41,  7, 0, l2activeImportPower,   AmsFieldL2ActiveImportPower,   4,    1) \
+    X(ACTIVE_IMPORT_L3,        61,  7, 0, l3activeImportPower,   AmsFieldL3ActiveImportPower,   4,    1) \
+    X(ACTIVE_EXPORT_L1,        22,  7, 0, l1activeExportPower,   AmsFieldL1ActiveExportPower,   4,    1) \
+    X(ACTIVE_EXPORT_L2,        42,  7, 0, l2activeExportPower,   AmsFieldL2ActiveExportPower,   4,    1) \
+    X(ACTIVE_EXPORT_L3,        62,  7, 0, l3activeExportPower,   AmsFieldL3ActiveExportPower,   4,    1) \
+    X(ACTIVE_IMPORT_L1_COUNT,  21,  8, 0, l1activeImportCounter, AmsFieldL1ActiveImportCounter, 4, 1000) \
+    X(ACTIVE_IMPORT_L2_COUNT,  41,  8, 0, l2activeImportCounter, AmsFieldL2ActiveImportCounter, 4, 1000) \
+    X(ACTIVE_IMPORT_L3_COUNT,  61,  8, 0, l3activeImportCounter, AmsFieldL3ActiveImportCounter, 4, 1000) \
+    X(ACTIVE_EXPORT_L1_COUNT,  22,  8, 0, l1activeExportCounter, AmsFieldL1ActiveExportCounter, 4, 1000) \
+    X(ACTIVE_EXPORT_L2_COUNT,  42,  8, 0, l2activeExportCounter, AmsFieldL2ActiveExportCounter, 4, 1000) \
+    X(ACTIVE_EXPORT_L3_COUNT,  62,  8, 0, l3activeExportCounter, AmsFieldL3ActiveExportCounter, 4, 1000)
+
+#define OBIS_KEY(sensor, gr, tariff) (((uint32_t) (sensor) << 16) | ((uint32_t) (gr) << 8) | (tariff))
+
+#define OBIS_REGISTER_CONSTANT(name, sensor, gr, tariff, field, bit, list, divisor) const OBIS_code_t OBIS_##name PROGMEM = { sensor, gr, tariff };
+OBIS_VALUE_REGISTERS(OBIS_REGISTER_CONSTANT)
 
 #endif
@@ -9,6 +9,7 @@
 AmsData::AmsData() {}
 
 void AmsData::apply(AmsData& other) {
+    changedFields = 0;
     if(other.getListType() < 3) {
         unsigned long ms = this->lastUpdateMillis > other.getLastUpdateMillis() ? 0 : other.getLastUpdateMillis() - this->lastUpdateMillis;
 
@@ -17,6 +18,7 @@ void AmsData::apply(AmsData& other) {
                 uint32_t power = (activeImportPower + other.getActiveImportPower()) / 2;
                 float add = power * (((float) ms) / 3600000.0);
                 activeImportCounter += add / 1000.0;
+                changedFields |= AMS_FIELD(AmsFieldActiveImportCounter);
                 //Serial.printf("%dW, %dms, %.6fkWh added\n", other.getActiveImportPower(), ms, add);
             }
 
@@ -26,16 +28,19 @@ void AmsData::apply(AmsData& other) {
                     uint32_t power = (activeExportPower + other.getActiveExportPower()) / 2;
                     float add = power * (((float) ms) / 3600000.0);
                     activeExportCounter += add / 1000.0;
+                    changedFields |= AMS_FIELD(AmsFieldActiveExportCounter);
                 }
                 if(other.getReactiveImportPower() > 0) {
                     uint32_t power = (reactiveImportPower + other.getReactiveImportPower()) / 2;
                     float add = power * (((float) ms) / 3600000.0);
                     reactiveImportCounter += add / 1000.0;
+                    changedFields |= AMS_FIELD(AmsFieldReactiveImportCounter);
                 }
                 if(other.getReactiveExportPower() > 0) {
                     uint32_t power = (reactiveExportPower + other.getReactiveExportPower()) / 2;
                     float add = power * (((float) ms) / 3600000.0);
                     reactiveExportCounter += add / 1000.0;
+                    changedFields |= AMS_FIELD(AmsFieldReactiveExportCounter);
                 }
             }
             counterEstimated = true;
@@ -49,138 +54,111 @@ void AmsData::apply(AmsData& other) {
     this->packageTimestamp = other.getPackageTimestamp();
     if(other.getListType() > this->listType)
         this->listType = other.getListType();
-    switch(other.getListType()) {
-        case 4:
-            this->powerFactor = other.getPowerFactor();
-            this->l1PowerFactor = other.getL1PowerFactor();
-            this->l2PowerFactor = other.getL2PowerFactor();
-            this->l3PowerFactor = other.getL3PowerFactor();
-            this->l1activeImportPower = other.getL1ActiveImportPower();
-            this->l2activeImportPower = other.getL2ActiveImportPower();
-            this->l3activeImportPower = other.getL3ActiveImportPower();
-            this->l1activeExportPower = other.getL1ActiveExportPower();
-            this->l2activeExportPower = other.getL2ActiveExportPower();
-            this->l3activeExportPower = other.getL3ActiveExportPower();
-            this->l1activeImportCounter = other.getL1ActiveImportCounter();
-            this->l2activeImportCounter = other.getL2ActiveImportCounter();
-            this->l3activeImportCounter = other.getL3ActiveImportCounter();
-            this->l1activeExportCounter = other.getL1ActiveExportCounter();
-            this->l2activeExportCounter = other.getL2ActiveExportCounter();
-            this->l3activeExportCounter = other.getL3ActiveExportCounter();
-        case 3:
-            this->meterTimestamp = other.getMeterTimestamp();
-            this->activeImportCounter = other.getActiveImportCounter();
-            this->activeExportCounter = other.getActiveExportCounter();
-            this->reactiveImportCounter = other.getReactiveImportCounter();
-            this->reactiveExportCounter = other.getReactiveExportCounter();
-            this->counterEstimated = false;
-        case 2:
-            this->listId = other.getListId();
-            this->meterId = other.getMeterId();
-            this->meterType = other.getMeterType();
-            this->meterModel = other.getMeterModel();
-            this->reactiveImportPower = other.getReactiveImportPower();
-            this->reactiveExportPower = other.getReactiveExportPower();
-            this->l1current = other.getL1Current();
-            this->l2current = other.getL2Current();
-            this->l2currentMissing = other.isL2currentMissing();
-            this->l3current = other.getL3Current();
-            this->l1voltage = other.getL1Voltage();
-            this->l2voltage = other.getL2Voltage();
-            this->l3voltage = other.getL3Voltage();
-            this->threePhase = other.isThreePhase();
-            this->twoPhase = other.isTwoPhase();
-    }
 
-    // Moved outside switch to handle meters alternating between sending active and accumulated values
-    if(other.getListType() == 1 || (other.getActiveImportPower() > 0 || other.getActiveExportPower() > 0))
-        this->activeImportPower = other.getActiveImportPower();
-    if(other.getListType() == 2 || (other.getActiveImportPower() > 0 || other.getActiveExportPower() > 0))
-        this->activeExportPower = other.getActiveExportPower();
+    changedFields |= merge(other, true);
+    presentFields |= other.presentFields;
+    if(other.getListType() > 2)
+        this->counterEstimated = false;
+    updateCount++;
 }
 
-void AmsData::apply(OBIS_code_t obis, double value) {
-    switch(obis.gr) {
-        case 1:
-            switch(obis.sensor) {
-                case 7:
-                    switch(obis.tariff) {
-                        case 0:
-                            activeImportPower = value; 
-                            listType = max(listType, (uint8_t) 1);
-                            break;
-                    }
-                    break;
-                case 8:
-                    switch(obis.tariff) {
-                        case 0:
-                            activeImportCounter = value; 
-                            listType = max(listType, (uint8_t) 3);
-                            break;
-                    }
-                    break;
-            }
-            break;
-        case 2:
-            switch(obis.sensor) {
-                case 7:
-                    switch(obis.tariff) {
-                        case 0:
-                            activeExportPower = value; 
-                            listType = max(listType, (uint8_t) 2);
-                            break;
-                    }
-                    break;
-                case 8:
-                    switch(obis.tariff) {
-                        case 0:
-                            activeExportCounter = value; 
-                            listType = max(listType, (uint8_t) 3);
-                            break;
-                    }
-                    break;
-            }
-            break;
-        case 3:
-            switch(obis.sensor) {
-                case 7:
-                    switch(obis.tariff) {
-                        case 0:
-                            reactiveImportPower = value; 
-                            listType = max(listType, (uint8_t) 2);
-                            break;
-                    }
-                    break;
-                case 8:
-                    switch(obis.tariff) {
-                        case 0:
-                            reactiveImportCounter = value; 
-                            listType = max(listType, (uint8_t) 3);
-                            break;
-                    }
-                    break;
-            }
-            break;
-        case 4:
-            switch(obis.sensor) {
-                case 7:
-                    switch(obis.tariff) {
-                        case 0:
-                            reactiveExportPower = value; 
-                            listType = max(listType, (uint8_t) 2);
-                            break;
-                    }
-                    break;
-                case 8:
-                    switch(obis.tariff) {
-                        case 0:
-                            reactiveExportCounter = value; 
-                            listType = max(listType, (uint8_t) 3);
-                            break;
-                    }
-                    break;
-            }
+uint64_t AmsData::getPresentFields() {
+    return presentFields;
+}
+
+uint64_t AmsData::getChangedFields() {
+    return changedFields;
+}
+
+uint64_t AmsData::diff(AmsData& other) {
+    return merge(other, false);
+}
+
+uint32_t AmsData::getUpdateCount() {
+    return updateCount;
+}
+
+#define AMS_MERGE_VALUE(bit, member) \
+    if((fields & AMS_FIELD(bit)) && member != other.member) { \
+        if(write) member = other.member; \
+        changed |= AMS_FIELD(bit); \
+    }
+
+#define AMS_MERGE_STRING(bit, member) \
+    if((fields & AMS_FIELD(bit)) && strncmp(member, other.member, sizeof(member)) != 0) { \
+        if(write) memcpy(member, other.member, sizeof(member)); \
+        changed |= AMS_FIELD(bit); \
+    }
+
+// Copies the fields present in other when write is set, returns the ones that differ
+uint64_t AmsData::merge(AmsData& other, bool write) {
+    uint64_t fields = other.getPresentFields();
+    uint64_t changed = 0;
+
+    AMS_MERGE_STRING(AmsFieldListId, listId)
+    AMS_MERGE_STRING(AmsFieldMeterId, meterId)
+    AMS_MERGE_VALUE(AmsFieldMeterType, meterType)
+    AMS_MERGE_STRING(AmsFieldMeterModel, meterModel)
+    AMS_MERGE_VALUE(AmsFieldMeterTimestamp, meterTimestamp)
+
+    AMS_MERGE_VALUE(AmsFieldActiveImportPower, activeImportPower)
+    AMS_MERGE_VALUE(AmsFieldReactiveImportPower, reactiveImportPower)
+    AMS_MERGE_VALUE(AmsFieldActiveExportPower, activeExportPower)
+    AMS_MERGE_VALUE(AmsFieldReactiveExportPower, reactiveExportPower)
+
+    AMS_MERGE_VALUE(AmsFieldL1Voltage, l1voltage)
+    AMS_MERGE_VALUE(AmsFieldL2Voltage, l2voltage)
+    AMS_MERGE_VALUE(AmsFieldL3Voltage, l3voltage)
+    AMS_MERGE_VALUE(AmsFieldL1Current, l1current)
+    AMS_MERGE_VALUE(AmsFieldL2Current, l2current)
+    AMS_MERGE_VALUE(AmsFieldL3Current, l3current)
+    if((fields & AMS_FIELD(AmsFieldPhases)) && (threePhase != other.threePhase || twoPhase != other.twoPhase || l2currentMissing != other.l2currentMissing)) {
+        if(write) {
+            threePhase = other.threePhase;
+            twoPhase = other.twoPhase;
+            l2currentMissing = other.l2currentMissing;
+        }
+        changed |= AMS_FIELD(AmsFieldPhases);
+    }
+
+    AMS_MERGE_VALUE(AmsFieldPowerFactor, powerFactor)
+    AMS_MERGE_VALUE(AmsFieldL1PowerFactor, l1PowerFactor)
+    AMS_MERGE_VALUE(AmsFieldL2PowerFactor, l2PowerFactor)
+    AMS_MERGE_VALUE(AmsFieldL3PowerFactor, l3PowerFactor)
+
+    AMS_MERGE_VALUE(AmsFieldL1ActiveImportPower, l1activeImportPower)
+    AMS_MERGE_VALUE(AmsFieldL2ActiveImportPower, l2activeImportPower)
+    AMS_MERGE_VALUE(AmsFieldL3ActiveImportPower, l3activeImportPower)
+    AMS_MERGE_VALUE(AmsFieldL1ActiveExportPower, l1activeExportPower)
+    AMS_MERGE_VALUE(AmsFieldL2ActiveExportPower, l2activeExportPower)
+    AMS_MERGE_VALUE(AmsFieldL3ActiveExportPower, l3activeExportPower)
+
+    AMS_MERGE_VALUE(AmsFieldL1ActiveImportCounter, l1activeImportCounter)
+    AMS_MERGE_VALUE(AmsFieldL2ActiveImportCounter, l2activeImportCounter)
+    AMS_MERGE_VALUE(AmsFieldL3ActiveImportCounter, l3activeImportCounter)
+    AMS_MERGE_VALUE(AmsFieldL1ActiveExportCounter, l1activeExportCounter)
+    AMS_MERGE_VALUE(AmsFieldL2ActiveExportCounter, l2activeExportCounter)
+    AMS_MERGE_VALUE(AmsFieldL3ActiveExportCounter, l3activeExportCounter)
+
+    AMS_MERGE_VALUE(AmsFieldActiveImportCounter, activeImportCounter)
+    AMS_MERGE_VALUE(AmsFieldReactiveImportCounter, reactiveImportCounter)
+    AMS_MERGE_VALUE(AmsFieldActiveExportCounter, activeExportCounter)
+    AMS_MERGE_VALUE(AmsFieldReactiveExportCounter, reactiveExportCounter)
+
+    return changed;
+}
+
+// Value is expected in the unit of the AmsData field, the compiler turns the register table into a sorted switch
+#define OBIS_APPLY_CASE(name, sensor, gr, tariff, field, bit, list, divisor) \
+        case OBIS_KEY(sensor, gr, tariff): \
+            field = value; \
+            presentFields |= AMS_FIELD(bit); \
+            listType = max(listType, (uint8_t) list); \
             break;
+
+void AmsData::apply(OBIS_code_t obis, double value) {
+    switch(OBIS_KEY(obis.sensor, obis.gr, obis.tariff)) {
+        OBIS_VALUE_REGISTERS(OBIS_APPLY_CASE)
     }
 }
 
@@ -196,11 +174,11 @@ uint8_t AmsData::getListType() {
     return this->listType;
 }
 
-String AmsData::getListId() {
+const char* AmsData::getListId() {
     return this->listId;
 }
 
-String AmsData::getMeterId() {
+const char* AmsData::getMeterId() {
     return this->meterId;
 }
 
@@ -208,7 +186,7 @@ uint8_t AmsData::getMeterType() {
     return this->meterType;
 }
 
-String AmsData::getMeterModel() {
+const char* AmsData::getMeterModel() {
     return this->meterModel;
 }
 
@@ -363,4 +341,24 @@ void AmsData::setLastError(int8_t lastError) {
     } else {
         lastErrorCount++;
     }
-}
\ No newline at end of file
+}
+
+static void copyIdentifier(char* target, const char* value, size_t size) {
+    strncpy(target, value, size - 1);
+    target[size - 1] = '\0';
+}
+
+void AmsData::setListId(const char* value) {
+    copyIdentifier(listId, value, sizeof(listId));
+    presentFields |= AMS_FIELD(AmsFieldListId);
+}
+
+void AmsData::setMeterId(const char* value) {
+    copyIdentifier(meterId, value, sizeof(meterId));
+    presentFields |= AMS_FIELD(AmsFieldMeterId);
+}
+
+void AmsData::setMeterModel(const char* value) {
+    copyIdentifier(meterModel, value, sizeof(meterModel));
+    presentFields |= AMS_FIELD(AmsFieldMeterModel);
+}
@@ -10,6 +10,9 @@
 #include "AmsData.h"
 #include "RemoteDebug.h"
 #include "Timezone.h"
+#include "RecordLog.h"
+#include "QuarterHourStorage.h"
+#include "HistoryStorage.h"
 
 struct DayDataPoints5 {
     uint8_t version;
@@ -53,15 +56,25 @@ struct MonthDataPoints {
 
 class AmsDataStorage {
 public:
-    AmsDataStorage(RemoteDebug*);
+    AmsDataStorage(RemoteDebug*, RecordLog*);
     void setTimezone(Timezone*);
     bool update(AmsData*);
+    bool sample(AmsData*);
     uint32_t getHourImport(uint8_t);
     uint32_t getHourExport(uint8_t);
     uint32_t getDayImport(uint8_t);
     uint32_t getDayExport(uint8_t);
+    uint16_t getQuarterHours(time_t from, uint16_t count, uint32_t* imp, uint32_t* exp);
+    uint16_t getHistory(uint8_t tier, time_t from, time_t to, HistorySlot* slots, uint16_t max);
     bool load();
     bool save();
+    // Record log streams written by save()
+    uint8_t getStreams();
+    // Closed quarter hour days and history slots that are not in their files yet, written before the record log streams
+    bool hasPendingWrites();
+    // A day has closed, closed hours alone can wait in RAM for it
+    bool isWriteDue();
+    int32_t writePending();
 
     DayDataPoints getDayData();
     bool setDayData(DayDataPoints&);
@@ -96,6 +109,11 @@ private:
         10
     };
     RemoteDebug* debugger;
+    RecordLog* records;
+    QuarterHourStorage quarters;
+    HistoryStorage history;
+    time_t getTime(AmsData*);
+    bool loadFiles();
     void setHourImport(uint8_t, uint32_t);
     void setHourExport(uint8_t, uint32_t);
     void setDayImport(uint8_t, uint32_t);
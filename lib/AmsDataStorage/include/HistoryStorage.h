@@ -0,0 +1,135 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _HISTORYSTORAGE_H
+#define _HISTORYSTORAGE_H
+
+#include "Arduino.h"
+#include "AmsData.h"
+#include "RemoteDebug.h"
+#include "Timezone.h"
+#include "RecordLog.h"
+
+#define HISTORY_TIER_MINUTE 0
+#define HISTORY_TIER_HOUR 1
+#define HISTORY_TIER_DAY 2
+#define HISTORY_TIER_MONTH 3
+#define HISTORY_TIER_YEAR 4
+#define HISTORY_TIERS 5
+
+// Slots kept of each tier, can be set with build flags to fit the flash budget. Minutes are only kept in memory, up to
+// 255 of them. The other tiers append closed slots to one of two files each and start the other file over when it has
+// this many, so between this and twice as many are kept
+#ifndef HISTORY_MINUTES
+#if defined(ESP8266)
+#define HISTORY_MINUTES 15
+#else
+#define HISTORY_MINUTES 60
+#endif
+#endif
+#ifndef HISTORY_HOURS
+#define HISTORY_HOURS 168
+#endif
+#ifndef HISTORY_DAYS
+#define HISTORY_DAYS 366
+#endif
+#ifndef HISTORY_MONTHS
+#define HISTORY_MONTHS 36
+#endif
+#ifndef HISTORY_YEARS
+#define HISTORY_YEARS 10
+#endif
+
+// Closed hours wait in RAM for the day to close, each append to a file has LittleFS copy its last block to a newly
+// erased one. Room is kept for the day, month and year closed with the last hour
+#ifndef HISTORY_PENDING_HOURS
+#define HISTORY_PENDING_HOURS 24
+#endif
+#define HISTORY_PENDING (HISTORY_PENDING_HOURS + 3)
+
+/**
+ * Energy in Wh and the lowest and highest power in W over a slot. Min is higher than max when the slot has no power
+ * readings. Hours have the energy from the meter counters, the tiers above add up the slots of the one below.
+ */
+struct HistorySlot {
+    uint32_t start;
+    uint32_t importEnergy;
+    uint32_t exportEnergy;
+    uint32_t importMin;
+    uint32_t importMax;
+    uint32_t exportMin;
+    uint32_t exportMax;
+};
+
+// The day, month and year that are not complete yet, kept as a record log stream
+struct HistoryData {
+    uint8_t version;
+    HistorySlot open[3];
+};
+
+/**
+ * Round robin history in tiers of minutes, hours, days, months and years. Each slot is added to the open slot of the
+ * tier above when it is closed, so a tier is never computed again from the one below. Days, months and years follow
+ * the local time zone.
+ */
+class HistoryStorage {
+public:
+    HistoryStorage(RemoteDebug*, RecordLog*);
+    void setTimezone(Timezone*);
+    bool load();
+
+    // Power readings for the minutes, and the hour they are in
+    void sample(AmsData*, time_t now);
+    // The hour from the meter counters, closes it and adds it to the day
+    void addHour(time_t start, uint32_t imp, uint32_t exp);
+
+    // Copies the slots of a tier that start from from and before to, oldest first and with the open one last.
+    // Returns the number of slots
+    uint16_t getSlots(uint8_t tier, time_t from, time_t to, HistorySlot* slots, uint16_t max);
+
+    // Closed slots wait in RAM until they are appended to their files here from the persistence scheduler, so an hour
+    // closing does not write flash while a HAN frame is arriving. The record log stream must be saved after this.
+    // Returns the number of bytes written or -1 when a slot could not be written. The one write left outside is the
+    // repair of a file with an interrupted slot, when the tier is first used after a boot
+    bool hasPending();
+    // A day or more has closed, or the hours waiting fill what is kept for them
+    bool isWriteDue();
+    int32_t writePending();
+
+private:
+    RemoteDebug* debugger;
+    RecordLog* records;
+    Timezone* tz = NULL;
+    HistoryData data;
+
+    HistorySlot minutes[HISTORY_MINUTES];
+    uint8_t minuteHead = 0;
+    float minuteImport = 0, minuteExport = 0;
+    HistorySlot hours[2]; // By odd and even hour, the last one is still open when its counters arrive
+    uint64_t lastUpdateMillis = 0;
+
+    bool scanned[HISTORY_TIERS];
+    uint8_t active[HISTORY_TIERS];
+    uint16_t count[HISTORY_TIERS];
+    uint32_t last[HISTORY_TIERS];
+    HistorySlot pending[HISTORY_PENDING]; // In the order they were closed
+    uint8_t pendingTier[HISTORY_PENDING];
+    uint8_t pendingCount = 0;
+
+    time_t getStart(uint8_t tier, time_t);
+    uint16_t getTierSize(uint8_t tier);
+    void getPath(uint8_t tier, uint8_t file, char* buf);
+    void clear(HistorySlot&, uint32_t start);
+    void add(HistorySlot& to, HistorySlot& from);
+    void closeMinute();
+    void rollUp(uint8_t tier, HistorySlot&);
+    void scan(uint8_t tier);
+    bool append(uint8_t tier, HistorySlot&);
+    bool write(uint8_t tier);
+    uint16_t readFile(uint8_t tier, uint8_t file, time_t from, time_t to, HistorySlot* slots, uint16_t max);
+};
+
+#endif
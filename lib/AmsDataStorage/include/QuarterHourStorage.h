@@ -0,0 +1,96 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _QUARTERHOURSTORAGE_H
+#define _QUARTERHOURSTORAGE_H
+
+#include "Arduino.h"
+#include "AmsData.h"
+#include "RemoteDebug.h"
+#include "Timezone.h"
+#include "RecordLog.h"
+
+// Encoded size of the open day, three bytes per value covers quarters of up to 4 MWh for the 100 quarters of a 25 hour day
+#define QUARTER_HOUR_BUFFER 600
+// Quarters that can be waiting for a counter reading, meters that send counters once an hour need four
+#define QUARTER_HOUR_ESTIMATES 8
+// Closed days go to the file of their 30 day period, a file from an older period is started over when used again.
+// With three files, this keeps at least 60 days
+#define QUARTER_HOUR_FILES 3
+#define QUARTER_HOUR_FILE_DAYS 30
+
+/**
+ * The day being recorded, kept as a record log stream. Each quarter is the difference in Wh from the one before for
+ * import and then export, zigzag encoded so small negative differences stay small, and written as a varint.
+ */
+struct QuarterHourDay {
+    uint8_t version;
+    uint8_t count;
+    uint16_t length;
+    time_t start; // Local midnight
+    uint32_t lastImport; // The last quarter in data, the next one is encoded against these
+    uint32_t lastExport;
+    uint64_t activeImport; // Meter counters at the end of the last quarter in data
+    uint64_t activeExport;
+    uint8_t data[QUARTER_HOUR_BUFFER];
+};
+
+/**
+ * Header of a closed day in the history files, followed by its encoded quarters. The CRC covers the header with the
+ * CRC field set to 0, followed by the quarters.
+ */
+struct QuarterHourBlock {
+    uint32_t start;
+    uint16_t length;
+    uint8_t count;
+    uint8_t version;
+    uint16_t crc;
+    uint16_t reserved;
+};
+
+/**
+ * Import and export for each 15 minute interval. Values come from the meter counters, the same way as the hourly
+ * values in AmsDataStorage. Meters that only send counters once an hour get the hour split between its quarters by
+ * the energy measured from the power readings, and a gap without readings is spread evenly.
+ */
+class QuarterHourStorage {
+public:
+    QuarterHourStorage(RemoteDebug*, RecordLog*);
+    void setTimezone(Timezone*);
+    bool update(AmsData*, time_t now);
+    bool load();
+
+    // Fills import and export in Wh for count quarters from the one that contains from, quarters without data are 0.
+    // Returns the number of quarters that had data
+    uint16_t getQuarters(time_t from, uint16_t count, uint32_t* imp, uint32_t* exp);
+
+    // A closed day is held in RAM until it is written to its file here, from the persistence scheduler, as writing
+    // flash in update() could stall a HAN frame. The record log stream must be saved after this. Returns the number of
+    // bytes written or -1 when it failed, the day is then kept to try again
+    bool hasPending();
+    int32_t writePending();
+
+private:
+    RemoteDebug* debugger;
+    RecordLog* records;
+    Timezone* tz = NULL;
+    QuarterHourDay day;
+    uint8_t dayQuarters = 0;
+    uint64_t lastUpdateMillis = 0;
+    float estImport[QUARTER_HOUR_ESTIMATES];
+    float estExport[QUARTER_HOUR_ESTIMATES];
+    bool estimated = false; // The power readings have covered all the time since the last counter
+    QuarterHourBlock pendingBlock;
+    uint8_t* pending = NULL; // Quarters of the closed day that is not in its file yet
+
+    time_t getDayStart(time_t);
+    void startDay(uint32_t quarter);
+    bool closeDay();
+    bool seek(uint32_t quarter);
+    bool append(uint32_t imp, uint32_t exp);
+};
+
+#endif
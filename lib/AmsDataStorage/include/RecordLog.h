@@ -0,0 +1,100 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _RECORDLOG_H
+#define _RECORDLOG_H
+
+#include "Arduino.h"
+#include "RemoteDebug.h"
+#include "LittleFS.h"
+
+// Each segment is compacted into the other before it grows past this, so loading reads at most twice this
+#define RECORD_LOG_SEGMENT_SIZE 4096
+
+#define RECORD_LOG_STREAMS 8
+#define RECORD_LOG_STREAM_DAY 0
+#define RECORD_LOG_STREAM_MONTH 1
+#define RECORD_LOG_STREAM_ACCOUNTING 2
+#define RECORD_LOG_STREAM_QUARTER 3
+#define RECORD_LOG_STREAM_HISTORY 4
+
+// Stream byte of the record that starts a segment and of the one that ends each save, the value is the generation of
+// the segment. Records after the last end record were interrupted while saving, and a segment without one is ignored
+#define RECORD_LOG_HEADER 0xFF
+#define RECORD_LOG_BEGIN 0
+#define RECORD_LOG_END 1
+// Set on the stream byte of a record that clears the stream, starts each stream in a compacted segment
+#define RECORD_LOG_RESET 0x80
+
+/**
+ * One word of a stream. The CRC covers the whole record with the CRC field set to 0.
+ */
+struct RecordLogEntry {
+    uint8_t stream;
+    uint8_t word;
+    uint16_t crc;
+    uint32_t value;
+};
+
+/**
+ * Persists structs as an append-only log of changed 32 bit words, instead of rewriting the whole file each time.
+ * A save compares the struct with a copy of what was last written and appends one record per changed word to the
+ * active segment. When the segment is full, the current state is written as a snapshot to the other segment, which
+ * becomes the active one. Streams that are in the log but not loaded yet hold compaction back, as the snapshot would
+ * lose them. Loading replays both segments, oldest first, up to the end record of the last complete save.
+ */
+class RecordLog {
+public:
+    RecordLog(RemoteDebug*);
+    ~RecordLog();
+
+    // The struct kept in the stream, does not touch the file system
+    void attach(uint8_t stream, void* data, uint16_t size);
+    // Replays the stream into the attached struct, returns false when the log has nothing for it
+    bool load(uint8_t stream);
+    // Appends the changed words of the streams in the mask, one bit per stream. A stream that was never loaded
+    // replaces what the log had
+    bool save(uint8_t mask);
+    // For after the file system has been formatted, the log is scanned again and the next save writes the loaded
+    // streams as a snapshot, also when nothing has changed
+    void reset();
+
+    uint32_t getBytesWritten();
+    uint32_t getRecordsWritten();
+    // Records of the stream, from saves and compactions
+    uint32_t getRecordsWritten(uint8_t stream);
+    uint16_t getCompactions();
+
+private:
+    RemoteDebug* debugger;
+    uint8_t* data[RECORD_LOG_STREAMS] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    uint8_t* shadow[RECORD_LOG_STREAMS] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    uint16_t size[RECORD_LOG_STREAMS] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    bool scanned = false;
+    uint32_t generation[2] = { 0, 0 };
+    uint32_t length[2] = { 0, 0 }; // Up to the last end record
+    uint8_t active = 0;
+    uint32_t activeSize = 0;
+    bool damaged = false; // The next save compacts, as appending would leave the records after a broken one
+    bool writeFailed = false;
+    bool snapshot = false; // The next save compacts, the files are gone
+    uint8_t present = 0; // Streams that have records in the log
+    uint8_t loaded = 0; // Streams where the attached struct is what the log has
+
+    uint32_t bytesWritten = 0;
+    uint32_t recordsWritten = 0;
+    uint32_t streamRecords[RECORD_LOG_STREAMS] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    uint16_t compactions = 0;
+
+    void scan();
+    bool readEntry(File& file, RecordLogEntry& entry);
+    void writeEntry(File& file, uint8_t stream, uint8_t word, uint32_t value);
+    uint16_t writeChanges(File* file, uint8_t stream, bool all);
+    bool compact();
+};
+
+#endif
@@ -10,27 +10,26 @@
 #include "AmsStorage.h"
 #include "FirmwareVersion.h"
 
-AmsDataStorage::AmsDataStorage(RemoteDebug* debugger) {
+AmsDataStorage::AmsDataStorage(RemoteDebug* debugger, RecordLog* records) : quarters(debugger, records), history(debugger, records) {
     day.version = 6;
     day.accuracy = 1;
     month.version = 7;
     month.accuracy = 1;
     this->debugger = debugger;
+    this->records = records;
+    records->attach(RECORD_LOG_STREAM_DAY, &day, sizeof(day));
+    records->attach(RECORD_LOG_STREAM_MONTH, &month, sizeof(month));
 }
 
 void AmsDataStorage::setTimezone(Timezone* tz) {
     this->tz = tz;
+    quarters.setTimezone(tz);
+    history.setTimezone(tz);
 }
 
-bool AmsDataStorage::update(AmsData* data) {
-    if(isHappy()) {
-        return false;
-    }
-
+// Falls back to the meter clock until NTP has set the time
+time_t AmsDataStorage::getTime(AmsData* data) {
     time_t now = time(nullptr);
-    if(tz == NULL) {
-        return false;
-    }
     if(now < FirmwareVersion::BuildEpoch) {
         if(data->getMeterTimestamp() > FirmwareVersion::BuildEpoch) {
             now = data->getMeterTimestamp();
@@ -38,6 +37,18 @@ bool AmsDataStorage::update(AmsData* data) {
             now = data->getPackageTimestamp();
         }
     }
+    return now;
+}
+
+bool AmsDataStorage::update(AmsData* data) {
+    if(isHappy()) {
+        return false;
+    }
+
+    if(tz == NULL) {
+        return false;
+    }
+    time_t now = getTime(data);
     if(now < FirmwareVersion::BuildEpoch) {
         return false;
     }
@@ -130,6 +141,7 @@ bool AmsDataStorage::update(AmsData* data) {
             uint32_t exp = exportCounter - day.activeExport;
             setHourImport(utcYesterday.Hour, imp);
             setHourExport(utcYesterday.Hour, exp);
+            history.addHour(now - (now % 3600) - 3600, imp, exp);
 
             day.activeImport = importCounter;
             day.activeExport = exportCounter;
@@ -155,6 +167,7 @@ bool AmsDataStorage::update(AmsData* data) {
                 float exp = (epm * minutes);
                 setHourImport(last.Hour, imp);
                 setHourExport(last.Hour, exp);
+                history.addHour(day.lastMeterReadTime, imp, exp);
 
                 day.activeImport += imp;
                 day.activeExport += exp;
@@ -214,6 +227,27 @@ bool AmsDataStorage::update(AmsData* data) {
     return ret;
 }
 
+// Each reading from the meter, for the quarter hours and the minutes of the history
+bool AmsDataStorage::sample(AmsData* data) {
+    if(tz == NULL) {
+        return false;
+    }
+    time_t now = getTime(data);
+    if(now < FirmwareVersion::BuildEpoch) {
+        return false;
+    }
+    history.sample(data, now);
+    return quarters.update(data, now);
+}
+
+uint16_t AmsDataStorage::getQuarterHours(time_t from, uint16_t count, uint32_t* imp, uint32_t* exp) {
+    return quarters.getQuarters(from, count, imp, exp);
+}
+
+uint16_t AmsDataStorage::getHistory(uint8_t tier, time_t from, time_t to, HistorySlot* slots, uint16_t max) {
+    return history.getSlots(tier, from, to, slots, max);
+}
+
 void AmsDataStorage::setHourImport(uint8_t hour, uint32_t val) {
     if(hour < 0 || hour > 24) return;
     
@@ -375,6 +409,20 @@ bool AmsDataStorage::load() {
         return false;
     }
 
+    bool hasDay = records->load(RECORD_LOG_STREAM_DAY);
+    bool hasMonth = records->load(RECORD_LOG_STREAM_MONTH);
+    quarters.load();
+    history.load();
+    if(hasDay || hasMonth) {
+        DayDataPoints day = this->day;
+        MonthDataPoints month = this->month;
+        return setDayData(day) & setMonthData(month);
+    }
+    return loadFiles();
+}
+
+// Plot files from before the record log, their contents are moved into it
+bool AmsDataStorage::loadFiles() {
     bool ret = false;
     if(LittleFS.exists(FILE_DAYPLOT)) {
         File file = LittleFS.open(FILE_DAYPLOT, "r");
@@ -424,6 +472,10 @@ bool AmsDataStorage::load() {
         file.close();
     }
 
+    if(ret && save()) {
+        LittleFS.remove(FILE_DAYPLOT);
+        LittleFS.remove(FILE_MONTHPLOT);
+    }
     return ret;
 }
 
@@ -431,25 +483,35 @@ bool AmsDataStorage::save() {
     if(!LittleFS.begin()) {
         return false;
     }
-    {
-        File file = LittleFS.open(FILE_DAYPLOT, "w");
-        char buf[sizeof(day)];
-        memcpy(buf, &day, sizeof(day));
-        for(unsigned long i = 0; i < sizeof(day); i++) {
-            file.write(buf[i]);
-        }
-        file.close();
+    // The record log no longer has a closed day or slot, it is only in RAM until its file is written
+    if(writePending() < 0) {
+        return false;
     }
-    {
-        File file = LittleFS.open(FILE_MONTHPLOT, "w");
-        char buf[sizeof(month)];
-        memcpy(buf, &month, sizeof(month));
-        for(unsigned long i = 0; i < sizeof(month); i++) {
-            file.write(buf[i]);
-        }
-        file.close();
+    return records->save(getStreams());
+}
+
+bool AmsDataStorage::hasPendingWrites() {
+    return quarters.hasPending() || history.hasPending();
+}
+
+bool AmsDataStorage::isWriteDue() {
+    return quarters.hasPending() || history.isWriteDue();
+}
+
+int32_t AmsDataStorage::writePending() {
+    if(!hasPendingWrites()) {
+        return 0;
     }
-    return true;
+    if(!LittleFS.begin()) {
+        return -1;
+    }
+    int32_t q = quarters.writePending();
+    int32_t h = history.writePending();
+    return q < 0 || h < 0 ? -1 : q + h;
+}
+
+uint8_t AmsDataStorage::getStreams() {
+    return (1 << RECORD_LOG_STREAM_DAY) | (1 << RECORD_LOG_STREAM_MONTH) | (1 << RECORD_LOG_STREAM_QUARTER) | (1 << RECORD_LOG_STREAM_HISTORY);
 }
 
 DayDataPoints AmsDataStorage::getDayData() {
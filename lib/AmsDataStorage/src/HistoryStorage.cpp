@@ -0,0 +1,372 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "HistoryStorage.h"
+#include "LittleFS.h"
+#include "AmsStorage.h"
+
+HistoryStorage::HistoryStorage(RemoteDebug* debugger, RecordLog* records) {
+    this->debugger = debugger;
+    this->records = records;
+    memset(&data, 0, sizeof(data));
+    data.version = 1;
+    for(uint8_t i = 0; i < HISTORY_MINUTES; i++) clear(minutes[i], 0);
+    clear(hours[0], 0);
+    clear(hours[1], 0);
+    for(uint8_t i = 0; i < HISTORY_TIERS; i++) scanned[i] = false;
+    records->attach(RECORD_LOG_STREAM_HISTORY, &data, sizeof(data));
+}
+
+void HistoryStorage::setTimezone(Timezone* tz) {
+    this->tz = tz;
+}
+
+bool HistoryStorage::load() {
+    bool ret = records->load(RECORD_LOG_STREAM_HISTORY);
+    if(ret && data.version != 1) {
+        memset(&data, 0, sizeof(data));
+        data.version = 1;
+        ret = false;
+    }
+    return ret;
+}
+
+void HistoryStorage::clear(HistorySlot& slot, uint32_t start) {
+    slot.start = start;
+    slot.importEnergy = 0;
+    slot.exportEnergy = 0;
+    slot.importMin = UINT32_MAX;
+    slot.importMax = 0;
+    slot.exportMin = UINT32_MAX;
+    slot.exportMax = 0;
+}
+
+void HistoryStorage::add(HistorySlot& to, HistorySlot& from) {
+    to.importEnergy += from.importEnergy;
+    to.exportEnergy += from.exportEnergy;
+    if(from.importMin < to.importMin) to.importMin = from.importMin;
+    if(from.importMax > to.importMax) to.importMax = from.importMax;
+    if(from.exportMin < to.exportMin) to.exportMin = from.exportMin;
+    if(from.exportMax > to.exportMax) to.exportMax = from.exportMax;
+}
+
+time_t HistoryStorage::getStart(uint8_t tier, time_t t) {
+    if(tier == HISTORY_TIER_MINUTE) return t - (t % 60);
+    if(tier == HISTORY_TIER_HOUR) return t - (t % 3600);
+
+    tmElements_t tm;
+    breakTime(tz == NULL ? t : tz->toLocal(t), tm);
+    tm.Hour = 0;
+    tm.Minute = 0;
+    tm.Second = 0;
+    if(tier >= HISTORY_TIER_MONTH) tm.Day = 1;
+    if(tier >= HISTORY_TIER_YEAR) tm.Month = 1;
+    time_t local = makeTime(tm);
+    return tz == NULL ? local : tz->toUTC(local);
+}
+
+uint16_t HistoryStorage::getTierSize(uint8_t tier) {
+    switch(tier) {
+        case HISTORY_TIER_HOUR: return HISTORY_HOURS;
+        case HISTORY_TIER_DAY: return HISTORY_DAYS;
+        case HISTORY_TIER_MONTH: return HISTORY_MONTHS;
+        case HISTORY_TIER_YEAR: return HISTORY_YEARS;
+    }
+    return HISTORY_MINUTES;
+}
+
+void HistoryStorage::getPath(uint8_t tier, uint8_t file, char* buf) {
+    snprintf_P(buf, 24, PSTR(FILE_HISTORY), tier, file);
+}
+
+void HistoryStorage::sample(AmsData* meter, time_t now) {
+    if(meter->getListType() == 0) return;
+
+    uint32_t minute = getStart(HISTORY_TIER_MINUTE, now);
+    if(minutes[minuteHead].start != minute) {
+        if(minutes[minuteHead].start != 0) closeMinute();
+        clear(minutes[minuteHead], minute);
+    }
+
+    uint64_t ms = meter->getLastUpdateMillis();
+    if(ms > lastUpdateMillis) {
+        if(lastUpdateMillis != 0 && ms - lastUpdateMillis < 60000) {
+            float hours = (ms - lastUpdateMillis) / 3600000.0;
+            minuteImport += meter->getActiveImportPower() * hours;
+            minuteExport += meter->getActiveExportPower() * hours;
+        }
+        lastUpdateMillis = ms;
+    }
+
+    HistorySlot& slot = minutes[minuteHead];
+    slot.importEnergy = minuteImport;
+    slot.exportEnergy = minuteExport;
+    uint32_t imp = meter->getActiveImportPower();
+    if(imp < slot.importMin) slot.importMin = imp;
+    if(imp > slot.importMax) slot.importMax = imp;
+    // List 1 only has import
+    if(meter->getListType() > 1) {
+        uint32_t exp = meter->getActiveExportPower();
+        if(exp < slot.exportMin) slot.exportMin = exp;
+        if(exp > slot.exportMax) slot.exportMax = exp;
+    }
+}
+
+// Whole Wh go to the minute, the rest is carried over to the next one
+void HistoryStorage::closeMinute() {
+    HistorySlot& minute = minutes[minuteHead];
+    minuteImport -= minute.importEnergy;
+    minuteExport -= minute.exportEnergy;
+
+    uint32_t start = getStart(HISTORY_TIER_HOUR, minute.start);
+    HistorySlot& hour = hours[(start / 3600) % 2];
+    if(hour.start != start) clear(hour, start);
+    add(hour, minute);
+
+    minuteHead = (minuteHead + 1) % HISTORY_MINUTES;
+}
+
+void HistoryStorage::addHour(time_t start, uint32_t imp, uint32_t exp) {
+    HistorySlot slot;
+    HistorySlot& hour = hours[(start / 3600) % 2];
+    if(hour.start == start) {
+        slot = hour;
+        clear(hour, 0);
+    } else {
+        clear(slot, start);
+    }
+    slot.importEnergy = imp;
+    slot.exportEnergy = exp;
+    if(append(HISTORY_TIER_HOUR, slot)) {
+        rollUp(HISTORY_TIER_DAY, slot);
+    }
+}
+
+// Adds a closed slot to the open one of the tier, which is closed first if the slot is past it
+void HistoryStorage::rollUp(uint8_t tier, HistorySlot& slot) {
+    HistorySlot& open = data.open[tier - HISTORY_TIER_DAY];
+    uint32_t start = getStart(tier, slot.start);
+    if(start < open.start) {
+        return;
+    }
+    if(open.start != start) {
+        if(open.start != 0) {
+            HistorySlot closed = open;
+            if(append(tier, closed) && tier < HISTORY_TIER_YEAR) {
+                rollUp(tier + 1, closed);
+            }
+        }
+        clear(open, start);
+    }
+    add(open, slot);
+}
+
+// Finds the file being appended to, and copies the whole slots of a file that was interrupted while appending to a
+// new one
+void HistoryStorage::scan(uint8_t tier) {
+    scanned[tier] = true;
+    active[tier] = 0;
+    count[tier] = 0;
+    last[tier] = 0;
+
+    char path[24];
+    for(uint8_t f = 0; f < 2; f++) {
+        getPath(tier, f, path);
+        if(!LittleFS.exists(path)) continue;
+
+        File file = LittleFS.open(path, "r");
+        size_t size = file.size();
+        uint16_t n = size / sizeof(HistorySlot);
+        if(size % sizeof(HistorySlot) != 0) {
+            if(debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("(HistoryStorage) %s has %d bytes of an interrupted slot\n"), path, size % sizeof(HistorySlot));
+            File copy = LittleFS.open(FILE_HISTORY_TMP, "w");
+            HistorySlot slot;
+            for(uint16_t i = 0; i < n && file.read((uint8_t*) &slot, sizeof(slot)) == sizeof(slot); i++) {
+                copy.write((uint8_t*) &slot, sizeof(slot));
+            }
+            copy.close();
+            file.close();
+            LittleFS.remove(path);
+            LittleFS.rename(FILE_HISTORY_TMP, path);
+            file = LittleFS.open(path, "r");
+        }
+
+        HistorySlot slot;
+        if(n > 0 && file.seek((n - 1) * sizeof(slot)) && file.read((uint8_t*) &slot, sizeof(slot)) == sizeof(slot) && slot.start > last[tier]) {
+            active[tier] = f;
+            count[tier] = n;
+            last[tier] = slot.start;
+        }
+        file.close();
+    }
+}
+
+// Returns false for a slot that is already there, which happens when restarting before the open slots were saved.
+// The slot is written by writePending()
+bool HistoryStorage::append(uint8_t tier, HistorySlot& slot) {
+    if(!scanned[tier]) scan(tier);
+    if(slot.start <= last[tier]) {
+        return false;
+    }
+
+    // Only if the scheduler has not been able to write for longer than the slots kept can cover
+    if(pendingCount == HISTORY_PENDING) {
+        writePending();
+    }
+    pending[pendingCount] = slot;
+    pendingTier[pendingCount++] = tier;
+    last[tier] = slot.start;
+    return true;
+}
+
+// Appends the waiting slots of the tier with one open of the file, and takes them out of the queue
+bool HistoryStorage::write(uint8_t tier) {
+    char path[24];
+    File file;
+    bool ret = true;
+    uint8_t n = 0;
+    for(uint8_t i = 0; i < pendingCount; i++) {
+        if(pendingTier[i] != tier) {
+            pending[n] = pending[i];
+            pendingTier[n++] = pendingTier[i];
+            continue;
+        }
+        if(!ret) continue;
+
+        bool restart = count[tier] >= getTierSize(tier);
+        if(restart) {
+            file.close();
+            active[tier] ^= 1;
+            count[tier] = 0;
+        }
+        if(restart || !file) {
+            getPath(tier, active[tier], path);
+            file = LittleFS.open(path, restart ? "w" : "a");
+        }
+        ret = file && file.write((uint8_t*) &pending[i], sizeof(HistorySlot)) == sizeof(HistorySlot);
+        if(ret) {
+            count[tier]++;
+        } else {
+            if(debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("(HistoryStorage) Unable to write to %s\n"), path);
+            scanned[tier] = false;
+        }
+    }
+    file.close();
+    pendingCount = n;
+    return ret;
+}
+
+bool HistoryStorage::hasPending() {
+    return pendingCount != 0;
+}
+
+bool HistoryStorage::isWriteDue() {
+    if(pendingCount >= HISTORY_PENDING_HOURS) return true;
+    for(uint8_t i = 0; i < pendingCount; i++) {
+        if(pendingTier[i] != HISTORY_TIER_HOUR) return true;
+    }
+    return false;
+}
+
+// A slot that could not be written is dropped and the files are scanned again, as before it was deferred
+int32_t HistoryStorage::writePending() {
+    int32_t bytes = 0;
+    bool ok = true;
+    for(uint8_t tier = HISTORY_TIER_HOUR; tier < HISTORY_TIERS; tier++) {
+        uint8_t before = pendingCount;
+        if(write(tier)) {
+            bytes += (before - pendingCount) * sizeof(HistorySlot);
+        } else {
+            ok = false;
+        }
+    }
+    return ok ? bytes : -1;
+}
+
+// Slots are in order and of fixed size, so the first one in range is found by bisection
+uint16_t HistoryStorage::readFile(uint8_t tier, uint8_t f, time_t from, time_t to, HistorySlot* slots, uint16_t max) {
+    char path[24];
+    getPath(tier, f, path);
+    if(max == 0 || !LittleFS.exists(path)) return 0;
+
+    File file = LittleFS.open(path, "r");
+    uint16_t n = file.size() / sizeof(HistorySlot);
+    uint16_t lo = 0, hi = n;
+    HistorySlot slot;
+    while(lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        file.seek(mid * sizeof(slot));
+        if(file.read((uint8_t*) &slot, sizeof(slot)) != sizeof(slot)) break;
+        if(slot.start < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    uint16_t i = 0;
+    file.seek(lo * sizeof(slot));
+    while(i < max && lo + i < n && file.read((uint8_t*) &slots[i], sizeof(slot)) == sizeof(slot) && slots[i].start < to) {
+        i++;
+    }
+    file.close();
+    return i;
+}
+
+uint16_t HistoryStorage::getSlots(uint8_t tier, time_t from, time_t to, HistorySlot* slots, uint16_t max) {
+    uint16_t n = 0;
+    if(tier == HISTORY_TIER_MINUTE) {
+        for(uint8_t i = 1; i <= HISTORY_MINUTES && n < max; i++) {
+            HistorySlot& minute = minutes[(minuteHead + i) % HISTORY_MINUTES];
+            if(minute.start != 0 && minute.start >= from && minute.start < to) slots[n++] = minute;
+        }
+        return n;
+    }
+    if(tier >= HISTORY_TIERS) {
+        return 0;
+    }
+
+    if(!scanned[tier]) scan(tier);
+    n += readFile(tier, active[tier] ^ 1, from, to, slots, max);
+    n += readFile(tier, active[tier], from, to, slots + n, max - n);
+    for(uint8_t i = 0; i < pendingCount && n < max; i++) {
+        HistorySlot& closed = pending[i];
+        if(pendingTier[i] == tier && closed.start >= from && closed.start < to) slots[n++] = closed;
+    }
+
+    // The hours that are not closed yet, or the open day, month or year with the open slots below it and the hours that
+    // are not closed yet
+    if(tier == HISTORY_TIER_HOUR) {
+        bool later = hours[1].start < hours[0].start;
+        for(uint8_t i = 0; i < 2; i++) {
+            HistorySlot& hour = hours[later ^ i];
+            if(hour.start > last[tier] && hour.start >= from && hour.start < to && n < max) slots[n++] = hour;
+        }
+    } else {
+        // Right after midnight, the open day can be in the next month before the open month is closed
+        HistorySlot open[2];
+        open[0] = data.open[tier - HISTORY_TIER_DAY];
+        clear(open[1], 0);
+        HistorySlot* lower[4] = { &hours[0], &hours[1], NULL, NULL };
+        for(uint8_t t = HISTORY_TIER_DAY; t < tier; t++) {
+            lower[2 + t - HISTORY_TIER_DAY] = &data.open[t - HISTORY_TIER_DAY];
+        }
+        for(uint8_t i = 0; i < 4; i++) {
+            if(lower[i] == NULL || lower[i]->start == 0) continue;
+            uint32_t start = getStart(tier, lower[i]->start);
+            if(start == open[0].start) {
+                add(open[0], *lower[i]);
+            } else if(start > open[0].start) {
+                if(open[1].start != start) clear(open[1], start);
+                add(open[1], *lower[i]);
+            }
+        }
+        for(uint8_t i = 0; i < 2; i++) {
+            if(open[i].start > last[tier] && open[i].start >= from && open[i].start < to && n < max) slots[n++] = open[i];
+        }
+    }
+    return n;
+}
@@ -0,0 +1,331 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "QuarterHourStorage.h"
+#include "LittleFS.h"
+#include "AmsStorage.h"
+#include "crc.h"
+
+static const char* QUARTER_HOUR_FILE[QUARTER_HOUR_FILES] = { FILE_QUARTER_HOUR_0, FILE_QUARTER_HOUR_1, FILE_QUARTER_HOUR_2 };
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+static uint8_t writeVarint(uint8_t* buf, uint32_t value) {
+    uint8_t len = 0;
+    while(value > 0x7F) {
+        buf[len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buf[len++] = value;
+    return len;
+}
+
+static bool readVarint(const uint8_t* buf, uint16_t length, uint16_t& pos, uint32_t& value) {
+    value = 0;
+    for(uint8_t shift = 0; pos < length && shift < 35; shift += 7) {
+        uint8_t b = buf[pos++];
+        value |= (uint32_t) (b & 0x7F) << shift;
+        if((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+// Decodes the quarters of a day starting at quarter first, keeping those from quarter from and n quarters on
+static uint16_t decode(const uint8_t* buf, uint16_t length, uint8_t count, uint32_t first, uint32_t from, uint16_t n, uint32_t* imp, uint32_t* exp) {
+    uint16_t pos = 0, found = 0;
+    uint32_t i = 0, e = 0, di, de;
+    for(uint32_t q = first; q < first + count && q < from + n; q++) {
+        if(!readVarint(buf, length, pos, di) || !readVarint(buf, length, pos, de)) break;
+        i += unzigzag(di);
+        e += unzigzag(de);
+        if(q >= from) {
+            imp[q - from] = i;
+            exp[q - from] = e;
+            found++;
+        }
+    }
+    return found;
+}
+
+QuarterHourStorage::QuarterHourStorage(RemoteDebug* debugger, RecordLog* records) {
+    this->debugger = debugger;
+    this->records = records;
+    memset(&day, 0, sizeof(day));
+    day.version = 1;
+    memset(estImport, 0, sizeof(estImport));
+    memset(estExport, 0, sizeof(estExport));
+    records->attach(RECORD_LOG_STREAM_QUARTER, &day, sizeof(day));
+}
+
+void QuarterHourStorage::setTimezone(Timezone* tz) {
+    this->tz = tz;
+    dayQuarters = 0;
+}
+
+bool QuarterHourStorage::load() {
+    bool ret = records->load(RECORD_LOG_STREAM_QUARTER);
+    if(ret && (day.version != 1 || day.length > QUARTER_HOUR_BUFFER)) {
+        memset(&day, 0, sizeof(day));
+        day.version = 1;
+        ret = false;
+    }
+    dayQuarters = 0;
+    return ret;
+}
+
+bool QuarterHourStorage::update(AmsData* data, time_t now) {
+    uint32_t quarter = now / 900;
+    uint32_t next = day.start == 0 ? quarter : day.start / 900 + day.count;
+
+    // Energy from the power readings, decides how a counter difference covering more than one quarter is split
+    uint64_t ms = data->getLastUpdateMillis();
+    if(ms > lastUpdateMillis) {
+        if(lastUpdateMillis == 0 || ms - lastUpdateMillis > 60000) {
+            estimated = false;
+        } else if(quarter >= next && quarter - next < QUARTER_HOUR_ESTIMATES) {
+            float hours = (ms - lastUpdateMillis) / 3600000.0;
+            estImport[quarter - next] += data->getActiveImportPower() * hours;
+            estExport[quarter - next] += data->getActiveExportPower() * hours;
+        }
+        lastUpdateMillis = ms;
+    }
+
+    if(data->getListType() < 3) {
+        return false;
+    }
+
+    uint64_t importCounter = data->getActiveImportCounter() * 1000;
+    uint64_t exportCounter = data->getActiveExportCounter() * 1000;
+    if(importCounter == 0) {
+        return false;
+    }
+
+    // Nothing to count from, quarters up to now are cleared and counting starts here
+    if(day.activeImport == 0 || day.activeImport > importCounter || day.activeExport > exportCounter || quarter < next || now - (time_t) next * 900 > 86400) {
+        bool ret = quarter >= next && seek(quarter);
+        day.activeImport = importCounter;
+        day.activeExport = exportCounter;
+        memset(estImport, 0, sizeof(estImport));
+        memset(estExport, 0, sizeof(estExport));
+        estimated = true;
+        return ret;
+    }
+
+    if(quarter == next) {
+        return false;
+    }
+
+    // The difference is split between the quarters that have ended by their share of the measured energy, or evenly
+    // when the power readings did not cover all of the time since the last counter
+    uint32_t n = quarter - next;
+    uint32_t imp = importCounter - day.activeImport;
+    uint32_t exp = exportCounter - day.activeExport;
+    float impSum = 0, expSum = 0;
+    if(estimated && n <= QUARTER_HOUR_ESTIMATES) {
+        for(uint8_t i = 0; i < n; i++) {
+            impSum += estImport[i];
+            expSum += estExport[i];
+        }
+    }
+
+    float impAt = 0, expAt = 0;
+    uint32_t impDone = 0, expDone = 0;
+    for(uint32_t i = 0; i < n; i++) {
+        uint32_t impTo = imp, expTo = exp;
+        if(i < n-1) {
+            if(impSum > 0) {
+                impAt += estImport[i];
+                impTo = imp * (impAt / impSum);
+            } else {
+                impTo = (uint64_t) imp * (i+1) / n;
+            }
+            if(expSum > 0) {
+                expAt += estExport[i];
+                expTo = exp * (expAt / expSum);
+            } else {
+                expTo = (uint64_t) exp * (i+1) / n;
+            }
+        }
+        if(!seek(next + i) || !append(impTo - impDone, expTo - expDone)) {
+            if(debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("(QuarterHourStorage) No room for quarter %lu\n"), next + i);
+            break;
+        }
+        impDone = impTo;
+        expDone = expTo;
+    }
+
+    day.activeImport = importCounter;
+    day.activeExport = exportCounter;
+    estimated = true;
+    for(uint8_t i = 0; i < QUARTER_HOUR_ESTIMATES; i++) {
+        estImport[i] = i + n < QUARTER_HOUR_ESTIMATES ? estImport[i + n] : 0;
+        estExport[i] = i + n < QUARTER_HOUR_ESTIMATES ? estExport[i + n] : 0;
+    }
+    return true;
+}
+
+time_t QuarterHourStorage::getDayStart(time_t t) {
+    if(tz == NULL) return t - (t % 86400);
+    time_t local = tz->toLocal(t);
+    return tz->toUTC(local - (local % 86400));
+}
+
+// What was in data after length is left, as clearing it would have the record log write every word of it
+void QuarterHourStorage::startDay(uint32_t quarter) {
+    day.start = getDayStart((time_t) quarter * 900);
+    day.count = 0;
+    day.length = 0;
+    day.lastImport = 0;
+    day.lastExport = 0;
+    dayQuarters = (getDayStart(day.start + 93600) - day.start) / 900; // 26 hours on is the next day, also with DST
+}
+
+// Makes quarter the next one to append to the open day, the day is closed and a new one started if it is not in it.
+// Quarters that were skipped are 0
+bool QuarterHourStorage::seek(uint32_t quarter) {
+    if(day.start != 0 && dayQuarters == 0) {
+        dayQuarters = (getDayStart(day.start + 93600) - day.start) / 900;
+    }
+    uint32_t first = day.start / 900;
+    if(day.start == 0 || quarter < first || quarter >= first + dayQuarters) {
+        closeDay();
+        startDay(quarter);
+        first = day.start / 900;
+    }
+    while(first + day.count < quarter) {
+        if(!append(0, 0)) return false;
+    }
+    return true;
+}
+
+bool QuarterHourStorage::append(uint32_t imp, uint32_t exp) {
+    if(day.count == UINT8_MAX || day.length + 10 > QUARTER_HOUR_BUFFER) {
+        return false;
+    }
+    day.length += writeVarint(day.data + day.length, zigzag(imp - day.lastImport));
+    day.length += writeVarint(day.data + day.length, zigzag(exp - day.lastExport));
+    day.lastImport = imp;
+    day.lastExport = exp;
+    day.count++;
+    return true;
+}
+
+// Until it is written, a restart has the day come back from the record log to be closed again
+bool QuarterHourStorage::closeDay() {
+    if(day.start == 0 || day.count == 0) {
+        return false;
+    }
+
+    // Only if the scheduler has not been able to write for a day
+    if(pending != NULL && writePending() < 0) {
+        if(debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("(QuarterHourStorage) Dropped day from %lu\n"), pendingBlock.start);
+        free(pending);
+        pending = NULL;
+    }
+
+    uint8_t* buf = (uint8_t*) malloc(day.length);
+    if(buf == NULL) {
+        if(debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("(QuarterHourStorage) No memory to close day\n"));
+        return false;
+    }
+    memcpy(buf, day.data, day.length);
+    pendingBlock = { (uint32_t) day.start, day.length, day.count, 1, 0, 0 };
+    uint16_t crc = crc16_x25_update(CRC16_X25_INIT, (uint8_t*) &pendingBlock, sizeof(pendingBlock));
+    pendingBlock.crc = crc16_x25_final(crc16_x25_update(crc, buf, day.length));
+    pending = buf;
+    return true;
+}
+
+bool QuarterHourStorage::hasPending() {
+    return pending != NULL;
+}
+
+int32_t QuarterHourStorage::writePending() {
+    if(pending == NULL) {
+        return 0;
+    }
+
+    // The file is started over when it has days from an older period
+    uint32_t period = pendingBlock.start / 86400 / QUARTER_HOUR_FILE_DAYS;
+    const char* path = QUARTER_HOUR_FILE[period % QUARTER_HOUR_FILES];
+    bool append = false;
+    if(LittleFS.exists(path)) {
+        File file = LittleFS.open(path, "r");
+        QuarterHourBlock first;
+        append = file.read((uint8_t*) &first, sizeof(first)) == sizeof(first) && first.start / 86400 / QUARTER_HOUR_FILE_DAYS == period;
+        file.close();
+    }
+
+    File file = LittleFS.open(path, append ? "a" : "w");
+    if(!file) {
+        if(debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("(QuarterHourStorage) Unable to open %s\n"), path);
+        return -1;
+    }
+    bool ret = file.write((uint8_t*) &pendingBlock, sizeof(pendingBlock)) == sizeof(pendingBlock) && file.write(pending, pendingBlock.length) == pendingBlock.length;
+    file.close();
+    if(!ret) {
+        if(debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("(QuarterHourStorage) Unable to write to %s\n"), path);
+        return -1;
+    }
+    if(debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("(QuarterHourStorage) Closed day with %d quarters in %d bytes\n"), pendingBlock.count, pendingBlock.length);
+    free(pending);
+    pending = NULL;
+    return sizeof(pendingBlock) + pendingBlock.length;
+}
+
+uint16_t QuarterHourStorage::getQuarters(time_t from, uint16_t count, uint32_t* imp, uint32_t* exp) {
+    memset(imp, 0, count * sizeof(uint32_t));
+    memset(exp, 0, count * sizeof(uint32_t));
+    uint32_t first = from / 900;
+    uint32_t last = first + count;
+    uint16_t found = 0;
+
+    // Only days before the open one are in the files
+    uint8_t buf[QUARTER_HOUR_BUFFER];
+    for(uint8_t f = 0; f < QUARTER_HOUR_FILES; f++) {
+        if(day.start != 0 && first >= day.start / 900) break;
+        if(!LittleFS.exists(QUARTER_HOUR_FILE[f])) continue;
+
+        File file = LittleFS.open(QUARTER_HOUR_FILE[f], "r");
+        QuarterHourBlock block;
+        uint32_t pos = 0;
+        while(file.read((uint8_t*) &block, sizeof(block)) == sizeof(block) && block.version == 1 && block.length <= QUARTER_HOUR_BUFFER) {
+            pos += sizeof(block) + block.length;
+            uint32_t start = block.start / 900;
+
+            // Days are in order, a file is only read until its days are past the range
+            if(start >= last) break;
+            if(start + block.count <= first) {
+                file.seek(pos);
+                continue;
+            }
+
+            if(file.read(buf, block.length) != block.length) break;
+            uint16_t crc = block.crc;
+            block.crc = 0;
+            if(crc16_x25_final(crc16_x25_update(crc16_x25_update(CRC16_X25_INIT, (uint8_t*) &block, sizeof(block)), buf, block.length)) != crc) {
+                if(debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("(QuarterHourStorage) Bad block in %s at %lu\n"), QUARTER_HOUR_FILE[f], pos - sizeof(block) - block.length);
+                break;
+            }
+            found += decode(buf, block.length, block.count, start, first, count, imp, exp);
+        }
+        file.close();
+    }
+
+    if(pending != NULL) {
+        found += decode(pending, pendingBlock.length, pendingBlock.count, pendingBlock.start / 900, first, count, imp, exp);
+    }
+    if(day.start != 0) {
+        found += decode(day.data, day.length, day.count, day.start / 900, first, count, imp, exp);
+    }
+    return found;
+}
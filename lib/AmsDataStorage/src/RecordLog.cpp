@@ -0,0 +1,260 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "RecordLog.h"
+#include "AmsStorage.h"
+#include "crc.h"
+
+static const char* RECORD_LOG_FILES[2] = { FILE_RECORD_LOG_0, FILE_RECORD_LOG_1 };
+
+RecordLog::RecordLog(RemoteDebug* debugger) {
+    this->debugger = debugger;
+}
+
+RecordLog::~RecordLog() {
+    for(uint8_t i = 0; i < RECORD_LOG_STREAMS; i++) {
+        if(shadow[i] != NULL) delete[] shadow[i];
+    }
+}
+
+bool RecordLog::readEntry(File& file, RecordLogEntry& entry) {
+    if(file.read((uint8_t*) &entry, sizeof(entry)) != sizeof(entry)) return false;
+    uint16_t crc = entry.crc;
+    entry.crc = 0;
+    if(crc16_x25((uint8_t*) &entry, sizeof(entry)) != crc) return false;
+    entry.crc = crc;
+    return entry.stream == RECORD_LOG_HEADER || (entry.stream & ~RECORD_LOG_RESET) < RECORD_LOG_STREAMS;
+}
+
+void RecordLog::writeEntry(File& file, uint8_t stream, uint8_t word, uint32_t value) {
+    RecordLogEntry entry = { stream, word, 0, value };
+    entry.crc = crc16_x25((uint8_t*) &entry, sizeof(entry));
+    size_t written = file.write((uint8_t*) &entry, sizeof(entry));
+    if(written != sizeof(entry)) writeFailed = true;
+    activeSize += written;
+    bytesWritten += written;
+    recordsWritten++;
+    if(stream != RECORD_LOG_HEADER) streamRecords[stream & ~RECORD_LOG_RESET]++;
+}
+
+// Finds the active segment, which streams the log has and whether the active segment ends in an interrupted save
+void RecordLog::scan() {
+    scanned = true;
+    present = 0;
+    bool broken[2] = { false, false };
+    for(uint8_t s = 0; s < 2; s++) {
+        generation[s] = 0;
+        length[s] = 0;
+        if(!LittleFS.exists(RECORD_LOG_FILES[s])) continue;
+
+        File file = LittleFS.open(RECORD_LOG_FILES[s], "r");
+        RecordLogEntry entry;
+        uint32_t pos = 0, begin = 0;
+        uint8_t streams = 0, saved = 0;
+        while(readEntry(file, entry)) {
+            pos += sizeof(entry);
+            if(entry.stream != RECORD_LOG_HEADER) {
+                streams |= 1 << (entry.stream & ~RECORD_LOG_RESET);
+            } else if(entry.word == RECORD_LOG_BEGIN && pos == sizeof(entry)) {
+                begin = entry.value;
+            } else if(entry.word == RECORD_LOG_END && entry.value == begin && begin != 0) {
+                generation[s] = begin;
+                length[s] = pos;
+                saved = streams;
+            }
+        }
+        broken[s] = length[s] != file.size();
+        file.close();
+
+        if(generation[s] != 0) {
+            present |= saved;
+            if(broken[s] && debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("(RecordLog) %s has an interrupted save after %lu bytes\n"), RECORD_LOG_FILES[s], length[s]);
+        }
+    }
+    active = generation[1] > generation[0] ? 1 : 0;
+    activeSize = length[active];
+    damaged = generation[active] != 0 && broken[active];
+    if(debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("(RecordLog) Segment %d generation %lu is active with %lu bytes\n"), active, generation[active], activeSize);
+}
+
+void RecordLog::attach(uint8_t stream, void* data, uint16_t size) {
+    if(stream >= RECORD_LOG_STREAMS || size == 0 || size > 1024) return;
+    if(shadow[stream] != NULL) delete[] shadow[stream];
+    shadow[stream] = new uint8_t[size];
+    memset(shadow[stream], 0, size);
+    this->data[stream] = (uint8_t*) data;
+    this->size[stream] = size;
+    loaded &= ~(1 << stream);
+}
+
+bool RecordLog::load(uint8_t stream) {
+    if(stream >= RECORD_LOG_STREAMS || data[stream] == NULL) return false;
+    if(!scanned) scan();
+
+    // The older segment first, the snapshot at the start of the newer one resets what it had
+    bool found = false;
+    uint8_t order[2] = { (uint8_t) (active ^ 1), active };
+    for(uint8_t i = 0; i < 2; i++) {
+        uint8_t s = order[i];
+        if(generation[s] == 0) continue;
+
+        File file = LittleFS.open(RECORD_LOG_FILES[s], "r");
+        RecordLogEntry entry;
+        for(uint32_t pos = 0; pos < length[s] && readEntry(file, entry); pos += sizeof(entry)) {
+            if(entry.stream == RECORD_LOG_HEADER || (entry.stream & ~RECORD_LOG_RESET) != stream) continue;
+            if(!found || (entry.stream & RECORD_LOG_RESET) != 0) {
+                memset(data[stream], 0, size[stream]);
+                found = true;
+            }
+            uint16_t offset = entry.word * 4;
+            if((entry.stream & RECORD_LOG_RESET) == 0 && offset < size[stream]) {
+                memcpy(data[stream] + offset, &entry.value, min(4, size[stream] - offset));
+            }
+        }
+        file.close();
+    }
+
+    // Without records, everything that is not zero has to be written on the first save
+    if(found) {
+        memcpy(shadow[stream], data[stream], size[stream]);
+    } else {
+        memset(shadow[stream], 0, size[stream]);
+    }
+    loaded |= 1 << stream;
+    return found;
+}
+
+// Appends a record for each word of the stream that differs from what was last written, or from zero. Only counts
+// them without a file
+uint16_t RecordLog::writeChanges(File* file, uint8_t stream, bool all) {
+    uint16_t count = 0;
+    for(uint16_t offset = 0; offset < size[stream]; offset += 4) {
+        uint32_t value = 0, last = 0;
+        uint8_t len = min(4, size[stream] - offset);
+        memcpy(&value, data[stream] + offset, len);
+        if(!all) memcpy(&last, shadow[stream] + offset, len);
+        if(value != last) {
+            if(file != NULL) writeEntry(*file, stream, offset / 4, value);
+            count++;
+        }
+    }
+    if(file != NULL) memcpy(shadow[stream], data[stream], size[stream]);
+    return count;
+}
+
+// Writes the loaded streams as a snapshot to the other segment, which becomes the active one
+bool RecordLog::compact() {
+    uint8_t target = active ^ 1;
+    uint32_t next = max(generation[0], generation[1]) + 1;
+    File file = LittleFS.open(RECORD_LOG_FILES[target], "w");
+    if(!file) {
+        damaged = true;
+        return false;
+    }
+
+    // Not valid until the end record is in place
+    generation[target] = 0;
+    activeSize = 0;
+    writeEntry(file, RECORD_LOG_HEADER, RECORD_LOG_BEGIN, next);
+    for(uint8_t i = 0; i < RECORD_LOG_STREAMS; i++) {
+        if((loaded & (1 << i)) == 0) continue;
+        writeEntry(file, i | RECORD_LOG_RESET, 0, size[i]);
+        writeChanges(&file, i, true);
+    }
+    writeEntry(file, RECORD_LOG_HEADER, RECORD_LOG_END, next);
+    file.close();
+    if(writeFailed) {
+        writeFailed = false;
+        activeSize = length[active];
+        damaged = true;
+        return false;
+    }
+
+    generation[target] = next;
+    length[target] = activeSize;
+    active = target;
+    damaged = false;
+    snapshot = false;
+    present = loaded;
+    compactions++;
+    if(debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("(RecordLog) Compacted into segment %d generation %lu, %lu bytes\n"), active, next, activeSize);
+    return true;
+}
+
+bool RecordLog::save(uint8_t mask) {
+    if(!scanned) scan();
+
+    uint16_t changes = 0;
+    uint8_t replace = 0;
+    for(uint8_t i = 0; i < RECORD_LOG_STREAMS; i++) {
+        if(data[i] == NULL || (mask & (1 << i)) == 0) continue;
+        if((loaded & (1 << i)) == 0) {
+            replace |= 1 << i;
+            changes++;
+        }
+        changes += writeChanges(NULL, i, false);
+    }
+    if(changes == 0 && !snapshot) return true;
+    loaded |= replace;
+    changes++;
+
+    // Compacting drops streams that are in the log but not loaded, so it waits until they are
+    if(generation[active] == 0 || damaged || snapshot || activeSize + changes * sizeof(RecordLogEntry) > RECORD_LOG_SEGMENT_SIZE) {
+        if((present & ~loaded) == 0) return compact();
+        if(generation[active] == 0 || damaged) return false;
+    }
+
+    File file = LittleFS.open(RECORD_LOG_FILES[active], "a");
+    if(!file) {
+        damaged = true;
+        return false;
+    }
+    for(uint8_t i = 0; i < RECORD_LOG_STREAMS; i++) {
+        if(data[i] == NULL || (mask & (1 << i)) == 0) continue;
+        if((replace & (1 << i)) != 0) writeEntry(file, i | RECORD_LOG_RESET, 0, size[i]);
+        writeChanges(&file, i, false);
+        present |= 1 << i;
+    }
+    writeEntry(file, RECORD_LOG_HEADER, RECORD_LOG_END, generation[active]);
+    file.close();
+    if(writeFailed) {
+        writeFailed = false;
+        damaged = true;
+        return false;
+    }
+    length[active] = activeSize;
+    return true;
+}
+
+void RecordLog::reset() {
+    scanned = false;
+    generation[0] = 0;
+    generation[1] = 0;
+    length[0] = 0;
+    length[1] = 0;
+    active = 0;
+    activeSize = 0;
+    damaged = false;
+    writeFailed = false;
+    present = 0;
+    snapshot = true;
+}
+
+uint32_t RecordLog::getBytesWritten() {
+    return bytesWritten;
+}
+
+uint32_t RecordLog::getRecordsWritten() {
+    return recordsWritten;
+}
+
+uint32_t RecordLog::getRecordsWritten(uint8_t stream) {
+    return stream < RECORD_LOG_STREAMS ? streamRecords[stream] : 0;
+}
+
+uint16_t RecordLog::getCompactions() {
+    return compactions;
+}
@@ -0,0 +1,38 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _BUFFEROCCUPANCY_H
+#define _BUFFEROCCUPANCY_H
+
+#include "Arduino.h"
+
+#define BUFFER_OCCUPANCY_BINS 8
+
+/**
+ * How full a buffer got, sampled once per frame. Bin n counts samples of up to 64 << n bytes, the last bin
+ * also counts anything larger. Besides the all time high watermark there is one for the current window,
+ * so buffers can be sized down again when frames get smaller.
+ */
+class BufferOccupancy {
+public:
+    void add(uint16_t used);
+    void clear();
+    uint16_t nextWindow();
+
+    uint16_t getMax();
+    uint16_t getWindowMax();
+    uint32_t getCount();
+    uint32_t getBin(uint8_t bin);
+    size_t printBins(char* buf, size_t size);
+
+private:
+    uint16_t max = 0;
+    uint16_t windowMax = 0;
+    uint32_t count = 0;
+    uint32_t bins[BUFFER_OCCUPANCY_BINS] = {0};
+};
+
+#endif
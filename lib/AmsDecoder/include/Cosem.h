@@ -14,15 +14,25 @@ enum CosemType {
     CosemTypeNull = 0x00,
     CosemTypeArray = 0x01,
     CosemTypeStructure = 0x02,
+    CosemTypeBoolean = 0x03,
+    CosemTypeBitString = 0x04,
     CosemTypeOctetString = 0x09,
     CosemTypeString = 0x0A,
+    CosemTypeUtf8String = 0x0C,
     CosemTypeDLongSigned = 0x05,
     CosemTypeDLongUnsigned = 0x06,
+    CosemTypeInteger = 0x0F,
     CosemTypeLongSigned = 0x10,
+    CosemTypeUnsigned = 0x11,
     CosemTypeLongUnsigned = 0x12,
     CosemTypeLong64Signed = 0x14,
     CosemTypeLong64Unsigned = 0x15,
-    CosemTypeDateTime = 0x19
+    CosemTypeEnum = 0x16,
+    CosemTypeFloat32 = 0x17,
+    CosemTypeFloat64 = 0x18,
+    CosemTypeDateTime = 0x19,
+    CosemTypeDate = 0x1A,
+    CosemTypeTime = 0x1B
 };
 
 struct CosemBasic {
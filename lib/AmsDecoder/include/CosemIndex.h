@@ -0,0 +1,79 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _COSEMINDEX_H
+#define _COSEMINDEX_H
+
+#include "Arduino.h"
+#include "Cosem.h"
+
+#define COSEM_INDEX_OBIS_SLOTS 64
+#define COSEM_INDEX_OBIS_MAX 48
+#define COSEM_INDEX_ITEMS 192
+
+#if defined(ESP8266)
+#define COSEM_LAYOUT_CACHE_SIZE 1
+#else
+#define COSEM_LAYOUT_CACHE_SIZE 3
+#endif
+
+/**
+ * Walks a COSEM payload once and remembers where each item starts, and which item follows each
+ * OBIS code (6 byte octet string, first occurrence wins). Lookups return false when the answer is
+ * outside what was indexed, so the caller can fall back to scanning the payload.
+ */
+class CosemIndex {
+public:
+    void build(const char* ptr, uint16_t length);
+    bool find(const uint8_t* obis, CosemData** item);
+    bool find(uint32_t key, CosemData** item); // C, D, E and F packed big endian, as compared in the payload
+    bool at(uint8_t index, CosemData** item);
+
+    uint32_t getFingerprint();
+    uint16_t getItemCount();
+    uint16_t getHits();
+
+    static uint16_t itemLength(CosemData* item);
+
+private:
+    const char* ptr = NULL;
+    uint16_t length = 0;
+    uint32_t layout = 0;
+    uint16_t items = 0;
+    uint16_t hits = 0;
+    uint8_t obisCount = 0;
+    bool obisOverflow = false;
+
+    uint32_t keys[COSEM_INDEX_OBIS_SLOTS];
+    uint16_t values[COSEM_INDEX_OBIS_SLOTS]; // Offset of the item following the OBIS code, 0 is an empty slot
+    uint8_t used[COSEM_INDEX_OBIS_MAX];
+    uint16_t offsets[COSEM_INDEX_ITEMS];
+    uint8_t types[COSEM_INDEX_ITEMS];
+    uint8_t lengths[COSEM_INDEX_ITEMS];
+
+    bool matches(const char* ptr, uint16_t length);
+
+    static uint32_t obisKey(const uint8_t* obis);
+    static uint8_t slot(uint32_t key);
+
+    friend class CosemLayoutCache;
+};
+
+/**
+ * Meters repeat the same few lists, with only the values changing. A payload with the same item types,
+ * lengths and OBIS codes at the same offsets as a cached layout reuses the index built the first time
+ * that layout was seen, checking those bytes is much cheaper than walking the payload again.
+ */
+class CosemLayoutCache {
+public:
+    CosemIndex* load(const char* ptr, uint16_t length);
+
+private:
+    CosemIndex layouts[COSEM_LAYOUT_CACHE_SIZE];
+    uint8_t replace = 0;
+};
+
+#endif
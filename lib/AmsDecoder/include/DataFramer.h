@@ -0,0 +1,34 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _DATAFRAMER_H
+#define _DATAFRAMER_H
+
+#include "Arduino.h"
+#include "DataParser.h"
+#include "DsmrParser.h"
+
+/**
+ * Tracks the boundary of the outermost frame while bytes are appended to the HAN buffer, so the
+ * full unwrap chain (header/FCS checks, LLC, GCM, DLMS) only runs once the declared length has arrived.
+ * DSMR has no length field, its parser is fed the new bytes instead and says when the telegram has ended.
+ * Other formats without a length field fall back to checking on every byte, like before.
+ */
+class DataFramer {
+public:
+    void reset();
+    int8_t append(const uint8_t *buf, uint16_t len);
+    uint16_t getExpectedLength();
+    DSMRParser* getDSMRParser();
+
+private:
+    uint8_t tag = DATA_TAG_NONE;
+    uint16_t expected = 0;
+    bool deferred = false;
+    DSMRParser dsmr;
+};
+
+#endif
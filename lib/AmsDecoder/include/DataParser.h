@@ -20,6 +20,8 @@
 #define DATA_TAG_AARQ 0x60
 #define DATA_TAG_AARE 0x61
 #define DATA_TAG_RES 0xC4 // Get Response
+#define DATA_TAG_EXCEPTION 0xD8 // Exception Response
+#define DATA_TAG_SERVICE_ERROR 0x0E // Confirmed Service Error
 
 #define DATA_PARSE_OK 0
 #define DATA_PARSE_FAIL -1
@@ -7,6 +7,7 @@
 #ifndef _DATAPASERSERS_H
 #define _DATAPASERSERS_H
 
+#include "SegmentArena.h"
 #include "HdlcParser.h"
 #include "DlmsParser.h"
 #include "DsmrParser.h"
@@ -14,6 +15,8 @@
 #include "GbtParser.h"
 #include "GcmParser.h"
 #include "LlcParser.h"
+#include "DataFramer.h"
+#include "CosemIndex.h"
 
 #endif
 
@@ -10,14 +10,28 @@
 #include "Arduino.h"
 #include "DataParser.h"
 
+/**
+ * A P1 telegram has no length field, it ends with a newline after the "!CRC" line. append() resumes
+ * where the previous call stopped and folds the new bytes into the CRC, so feeding a telegram byte by
+ * byte is linear in its length. parse() uses that result when it was fed the same buffer, and makes a
+ * single pass otherwise (telegrams wrapped in HDLC/M-Bus, which are already verified by the frame).
+ */
 class DSMRParser {
 public:
+    void reset();
+    int8_t append(const uint8_t *buf, uint16_t len);
     int8_t parse(uint8_t *buf, DataParserContext &ctx, bool verified);
     uint16_t getCrc();
     uint16_t getCrcCalc();
 private:
-    uint16_t crc;
-    uint16_t crc_calc;
+    uint16_t crc = 0;
+    uint16_t crc_calc = 0;
+
+    uint16_t scanned = 0;
+    uint16_t crcPos = 0;
+    uint8_t crcDigits = 0;
+    uint8_t lastByte = 0x00;
+    bool complete = false;
 };
 
 #endif
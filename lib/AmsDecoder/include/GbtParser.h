@@ -9,6 +9,7 @@
 
 #include "Arduino.h"
 #include "DataParser.h"
+#include "SegmentArena.h"
 
 #define GBT_TAG 0xE0
 
@@ -22,11 +23,10 @@ typedef struct GBTHeader {
 
 class GBTParser {
 public:
+    GBTParser(SegmentArena* segments);
     int8_t parse(uint8_t *buf, DataParserContext &ctx);
 private:
-    uint8_t lastSequenceNumber = 0;
-    uint16_t pos = 0;
-    uint8_t *buf  = NULL;
+    SegmentArena* segments;
 };
 
 #endif
@@ -9,19 +9,38 @@
 
 #include "Arduino.h"
 #include "DataParser.h"
+#if defined(ESP8266)
+#include "bearssl/bearssl.h"
+#elif defined(ESP32)
+#include "mbedtls/gcm.h"
+#endif
 
 #define GCM_TAG 0xDB
 #define GCM_AUTH_FAILED -51
 #define GCM_DECRYPT_FAILED -52
 #define GCM_ENCRYPTION_KEY_FAILED -53
 
+// Bytes decrypted at a time on ESP32, a multiple of the AES block size
+#define GCM_CHUNK_SIZE 64
+
 class GCMParser {
 public:
     GCMParser(uint8_t *encryption_key, uint8_t *authentication_key);
+    ~GCMParser();
     int8_t parse(uint8_t *buf, DataParserContext &ctx);
 private:
-    uint8_t encryption_key[16];
-    uint8_t authentication_key[16];
+    // Security tag followed by the authentication key, only the first byte changes between frames
+    uint8_t additional_authenticated_data[17];
+    bool authenticate = false;
+    bool keyed = false;
+
+    // Key schedule and GHASH key are set up once, only the IV is reset for each frame
+    #if defined(ESP8266)
+    br_aes_ct_ctr_keys bc;
+    br_gcm_context gcmCtx;
+    #elif defined(ESP32)
+    mbedtls_gcm_context gcmCtx;
+    #endif
 };
 
 #endif
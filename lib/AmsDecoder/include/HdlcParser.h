@@ -9,9 +9,19 @@
 
 #include "Arduino.h"
 #include "DataParser.h"
+#include "SegmentArena.h"
 
 #define HDLC_FLAG 0x7E
 
+// Control field without the poll/final bit
+#define HDLC_PF 0x10
+#define HDLC_CONTROL_SNRM 0x83
+#define HDLC_CONTROL_DISC 0x43
+#define HDLC_CONTROL_UA 0x63
+#define HDLC_CONTROL_DM 0x0F
+#define HDLC_CONTROL_FRMR 0x87
+#define HDLC_CONTROL_RR 0x01
+
 typedef struct HDLCHeader {
 	uint8_t  flag;
 	uint16_t format;
@@ -29,12 +39,14 @@ typedef struct HDLC3CtrlHcs {
 
 class HDLCParser {
 public:
+    HDLCParser(SegmentArena* segments);
     int8_t parse(uint8_t *buf, DataParserContext &ctx);
+    uint8_t getControl();
 
 private:
+    SegmentArena* segments;
     uint8_t lastSequenceNumber = 0;
-    uint16_t pos = 0;
-    uint8_t *buf  = NULL;
+    uint8_t control = 0;
 };
 
 #endif
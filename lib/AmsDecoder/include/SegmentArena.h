@@ -0,0 +1,50 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _SEGMENTARENA_H
+#define _SEGMENTARENA_H
+
+#include "Arduino.h"
+
+struct SegmentArenaStats {
+    uint32_t messages;  // Reassembled messages handed on to the next parser
+    uint32_t segments;  // Segments appended, including those of messages that were later dropped
+    uint16_t gaps;      // Segments with an unexpected sequence number
+    uint16_t overflows; // Segments that did not fit
+    uint16_t dropped;   // Partial messages replaced by a new first segment
+    uint16_t maxLength;
+    uint8_t maxSegments;
+};
+
+/**
+ * Reassembly space for segmented HDLC, M-Bus and GBT messages, shared by the parsers and owned by
+ * the communicator. It does not allocate, it uses the front of the buffer the frames are read into.
+ * Segments are moved down to the end of what is already assembled and the next frame is read right
+ * after it, so the complete message ends up contiguous at the start of the buffer without a copy.
+ */
+class SegmentArena {
+public:
+    void begin(uint8_t* buf, uint16_t size);
+    void clear();
+    bool append(const uint8_t* src, uint16_t len, uint16_t sequence, bool first);
+    uint16_t finish();
+
+    uint8_t* getData();
+    uint16_t getLength();
+    bool isActive();
+    SegmentArenaStats& getStats();
+
+private:
+    uint8_t* buf = NULL;
+    uint16_t size = 0;
+    uint16_t length = 0;
+    uint16_t lastSequence = 0;
+    uint8_t segments = 0;
+    bool active = false;
+    SegmentArenaStats stats = {0,0,0,0,0,0,0};
+};
+
+#endif
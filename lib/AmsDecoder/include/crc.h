@@ -10,8 +10,18 @@
 #include "Arduino.h"
 #include <stdint.h>
 
+#define CRC16_INIT 0x0000
+#define CRC16_X25_INIT 0xFFFF
+#define CRC16_1021_INIT 0x0000
+
 uint16_t crc16(const uint8_t* p, int len);
 uint16_t crc16_x25(const uint8_t* p, int len);
 uint16_t crc16_1021(const uint8_t* p, int len);
 
+// Incremental variants, start with the matching *_INIT value and feed bytes as they arrive
+uint16_t crc16_update(uint16_t crc, const uint8_t* p, int len);
+uint16_t crc16_x25_update(uint16_t crc, const uint8_t* p, int len);
+uint16_t crc16_x25_final(uint16_t crc);
+uint16_t crc16_1021_update(uint16_t crc, const uint8_t* p, int len);
+
 #endif
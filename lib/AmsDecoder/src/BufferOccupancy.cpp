@@ -0,0 +1,57 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "BufferOccupancy.h"
+
+void BufferOccupancy::add(uint16_t used) {
+    uint8_t bin = 0;
+    while(bin < BUFFER_OCCUPANCY_BINS - 1 && used > (64 << bin)) bin++;
+    bins[bin]++;
+    count++;
+    if(used > max) max = used;
+    if(used > windowMax) windowMax = used;
+}
+
+void BufferOccupancy::clear() {
+    max = 0;
+    windowMax = 0;
+    count = 0;
+    memset(bins, 0, sizeof(bins));
+}
+
+// Returns the high watermark of the window that ended
+uint16_t BufferOccupancy::nextWindow() {
+    uint16_t ret = windowMax;
+    windowMax = 0;
+    return ret;
+}
+
+uint16_t BufferOccupancy::getMax() {
+    return max;
+}
+
+uint16_t BufferOccupancy::getWindowMax() {
+    return windowMax;
+}
+
+uint32_t BufferOccupancy::getCount() {
+    return count;
+}
+
+uint32_t BufferOccupancy::getBin(uint8_t bin) {
+    return bin < BUFFER_OCCUPANCY_BINS ? bins[bin] : 0;
+}
+
+// Comma separated counts, for JSON arrays
+size_t BufferOccupancy::printBins(char* buf, size_t size) {
+    size_t pos = 0;
+    buf[0] = '\0';
+    for(uint8_t i = 0; i < BUFFER_OCCUPANCY_BINS; i++) {
+        pos += snprintf_P(buf+pos, size-pos, i == 0 ? PSTR("%lu") : PSTR(",%lu"), (unsigned long) bins[i]);
+        if(pos >= size) return size - 1;
+    }
+    return pos;
+}
@@ -0,0 +1,151 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "CosemIndex.h"
+
+uint32_t CosemIndex::obisKey(const uint8_t* obis) {
+    return ((uint32_t) obis[0] << 24) | ((uint32_t) obis[1] << 16) | ((uint32_t) obis[2] << 8) | obis[3];
+}
+
+uint8_t CosemIndex::slot(uint32_t key) {
+    return ((uint32_t) (key * 2654435761UL)) >> 26; // Fibonacci hashing into 64 slots
+}
+
+uint16_t CosemIndex::itemLength(CosemData* item) {
+    switch(item->base.type) {
+        case CosemTypeArray:
+        case CosemTypeStructure:
+            return 2;
+        case CosemTypeOctetString:
+        case CosemTypeString:
+            return 2 + item->base.length;
+        case CosemTypeLongSigned:
+        case CosemTypeLongUnsigned:
+            return 3;
+        case CosemTypeDLongSigned:
+        case CosemTypeDLongUnsigned:
+            return 5;
+        case CosemTypeLong64Signed:
+        case CosemTypeLong64Unsigned:
+            return 9;
+        case CosemTypeNull:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+// Types where the second byte is a length or element count
+static bool hasLength(uint8_t type) {
+    return type == CosemTypeArray || type == CosemTypeStructure || type == CosemTypeOctetString || type == CosemTypeString;
+}
+
+void CosemIndex::build(const char* ptr, uint16_t length) {
+    this->ptr = ptr;
+    this->length = length;
+    layout = 2166136261UL;
+    items = 0;
+    hits = 0;
+    obisCount = 0;
+    obisOverflow = false;
+    memset(values, 0, sizeof(values));
+
+    uint16_t pos = 0;
+    while(pos < length) {
+        CosemData* item = (CosemData*) (ptr + pos);
+        if(items < COSEM_INDEX_ITEMS) {
+            offsets[items] = pos;
+            types[items] = item->base.type;
+            lengths[items] = item->base.length;
+        }
+        items++;
+        layout = (layout ^ item->base.type) * 16777619UL;
+
+        uint16_t next = pos + itemLength(item);
+        if(item->base.type == CosemTypeOctetString && item->base.length == 6 && next < length) {
+            if(obisCount < COSEM_INDEX_OBIS_MAX) {
+                uint32_t key = obisKey(item->oct.data + 2);
+                uint8_t s = slot(key);
+                while(values[s] != 0 && keys[s] != key) s = (s + 1) & (COSEM_INDEX_OBIS_SLOTS - 1);
+                if(values[s] == 0) {
+                    keys[s] = key;
+                    values[s] = next;
+                    used[obisCount++] = s;
+                }
+            } else {
+                obisOverflow = true;
+            }
+        }
+        pos = next;
+    }
+}
+
+// Same types and lengths at every recorded offset means the items line up the same way, by induction from the first
+bool CosemIndex::matches(const char* ptr, uint16_t length) {
+    if(this->ptr == NULL || length != this->length || items > COSEM_INDEX_ITEMS) return false;
+    for(uint16_t i = 0; i < items; i++) {
+        const uint8_t* p = (const uint8_t*) ptr + offsets[i];
+        if(p[0] != types[i]) return false;
+        if(hasLength(types[i]) && p[1] != lengths[i]) return false;
+    }
+    for(uint8_t i = 0; i < obisCount; i++) {
+        uint8_t s = used[i];
+        if(obisKey((const uint8_t*) ptr + values[s] - 4) != keys[s]) return false;
+    }
+    return true;
+}
+
+bool CosemIndex::find(const uint8_t* obis, CosemData** item) {
+    return find(obisKey(obis), item);
+}
+
+bool CosemIndex::find(uint32_t key, CosemData** item) {
+    if(ptr == NULL) return false;
+    uint8_t s = slot(key);
+    while(values[s] != 0) {
+        if(keys[s] == key) {
+            *item = (CosemData*) (ptr + values[s]);
+            return true;
+        }
+        s = (s + 1) & (COSEM_INDEX_OBIS_SLOTS - 1);
+    }
+    *item = NULL;
+    return !obisOverflow;
+}
+
+bool CosemIndex::at(uint8_t index, CosemData** item) {
+    if(ptr == NULL || index >= items || index >= COSEM_INDEX_ITEMS) return false;
+    *item = (CosemData*) (ptr + offsets[index]);
+    return true;
+}
+
+uint32_t CosemIndex::getFingerprint() {
+    return layout;
+}
+
+uint16_t CosemIndex::getItemCount() {
+    return items;
+}
+
+uint16_t CosemIndex::getHits() {
+    return hits;
+}
+
+CosemIndex* CosemLayoutCache::load(const char* ptr, uint16_t length) {
+    for(uint8_t i = 0; i < COSEM_LAYOUT_CACHE_SIZE; i++) {
+        CosemIndex* index = &layouts[i];
+        if(index->matches(ptr, length)) {
+            index->ptr = ptr;
+            if(index->hits < 0xFFFF) index->hits++;
+            return index;
+        }
+    }
+
+    CosemIndex* index = &layouts[replace];
+    replace = (replace + 1) % COSEM_LAYOUT_CACHE_SIZE;
+    index->build(ptr, length);
+    return index;
+}
@@ -0,0 +1,70 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "DataFramer.h"
+#include "HdlcParser.h"
+#include "MbusParser.h"
+
+void DataFramer::reset() {
+    tag = DATA_TAG_NONE;
+    expected = 0;
+    deferred = false;
+    dsmr.reset();
+}
+
+// Returns DATA_PARSE_OK when the buffer should be unwrapped, DATA_PARSE_INCOMPLETE when more bytes are needed
+int8_t DataFramer::append(const uint8_t *buf, uint16_t len) {
+    if(len == 0) return DATA_PARSE_INCOMPLETE;
+    if(len == 1) {
+        reset();
+        tag = buf[0];
+    }
+    if(deferred) return DATA_PARSE_OK;
+
+    switch(tag) {
+        case DATA_TAG_HDLC:
+            if(expected == 0) {
+                if(len < 3) return DATA_PARSE_INCOMPLETE;
+
+                // Not frame format type 3, let the parser reject it
+                if((buf[1] & 0xF0) != 0xA0) {
+                    deferred = true;
+                    return DATA_PARSE_OK;
+                }
+                expected = (((buf[1] << 8) | buf[2]) & 0x7FF) + 2;
+            }
+            break;
+        case DATA_TAG_MBUS:
+            if(expected == 0) {
+                if(len < 4) return DATA_PARSE_INCOMPLETE;
+
+                // Length mismatch, missing start flag or no length field, let the parser handle it on every byte
+                if(buf[1] != buf[2] || buf[3] != MBUS_START || buf[1] == 0x00) {
+                    deferred = true;
+                    return DATA_PARSE_OK;
+                }
+                uint16_t l = buf[1];
+                if(l < 4) l += 256; // Same rule as MBUSParser
+                expected = l + 6;
+            }
+            break;
+        case DATA_TAG_DSMR:
+            // Only the new bytes are looked at, errors are left for the parser to report
+            return dsmr.append(buf, len) == DATA_PARSE_INCOMPLETE ? DATA_PARSE_INCOMPLETE : DATA_PARSE_OK;
+        default:
+            deferred = true;
+            return DATA_PARSE_OK;
+    }
+    return len >= expected ? DATA_PARSE_OK : DATA_PARSE_INCOMPLETE;
+}
+
+uint16_t DataFramer::getExpectedLength() {
+    return expected;
+}
+
+DSMRParser* DataFramer::getDSMRParser() {
+    return &dsmr;
+}
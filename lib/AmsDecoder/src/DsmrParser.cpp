@@ -6,30 +6,64 @@
 
 #include "DsmrParser.h"
 #include "crc.h"
-#include "hexutils.h"
-#include "lwip/def.h"
+
+void DSMRParser::reset() {
+    crc = 0x0000;
+    crc_calc = CRC16_INIT;
+    scanned = 0;
+    crcPos = 0;
+    crcDigits = 0;
+    lastByte = 0x00;
+    complete = false;
+}
+
+// Returns DATA_PARSE_OK once the line after "!" has ended, len is the total number of bytes in buf so far
+int8_t DSMRParser::append(const uint8_t *buf, uint16_t len) {
+    if(len < scanned) reset(); // Buffer was restarted
+    if(complete) return DATA_PARSE_OK;
+    if(scanned == 0 && len > 0 && buf[0] != '/') return DATA_PARSE_BOUNDRY_FLAG_MISSING;
+
+    uint16_t from = scanned;
+    while(scanned < len) {
+        uint8_t b = buf[scanned++];
+        if(crcPos == 0) {
+            if(b == '!' && lastByte == '\n') {
+                crcPos = scanned;
+                crc_calc = crc16_update(crc_calc, buf+from, crcPos-from);
+            }
+            lastByte = b;
+        } else if(b == '\n') {
+            complete = true;
+            break;
+        } else if(crcDigits < 4) {
+            // Four hex digits, read as they arrive instead of through a String
+            uint8_t v;
+            if(b >= '0' && b <= '9') v = b - '0';
+            else if(b >= 'A' && b <= 'F') v = b - 'A' + 10;
+            else if(b >= 'a' && b <= 'f') v = b - 'a' + 10;
+            else {
+                crcDigits = 4;
+                continue;
+            }
+            crc = (crc << 4) | v;
+            crcDigits++;
+        }
+    }
+    if(crcPos == 0) crc_calc = crc16_update(crc_calc, buf+from, scanned-from);
+    return complete ? DATA_PARSE_OK : DATA_PARSE_INCOMPLETE;
+}
 
 int8_t DSMRParser::parse(uint8_t *buf, DataParserContext &ctx, bool verified) {
-    uint16_t crcPos = 0;
-    bool reachedEnd = verified;
-    uint8_t lastByte = 0x00;
-    for(int pos = 0; pos < ctx.length; pos++) {
-        uint8_t b = *(buf+pos);
-        if(pos == 0 && b != '/') return DATA_PARSE_BOUNDRY_FLAG_MISSING;
-        if(pos > 0 && b == '!' && lastByte == '\n') crcPos = pos+1;
-        if(crcPos > 0 && b == '\n') reachedEnd = true;
-        lastByte = b;
+    // The framer has normally fed this telegram already, only scan again when that is not the case
+    if(verified || !complete || scanned != ctx.length) {
+        reset();
+        int8_t res = append(buf, ctx.length);
+        if(res == DATA_PARSE_BOUNDRY_FLAG_MISSING) return res;
     }
-    if(!reachedEnd) return DATA_PARSE_INCOMPLETE;
+    if(!complete && !verified) return DATA_PARSE_INCOMPLETE;
     buf[ctx.length+1] = '\0';
-    if(crcPos > 0) {
-	    crc_calc = crc16(buf, crcPos);
-        crc = 0x0000;
-        fromHex((uint8_t*) &crc, String((char*) buf+crcPos), 2);
-        crc = ntohs(crc);
-
-        if(crc != crc_calc)
-            return DATA_PARSE_FOOTER_CHECKSUM_ERROR;
+    if(crcPos > 0 && crc != crc_calc) {
+        return DATA_PARSE_FOOTER_CHECKSUM_ERROR;
     }
     return DATA_PARSE_OK;
 }
@@ -39,4 +73,4 @@ uint16_t DSMRParser::getCrc() {
 }
 uint16_t DSMRParser::getCrcCalc() {
     return crc_calc;
-}
\ No newline at end of file
+}
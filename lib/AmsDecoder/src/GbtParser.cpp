@@ -7,32 +7,28 @@
 #include "GbtParser.h"
 #include "lwip/def.h"
 
+GBTParser::GBTParser(SegmentArena* segments) {
+    this->segments = segments;
+}
+
 int8_t GBTParser::parse(uint8_t *d, DataParserContext &ctx) {
+    if(ctx.length < sizeof(GBTHeader)) return DATA_PARSE_INCOMPLETE;
     GBTHeader* h = (GBTHeader*) (d);
     uint16_t sequence = ntohs(h->sequence);
 
     if(h->flag != GBT_TAG) return DATA_PARSE_BOUNDRY_FLAG_MISSING;
+    // A corrupt size would have the block copied from past the received frame
+    if(sizeof(GBTHeader) + h->size > ctx.length) return DATA_PARSE_FAIL;
 
-    if(sequence == 1) {
-        if(buf == NULL) buf = (uint8_t *)malloc((size_t)1024); // TODO find out from first package ?
-        pos = 0;
-    } else if(lastSequenceNumber != sequence-1) {
+    // The header may be overwritten when the block is moved into place
+    bool last = (h->control & 0x80) == 0x80;
+    uint8_t* ptr = (uint8_t*) &h[1];
+    if(!segments->append(ptr, h->size, sequence, sequence == 1)) {
         return DATA_PARSE_FAIL;
     }
 
-    if(buf == NULL) return DATA_PARSE_FAIL;
-
-    uint8_t* ptr = (uint8_t*) &h[1];
-    memcpy(buf + pos, ptr, h->size);
-    pos += h->size;
-    lastSequenceNumber = sequence;
-
-    if((h->control & 0x80) == 0x00) {
+    if(!last) {
         return DATA_PARSE_INTERMEDIATE_SEGMENT;
-    } else {
-        memcpy((uint8_t *) d, buf, pos);
     }
-    ctx.length = pos;
-    return DATA_PARSE_OK;
-
+    return DATA_PARSE_FINAL_SEGMENT;
 }
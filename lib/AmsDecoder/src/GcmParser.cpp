@@ -6,15 +6,26 @@
 
 #include "GcmParser.h"
 #include "lwip/def.h"
-#if defined(ESP8266)
-#include "bearssl/bearssl.h"
-#elif defined(ESP32)
-#include "mbedtls/gcm.h"
-#endif
 
 GCMParser::GCMParser(uint8_t *encryption_key, uint8_t *authentication_key) {
-    memcpy(this->encryption_key, encryption_key, 16);
-    memcpy(this->authentication_key, authentication_key, 16);
+    memcpy(additional_authenticated_data + 1, authentication_key, 16);
+    for(uint8_t i = 0; i < 16; i++) authenticate |= authentication_key[i] > 0;
+
+    #if defined(ESP8266)
+        br_aes_ct_ctr_init(&bc, encryption_key, 16);
+        br_gcm_init(&gcmCtx, &bc.vtable, br_ghash_ctmul32);
+        keyed = true;
+    #elif defined(ESP32)
+        // Uses the AES peripheral when the framework mbedtls is built with hardware AES, which is the default
+        mbedtls_gcm_init(&gcmCtx);
+        keyed = mbedtls_gcm_setkey(&gcmCtx, MBEDTLS_CIPHER_ID_AES, encryption_key, 128) == 0;
+    #endif
+}
+
+GCMParser::~GCMParser() {
+    #if defined(ESP32)
+        mbedtls_gcm_free(&gcmCtx);
+    #endif
 }
 
 int8_t GCMParser::parse(uint8_t *d, DataParserContext &ctx) {
@@ -28,6 +39,8 @@ int8_t GCMParser::parse(uint8_t *d, DataParserContext &ctx) {
 
     uint8_t systemTitleLength = *ptr;
     ptr++;
+    // The system title is the first 8 bytes of the IV, anything else is a corrupt frame
+    if(systemTitleLength > sizeof(ctx.system_title)) return DATA_PARSE_FAIL;
 
     uint8_t initialization_vector[12];
     memcpy(ctx.system_title, ptr, systemTitleLength);
@@ -62,9 +75,6 @@ int8_t GCMParser::parse(uint8_t *d, DataParserContext &ctx) {
     if(len + headersize > ctx.length)
         return DATA_PARSE_INCOMPLETE;
 
-    uint8_t additional_authenticated_data[17];
-    memcpy(additional_authenticated_data, ptr, 1);
-
     // Security tag
     uint8_t sec = *ptr;
     ptr++;
@@ -78,68 +88,59 @@ int8_t GCMParser::parse(uint8_t *d, DataParserContext &ctx) {
     int footersize = 0;
 
     // Authentication enabled
-    bool authenticate = false;
-    uint8_t authentication_tag[12];
     uint8_t authkeylen = 0, aadlen = 0;
     if((sec & 0x10) == 0x10) {
         authkeylen = 12;
         aadlen = 17;
         footersize += authkeylen;
-        memcpy(additional_authenticated_data + 1, authentication_key, 16);
-        memcpy(authentication_tag, ptr + len - footersize - 5, authkeylen);
-        for(uint8_t i; i < 16; i++) authenticate |= authentication_key[i] > 0;
     }
+    if(len < authkeylen + 5U) return DATA_PARSE_FAIL;
+    additional_authenticated_data[0] = sec;
+
+    // The authentication tag follows right after the cipher text
+    uint32_t cipherlen = len - authkeylen - 5; // 5 == security tag and frame counter
+    uint8_t* authentication_tag = ptr + cipherlen;
 
     #if defined(ESP8266)
-        br_gcm_context gcmCtx;
-        br_aes_ct_ctr_keys bc;
-        br_aes_ct_ctr_init(&bc, encryption_key, 16);
-        br_gcm_init(&gcmCtx, &bc.vtable, br_ghash_ctmul32);
         br_gcm_reset(&gcmCtx, initialization_vector, sizeof(initialization_vector));
         if(authenticate) {
             br_gcm_aad_inject(&gcmCtx, additional_authenticated_data, aadlen);
         }
         br_gcm_flip(&gcmCtx);
-        br_gcm_run(&gcmCtx, 0, (void*) (ptr), len - authkeylen - 5); // 5 == security tag and frame counter
+        br_gcm_run(&gcmCtx, 0, (void*) (ptr), cipherlen);
         if(authkeylen > 0 && br_gcm_check_tag_trunc(&gcmCtx, authentication_tag, authkeylen) != 1) {
             return GCM_AUTH_FAILED;
         }
     #elif defined(ESP32)
-        uint8_t cipher_text[len - authkeylen - 5];
-        memcpy(cipher_text, ptr, len - authkeylen - 5);
-
-        mbedtls_gcm_context m_ctx;
-        mbedtls_gcm_init(&m_ctx);
-        int success = mbedtls_gcm_setkey(&m_ctx, MBEDTLS_CIPHER_ID_AES, encryption_key, 128);
-        if (0 != success) {
+        if(!keyed) {
             return GCM_ENCRYPTION_KEY_FAILED;
         }
-        if (authenticate) {
-            success = mbedtls_gcm_auth_decrypt(&m_ctx, sizeof(cipher_text), initialization_vector, sizeof(initialization_vector),
-                additional_authenticated_data, aadlen, authentication_tag, authkeylen,
-                cipher_text, (unsigned char*)(ptr));
-            if (authkeylen > 0 && success == MBEDTLS_ERR_GCM_AUTH_FAILED) {
-                mbedtls_gcm_free(&m_ctx);
-                return GCM_AUTH_FAILED;
-            } else if(success == MBEDTLS_ERR_GCM_BAD_INPUT) {
-                mbedtls_gcm_free(&m_ctx);
-                return GCM_DECRYPT_FAILED;
-            }
-        } else {
-            success = mbedtls_gcm_starts(&m_ctx, MBEDTLS_GCM_DECRYPT, initialization_vector, sizeof(initialization_vector),NULL, 0);
-            if (0 != success) {
-                mbedtls_gcm_free(&m_ctx);
-                return GCM_DECRYPT_FAILED;
-            }
-            success = mbedtls_gcm_update(&m_ctx, sizeof(cipher_text), cipher_text, (unsigned char*)(ptr));
-            if (0 != success) {
-                mbedtls_gcm_free(&m_ctx);
+        // mbedtls does not allow the output to be the input, so the cipher text goes through a small buffer
+        // and is written back over itself one chunk at a time
+        bool check = authenticate && authkeylen > 0;
+        if(mbedtls_gcm_starts(&gcmCtx, MBEDTLS_GCM_DECRYPT, initialization_vector, sizeof(initialization_vector),
+            check ? additional_authenticated_data : NULL, check ? aadlen : 0) != 0) {
+            return GCM_DECRYPT_FAILED;
+        }
+        uint8_t chunk[GCM_CHUNK_SIZE];
+        for(uint32_t pos = 0; pos < cipherlen; pos += GCM_CHUNK_SIZE) {
+            uint32_t n = min((uint32_t) GCM_CHUNK_SIZE, cipherlen - pos);
+            if(mbedtls_gcm_update(&gcmCtx, n, ptr + pos, chunk) != 0) {
                 return GCM_DECRYPT_FAILED;
             }
+            memcpy(ptr + pos, chunk, n);
+        }
+        uint8_t tag[16];
+        if(mbedtls_gcm_finish(&gcmCtx, tag, sizeof(tag)) != 0) {
+            return GCM_DECRYPT_FAILED;
+        }
+        if(check) {
+            uint8_t diff = 0;
+            for(uint8_t i = 0; i < authkeylen; i++) diff |= tag[i] ^ authentication_tag[i];
+            if(diff != 0) return GCM_AUTH_FAILED;
         }
-        mbedtls_gcm_free(&m_ctx);
     #endif
 
     ctx.length -= footersize + headersize;
     return ptr-d;
-}
\ No newline at end of file
+}
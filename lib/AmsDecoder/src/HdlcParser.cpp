@@ -8,6 +8,10 @@
 #include "lwip/def.h"
 #include "crc.h"
 
+HDLCParser::HDLCParser(SegmentArena* segments) {
+    this->segments = segments;
+}
+
 int8_t HDLCParser::parse(uint8_t *d, DataParserContext &ctx) {
     int len;
 
@@ -52,6 +56,7 @@ int8_t HDLCParser::parse(uint8_t *d, DataParserContext &ctx) {
         // Verify HCS
         if(ntohs(t3->hcs) != crc16_x25(d + 1, ptr-d))
             return DATA_PARSE_HEADER_CHECKSUM_ERROR;
+        control = t3->control;
         ptr += 3;
 
         // Exclude all of header and 3 byte footer
@@ -60,36 +65,35 @@ int8_t HDLCParser::parse(uint8_t *d, DataParserContext &ctx) {
             ctx.length -= 3;
         }
 
+        // Segments are joined without LLC, which is only required in the first but repeated by some meters
+        uint8_t* info = ptr;
+        uint16_t infoLength = ctx.length;
+        if(((h->format & 0x08) == 0x08 || lastSequenceNumber > 0) && infoLength >= 3 && info[0] == 0xE6 && (info[1] == 0xE6 || info[1] == 0xE7) && info[2] == 0x00) {
+            info += 3;
+            infoLength -= 3;
+        }
+
         // Payload incomplete
         if((h->format & 0x08) == 0x08) {
-            if(lastSequenceNumber == 0) {
-                if(buf == NULL) buf = (uint8_t *)malloc((size_t)1024);
-                pos = 0;
+            if(!segments->append(info, infoLength, lastSequenceNumber, lastSequenceNumber == 0)) {
+                lastSequenceNumber = 0;
+                return DATA_PARSE_FAIL;
             }
-
-            if(buf == NULL) return DATA_PARSE_FAIL;
-
-            memcpy(buf + pos, ptr+3, ctx.length); // +3 to skip LLC
-            pos += ctx.length;
-
             lastSequenceNumber++;
             return DATA_PARSE_INTERMEDIATE_SEGMENT;
         } else if(lastSequenceNumber > 0) {
+            bool ok = segments->append(info, infoLength, lastSequenceNumber, false);
             lastSequenceNumber = 0;
-            if(buf == NULL) return DATA_PARSE_FAIL;
-
-            memcpy(buf + pos, ptr+3, ctx.length); // +3 to skip LLC
-            pos += ctx.length;
-
-            memcpy((uint8_t *) d, buf, pos);
-            free(buf);
-            buf = NULL;
-            ctx.length = pos;
-            pos = 0;
-            return DATA_PARSE_OK;
+            if(!ok) return DATA_PARSE_FAIL;
+            return DATA_PARSE_FINAL_SEGMENT;
         } else {
             return ptr-d;
         }
     }
     return DATA_PARSE_UNKNOWN_DATA;
-}
\ No newline at end of file
+}
+
+// Control field of the last frame that passed the checksums, frame type and sequence numbers for a pull client
+uint8_t HDLCParser::getControl() {
+    return control;
+}
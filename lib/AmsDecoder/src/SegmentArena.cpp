@@ -0,0 +1,72 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "SegmentArena.h"
+
+void SegmentArena::begin(uint8_t* buf, uint16_t size) {
+    this->buf = buf;
+    this->size = size;
+    clear();
+}
+
+void SegmentArena::clear() {
+    length = 0;
+    segments = 0;
+    active = false;
+}
+
+// Segments after the first must follow the previous sequence number, the message is dropped on a gap or overflow
+bool SegmentArena::append(const uint8_t* src, uint16_t len, uint16_t sequence, bool first) {
+    if(first) {
+        if(active) stats.dropped++;
+        clear();
+        active = true;
+    } else if(!active || sequence != (uint16_t) (lastSequence + 1)) {
+        stats.gaps++;
+        clear();
+        return false;
+    }
+
+    if(buf == NULL || len > size - length) {
+        stats.overflows++;
+        clear();
+        return false;
+    }
+
+    // The frame holding the segment is always read after the assembled part, so this only moves data down
+    memmove(buf + length, src, len);
+    length += len;
+    lastSequence = sequence;
+    segments++;
+    stats.segments++;
+    return true;
+}
+
+// Returns the length of the complete message at getData(), the arena is free for the next frame afterwards
+uint16_t SegmentArena::finish() {
+    uint16_t ret = length;
+    stats.messages++;
+    if(ret > stats.maxLength) stats.maxLength = ret;
+    if(segments > stats.maxSegments) stats.maxSegments = segments;
+    clear();
+    return ret;
+}
+
+uint8_t* SegmentArena::getData() {
+    return buf;
+}
+
+uint16_t SegmentArena::getLength() {
+    return length;
+}
+
+bool SegmentArena::isActive() {
+    return active;
+}
+
+SegmentArenaStats& SegmentArena::getStats() {
+    return stats;
+}
@@ -6,49 +6,95 @@
 
 #include "crc.h"
 
-uint16_t crc16_x25(const uint8_t* p, int len)
-{
-	uint16_t crc = UINT16_MAX;
+// Table entries are generated at compile time from the polynomial, one byte at a time
+constexpr uint16_t crc16_reflected_entry(uint16_t poly, uint16_t crc, uint8_t bits) {
+	return bits == 0 ? crc : crc16_reflected_entry(poly, (crc & 1) ? (crc >> 1) ^ poly : (crc >> 1), bits - 1);
+}
+
+constexpr uint16_t crc16_normal_entry(uint16_t poly, uint16_t crc, uint8_t bits) {
+	return bits == 0 ? crc : crc16_normal_entry(poly, (crc & 0x8000) ? (crc << 1) ^ poly : (crc << 1), bits - 1);
+}
+
+// Slice k holds the effect of a byte followed by k zero bytes
+constexpr uint16_t crc16_reflected_slice(uint16_t poly, uint16_t i, uint8_t k) {
+	return k == 0 ? crc16_reflected_entry(poly, i, 8) :
+		(crc16_reflected_slice(poly, i, k-1) >> 8) ^ crc16_reflected_entry(poly, crc16_reflected_slice(poly, i, k-1) & 0xFF, 8);
+}
+
+#define CRC_R(p, k, i) crc16_reflected_slice(p, i, k)
+#define CRC_R4(p, k, i) CRC_R(p, k, i), CRC_R(p, k, i+1), CRC_R(p, k, i+2), CRC_R(p, k, i+3)
+#define CRC_R16(p, k, i) CRC_R4(p, k, i), CRC_R4(p, k, i+4), CRC_R4(p, k, i+8), CRC_R4(p, k, i+12)
+#define CRC_R64(p, k, i) CRC_R16(p, k, i), CRC_R16(p, k, i+16), CRC_R16(p, k, i+32), CRC_R16(p, k, i+48)
+#define CRC_R256(p, k) { CRC_R64(p, k, 0), CRC_R64(p, k, 64), CRC_R64(p, k, 128), CRC_R64(p, k, 192) }
+
+#define CRC_N(p, i) crc16_normal_entry(p, (i) << 8, 8)
+#define CRC_N4(p, i) CRC_N(p, i), CRC_N(p, i+1), CRC_N(p, i+2), CRC_N(p, i+3)
+#define CRC_N16(p, i) CRC_N4(p, i), CRC_N4(p, i+4), CRC_N4(p, i+8), CRC_N4(p, i+12)
+#define CRC_N64(p, i) CRC_N16(p, i), CRC_N16(p, i+16), CRC_N16(p, i+32), CRC_N16(p, i+48)
+#define CRC_N256(p) { CRC_N64(p, 0), CRC_N64(p, 64), CRC_N64(p, 128), CRC_N64(p, 192) }
 
+#if defined(ESP32)
+// Slicing-by-4, 2 KB per polynomial against 512 bytes for one table. Flash is memory mapped and cached so the extra
+// tables are cheap to read
+static const uint16_t crc16_x25_table[4][256] = {
+	CRC_R256(0x8408, 0), CRC_R256(0x8408, 1), CRC_R256(0x8408, 2), CRC_R256(0x8408, 3)
+};
+static const uint16_t crc16_a001_table[4][256] = {
+	CRC_R256(0xA001, 0), CRC_R256(0xA001, 1), CRC_R256(0xA001, 2), CRC_R256(0xA001, 3)
+};
+
+static uint16_t crc16_reflected_update(const uint16_t table[4][256], uint16_t crc, const uint8_t* p, int len) {
+	while(len >= 4) {
+		crc ^= p[0] | (p[1] << 8);
+		crc = table[3][crc & 0xFF] ^ table[2][crc >> 8] ^ table[1][p[2]] ^ table[0][p[3]];
+		p += 4;
+		len -= 4;
+	}
 	while(len--)
-		for (uint16_t i = 0, d = 0xff & *p++; i < 8; i++, d >>= 1)
-			crc = ((crc & 1) ^ (d & 1)) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
+		crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+	return crc;
+}
+#else
+// One 256 entry table per polynomial, kept in flash
+static const uint16_t crc16_x25_table[1][256] PROGMEM = { CRC_R256(0x8408, 0) };
+static const uint16_t crc16_a001_table[1][256] PROGMEM = { CRC_R256(0xA001, 0) };
 
+static uint16_t crc16_reflected_update(const uint16_t table[1][256], uint16_t crc, const uint8_t* p, int len) {
+	while(len--)
+		crc = (crc >> 8) ^ pgm_read_word(&table[0][(crc ^ *p++) & 0xFF]);
+	return crc;
+}
+#endif
+
+static const uint16_t crc16_1021_table[256] PROGMEM = CRC_N256(0x1021);
+
+uint16_t crc16_x25_update(uint16_t crc, const uint8_t* p, int len) {
+	return crc16_reflected_update(crc16_x25_table, crc, p, len);
+}
+
+uint16_t crc16_x25_final(uint16_t crc) {
 	return (~crc << 8) | (~crc >> 8 & 0xff);
 }
 
-uint16_t crc16 (const uint8_t *p, int len) {
-    uint16_t crc = 0;
+uint16_t crc16_x25(const uint8_t* p, int len) {
+	return crc16_x25_final(crc16_x25_update(CRC16_X25_INIT, p, len));
+}
 
-    while (len--) {
-		uint8_t i;
-		crc ^= *p++;
-		for (i = 0 ; i < 8 ; ++i) {
-			if (crc & 1)
-				crc = (crc >> 1) ^ 0xa001;
-			else
-				crc = (crc >> 1);
-		}    			
-    }
-    
-    return crc;
+uint16_t crc16_update(uint16_t crc, const uint8_t* p, int len) {
+	return crc16_reflected_update(crc16_a001_table, crc, p, len);
 }
 
-uint16_t crc16_1021(const uint8_t *p, int len) {
-	uint32_t crc = 0x0000;
-	for(int i = 0; i < len; i++) {
-		int mask = 0x80;
-		while(mask > 0) {
-			crc <<= 1;
-			if (p[i] & mask){
-				crc |= 1;
-			}
-			mask>>=1;
-			if (crc & 0x10000) {
-				crc &= 0xffff;
-				crc ^= 0x1021;
-			}
-		}
-	}
+uint16_t crc16(const uint8_t *p, int len) {
+	return crc16_update(CRC16_INIT, p, len);
+}
+
+// Input bits are shifted straight into the register, no augmentation with zero bits
+uint16_t crc16_1021_update(uint16_t crc, const uint8_t* p, int len) {
+	while(len--)
+		crc = ((crc << 8) | *p++) ^ pgm_read_word(&crc16_1021_table[crc >> 8]);
 	return crc;
 }
+
+uint16_t crc16_1021(const uint8_t *p, int len) {
+	return crc16_1021_update(CRC16_1021_INIT, p, len);
+}
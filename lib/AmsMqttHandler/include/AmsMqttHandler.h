@@ -19,6 +19,9 @@
 #include <esp_task_wdt.h>
 #endif
 
+// Unchanged values are still published this often, so subscribers that joined late get everything
+#define AMS_MQTT_REFRESH_INTERVAL 60000
+
 class AmsMqttHandler {
 public:
     AmsMqttHandler(MqttConfig& mqttConfig, RemoteDebug* debugger, char* buf) {
@@ -65,6 +68,9 @@ protected:
     WiFiClientSecure *mqttSecureClient = NULL;
     char* json;
     uint16_t BufferSize = 2048;
+    unsigned long lastRefresh = -AMS_MQTT_REFRESH_INTERVAL;
+
+    uint64_t getChangedFields(AmsData* data, AmsData* previousState);
 };
 
 #endif
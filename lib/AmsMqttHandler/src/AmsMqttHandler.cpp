@@ -13,6 +13,15 @@ void AmsMqttHandler::setCaVerification(bool caVerification) {
 	this->caVerification = caVerification;
 }
 
+// Fields in data that differ from previousState, or all of them when a refresh is due
+uint64_t AmsMqttHandler::getChangedFields(AmsData* data, AmsData* previousState) {
+	if(previousState == NULL || previousState == data || millis() - lastRefresh >= AMS_MQTT_REFRESH_INTERVAL) {
+		lastRefresh = millis();
+		return AMS_FIELDS_ALL;
+	}
+	return previousState->diff(*data);
+}
+
 void AmsMqttHandler::setConfig(MqttConfig& mqttConfig) {
 	this->mqttConfig = mqttConfig;
 	this->mqttConfigChanged = true;
@@ -123,6 +132,7 @@ bool AmsMqttHandler::connect() {
 			}
 		}
 		mqtt.publish(statusTopic, "online", true, 0);
+		lastRefresh = millis() - AMS_MQTT_REFRESH_INTERVAL;
         mqtt.loop();
         return true;
 	} else {
@@ -36,6 +36,8 @@
 #endif
 
 #define CC_BUF_SIZE 2048
+// Intervals to wait before sending an update when the meter data has not changed
+#define CC_IDLE_INTERVALS 6
 
 static const char CC_JSON_POWER[] PROGMEM = ",\"%s\":{\"P\":%lu,\"Q\":%lu}";
 static const char CC_JSON_POWER_LIST3[] PROGMEM = ",\"%s\":{\"P\":%lu,\"Q\":%lu,\"tP\":%.3f,\"tQ\":%.3f}";
@@ -77,6 +79,9 @@ private:
     String uuid;
     bool initialized = false;
     unsigned long lastUpdate = 0;
+    uint64_t pendingFields = AMS_FIELDS_ALL;
+    uint32_t lastUpdateCount = 0;
+    int8_t lastHanError = 0;
     char mac[18];
     char apmac[18];
 
@@ -145,8 +145,16 @@ bool CloudConnector::init() {
 
 void CloudConnector::update(AmsData& data, EnergyAccounting& ea) {
     if(!config.enabled) return;
+
+    // Collect what the meter changed since the last update, a missed mask counts as everything
+    if(data.getUpdateCount() != lastUpdateCount) {
+        pendingFields |= data.getUpdateCount() - lastUpdateCount == 1 ? data.getChangedFields() : AMS_FIELDS_ALL;
+        lastUpdateCount = data.getUpdateCount();
+    }
+
     unsigned long now = millis();
     if(now-lastUpdate < config.interval*1000) return;
+    if(lastUpdate != 0 && pendingFields == 0 && data.getLastError() == lastHanError && now-lastUpdate < config.interval*1000*CC_IDLE_INTERVALS) return;
     if(!ESPRandom::isValidV4Uuid(config.clientId)) {
         if(debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("(CloudConnector) Client ID is not valid\n"));
         return;
@@ -207,8 +215,8 @@ void CloudConnector::update(AmsData& data, EnergyAccounting& ea) {
             tz == NULL ? 0 : (tz->toLocal(now)-now)/3600,
             data.getMeterType(),
             meterManufacturer(data.getMeterType()).c_str(),
-            data.getMeterModel().c_str(),
-            data.getMeterId().c_str(),
+            data.getMeterModel(),
+            data.getMeterId(),
             distributionSystemStr(distributionSystem).c_str(),
             mainFuse,
             maxPwr,
@@ -378,6 +386,8 @@ void CloudConnector::update(AmsData& data, EnergyAccounting& ea) {
     udp.endPacket();
 
     lastUpdate = now;
+    pendingFields = 0;
+    lastHanError = data.getLastError();
 }
 
 void CloudConnector::forceUpdate() {
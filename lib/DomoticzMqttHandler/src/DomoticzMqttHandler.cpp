@@ -9,7 +9,8 @@
 
 bool DomoticzMqttHandler::publish(AmsData* data, AmsData* previousState, EnergyAccounting* ea, PriceService* ps) {
     bool ret = false;
-    if (config.elidx > 0) {
+    uint64_t changed = getChangedFields(data, previousState);
+    if (config.elidx > 0 && (changed & (AMS_FIELD(AmsFieldActiveImportPower) | AMS_FIELD(AmsFieldActiveImportCounter)))) {
         if(data->getActiveImportCounter() > 1.0) {
             energy = data->getActiveImportCounter();
         }
@@ -28,7 +29,7 @@ bool DomoticzMqttHandler::publish(AmsData* data, AmsData* previousState, EnergyA
     if(data->getListType() == 1)
         return ret;
 
-    if (config.vl1idx > 0){				
+    if (config.vl1idx > 0 && (changed & AMS_FIELD(AmsFieldL1Voltage))){				
         char val[16];
         snprintf_P(val, 16, PSTR("%.2f"), data->getL1Voltage());
         snprintf_P(json, BufferSize, DOMOTICZ_JSON,
@@ -39,7 +40,7 @@ bool DomoticzMqttHandler::publish(AmsData* data, AmsData* previousState, EnergyA
         mqtt.loop();
     }
 
-    if (config.vl2idx > 0){				
+    if (config.vl2idx > 0 && (changed & AMS_FIELD(AmsFieldL2Voltage))){				
         char val[16];
         snprintf_P(val, 16, PSTR("%.2f"), data->getL2Voltage());
         snprintf_P(json, BufferSize, DOMOTICZ_JSON,
@@ -50,7 +51,7 @@ bool DomoticzMqttHandler::publish(AmsData* data, AmsData* previousState, EnergyA
         mqtt.loop();
     }
 
-    if (config.vl3idx > 0){				
+    if (config.vl3idx > 0 && (changed & AMS_FIELD(AmsFieldL3Voltage))){				
         char val[16];
         snprintf(val, 16, "%.2f", data->getL3Voltage());
         snprintf_P(json, BufferSize, DOMOTICZ_JSON,
@@ -61,7 +62,7 @@ bool DomoticzMqttHandler::publish(AmsData* data, AmsData* previousState, EnergyA
         mqtt.loop();
     }
 
-    if (config.cl1idx > 0){				
+    if (config.cl1idx > 0 && (changed & (AMS_FIELD(AmsFieldL1Current) | AMS_FIELD(AmsFieldL2Current) | AMS_FIELD(AmsFieldL3Current)))){				
         char val[16];
         snprintf(val, 16, "%.1f;%.1f;%.1f", data->getL1Current(), data->getL2Current(), data->getL3Current());
         snprintf_P(json, BufferSize, DOMOTICZ_JSON,
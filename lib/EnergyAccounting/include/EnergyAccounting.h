@@ -80,7 +80,7 @@ struct EnergyAccountingRealtimeData {
 
 class EnergyAccounting {
 public:
-    EnergyAccounting(RemoteDebug*, EnergyAccountingRealtimeData*);
+    EnergyAccounting(RemoteDebug*, EnergyAccountingRealtimeData*, RecordLog*);
     void setup(AmsDataStorage *ds, EnergyAccountingConfig *config);
     void setPriceService(PriceService *ps);
     void setTimezone(Timezone*);
@@ -88,6 +88,8 @@ public:
     bool update(AmsData* amsData);
     bool load();
     bool save();
+    // Record log streams written by save()
+    uint8_t getStreams();
     bool isInitialized();
 
     float getUseThisHour();
@@ -124,6 +126,7 @@ public:
 
 private:
     RemoteDebug* debugger = NULL;
+    RecordLog* records = NULL;
     bool init = false, initPrice = false;
     AmsDataStorage *ds = NULL;
     PriceService *ps = NULL;
@@ -133,6 +136,7 @@ private:
     EnergyAccountingRealtimeData* realtimeData = NULL;
     String currency = "";
 
+    bool loadFile();
     void calcDayCost();
     bool updateMax(uint16_t val, uint8_t day);
 };
@@ -9,9 +9,11 @@
 #include "AmsStorage.h"
 #include "FirmwareVersion.h"
 
-EnergyAccounting::EnergyAccounting(RemoteDebug* debugger, EnergyAccountingRealtimeData* rtd) {
+EnergyAccounting::EnergyAccounting(RemoteDebug* debugger, EnergyAccountingRealtimeData* rtd, RecordLog* records) {
     data.version = 1;
     this->debugger = debugger;
+    this->records = records;
+    records->attach(RECORD_LOG_STREAM_ACCOUNTING, &data, sizeof(data));
     if(rtd->magic != 0x6A) {
         rtd->magic = 0x6A;
         rtd->currentHour = 0;
@@ -396,6 +398,14 @@ bool EnergyAccounting::load() {
         return false;
     }
 
+    if(records->load(RECORD_LOG_STREAM_ACCOUNTING)) {
+        return data.version == 6;
+    }
+    return loadFile();
+}
+
+// File from before the record log, its contents are moved into it
+bool EnergyAccounting::loadFile() {
     bool ret = false;
     if(LittleFS.exists(FILE_ENERGYACCOUNTING)) {
         File file = LittleFS.open(FILE_ENERGYACCOUNTING, "r");
@@ -486,6 +496,9 @@ bool EnergyAccounting::load() {
         file.close();
     }
 
+    if(ret && save()) {
+        LittleFS.remove(FILE_ENERGYACCOUNTING);
+    }
     return ret;
 }
 
@@ -493,16 +506,11 @@ bool EnergyAccounting::save() {
     if(!LittleFS.begin()) {
         return false;
     }
-    {
-        File file = LittleFS.open(FILE_ENERGYACCOUNTING, "w");
-        char buf[sizeof(data)];
-        memcpy(buf, &data, sizeof(data));
-        for(uint8_t i = 0; i < sizeof(buf); i++) {
-            file.write(buf[i]);
-        }
-        file.close();
-    }
-    return true;
+    return records->save(getStreams());
+}
+
+uint8_t EnergyAccounting::getStreams() {
+    return 1 << RECORD_LOG_STREAM_ACCOUNTING;
 }
 
 EnergyAccountingData EnergyAccounting::getData() {
@@ -27,20 +27,24 @@ bool HomeAssistantMqttHandler::publish(AmsData* data, AmsData* previousState, En
     if(time(nullptr) < FirmwareVersion::BuildEpoch)
         return false;
 
-    if(data->getListType() >= 3) { // publish energy counts
-        publishList3(data, ea);
-        mqtt.loop();
-    }
+    // Lists where nothing has changed are skipped, Home Assistant keeps the last state of each sensor
+    uint64_t changed = getChangedFields(data, previousState) & data->getPresentFields();
+    if(changed != 0) {
+        if(data->getListType() >= 3) { // publish energy counts
+            publishList3(data, ea);
+            mqtt.loop();
+        }
 
-    if(data->getListType() == 1) { // publish power counts
-        publishList1(data, ea);
-        mqtt.loop();
-    } else if(data->getListType() <= 3) { // publish power counts and volts/amps
-        publishList2(data, ea);
-        mqtt.loop();
-    } else if(data->getListType() == 4) { // publish power counts and volts/amps/phase power and PF
-        publishList4(data, ea);
-        mqtt.loop();
+        if(data->getListType() == 1) { // publish power counts
+            publishList1(data, ea);
+            mqtt.loop();
+        } else if(data->getListType() <= 3) { // publish power counts and volts/amps
+            publishList2(data, ea);
+            mqtt.loop();
+        } else if(data->getListType() == 4) { // publish power counts and volts/amps/phase power and PF
+            publishList4(data, ea);
+            mqtt.loop();
+        }
     }
 
     if(ea->isInitialized()) {
@@ -61,8 +65,8 @@ bool HomeAssistantMqttHandler::publishList2(AmsData* data, EnergyAccounting* ea)
     publishList2Sensors();
     if(data->getActiveExportPower() > 0) publishList2ExportSensors();
     snprintf_P(json, BufferSize, HA3_JSON,
-        data->getListId().c_str(),
-        data->getMeterId().c_str(),
+        data->getListId(),
+        data->getMeterId(),
         getMeterModel(data).c_str(),
         data->getActiveImportPower(),
         data->getReactiveImportPower(),
@@ -95,8 +99,8 @@ bool HomeAssistantMqttHandler::publishList4(AmsData* data, EnergyAccounting* ea)
     publishList4Sensors();
     if(data->getL1ActiveExportPower() > 0 || data->getL2ActiveExportPower() > 0 || data->getL3ActiveExportPower() > 0) publishList4ExportSensors();
     snprintf_P(json, BufferSize, HA4_JSON,
-        data->getListId().c_str(),
-        data->getMeterId().c_str(),
+        data->getListId(),
+        data->getMeterId(),
         getMeterModel(data).c_str(),
         data->getActiveImportPower(),
         data->getL1ActiveImportPower(),
@@ -19,6 +19,13 @@ bool JsonMqttHandler::publish(AmsData* data, AmsData* previousState, EnergyAccou
 		return false;
     }
 
+    uint64_t changed = getChangedFields(data, previousState);
+    if((changed & data->getPresentFields()) == 0) {
+        if(debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("List ID %d unchanged, not publishing\n"), data->getListType());
+        loop();
+        return false;
+    }
+
     bool ret = false;
     memset(json, 0, BufferSize);
 
@@ -101,8 +108,8 @@ bool JsonMqttHandler::publishList2(AmsData* data, EnergyAccounting* ea) {
         pos += snprintf_P(json+pos, BufferSize-pos, PSTR("\"data\":{"));
     }
     pos += snprintf_P(json+pos, BufferSize-pos, PSTR("\"lv\":\"%s\",\"meterId\":\"%s\",\"type\":\"%s\",\"P\":%d,\"Q\":%d,\"PO\":%d,\"QO\":%d,\"I1\":%.2f,\"I2\":%.2f,\"I3\":%.2f,\"U1\":%.2f,\"U2\":%.2f,\"U3\":%.2f"),
-        data->getListId().c_str(),
-        data->getMeterId().c_str(),
+        data->getListId(),
+        data->getMeterId(),
         getMeterModel(data).c_str(),
         data->getActiveImportPower(),
         data->getReactiveImportPower(),
@@ -132,8 +139,8 @@ bool JsonMqttHandler::publishList3(AmsData* data, EnergyAccounting* ea) {
         pos += snprintf_P(json+pos, BufferSize-pos, PSTR("\"data\":{"));
     }
     pos += snprintf_P(json+pos, BufferSize-pos, PSTR("\"lv\":\"%s\",\"meterId\":\"%s\",\"type\":\"%s\",\"P\":%d,\"Q\":%d,\"PO\":%d,\"QO\":%d,\"I1\":%.2f,\"I2\":%.2f,\"I3\":%.2f,\"U1\":%.2f,\"U2\":%.2f,\"U3\":%.2f,\"tPI\":%.3f,\"tPO\":%.3f,\"tQI\":%.3f,\"tQO\":%.3f,\"rtc\":%lu"),
-        data->getListId().c_str(),
-        data->getMeterId().c_str(),
+        data->getListId(),
+        data->getMeterId(),
         getMeterModel(data).c_str(),
         data->getActiveImportPower(),
         data->getReactiveImportPower(),
@@ -168,8 +175,8 @@ bool JsonMqttHandler::publishList4(AmsData* data, EnergyAccounting* ea) {
         pos += snprintf_P(json+pos, BufferSize-pos, PSTR("\"data\":{"));
     }
     pos += snprintf_P(json+pos, BufferSize-pos, PSTR("\"lv\":\"%s\",\"meterId\":\"%s\",\"type\":\"%s\",\"P\":%d,\"P1\":%d,\"P2\":%d,\"P3\":%d,\"Q\":%d,\"PO\":%d,\"PO1\":%d,\"PO2\":%d,\"PO3\":%d,\"QO\":%d,\"I1\":%.2f,\"I2\":%.2f,\"I3\":%.2f,\"U1\":%.2f,\"U2\":%.2f,\"U3\":%.2f,\"PF\":%.2f,\"PF1\":%.2f,\"PF2\":%.2f,\"PF3\":%.2f,\"tPI\":%.3f,\"tPO\":%.3f,\"tQI\":%.3f,\"tQO\":%.3f,\"tPI1\":%.3f,\"tPI2\":%.3f,\"tPI3\":%.3f,\"tPO1\":%.3f,\"tPO2\":%.3f,\"tPO3\":%.3f,\"rtc\":%lu"),
-        data->getListId().c_str(),
-        data->getMeterId().c_str(),
+        data->getListId(),
+        data->getMeterId(),
         getMeterModel(data).c_str(),
         data->getActiveImportPower(),
         data->getL1ActiveImportPower(),
@@ -0,0 +1,92 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _PERSISTENCESCHEDULER_H
+#define _PERSISTENCESCHEDULER_H
+
+#include "Arduino.h"
+#include "RemoteDebug.h"
+#include "RecordLog.h"
+#include <functional>
+
+#define PERSIST_DATA 0
+#define PERSIST_ACCOUNTING 1
+#define PERSIST_PRICES 2
+#define PERSIST_CONFIG 3
+#define PERSIST_CERTIFICATES 4
+#define PERSIST_HISTORY 5 // Closed quarter hour days and history slots, appended to their files
+#define PERSIST_MODULES 6
+
+// Modules marked dirty within this many ms of the first one are written together
+#define PERSIST_WINDOW 5000
+// Longest a flush is held back while HAN data is arriving
+#define PERSIST_MAX_DEFER 60000
+// Longest held changes wait for another module to be written, a day closes before that
+#define PERSIST_MAX_HOLD 86400000
+
+// Writes the module, returns the number of bytes written or -1 when it failed
+typedef std::function<int32_t()> PersistFunction;
+
+struct PersistModule {
+    uint8_t streams; // Record log streams, saved together with those of the other dirty modules
+    uint8_t after; // Modules whose files the streams refer to, the streams wait while one of those fails
+    PersistFunction save;
+    uint32_t writes;
+    uint32_t bytes;
+    uint16_t failures;
+};
+
+/**
+ * Modules mark themselves dirty instead of writing to flash at once. When the first one has waited for the window,
+ * all dirty modules are written in one go, but not while a HAN frame is arriving as flash writes stall the CPU. The
+ * modules that write their own files go first, then the record log streams of the dirty modules are appended in a
+ * single save, so the record log never refers to something that is not in a file yet. Changes that are only worth a
+ * write of their own now and then, like the hourly ones, are held in RAM and go with the next flush, before restarting
+ * or when power is failing. When a file module fails, the
+ * streams attached after it are not saved and stay dirty, what the record log drops is still only in RAM.
+ */
+class PersistenceScheduler {
+public:
+    PersistenceScheduler(RemoteDebug*, RecordLog*);
+    void attach(uint8_t module, uint8_t streams, uint8_t after = 0);
+    void attach(uint8_t module, PersistFunction save);
+
+    // Held changes are written with the next flush instead of after the window
+    void setDirty(uint8_t module, bool hold = false);
+    bool isDirty(uint8_t module);
+    // Counts a write the module did by itself, for what cannot wait, like configuration and uploaded certificates
+    void written(uint8_t module, uint32_t bytes);
+
+    // Busy is true while HAN data is arriving
+    void loop(bool busy);
+    // Writes the dirty modules now, before restarting or when power is failing
+    bool flush();
+    // The file system has been formatted, the record log starts over
+    void formatted();
+
+    uint32_t getWrites(uint8_t module);
+    uint32_t getBytes(uint8_t module);
+    uint16_t getFailures(uint8_t module);
+    uint32_t getFlushes();
+    uint32_t getDeferrals();
+
+private:
+    RemoteDebug* debugger;
+    RecordLog* records;
+    PersistModule modules[PERSIST_MODULES];
+
+    uint8_t dirty = 0;
+    unsigned long dirtySince = 0;
+    uint8_t held = 0;
+    unsigned long heldSince = 0;
+    bool deferring = false;
+    uint32_t flushes = 0;
+    uint32_t deferrals = 0;
+
+    uint32_t getRecords(uint8_t streams);
+};
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "PersistenceScheduler.h"
+#include "LittleFS.h"
+
+PersistenceScheduler::PersistenceScheduler(RemoteDebug* debugger, RecordLog* records) {
+    this->debugger = debugger;
+    this->records = records;
+    for(uint8_t i = 0; i < PERSIST_MODULES; i++) {
+        modules[i].streams = 0;
+        modules[i].after = 0;
+        modules[i].save = NULL;
+        modules[i].writes = 0;
+        modules[i].bytes = 0;
+        modules[i].failures = 0;
+    }
+}
+
+void PersistenceScheduler::attach(uint8_t module, uint8_t streams, uint8_t after) {
+    if(module >= PERSIST_MODULES) return;
+    modules[module].streams = streams;
+    modules[module].after = after;
+}
+
+void PersistenceScheduler::attach(uint8_t module, PersistFunction save) {
+    if(module >= PERSIST_MODULES) return;
+    modules[module].save = save;
+}
+
+void PersistenceScheduler::setDirty(uint8_t module, bool hold) {
+    if(module >= PERSIST_MODULES) return;
+    if(hold) {
+        if(held == 0) heldSince = millis();
+        held |= 1 << module;
+        return;
+    }
+    if(dirty == 0) dirtySince = millis();
+    dirty |= 1 << module;
+}
+
+bool PersistenceScheduler::isDirty(uint8_t module) {
+    return module < PERSIST_MODULES && ((dirty | held) & (1 << module)) != 0;
+}
+
+void PersistenceScheduler::written(uint8_t module, uint32_t bytes) {
+    if(module >= PERSIST_MODULES) return;
+    modules[module].writes++;
+    modules[module].bytes += bytes;
+}
+
+void PersistenceScheduler::loop(bool busy) {
+    if(held != 0 && millis() - heldSince >= PERSIST_MAX_HOLD) {
+        if(dirty == 0) dirtySince = millis();
+        dirty |= held;
+        held = 0;
+    }
+    if(dirty == 0) return;
+
+    unsigned long waited = millis() - dirtySince;
+    if(waited < PERSIST_WINDOW) return;
+    if(busy && waited < PERSIST_MAX_DEFER) {
+        if(!deferring) deferrals++;
+        deferring = true;
+        return;
+    }
+    flush();
+}
+
+uint32_t PersistenceScheduler::getRecords(uint8_t streams) {
+    uint32_t count = 0;
+    for(uint8_t i = 0; i < RECORD_LOG_STREAMS; i++) {
+        if(streams & (1 << i)) count += records->getRecordsWritten(i);
+    }
+    return count;
+}
+
+// Modules that fail stay dirty and are tried again after another window
+bool PersistenceScheduler::flush() {
+    if(dirty == 0) dirtySince = heldSince;
+    dirty |= held;
+    held = 0;
+    if(dirty == 0) return true;
+
+    uint8_t failed = 0;
+
+    // Files first, the record log can refer to what is in them
+    for(uint8_t i = 0; i < PERSIST_MODULES; i++) {
+        if((dirty & (1 << i)) == 0 || modules[i].streams != 0) continue;
+        int32_t bytes = modules[i].save == NULL ? -1 : modules[i].save();
+        if(bytes < 0) {
+            modules[i].failures++;
+            failed |= 1 << i;
+        } else {
+            modules[i].writes++;
+            modules[i].bytes += bytes;
+        }
+    }
+
+    // Not the streams that would drop what a failed file module still holds, they are saved with it next time
+    uint8_t waiting = 0;
+    for(uint8_t i = 0; i < PERSIST_MODULES; i++) {
+        if((dirty & (1 << i)) != 0 && modules[i].streams != 0 && (modules[i].after & failed) != 0) waiting |= 1 << i;
+    }
+
+    uint8_t streams = 0;
+    uint32_t before[PERSIST_MODULES];
+    for(uint8_t i = 0; i < PERSIST_MODULES; i++) {
+        if(((dirty & ~waiting) & (1 << i)) == 0 || modules[i].streams == 0) continue;
+        streams |= modules[i].streams;
+        before[i] = getRecords(modules[i].streams);
+    }
+    if(streams != 0) {
+        bool ok = LittleFS.begin() && records->save(streams);
+        for(uint8_t i = 0; i < PERSIST_MODULES; i++) {
+            if(((dirty & ~waiting) & (1 << i)) == 0 || modules[i].streams == 0) continue;
+            if(ok) {
+                modules[i].writes++;
+                modules[i].bytes += (getRecords(modules[i].streams) - before[i]) * sizeof(RecordLogEntry);
+            } else {
+                modules[i].failures++;
+                failed |= 1 << i;
+            }
+        }
+    }
+
+    if(debugger->isActive(RemoteDebug::DEBUG)) {
+        debugger->printf_P(PSTR("(PersistenceScheduler) Flushed modules %02X after %lu ms, %d failed\n"), dirty, millis() - dirtySince, failed);
+        for(uint8_t i = 0; i < PERSIST_MODULES; i++) {
+            debugger->printf_P(PSTR("(PersistenceScheduler)  module %d: %lu writes, %lu bytes, %d failures\n"), i, modules[i].writes, modules[i].bytes, modules[i].failures);
+        }
+    }
+
+    flushes++;
+    deferring = false;
+    dirty = failed | waiting;
+    dirtySince = millis();
+    return failed == 0;
+}
+
+void PersistenceScheduler::formatted() {
+    records->reset();
+}
+
+uint32_t PersistenceScheduler::getWrites(uint8_t module) {
+    return module < PERSIST_MODULES ? modules[module].writes : 0;
+}
+
+uint32_t PersistenceScheduler::getBytes(uint8_t module) {
+    return module < PERSIST_MODULES ? modules[module].bytes : 0;
+}
+
+uint16_t PersistenceScheduler::getFailures(uint8_t module) {
+    return module < PERSIST_MODULES ? modules[module].failures : 0;
+}
+
+uint32_t PersistenceScheduler::getFlushes() {
+    return flushes;
+}
+
+uint32_t PersistenceScheduler::getDeferrals() {
+    return deferrals;
+}
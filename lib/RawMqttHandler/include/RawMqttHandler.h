@@ -29,10 +29,10 @@ private:
     bool full;
     String topic;
 
-    bool publishList1(AmsData* data, AmsData* meterState);
-    bool publishList2(AmsData* data, AmsData* meterState);
-    bool publishList3(AmsData* data, AmsData* meterState);
-    bool publishList4(AmsData* data, AmsData* meterState);
+    bool publishList1(AmsData* data, uint64_t changed);
+    bool publishList2(AmsData* data, uint64_t changed);
+    bool publishList3(AmsData* data, uint64_t changed);
+    bool publishList4(AmsData* data, uint64_t changed);
     bool publishRealtime(EnergyAccounting* ea);
 };
 #endif
@@ -12,21 +12,23 @@ bool RawMqttHandler::publish(AmsData* data, AmsData* meterState, EnergyAccountin
 	if(topic.isEmpty() || !mqtt.connected())
 		return false;
         
+    // Minimal format only sends what differs from the current state
+    uint64_t changed = full ? AMS_FIELDS_ALL : meterState->diff(*data);
     if(data->getPackageTimestamp() > 0) {
         mqtt.publish(topic + "/meter/dlms/timestamp", String(data->getPackageTimestamp()));
     }
     switch(data->getListType()) {
         case 4:
-            publishList4(data, meterState);
+            publishList4(data, changed);
             loop();
         case 3:
-            publishList3(data, meterState);
+            publishList3(data, changed);
             loop();
         case 2:
-            publishList2(data, meterState);
+            publishList2(data, changed);
             loop();
         case 1:
-            publishList1(data, meterState);
+            publishList1(data, changed);
             loop();
     }
     if(ea->isInitialized()) {
@@ -36,56 +38,56 @@ bool RawMqttHandler::publish(AmsData* data, AmsData* meterState, EnergyAccountin
     return true;
 }
 
-bool RawMqttHandler::publishList1(AmsData* data, AmsData* meterState) {
-    if(full || meterState->getActiveImportPower() != data->getActiveImportPower()) {
+bool RawMqttHandler::publishList1(AmsData* data, uint64_t changed) {
+    if(changed & AMS_FIELD(AmsFieldActiveImportPower)) {
         mqtt.publish(topic + "/meter/import/active", String(data->getActiveImportPower()));
     }
     return true;
 }
 
-bool RawMqttHandler::publishList2(AmsData* data, AmsData* meterState) {
+bool RawMqttHandler::publishList2(AmsData* data, uint64_t changed) {
     // Only send data if changed. ID and Type is sent on the 10s interval only if changed
-    if(full || meterState->getMeterId() != data->getMeterId()) {
+    if(changed & AMS_FIELD(AmsFieldMeterId)) {
         mqtt.publish(topic + "/meter/id", data->getMeterId());
     }
-    if(full || meterState->getMeterModel() != data->getMeterModel()) {
+    if(changed & AMS_FIELD(AmsFieldMeterModel)) {
         mqtt.publish(topic + "/meter/type", data->getMeterModel());
     }
     loop();
-    if(full || meterState->getL1Current() != data->getL1Current()) {
+    if(changed & AMS_FIELD(AmsFieldL1Current)) {
         mqtt.publish(topic + "/meter/l1/current", String(data->getL1Current(), 2));
     }
-    if(full || meterState->getL1Voltage() != data->getL1Voltage()) {
+    if(changed & AMS_FIELD(AmsFieldL1Voltage)) {
         mqtt.publish(topic + "/meter/l1/voltage", String(data->getL1Voltage(), 2));
     }
     loop();
-    if(full || meterState->getL2Current() != data->getL2Current()) {
+    if(changed & AMS_FIELD(AmsFieldL2Current)) {
         mqtt.publish(topic + "/meter/l2/current", String(data->getL2Current(), 2));
     }
-    if(full || meterState->getL2Voltage() != data->getL2Voltage()) {
+    if(changed & AMS_FIELD(AmsFieldL2Voltage)) {
         mqtt.publish(topic + "/meter/l2/voltage", String(data->getL2Voltage(), 2));
     }
     loop();
-    if(full || meterState->getL3Current() != data->getL3Current()) {
+    if(changed & AMS_FIELD(AmsFieldL3Current)) {
         mqtt.publish(topic + "/meter/l3/current", String(data->getL3Current(), 2));
     }
-    if(full || meterState->getL3Voltage() != data->getL3Voltage()) {
+    if(changed & AMS_FIELD(AmsFieldL3Voltage)) {
         mqtt.publish(topic + "/meter/l3/voltage", String(data->getL3Voltage(), 2));
     }
     loop();
-    if(full || meterState->getReactiveExportPower() != data->getReactiveExportPower()) {
+    if(changed & AMS_FIELD(AmsFieldReactiveExportPower)) {
         mqtt.publish(topic + "/meter/export/reactive", String(data->getReactiveExportPower()));
     }
-    if(full || meterState->getActiveExportPower() != data->getActiveExportPower()) {
+    if(changed & AMS_FIELD(AmsFieldActiveExportPower)) {
         mqtt.publish(topic + "/meter/export/active", String(data->getActiveExportPower()));
     }
-    if(full || meterState->getReactiveImportPower() != data->getReactiveImportPower()) {
+    if(changed & AMS_FIELD(AmsFieldReactiveImportPower)) {
         mqtt.publish(topic + "/meter/import/reactive", String(data->getReactiveImportPower()));
     }
     return true;
 }
 
-bool RawMqttHandler::publishList3(AmsData* data, AmsData* meterState) {
+bool RawMqttHandler::publishList3(AmsData* data, uint64_t changed) {
     // ID and type belongs to List 2, but I see no need to send that every 10s
     mqtt.publish(topic + "/meter/id", data->getMeterId(), true, 0);
     mqtt.publish(topic + "/meter/type", data->getMeterModel(), true, 0);
@@ -97,68 +99,68 @@ bool RawMqttHandler::publishList3(AmsData* data, AmsData* meterState) {
     return true;
 }
 
-bool RawMqttHandler::publishList4(AmsData* data, AmsData* meterState) {
-        if(full || meterState->getL1ActiveImportPower() != data->getL1ActiveImportPower()) {
+bool RawMqttHandler::publishList4(AmsData* data, uint64_t changed) {
+        if(changed & AMS_FIELD(AmsFieldL1ActiveImportPower)) {
             mqtt.publish(topic + "/meter/import/l1", String(data->getL1ActiveImportPower()));
             mqtt.loop();
         }
-        if(full || meterState->getL2ActiveImportPower() != data->getL2ActiveImportPower()) {
+        if(changed & AMS_FIELD(AmsFieldL2ActiveImportPower)) {
             mqtt.publish(topic + "/meter/import/l2", String(data->getL2ActiveImportPower()));
             mqtt.loop();
         }
-        if(full || meterState->getL3ActiveImportPower() != data->getL3ActiveImportPower()) {
+        if(changed & AMS_FIELD(AmsFieldL3ActiveImportPower)) {
             mqtt.publish(topic + "/meter/import/l3", String(data->getL3ActiveImportPower()));
             mqtt.loop();
         }
-        if(full || meterState->getL1ActiveExportPower() != data->getL1ActiveExportPower()) {
+        if(changed & AMS_FIELD(AmsFieldL1ActiveExportPower)) {
             mqtt.publish(topic + "/meter/export/l1", String(data->getL1ActiveExportPower()));
             mqtt.loop();
         }
-        if(full || meterState->getL2ActiveExportPower() != data->getL2ActiveExportPower()) {
+        if(changed & AMS_FIELD(AmsFieldL2ActiveExportPower)) {
             mqtt.publish(topic + "/meter/export/l2", String(data->getL2ActiveExportPower()));
             mqtt.loop();
         }
-        if(full || meterState->getL3ActiveExportPower() != data->getL3ActiveExportPower()) {
+        if(changed & AMS_FIELD(AmsFieldL3ActiveExportPower)) {
             mqtt.publish(topic + "/meter/export/l3", String(data->getL3ActiveExportPower()));
             mqtt.loop();
         }
-        if(full || meterState->getL1ActiveImportCounter() != data->getL1ActiveImportCounter()) {
+        if(changed & AMS_FIELD(AmsFieldL1ActiveImportCounter)) {
             mqtt.publish(topic + "/meter/import/l1/accumulated", String(data->getL1ActiveImportCounter(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL2ActiveImportCounter() != data->getL2ActiveImportCounter()) {
+        if(changed & AMS_FIELD(AmsFieldL2ActiveImportCounter)) {
             mqtt.publish(topic + "/meter/import/l2/accumulated", String(data->getL2ActiveImportCounter(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL3ActiveImportCounter() != data->getL3ActiveImportCounter()) {
+        if(changed & AMS_FIELD(AmsFieldL3ActiveImportCounter)) {
             mqtt.publish(topic + "/meter/import/l3/accumulated", String(data->getL3ActiveImportCounter(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL1ActiveExportCounter() != data->getL1ActiveExportCounter()) {
+        if(changed & AMS_FIELD(AmsFieldL1ActiveExportCounter)) {
             mqtt.publish(topic + "/meter/export/l1/accumulated", String(data->getL1ActiveExportCounter(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL2ActiveExportCounter() != data->getL2ActiveExportCounter()) {
+        if(changed & AMS_FIELD(AmsFieldL2ActiveExportCounter)) {
             mqtt.publish(topic + "/meter/export/l2/accumulated", String(data->getL2ActiveExportCounter(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL3ActiveExportCounter() != data->getL3ActiveExportCounter()) {
+        if(changed & AMS_FIELD(AmsFieldL3ActiveExportCounter)) {
             mqtt.publish(topic + "/meter/export/l3/accumulated", String(data->getL3ActiveExportCounter(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getPowerFactor() != data->getPowerFactor()) {
+        if(changed & AMS_FIELD(AmsFieldPowerFactor)) {
             mqtt.publish(topic + "/meter/powerfactor", String(data->getPowerFactor(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL1PowerFactor() != data->getL1PowerFactor()) {
+        if(changed & AMS_FIELD(AmsFieldL1PowerFactor)) {
             mqtt.publish(topic + "/meter/l1/powerfactor", String(data->getL1PowerFactor(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL2PowerFactor() != data->getL2PowerFactor()) {
+        if(changed & AMS_FIELD(AmsFieldL2PowerFactor)) {
             mqtt.publish(topic + "/meter/l2/powerfactor", String(data->getL2PowerFactor(), 2));
             mqtt.loop();
         }
-        if(full || meterState->getL3PowerFactor() != data->getL3PowerFactor()) {
+        if(changed & AMS_FIELD(AmsFieldL3PowerFactor)) {
             mqtt.publish(topic + "/meter/l3/powerfactor", String(data->getL3PowerFactor(), 2));
             mqtt.loop();
         }
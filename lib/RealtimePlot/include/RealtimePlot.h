@@ -10,22 +10,79 @@
 #include <stdint.h>
 #include "AmsData.h"
 
-#define REALTIME_SAMPLE 10000
+#define REALTIME_RESOLUTION 10 // Seconds per slot, 1 to 60
 #define REALTIME_SIZE 360
+// Slots sharing an exponent. One block more than the size is kept, so the block being written never has slots that
+// are read with an exponent set for the new ones
+#define REALTIME_BLOCK 8
+
+#define REALTIME_SERIES 10
+#define REALTIME_NET 0
+#define REALTIME_L1_POWER 1
+#define REALTIME_L2_POWER 2
+#define REALTIME_L3_POWER 3
+#define REALTIME_L1_VOLTAGE 4
+#define REALTIME_L2_VOLTAGE 5
+#define REALTIME_L3_VOLTAGE 6
+#define REALTIME_L1_CURRENT 7
+#define REALTIME_L2_CURRENT 8
+#define REALTIME_L3_CURRENT 9
+
+#define REALTIME_AVG 0
+#define REALTIME_MIN 1
+#define REALTIME_MAX 2
+
+// Bytes for the slots of all series, with many series the number of slots is reduced to stay within it
+#if defined(ESP8266)
+#define REALTIME_BUDGET 3072
+#define REALTIME_DEFAULT_SERIES (1 << REALTIME_NET)
+#else
+#define REALTIME_BUDGET 32768
+#define REALTIME_DEFAULT_SERIES 0x3FF
+#endif
+
+/**
+ * Average, lowest and highest reading of a slot, multiplied by 10 to the power of minus the exponent of its block
+ */
+struct RealtimeSlot {
+    int16_t avg;
+    int16_t min;
+    int16_t max;
+};
+
+struct RealtimeSeries {
+    RealtimeSlot* slots;
+    int8_t* exponents;
+    float sum;
+    float min;
+    float max;
+    uint16_t count;
+};
 
 class RealtimePlot {
 public:
-    RealtimePlot();
+    RealtimePlot(uint8_t resolution = REALTIME_RESOLUTION, uint16_t series = REALTIME_DEFAULT_SERIES);
     void update(AmsData& data);
     int32_t getValue(uint16_t req);
+    // Copies count slots of a series from offset slots back, newest first, in units of 10 to the power of exponent
+    uint16_t getValues(uint8_t series, uint8_t aggregate, uint16_t offset, uint16_t count, int32_t* values, int8_t exponent);
     int16_t getSize();
+    uint8_t getResolution();
+    bool hasSeries(uint8_t series);
+    // The finest unit of the series, W for power, 0.1 V and 0.01 A
+    int8_t getExponent(uint8_t series);
 
 private:
-    int8_t* values;
-    uint8_t* scaling;
+    uint8_t resolution;
+    uint16_t size;
+    uint16_t slots; // Size and the block being written
+    RealtimeSeries series[REALTIME_SERIES];
 
     unsigned long lastMillis = 0;
     double lastReading = 0;
     uint16_t lastPos = 0;
+
+    float getReading(AmsData& data, uint8_t series);
+    void write(uint8_t series, uint16_t pos, float avg, float min, float max);
 };
 #endif
@@ -7,16 +7,94 @@
 #include "RealtimePlot.h"
 #include <stdlib.h>
 
-RealtimePlot::RealtimePlot() {
-    values = (int8_t*) malloc(REALTIME_SIZE);
-    scaling = (uint8_t*) malloc(REALTIME_SIZE);
-    memset(values, 0, REALTIME_SIZE);
-    memset(scaling, 0, REALTIME_SIZE);
+#define REALTIME_EXPONENT_MIN -2
+#define REALTIME_EXPONENT_MAX 5
+
+// Indexed by exponent - REALTIME_EXPONENT_MIN, so no pow() for each reading
+static const float REALTIME_SCALE[] = { 100.0, 10.0, 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001 };
+static const int32_t REALTIME_POW10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+#define REALTIME_POW10_MAX 7 // Last index of REALTIME_POW10
+static const int8_t REALTIME_SERIES_EXPONENT[REALTIME_SERIES] = { 0, 0, 0, 0, -1, -1, -1, -2, -2, -2 };
+
+RealtimePlot::RealtimePlot(uint8_t resolution, uint16_t enabled) {
+    this->resolution = constrain(resolution, 1, 60);
+
+    uint8_t count = 0;
+    for(uint8_t s = 0; s < REALTIME_SERIES; s++) {
+        if(enabled & (1 << s)) count++;
+    }
+    uint32_t fit = count == 0 ? 0 : REALTIME_BUDGET / (count * (sizeof(RealtimeSlot) * REALTIME_BLOCK + 1)) * REALTIME_BLOCK;
+    slots = min((uint32_t) REALTIME_SIZE + REALTIME_BLOCK, fit) / REALTIME_BLOCK * REALTIME_BLOCK;
+    size = slots > REALTIME_BLOCK ? slots - REALTIME_BLOCK : 0;
+
+    for(uint8_t s = 0; s < REALTIME_SERIES; s++) {
+        RealtimeSeries& rs = series[s];
+        rs.slots = NULL;
+        rs.exponents = NULL;
+        rs.count = 0;
+        if(size == 0 || (enabled & (1 << s)) == 0) continue;
+
+        rs.slots = (RealtimeSlot*) malloc(slots * sizeof(RealtimeSlot));
+        rs.exponents = (int8_t*) malloc(slots / REALTIME_BLOCK);
+        memset(rs.slots, 0, slots * sizeof(RealtimeSlot));
+        memset(rs.exponents, REALTIME_SERIES_EXPONENT[s], slots / REALTIME_BLOCK);
+    }
+}
+
+float RealtimePlot::getReading(AmsData& data, uint8_t series) {
+    switch(series) {
+        case REALTIME_L1_POWER: return (int32_t) data.getL1ActiveImportPower() - (int32_t) data.getL1ActiveExportPower();
+        case REALTIME_L2_POWER: return (int32_t) data.getL2ActiveImportPower() - (int32_t) data.getL2ActiveExportPower();
+        case REALTIME_L3_POWER: return (int32_t) data.getL3ActiveImportPower() - (int32_t) data.getL3ActiveExportPower();
+        case REALTIME_L1_VOLTAGE: return data.getL1Voltage();
+        case REALTIME_L2_VOLTAGE: return data.getL2Voltage();
+        case REALTIME_L3_VOLTAGE: return data.getL3Voltage();
+        case REALTIME_L1_CURRENT: return data.getL1Current();
+        case REALTIME_L2_CURRENT: return data.getL2Current();
+        case REALTIME_L3_CURRENT: return data.getL3Current();
+    }
+    return 0;
+}
+
+// A block starts over at the finest exponent of the series, and when a reading does not fit the exponent is raised
+// and what is already in the block divided down
+void RealtimePlot::write(uint8_t s, uint16_t pos, float avg, float min, float max) {
+    RealtimeSeries& rs = series[s];
+    uint16_t block = pos / REALTIME_BLOCK;
+    int8_t& exponent = rs.exponents[block];
+    if(pos % REALTIME_BLOCK == 0) {
+        exponent = REALTIME_SERIES_EXPONENT[s];
+    }
+
+    float peak = max > -min ? max : -min;
+    int8_t fit = exponent;
+    while(peak * REALTIME_SCALE[fit - REALTIME_EXPONENT_MIN] > INT16_MAX && fit < REALTIME_EXPONENT_MAX) {
+        fit++;
+    }
+    if(fit != exponent) {
+        int32_t div = REALTIME_POW10[fit - exponent];
+        RealtimeSlot* slot = rs.slots + block * REALTIME_BLOCK;
+        for(uint8_t i = 0; i < REALTIME_BLOCK; i++, slot++) {
+            slot->avg /= div;
+            slot->min /= div;
+            slot->max /= div;
+        }
+        exponent = fit;
+    }
+
+    float scale = REALTIME_SCALE[exponent - REALTIME_EXPONENT_MIN];
+    RealtimeSlot& slot = rs.slots[pos];
+    slot.avg = constrain(lroundf(avg * scale), INT16_MIN, INT16_MAX);
+    slot.min = constrain(lroundf(min * scale), INT16_MIN, INT16_MAX);
+    slot.max = constrain(lroundf(max * scale), INT16_MIN, INT16_MAX);
 }
 
 void RealtimePlot::update(AmsData& data) {
+    if(size == 0) return;
+
     unsigned long now = millis();
-    uint16_t pos = (now / REALTIME_SAMPLE) % REALTIME_SIZE;
+    unsigned long sample = resolution * 1000UL;
+    uint16_t pos = (now / sample) % slots;
     if(lastMillis == 0) {
         lastMillis = now;
         lastReading = data.getActiveImportCounter() - data.getActiveExportCounter();
@@ -26,31 +104,40 @@ void RealtimePlot::update(AmsData& data) {
     if(pos == lastPos && data.isCounterEstimated()) return;
 
     unsigned long ms = now - lastMillis;
-    int32_t val; // A bit hacky this one, but just to avoid spikes at end of hour. Will mostly be correct
+    float net; // A bit hacky this one, but just to avoid spikes at end of hour. Will mostly be correct
     if(data.isCounterEstimated()) {
-        val = ((data.getActiveImportCounter() - data.getActiveExportCounter() - lastReading) * 1000) / (((float) ms) / 3600000.0);
+        net = ((data.getActiveImportCounter() - data.getActiveExportCounter() - lastReading) * 1000) / (((float) ms) / 3600000.0);
     } else {
-        val = data.getActiveImportPower() - data.getActiveExportPower();
+        net = (int32_t) data.getActiveImportPower() - (int32_t) data.getActiveExportPower();
     }
-    uint8_t scale = 0;
-    int32_t update = val / pow(10, scale);
-    while(update > INT8_MAX || update < INT8_MIN) {
-        update = val / pow(10, ++scale);
+
+    // Slots passed without readings get this one, all of them when it has been longer than the plot
+    uint16_t skipped = 0;
+    if(pos != lastPos) {
+        skipped = ms / sample >= slots ? slots - 1 : (pos + slots - lastPos - 1) % slots;
     }
-    if(pos < lastPos) {
-        for(uint16_t i = lastPos+1; i < REALTIME_SIZE; i++) {
-            values[i] = update;
-            scaling[i] = scale;
-        }
-        for(uint16_t i = 0; i <= pos; i++) {
-            values[i] = update;
-            scaling[i] = scale;
+
+    for(uint8_t s = 0; s < REALTIME_SERIES; s++) {
+        RealtimeSeries& rs = series[s];
+        if(rs.slots == NULL) continue;
+
+        float val = s == REALTIME_NET ? net : getReading(data, s);
+        if(pos != lastPos) {
+            for(uint16_t i = skipped; i > 0; i--) {
+                write(s, (pos + slots - i) % slots, val, val, val);
+            }
+            rs.count = 0;
         }
-    } else {
-        for(uint16_t i = lastPos+1; i <= pos; i++) {
-            values[i] = update;
-            scaling[i] = scale;
+        if(rs.count == 0) {
+            rs.sum = 0;
+            rs.min = val;
+            rs.max = val;
         }
+        rs.sum += val;
+        rs.count++;
+        if(val < rs.min) rs.min = val;
+        if(val > rs.max) rs.max = val;
+        write(s, pos, rs.sum / rs.count, rs.min, rs.max);
     }
 
     lastMillis = now;
@@ -58,25 +145,67 @@ void RealtimePlot::update(AmsData& data) {
     lastPos = pos;
 }
 
-int32_t RealtimePlot::getValue(uint16_t req) {
-    if(req > REALTIME_SIZE) return 0;
+uint16_t RealtimePlot::getValues(uint8_t s, uint8_t aggregate, uint16_t offset, uint16_t count, int32_t* values, int8_t exponent) {
+    if(!hasSeries(s)) return 0;
+    RealtimeSeries& rs = series[s];
 
     unsigned long now = millis();
-    if(req * REALTIME_SAMPLE > now) return 0;
-    unsigned long reqTime = now - (req * REALTIME_SAMPLE);
-
-    uint16_t pos = (now / REALTIME_SAMPLE) % REALTIME_SIZE;
-    uint16_t getPos;
-    if(reqTime > lastMillis) {
-        getPos = lastPos;
-    } else if(req > pos) {
-        getPos = REALTIME_SIZE + pos - req;
-    } else {
-        getPos = pos - req;
+    unsigned long sample = resolution * 1000UL;
+    uint16_t pos = (now / sample) % slots;
+
+    // The factor is found once for each block
+    int16_t block = -1;
+    int8_t shift = 0;
+    for(uint16_t i = 0; i < count; i++) {
+        uint16_t req = offset + i;
+        if(req >= size || req * sample > now) {
+            values[i] = 0;
+            continue;
+        }
+
+        uint16_t getPos;
+        if(now - (req * sample) > lastMillis) {
+            getPos = lastPos;
+        } else {
+            getPos = (pos + slots - req) % slots;
+        }
+        if(getPos / REALTIME_BLOCK != block) {
+            block = getPos / REALTIME_BLOCK;
+            shift = rs.exponents[block] - exponent;
+        }
+
+        RealtimeSlot& slot = rs.slots[getPos];
+        int32_t val = aggregate == REALTIME_MIN ? slot.min : aggregate == REALTIME_MAX ? slot.max : slot.avg;
+        // The caller can ask for any exponent, past the table a slot divides to 0 and the product saturates
+        if(shift >= 0) {
+            int64_t v = (int64_t) val * REALTIME_POW10[shift > REALTIME_POW10_MAX ? REALTIME_POW10_MAX : shift];
+            for(int8_t k = REALTIME_POW10_MAX; k < shift && v != 0 && v > INT32_MIN && v < INT32_MAX; k++) v *= 10;
+            values[i] = constrain(v, (int64_t) INT32_MIN, (int64_t) INT32_MAX);
+        } else {
+            values[i] = val / REALTIME_POW10[-shift > REALTIME_POW10_MAX ? REALTIME_POW10_MAX : -shift];
+        }
     }
-    return values[getPos] * pow(10, scaling[getPos]);
+    return count;
+}
+
+int32_t RealtimePlot::getValue(uint16_t req) {
+    int32_t val = 0;
+    getValues(REALTIME_NET, REALTIME_AVG, req, 1, &val, 0);
+    return val;
 }
 
 int16_t RealtimePlot::getSize() {
-    return REALTIME_SIZE;
+    return size;
+}
+
+uint8_t RealtimePlot::getResolution() {
+    return resolution;
+}
+
+bool RealtimePlot::hasSeries(uint8_t s) {
+    return s < REALTIME_SERIES && series[s].slots != NULL;
+}
+
+int8_t RealtimePlot::getExponent(uint8_t s) {
+    return s < REALTIME_SERIES ? REALTIME_SERIES_EXPONENT[s] : 0;
 }
@@ -98,13 +98,29 @@ let tries = 0;
 let lastTemp = -127;
 let lastPrice = null;
 let data = {};
+
+// data.json only contains the meter values that changed since sequence "s", merge them into what we have
+function mergeData(current, delta) {
+    let merged = {...current};
+    for(const key in delta) {
+        let value = delta[key];
+        if(value !== null && typeof value === 'object' && !Array.isArray(value) && typeof merged[key] === 'object') {
+            merged[key] = {...merged[key], ...value};
+        } else {
+            merged[key] = value;
+        }
+    }
+    return merged;
+}
+
 export const dataStore = readable(data, (set) => { 
     let timeout;
     let scanTimeout;
     async function getData() {
-        fetchWithTimeout("data.json")
+        fetchWithTimeout(data.s === undefined ? "data.json" : "data.json?s=" + data.s)
             .then((res) => res.json())
-            .then((data) => {
+            .then((delta) => {
+                data = mergeData(data, delta);
                 set(data);
                 if(lastTemp != data.t) {
                     lastTemp = data.t;
@@ -138,6 +154,7 @@ export const dataStore = readable(data, (set) => {
             .catch((err) => {
                 tries++;
                 if(tries > 3) {
+                    data = {};
                     set({
                         em: 3,
                         hm: 0,
@@ -194,6 +211,40 @@ export async function getPrices() {
     priceShiftTimeout = setTimeout(shiftPrices, ((60-date.getMinutes())*60000))
 }
 
+// The .bin plots are a small header followed by arrays of little-endian int32, see WebPlotHeader
+function decodePlot(buffer) {
+    let view = new DataView(buffer);
+    let plot = {
+        version: view.getUint8(0),
+        exponent: view.getInt8(2),
+        resolution: view.getUint8(3),
+        offset: view.getUint16(4, true),
+        count: view.getUint16(6, true),
+        total: view.getUint16(8, true),
+        series: view.getUint8(10),
+        data: []
+    };
+    let scale = Math.pow(10, plot.exponent);
+    for(let a = 0, pos = 12; a < view.getUint8(1); a++) {
+        let values = new Array(plot.count);
+        for(let i = 0; i < plot.count; i++, pos += 4) {
+            values[i] = view.getInt32(pos, true) * scale;
+        }
+        plot.data.push(values);
+    }
+    return plot;
+}
+
+// Same as the .json plots, energy in kWh by hour or day
+function plotToKwh(plot) {
+    let ret = { unit: 'kwh' };
+    for(let i = 0; i < plot.count; i++) {
+        ret['i'+zeropad(plot.offset+i)] = plot.data[0][i] / 1000.0;
+        ret['e'+zeropad(plot.offset+i)] = plot.data[1][i] / 1000.0;
+    }
+    return ret;
+}
+
 let dayPlot = {};
 let dayPlotTimeout;
 export async function getDayPlot() {
@@ -201,8 +252,8 @@ export async function getDayPlot() {
         clearTimeout(dayPlotTimeout);
         dayPlotTimeout = 0;
     }
-    const response = await fetchWithTimeout("dayplot.json");
-    dayPlot = (await response.json())
+    const response = await fetchWithTimeout("dayplot.bin");
+    dayPlot = plotToKwh(decodePlot(await response.arrayBuffer()));
     dayPlotStore.set(dayPlot);
 
     let date = new Date();
@@ -221,8 +272,8 @@ export async function getMonthPlot() {
         clearTimeout(monthPlotTimeout);
         monthPlotTimeout = 0;
     }
-    const response = await fetchWithTimeout("monthplot.json");
-    monthPlot = (await response.json())
+    const response = await fetchWithTimeout("monthplot.bin");
+    monthPlot = plotToKwh(decodePlot(await response.arrayBuffer()));
     monthPlotStore.set(monthPlot);
 
     let date = new Date();
@@ -273,30 +324,22 @@ export async function getGitHubReleases() {
     gitHubReleaseStore.set(releases);
 };
 
-let realtimeOffset = 0;
+let realtimeLoaded = false;
 let realtime = { data: [] };
 export async function getRealtime() {
-    const response = await fetchWithTimeout(realtimeOffset < 0 ? "realtime.json" : "realtime.json?offset="+realtimeOffset);
-    let res = (await response.json())
+    const response = await fetchWithTimeout("realtime.bin");
+    let res = decodePlot(await response.arrayBuffer());
     realtimeStore.update(current => {
-        for(let i = 0; i < res.size; i++) {
-            current.data[res.offset+i] = res.data[i];
-        }
+        current.data = res.data[0];
         current.size = current.data.length;
+        current.resolution = res.resolution;
         return current;
     });
-    if(realtimeOffset >= 0) {
-        realtimeOffset += res.size;
-        if(realtimeOffset < res.total) {
-            setTimeout(getRealtime, 2000);
-        } else {
-            realtimeOffset = -1;
-        }
-    }
+    realtimeLoaded = true;
 }
 
 export function isRealtimeFullyLoaded() {
-    return realtimeOffset == -1;
+    return realtimeLoaded;
 }
 
 export const realtimeStore = writable(realtime);
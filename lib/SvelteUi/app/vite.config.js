@@ -20,12 +20,15 @@ export default defineConfig({
       "/data.json": "http://192.168.233.115",
       "/energyprice.json": "http://192.168.233.115",
       "/dayplot.json": "http://192.168.233.115",
+      "/dayplot.bin": "http://192.168.233.115",
       "/monthplot.json": "http://192.168.233.115",
+      "/monthplot.bin": "http://192.168.233.115",
       "/temperature.json": "http://192.168.233.115",
       "/sysinfo.json": "http://192.168.233.115",
       "/configuration.json": "http://192.168.233.115",
       "/tariff.json": "http://192.168.233.115",
       "/realtime.json": "http://192.168.233.115",
+      "/realtime.bin": "http://192.168.233.115",
       "/priceconfig.json": "http://192.168.233.115",
       "/save": "http://192.168.233.115",
       "/reboot": "http://192.168.233.115",
@@ -26,3 +26,4 @@ static const char MIME_HTML[] PROGMEM = "text/html";
 static const char MIME_JSON[] PROGMEM = "application/json";
 static const char MIME_CSS[] PROGMEM = "text/css";
 static const char MIME_JS[] PROGMEM = "text/javascript";
+static const char MIME_BINARY[] PROGMEM = "application/octet-stream";
@@ -20,6 +20,8 @@
 #include "PriceService.h"
 #include "RealtimePlot.h"
 #include "ConnectionHandler.h"
+#include "BufferOccupancy.h"
+#include "PersistenceScheduler.h"
 
 #if defined(ESP8266)
 	#include <ESP8266WiFi.h>
@@ -39,6 +41,26 @@
 
 #include "LittleFS.h"
 
+// Number of meter updates data.json can send a delta for
+#define WEB_DATA_HISTORY 16
+
+/**
+ * Start of the .bin plot responses, followed by arrays of count little-endian int32 values. Values are in units of 10 to
+ * the power of exponent, W or Wh when it is 0. The realtime plot has one array, newest first, and the day and month
+ * plots have import and export starting at hour or day offset.
+ */
+struct WebPlotHeader {
+	uint8_t version;
+	uint8_t arrays;
+	int8_t exponent;
+	uint8_t resolution; // Seconds for each realtime value
+	uint16_t offset;
+	uint16_t count;
+	uint16_t total;
+	uint8_t series;
+	uint8_t reserved;
+} __attribute__((packed));
+
 class AmsWebServer {
 public:
 	AmsWebServer(uint8_t* buf, RemoteDebug* Debug, HwTools* hw, ResetDataContainer* rdc);
@@ -52,6 +74,8 @@ public:
 	void setMeterConfig(uint8_t distributionSystem, uint16_t mainFuse, uint16_t productionCapacity);
 	void setMqttHandler(AmsMqttHandler* mqttHandler);
 	void setConnectionHandler(ConnectionHandler* ch);
+	void setHanOccupancy(BufferOccupancy* rx, BufferOccupancy* frame);
+	void setPersistenceScheduler(PersistenceScheduler* persistence);
 
 private:
 	RemoteDebug* debugger;
@@ -71,8 +95,13 @@ private:
 	AmsDataStorage* ds;
     EnergyAccounting* ea = NULL;
 	RealtimePlot* rtp = NULL;
+	uint32_t dataSeq = 0, dataUpdateCount = 0;
+	uint64_t dataChanged[WEB_DATA_HISTORY];
 	AmsMqttHandler* mqttHandler = NULL;
 	ConnectionHandler* ch = NULL;
+	BufferOccupancy* rxOccupancy = NULL;
+	BufferOccupancy* frameOccupancy = NULL;
+	PersistenceScheduler* persistence = NULL;
 	bool uploading = false;
 	File file;
 	bool performRestart = false;
@@ -105,12 +134,18 @@ private:
 
     void sysinfoJson();
     void dataJson();
+	uint16_t appendMeterJson(uint16_t pos, uint64_t fields);
 	void dayplotJson();
 	void monthplotJson();
+	void dayplotBin();
+	void monthplotBin();
 	void energyPriceJson();
 	void temperatureJson();
 	void tariffJson();
 	void realtimeJson();
+	void realtimeBin();
+	void sendBinary(uint16_t length);
+	void flushBeforeRestart();
 	void priceConfigJson();
 	void translationsJson();
 
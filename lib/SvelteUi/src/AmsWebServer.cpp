@@ -76,6 +76,13 @@ void AmsWebServer::setup(AmsConfiguration* config, GpioConfig* gpioConfig, AmsDa
 	this->ea = ea;
 	this->rtp = rtp;
 
+	// Random start, a client holding a sequence from before a reboot then gets everything
+	dataSeq = random(0x7FFFFFFF);
+	dataUpdateCount = meterState->getUpdateCount();
+	for(uint8_t i = 0; i < WEB_DATA_HISTORY; i++) {
+		dataChanged[i] = AMS_FIELDS_ALL;
+	}
+
 	String context;
 	config->getWebConfig(webConfig);
 	stripNonAscii((uint8_t*) webConfig.context, 32);
@@ -117,10 +124,13 @@ void AmsWebServer::setup(AmsConfiguration* config, GpioConfig* gpioConfig, AmsDa
 	server.on(context + F("/data.json"), HTTP_GET, std::bind(&AmsWebServer::dataJson, this));
 	server.on(context + F("/dayplot.json"), HTTP_GET, std::bind(&AmsWebServer::dayplotJson, this));
 	server.on(context + F("/monthplot.json"), HTTP_GET, std::bind(&AmsWebServer::monthplotJson, this));
+	server.on(context + F("/dayplot.bin"), HTTP_GET, std::bind(&AmsWebServer::dayplotBin, this));
+	server.on(context + F("/monthplot.bin"), HTTP_GET, std::bind(&AmsWebServer::monthplotBin, this));
 	server.on(context + F("/energyprice.json"), HTTP_GET, std::bind(&AmsWebServer::energyPriceJson, this));
 	server.on(context + F("/temperature.json"), HTTP_GET, std::bind(&AmsWebServer::temperatureJson, this));
 	server.on(context + F("/tariff.json"), HTTP_GET, std::bind(&AmsWebServer::tariffJson, this));
 	server.on(context + F("/realtime.json"), HTTP_GET, std::bind(&AmsWebServer::realtimeJson, this));
+	server.on(context + F("/realtime.bin"), HTTP_GET, std::bind(&AmsWebServer::realtimeBin, this));
 	server.on(context + F("/priceconfig.json"), HTTP_GET, std::bind(&AmsWebServer::priceConfigJson, this));
 	server.on(context + F("/translations.json"), HTTP_GET, std::bind(&AmsWebServer::translationsJson, this));
 
@@ -176,6 +186,15 @@ void AmsWebServer::setConnectionHandler(ConnectionHandler* ch) {
 	this->ch = ch;
 }
 
+void AmsWebServer::setHanOccupancy(BufferOccupancy* rx, BufferOccupancy* frame) {
+	rxOccupancy = rx;
+	frameOccupancy = frame;
+}
+
+void AmsWebServer::setPersistenceScheduler(PersistenceScheduler* persistence) {
+	this->persistence = persistence;
+}
+
 void AmsWebServer::setPriceService(PriceService* ps) {
 	this->ps = ps;
 }
@@ -188,6 +207,13 @@ void AmsWebServer::setMeterConfig(uint8_t distributionSystem, uint16_t mainFuse,
 }
 
 void AmsWebServer::loop() {
+	if(meterState->getUpdateCount() != dataUpdateCount) {
+		uint64_t changed = meterState->getUpdateCount() - dataUpdateCount == 1 ? meterState->getChangedFields() : AMS_FIELDS_ALL;
+		dataUpdateCount = meterState->getUpdateCount();
+		dataSeq++;
+		dataChanged[dataSeq % WEB_DATA_HISTORY] = changed;
+	}
+
 	server.handleClient();
 
 	if(maxPwr == 0 && meterState->getListType() > 1 && mainFuse > 0 && distributionSystem > 0) {
@@ -338,6 +364,11 @@ void AmsWebServer::sysinfoJson() {
 	if(!meterId.isEmpty())
 		meterId.replace(F("\\"), F("\\\\"));
 
+	char rxBins[96] = "";
+	char frameBins[96] = "";
+	if(rxOccupancy != NULL) rxOccupancy->printBins(rxBins, sizeof(rxBins));
+	if(frameOccupancy != NULL) frameOccupancy->printBins(frameBins, sizeof(frameBins));
+
 	time_t now = time(nullptr);
 
 	int size = snprintf_P(buf, BufferSize, SYSINFO_JSON,
@@ -389,6 +420,10 @@ void AmsWebServer::sysinfoJson() {
 		meterState->getMeterType(),
 		meterModel.c_str(),
 		meterId.c_str(),
+		rxOccupancy == NULL ? 0 : rxOccupancy->getMax(),
+		rxBins,
+		frameOccupancy == NULL ? 0 : frameOccupancy->getMax(),
+		frameBins,
 		ui.showImport,
 		ui.showExport,
 		ui.showVoltage,
@@ -438,9 +473,7 @@ void AmsWebServer::sysinfoJson() {
 		server.handleClient();
 		delay(250);
 
-		if(ds != NULL) {
-			ds->save();
-		}
+		flushBeforeRestart();
 		if(debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Rebooting\n"));
 		debugger->flush();
 		delay(1000);
@@ -525,39 +558,22 @@ void AmsWebServer::dataJson() {
 
 	time_t now = time(nullptr);
 
-	snprintf_P(buf, BufferSize, DATA_JSON,
+	// With the sequence from the previous response, only meter values changed since then are included
+	uint64_t fields = AMS_FIELDS_ALL;
+	if(server.hasArg(F("s"))) {
+		uint32_t since = strtoul(server.arg(F("s")).c_str(), NULL, 10);
+		if(dataSeq - since < WEB_DATA_HISTORY) {
+			fields = 0;
+			for(uint32_t i = since; i != dataSeq; i++) {
+				fields |= dataChanged[(i+1) % WEB_DATA_HISTORY];
+			}
+		}
+	}
+
+	uint16_t pos = snprintf_P(buf, BufferSize, DATA_JSON,
 		maxPwr == 0 ? meterState->isThreePhase() ? 20000 : 10000 : maxPwr,
 		productionCapacity,
 		mainFuse == 0 ? 40 : mainFuse,
-		meterState->getActiveImportPower(),
-		meterState->getActiveExportPower(),
-		meterState->getReactiveImportPower(),
-		meterState->getReactiveExportPower(),
-		meterState->getActiveImportCounter(),
-		meterState->getActiveExportCounter(),
-		meterState->getReactiveImportCounter(),
-		meterState->getReactiveExportCounter(),
-		meterState->getPowerFactor(),
-
-		meterState->getL1Voltage(),
-		meterState->getL1Current(),
-		meterState->getL1ActiveImportPower(),
-		meterState->getL1ActiveExportPower(),
-		meterState->getL1PowerFactor(),
-
-		meterState->getL2Voltage(),
-		meterState->getL2Current(),
-		meterState->getL2ActiveImportPower(),
-		meterState->getL2ActiveExportPower(),
-		meterState->getL2PowerFactor(),
-		meterState->isL2currentMissing() ? "true" : "false",
-
-		meterState->getL3Voltage(),
-		meterState->getL3Current(),
-		meterState->getL3ActiveImportPower(),
-		meterState->getL3ActiveExportPower(),
-		meterState->getL3PowerFactor(),
-
 		vcc,
 		rssi,
 		hw->getTemperature(),
@@ -592,8 +608,11 @@ void AmsWebServer::dataJson() {
 		meterState->getLastError(),
 		ps == NULL ? 0 : ps->getLastError(),
 		(uint32_t) now,
-		checkSecurity(1, false) ? "true" : "false"
+		checkSecurity(1, false) ? "true" : "false",
+		dataSeq
 	);
+	pos += appendMeterJson(pos, fields);
+	snprintf_P(buf+pos, BufferSize-pos, PSTR("}"));
 
 	server.sendHeader(HEADER_CACHE_CONTROL, CACHE_CONTROL_NO_CACHE);
 	server.sendHeader(HEADER_PRAGMA, PRAGMA_NO_CACHE);
@@ -603,6 +622,42 @@ void AmsWebServer::dataJson() {
 	server.send(200, MIME_JSON, buf);
 }
 
+uint16_t AmsWebServer::appendMeterJson(uint16_t pos, uint64_t fields) {
+	uint16_t start = pos;
+	if(fields & AMS_FIELD(AmsFieldActiveImportPower)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"i\":%lu"), meterState->getActiveImportPower());
+	if(fields & AMS_FIELD(AmsFieldActiveExportPower)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"e\":%lu"), meterState->getActiveExportPower());
+	if(fields & AMS_FIELD(AmsFieldReactiveImportPower)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"ri\":%lu"), meterState->getReactiveImportPower());
+	if(fields & AMS_FIELD(AmsFieldReactiveExportPower)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"re\":%lu"), meterState->getReactiveExportPower());
+	if(fields & AMS_FIELD(AmsFieldActiveImportCounter)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"ic\":%.3f"), meterState->getActiveImportCounter());
+	if(fields & AMS_FIELD(AmsFieldActiveExportCounter)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"ec\":%.3f"), meterState->getActiveExportCounter());
+	if(fields & AMS_FIELD(AmsFieldReactiveImportCounter)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"ric\":%.3f"), meterState->getReactiveImportCounter());
+	if(fields & AMS_FIELD(AmsFieldReactiveExportCounter)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"rec\":%.3f"), meterState->getReactiveExportCounter());
+	if(fields & AMS_FIELD(AmsFieldPowerFactor)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"f\":%.2f"), meterState->getPowerFactor());
+
+	float u[] = { meterState->getL1Voltage(), meterState->getL2Voltage(), meterState->getL3Voltage() };
+	float i[] = { meterState->getL1Current(), meterState->getL2Current(), meterState->getL3Current() };
+	uint32_t p[] = { meterState->getL1ActiveImportPower(), meterState->getL2ActiveImportPower(), meterState->getL3ActiveImportPower() };
+	uint32_t q[] = { meterState->getL1ActiveExportPower(), meterState->getL2ActiveExportPower(), meterState->getL3ActiveExportPower() };
+	float f[] = { meterState->getL1PowerFactor(), meterState->getL2PowerFactor(), meterState->getL3PowerFactor() };
+	for(uint8_t l = 0; l < 3; l++) {
+		uint64_t phase = fields & (AMS_FIELD(AmsFieldL1Voltage+l) | AMS_FIELD(AmsFieldL1Current+l) | AMS_FIELD(AmsFieldL1ActiveImportPower+l) | AMS_FIELD(AmsFieldL1ActiveExportPower+l) | AMS_FIELD(AmsFieldL1PowerFactor+l));
+		if(l == 1) phase |= fields & AMS_FIELD(AmsFieldPhases);
+		if(phase == 0) continue;
+
+		pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"l%d\":{"), l+1);
+		uint16_t first = pos;
+		if(phase & AMS_FIELD(AmsFieldL1Voltage+l)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"u\":%.2f"), u[l]);
+		if(phase & AMS_FIELD(AmsFieldL1Current+l)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"i\":%.2f"), i[l]);
+		if(phase & AMS_FIELD(AmsFieldL1ActiveImportPower+l)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"p\":%lu"), p[l]);
+		if(phase & AMS_FIELD(AmsFieldL1ActiveExportPower+l)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"q\":%lu"), q[l]);
+		if(phase & AMS_FIELD(AmsFieldL1PowerFactor+l)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"f\":%.2f"), f[l]);
+		if(phase & AMS_FIELD(AmsFieldPhases)) pos += snprintf_P(buf+pos, BufferSize-pos, PSTR(",\"e\":%s"), meterState->isL2currentMissing() ? "true" : "false");
+		buf[first] = ' '; // Leading comma of the first value
+		pos += snprintf_P(buf+pos, BufferSize-pos, PSTR("}"));
+	}
+	return pos - start;
+}
+
 void AmsWebServer::dayplotJson() {
 	if(!checkSecurity(2))
 		return;
@@ -647,6 +702,45 @@ void AmsWebServer::monthplotJson() {
 	}
 }
 
+// Values are copied as they are, without formatting, so the whole plot fits in buf
+void AmsWebServer::dayplotBin() {
+	if(!checkSecurity(2))
+		return;
+
+	if(ds == NULL) {
+		notFound();
+	} else {
+		WebPlotHeader header = { 1, 2, 0, 0, 0, 24, 24, 0, 0 };
+		int32_t values[2][24];
+		for(uint8_t i = 0; i < 24; i++) {
+			values[0][i] = ds->getHourImport(i);
+			values[1][i] = ds->getHourExport(i);
+		}
+		memcpy(buf, &header, sizeof(header));
+		memcpy(buf + sizeof(header), values, sizeof(values));
+		sendBinary(sizeof(header) + sizeof(values));
+	}
+}
+
+void AmsWebServer::monthplotBin() {
+	if(!checkSecurity(2))
+		return;
+
+	if(ds == NULL) {
+		notFound();
+	} else {
+		WebPlotHeader header = { 1, 2, 0, 0, 1, 31, 31, 0, 0 };
+		int32_t values[2][31];
+		for(uint8_t i = 0; i < 31; i++) {
+			values[0][i] = ds->getDayImport(i + 1);
+			values[1][i] = ds->getDayExport(i + 1);
+		}
+		memcpy(buf, &header, sizeof(header));
+		memcpy(buf + sizeof(header), values, sizeof(values));
+		sendBinary(sizeof(header) + sizeof(values));
+	}
+}
+
 void AmsWebServer::energyPriceJson() {
 	if(!checkSecurity(2))
 		return;
@@ -1527,7 +1621,11 @@ void AmsWebServer::handleSave() {
 				ps->setPriceConfig(i, pc);
 			}
 			ps->cropPriceConfig(count);
-			ps->save();
+			if(persistence != NULL) {
+				persistence->setDirty(PERSIST_PRICES);
+			} else {
+				ps->save();
+			}
 		} else {
 			if(debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Price service missing...\n"));
 		}
@@ -1537,6 +1635,7 @@ void AmsWebServer::handleSave() {
 
 	if (config->save()) {
 		if(debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Successfully saved.\n"));
+		if(persistence != NULL) persistence->written(PERSIST_CONFIG, EEPROM_SIZE);
 		if(config->isNetworkConfigChanged() || performRestart) {
 			performRestart = true;
 		} else {
@@ -1558,9 +1657,7 @@ void AmsWebServer::handleSave() {
 		server.handleClient();
 		delay(250);
 
-		if(ds != NULL) {
-			ds->save();
-		}
+		flushBeforeRestart();
 		if(debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Rebooting\n"));
 		debugger->flush();
 		delay(1000);
@@ -1579,6 +1676,7 @@ void AmsWebServer::reboot() {
 	server.handleClient();
 	delay(250);
 
+	flushBeforeRestart();
 	if(debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Rebooting\n"));
 	debugger->flush();
 	delay(1000);	rdc->cause = 3;
@@ -1665,6 +1763,7 @@ void AmsWebServer::upgradeFromUrl(String url, String nextVersion) {
 			break;
 		case HTTP_UPDATE_OK:
 			debugger->printf_P(PSTR("Update OK\n"));
+			flushBeforeRestart();
 			debugger->flush();
 			rdc->cause = 4;
 			ESP.restart();
@@ -1819,6 +1918,7 @@ void AmsWebServer::factoryResetPost() {
 	if(server.hasArg(F("perform")) && server.arg(F("perform")) == F("true")) {
 		if(debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Formatting LittleFS\n"));
 		LittleFS.format();
+		if(persistence != NULL) persistence->formatted();
 		if(debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Clearing configuration\n"));
 		config->clear();
 
@@ -1854,6 +1954,7 @@ void AmsWebServer::mqttCaUpload() {
 	uploadFile(FILE_MQTT_CA);
     HTTPUpload& upload = server.upload();
     if(upload.status == UPLOAD_FILE_END) {
+		if(persistence != NULL) persistence->written(PERSIST_CERTIFICATES, upload.totalSize);
 		server.sendHeader(HEADER_LOCATION,F("/configuration"));
 		server.send(303);
 
@@ -1888,6 +1989,7 @@ void AmsWebServer::mqttCertUpload() {
 	uploadFile(FILE_MQTT_CERT);
     HTTPUpload& upload = server.upload();
     if(upload.status == UPLOAD_FILE_END) {
+		if(persistence != NULL) persistence->written(PERSIST_CERTIFICATES, upload.totalSize);
 		server.sendHeader(HEADER_LOCATION,F("/configuration"));
 		server.send(303);
 		MqttConfig mqttConfig;
@@ -1921,6 +2023,7 @@ void AmsWebServer::mqttKeyUpload() {
 	uploadFile(FILE_MQTT_KEY);
     HTTPUpload& upload = server.upload();
     if(upload.status == UPLOAD_FILE_END) {
+		if(persistence != NULL) persistence->written(PERSIST_CERTIFICATES, upload.totalSize);
 		server.sendHeader(HEADER_LOCATION,F("/configuration"));
 		server.send(303);
 		MqttConfig mqttConfig;
@@ -2022,17 +2125,103 @@ void AmsWebServer::realtimeJson() {
 		offset = rtp->getSize();
 	}
 
-	uint16_t pos = snprintf_P(buf, BufferSize, PSTR("{\"offset\":%d,\"size\":%d,\"total\":%d,\"data\":["), offset, size, rtp->getSize());
-	bool first = true;
-	for(uint16_t i = 0; i < size; i++) {
-		pos += snprintf_P(buf+pos, BufferSize-pos, PSTR("%s%d"), first ? "" : ",", rtp->getValue(offset+i));
-		first = false;
+	uint8_t series = REALTIME_NET;
+	if(server.hasArg(F("series"))) {
+		series = server.arg(F("series")).toInt();
+	}
+	if(!rtp->hasSeries(series)) {
+		server.send_P(404, MIME_PLAIN, PSTR("404: Series not recorded"));
+		return;
+	}
+
+	uint8_t aggregate = REALTIME_AVG;
+	if(server.hasArg(F("aggregate"))) {
+		aggregate = server.arg(F("aggregate")).toInt();
+	}
+
+	// Values are in the finest unit of the series, 0.1 V for voltage and 0.01 A for current
+	int8_t exponent = rtp->getExponent(series);
+	uint16_t pos = snprintf_P(buf, BufferSize, PSTR("{\"offset\":%d,\"size\":%d,\"total\":%d,\"resolution\":%d,\"series\":%d,\"exponent\":%d,\"data\":["), offset, size, rtp->getSize(), rtp->getResolution(), series, exponent);
+	int32_t values[30];
+	for(uint16_t i = 0; i < size; i += 30) {
+		uint16_t count = rtp->getValues(series, aggregate, offset + i, min(size - i, 30), values, exponent);
+		for(uint16_t j = 0; j < count; j++) {
+			pos += snprintf_P(buf+pos, BufferSize-pos, PSTR("%s%d"), i + j == 0 ? "" : ",", values[j]);
+		}
 		delay(1);
 	}
 	pos += snprintf_P(buf+pos, BufferSize-pos, PSTR("]}"));
 	server.send(200, MIME_JSON, buf);
 }
 
+// The whole plot by default, in one response instead of pages of realtime.json
+void AmsWebServer::realtimeBin() {
+	if(rtp == NULL) {
+		server.send_P(500, MIME_PLAIN, PSTR("500: Not available"));
+		return;
+	}
+
+	uint16_t offset = 0;
+	if(server.hasArg(F("offset"))) {
+		offset = server.arg(F("offset")).toInt();
+	}
+	if(offset > rtp->getSize()) {
+		offset = rtp->getSize();
+	}
+
+	uint16_t size = rtp->getSize() - offset;
+	if(server.hasArg(F("size"))) {
+		size = min((uint16_t) server.arg(F("size")).toInt(), size);
+	}
+	size = min(size, (uint16_t) ((BufferSize - sizeof(WebPlotHeader)) / sizeof(int32_t)));
+
+	uint8_t series = REALTIME_NET;
+	if(server.hasArg(F("series"))) {
+		series = server.arg(F("series")).toInt();
+	}
+	if(!rtp->hasSeries(series)) {
+		server.send_P(404, MIME_PLAIN, PSTR("404: Series not recorded"));
+		return;
+	}
+
+	uint8_t aggregate = REALTIME_AVG;
+	if(server.hasArg(F("aggregate"))) {
+		aggregate = server.arg(F("aggregate")).toInt();
+	}
+
+	WebPlotHeader header = { 1, 1, rtp->getExponent(series), rtp->getResolution(), offset, size, (uint16_t) rtp->getSize(), series, 0 };
+	memcpy(buf, &header, sizeof(header));
+
+	// buf is not aligned for int32, so the values go through the stack
+	int32_t values[32];
+	uint16_t pos = sizeof(header);
+	for(uint16_t i = 0; i < size; i += 32) {
+		uint16_t count = rtp->getValues(series, aggregate, offset + i, min(size - i, 32), values, header.exponent);
+		memcpy(buf + pos, values, count * sizeof(int32_t));
+		pos += count * sizeof(int32_t);
+	}
+	sendBinary(pos);
+}
+
+void AmsWebServer::sendBinary(uint16_t length) {
+	server.sendHeader(HEADER_CACHE_CONTROL, CACHE_CONTROL_NO_CACHE);
+	server.sendHeader(HEADER_PRAGMA, PRAGMA_NO_CACHE);
+	server.sendHeader(HEADER_EXPIRES, EXPIRES_OFF);
+
+	server.setContentLength(length);
+	server.send_P(200, MIME_BINARY, PSTR(""));
+	server.sendContent(buf, length);
+}
+
+// Whatever is waiting to be written would be lost, the data storage was all that was saved before
+void AmsWebServer::flushBeforeRestart() {
+	if(persistence != NULL) {
+		persistence->flush();
+	} else if(ds != NULL) {
+		ds->save();
+	}
+}
+
 void AmsWebServer::setPriceSettings(String region, String currency) {
 	this->priceRegion = region;
 	this->priceCurrency = currency;
@@ -2420,9 +2609,7 @@ void AmsWebServer::configFileUpload() {
 			server.handleClient();
 			delay(250);
 
-			if(ds != NULL) {
-				ds->save();
-			}
+			flushBeforeRestart();
 			if(debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Rebooting\n"));
 			debugger->flush();
 			delay(1000);
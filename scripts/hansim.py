@@ -0,0 +1,645 @@
+#!/usr/bin/env python3
+#
+# Meter simulator for testing the HAN port on Linux. Frames are written to a pseudo-terminal, which a host build
+# of the firmware or any serial tool can open, or to a real serial port for testing with hardware. Frames are
+# either replayed from captures in frames/ or generated with a frame number in the active import counter, so
+# a receiver can tell which frames were lost and how long each took to decode, see --log. With --pull it is a
+# meter that only answers requests, for the Kamstrup pull communicator.
+#
+# Examples:
+#   python3 scripts/hansim.py --synth hdlc --baud 115200 --interval 0.1
+#   python3 scripts/hansim.py --synth hdlc --segment 64 --flip 0.0001 --link /tmp/ttyHAN
+#   python3 scripts/hansim.py --synth gcm --key 000102030405060708090A0B0C0D0E0F --auth 0F0E0D0C0B0A09080706050403020100
+#   python3 scripts/hansim.py --replay frames/Kamstup-Encrypted.raw --baud 2400 --parity E
+#   python3 scripts/hansim.py --pull --baud 9600 --parity N --pdu 64 --link /tmp/ttyHAN
+#
+# Messages per second, loss and latency as received by the firmware decoder built for the host:
+#   test/host/run.sh hansim_receiver -- --synth gbt --segment 40 --baud 115200 --interval 0.05 --count 200
+#
+# Only the Python standard library is used.
+
+import argparse
+import os
+import random
+import re
+import select
+import signal
+import sys
+import termios
+import time
+import tty
+
+BAUDS = {
+    1200: termios.B1200, 2400: termios.B2400, 4800: termios.B4800, 9600: termios.B9600, 19200: termios.B19200,
+    38400: termios.B38400, 57600: termios.B57600, 115200: termios.B115200
+}
+
+def crc16_x25(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return ~crc & 0xFFFF
+
+def crc16_dsmr(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+# AES-128 and GCM, small and slow but enough for a few frames per second
+
+SBOX = []
+def _sbox():
+    inv = [0] * 256
+    p = q = 1
+    while True:
+        p = p ^ ((p << 1) & 0xFF) ^ (0x1B if p & 0x80 else 0)
+        q ^= q << 1
+        q ^= q << 2
+        q ^= q << 4
+        q &= 0xFF
+        if q & 0x80:
+            q ^= 0x09
+        inv[p] = q
+        if p == 1:
+            break
+    inv[0] = 0
+    for i in range(256):
+        x = inv[i]
+        s = x ^ ((x << 1) | (x >> 7)) ^ ((x << 2) | (x >> 6)) ^ ((x << 3) | (x >> 5)) ^ ((x << 4) | (x >> 4))
+        SBOX.append((s ^ 0x63) & 0xFF)
+_sbox()
+
+def _xtime(a):
+    return ((a << 1) ^ 0x1B) & 0xFF if a & 0x80 else a << 1
+
+def aes_expand(key):
+    w = [list(key[i:i+4]) for i in range(0, 16, 4)]
+    rcon = 1
+    for i in range(4, 44):
+        t = list(w[i-1])
+        if i % 4 == 0:
+            t = [SBOX[b] for b in t[1:] + t[:1]]
+            t[0] ^= rcon
+            rcon = _xtime(rcon)
+        w.append([a ^ b for a, b in zip(w[i-4], t)])
+    return [sum(w[r*4:r*4+4], []) for r in range(11)]
+
+def aes_encrypt(rk, block):
+    s = [a ^ b for a, b in zip(block, rk[0])]
+    for r in range(1, 11):
+        s = [SBOX[b] for b in s]
+        s = [s[(i + 4 * (i % 4)) % 16] for i in range(16)]
+        if r < 10:
+            m = []
+            for c in range(4):
+                a = s[c*4:c*4+4]
+                t = a[0] ^ a[1] ^ a[2] ^ a[3]
+                m += [a[i] ^ t ^ _xtime(a[i] ^ a[(i + 1) % 4]) for i in range(4)]
+            s = m
+        s = [a ^ b for a, b in zip(s, rk[r])]
+    return bytes(s)
+
+def _gmul(x, y):
+    z = 0
+    for i in range(127, -1, -1):
+        if (y >> i) & 1:
+            z ^= x
+        x = (x >> 1) ^ (0xE1 << 120) if x & 1 else x >> 1
+    return z
+
+def gcm_encrypt(key, iv, plain, aad, taglen):
+    rk = aes_expand(key)
+    h = int.from_bytes(aes_encrypt(rk, bytes(16)), 'big')
+    j0 = iv + b'\x00\x00\x00\x01'
+    out = bytearray()
+    for i in range(0, len(plain), 16):
+        ks = aes_encrypt(rk, iv + (2 + i // 16).to_bytes(4, 'big'))
+        out += bytes(a ^ b for a, b in zip(plain[i:i+16], ks))
+    g = 0
+    for data in (aad, bytes(out)):
+        for i in range(0, len(data), 16):
+            g = _gmul(g ^ int.from_bytes(data[i:i+16].ljust(16, b'\x00'), 'big'), h)
+    g = _gmul(g ^ ((len(aad) * 8) << 64 | len(out) * 8), h)
+    tag = (g ^ int.from_bytes(aes_encrypt(rk, j0), 'big')).to_bytes(16, 'big')
+    return bytes(out), tag[:taglen]
+
+# Framing
+
+def hdlc_frame(info, segmented=False):
+    header = bytes([0xCE, 0xFF, 0x03, 0x13])
+    length = 2 + len(header) + 2 + len(info) + 2
+    fmt = 0xA000 | (0x0800 if segmented else 0) | length
+    h = bytes([fmt >> 8, fmt & 0xFF]) + header
+    h += crc16_x25(h).to_bytes(2, 'little')
+    body = h + info
+    return b'\x7e' + body + crc16_x25(body).to_bytes(2, 'little') + b'\x7e'
+
+def hdlc(apdu, segment):
+    # LLC only in the first segment
+    info = b'\xe6\xe7\x00' + apdu
+    if segment <= 0 or len(info) <= segment:
+        return [hdlc_frame(info)]
+    parts = [info[i:i+segment] for i in range(0, len(info), segment)]
+    return [hdlc_frame(p, i < len(parts) - 1) for i, p in enumerate(parts)]
+
+def mbus(apdu, segment):
+    segment = min(segment, 240) if segment > 0 else 240
+    parts = [apdu[i:i+segment] for i in range(0, len(apdu), segment)]
+    frames = []
+    for i, p in enumerate(parts):
+        ci = (0x10 if i == len(parts) - 1 else 0) | (i & 0x0F)
+        body = bytes([0x53, 0xFF, ci, 0x67, 0x67]) + p
+        frames.append(bytes([0x68, len(body), len(body), 0x68]) + body + bytes([sum(body) & 0xFF, 0x16]))
+    return frames
+
+def gbt(apdu, segment):
+    # One general block transfer block in each HDLC frame, block size is one byte
+    segment = min(segment, 200) if segment > 0 else 120
+    parts = [apdu[i:i+segment] for i in range(0, len(apdu), segment)]
+    frames = []
+    for i, p in enumerate(parts):
+        control = (0x80 if i == len(parts) - 1 else 0) | 0x40
+        block = bytes([0xE0, control]) + (i + 1).to_bytes(2, 'big') + bytes(2) + bytes([len(p)]) + p
+        frames += hdlc(block, 0)
+    return frames
+
+def gcm(apdu, key, auth, title, counter):
+    sec = 0x30 if auth else 0x20
+    iv = title + counter.to_bytes(4, 'big')
+    cipher, tag = gcm_encrypt(key, iv, apdu, bytes([sec]) + (auth or b''), 12 if auth else 0)
+    payload = bytes([sec]) + counter.to_bytes(4, 'big') + cipher + tag
+    if len(payload) < 0x80:
+        length = bytes([len(payload)])
+    elif len(payload) < 0x100:
+        length = bytes([0x81, len(payload)])
+    else:
+        length = bytes([0x82]) + len(payload).to_bytes(2, 'big')
+    return bytes([0xDB, len(title)]) + title + length + payload
+
+# Generated content, the frame number is the active import counter in Wh
+
+OBIS_LIST = [
+    # C, D, type, scaler
+    (1, 7, 0x06, 0), (2, 7, 0x06, 0), (3, 7, 0x06, 0), (4, 7, 0x06, 0),
+    (31, 7, 0x10, -1), (51, 7, 0x10, -1), (71, 7, 0x10, -1),
+    (32, 7, 0x12, -1), (52, 7, 0x12, -1), (72, 7, 0x12, -1),
+    (1, 8, 0x06, 0), (2, 8, 0x06, 0), (3, 8, 0x06, 0), (4, 8, 0x06, 0)
+]
+
+def obis_apdu(seq, rnd):
+    values = {
+        (1, 7): rnd.randint(100, 9000), (2, 7): 0, (3, 7): rnd.randint(0, 500), (4, 7): rnd.randint(0, 500),
+        (31, 7): rnd.randint(5, 400), (51, 7): rnd.randint(5, 400), (71, 7): rnd.randint(5, 400),
+        (32, 7): rnd.randint(2250, 2350), (52, 7): rnd.randint(2250, 2350), (72, 7): rnd.randint(2250, 2350),
+        (1, 8): seq, (2, 8): 0, (3, 8): seq // 4, (4, 8): seq // 8
+    }
+    body = bytes([0x01, len(OBIS_LIST)])
+    for c, d, t, scaler in OBIS_LIST:
+        v = values[(c, d)]
+        size = {0x06: 4, 0x10: 2, 0x12: 2}[t]
+        body += bytes([0x02, 0x03, 0x09, 0x06, 0x01, 0x00, c, d, 0x00, 0xFF, t]) + v.to_bytes(size, 'big', signed=t == 0x10)
+        body += bytes([0x02, 0x02, 0x0F, scaler & 0xFF, 0x16, 0x1B if d == 7 else 0x1E])
+    return b'\x0f' + (seq & 0xFFFFFFFF).to_bytes(4, 'big') + b'\x00' + body
+
+def dsmr_telegram(seq, rnd):
+    lines = [
+        '/ISK5\\2M550T-1012', '',
+        '1-3:0.2.8(50)',
+        '0-0:1.0.0(%sW)' % time.strftime('%y%m%d%H%M%S'),
+        '0-0:96.1.1(4530303433303036383935343433353139)',
+        '1-0:1.8.1(%010.3f*kWh)' % (seq / 1000.0),
+        '1-0:1.8.2(%010.3f*kWh)' % 0,
+        '1-0:2.8.1(%010.3f*kWh)' % 0,
+        '1-0:2.8.2(%010.3f*kWh)' % 0,
+        '1-0:1.7.0(%06.3f*kW)' % (rnd.randint(100, 9000) / 1000.0),
+        '1-0:2.7.0(%06.3f*kW)' % 0,
+        '1-0:32.7.0(%05.1f*V)' % (rnd.randint(2250, 2350) / 10.0),
+        '1-0:31.7.0(%03d*A)' % rnd.randint(0, 40),
+        '!'
+    ]
+    text = '\r\n'.join(lines).encode('ascii')
+    return text + ('%04X\r\n' % crc16_dsmr(text)).encode('ascii')
+
+# Captures, hex text with comments as in frames/ or raw binary
+
+def load_capture(path):
+    data = open(path, 'rb').read()
+    try:
+        text = data.decode('ascii')
+    except UnicodeDecodeError:
+        return split_frames(data)
+    tokens = []
+    for line in text.split('\n'):
+        line = re.split(r'\s-\s', line.split('//')[0])[0]
+        if line.strip().startswith('#'):
+            continue
+        hx = ''.join(line.split())
+        if re.fullmatch(r'([0-9A-Fa-f]{2})+', hx):
+            tokens.append(bytes.fromhex(hx))
+    return split_frames(b''.join(tokens))
+
+def split_frames(data):
+    # Keeps only what passes the checksums, so notes and redacted bytes in a capture are left out
+    frames = []
+    i = 0
+    while i < len(data) - 4:
+        if data[i] == 0x7E and (data[i+1] & 0xF0) == 0xA0:
+            n = ((data[i+1] << 8 | data[i+2]) & 0x07FF) + 2
+            f = data[i:i+n]
+            if len(f) == n and f[-1] == 0x7E and crc16_x25(f[1:-3]) == int.from_bytes(f[-3:-1], 'little'):
+                frames.append(f)
+                i += n
+                continue
+        if data[i] == 0x68 and data[i+1] == data[i+2] and data[i+3] == 0x68:
+            n = data[i+1] + 6
+            f = data[i:i+n]
+            if len(f) == n and f[-1] == 0x16 and sum(f[4:-2]) & 0xFF == f[-2]:
+                frames.append(f)
+                i += n
+                continue
+        i += 1
+    if not frames and data:
+        frames.append(data)
+    return frames
+
+# Pull mode, a meter answering a DLMS/COSEM client over an HDLC link, with logical name referencing as Kamstrup does
+
+PULL_METER_ID = b'5706567000000000'
+PULL_METER_MODEL = b'6841131BN243101040'
+
+# Channel 1 registers by C, D, E with type, scaler, unit and value, the counter goes up by one for each poll. Those
+# not listed are answered as undefined objects, like the registers a single phase meter does not have
+PULL_REGISTERS = {
+    (1, 7, 0): (0x06, 0, 0x1B, 1500), (2, 7, 0): (0x06, 0, 0x1B, 0),
+    (3, 7, 0): (0x06, 0, 0x1D, 120), (4, 7, 0): (0x06, 0, 0x1D, 45),
+    (32, 7, 0): (0x12, 0, 0x23, 230), (52, 7, 0): (0x12, 0, 0x23, 231), (72, 7, 0): (0x12, 0, 0x23, 232),
+    (31, 7, 0): (0x06, -2, 0x21, 650), (51, 7, 0): (0x06, -2, 0x21, 120), (71, 7, 0): (0x06, -2, 0x21, 310),
+    (1, 8, 0): (0x06, 1, 0x1E, 1234567), (2, 8, 0): (0x06, 1, 0x1E, 89),
+    (3, 8, 0): (0x06, 1, 0x20, 4567), (4, 8, 0): (0x06, 1, 0x20, 321),
+    (13, 7, 0): (0x10, -2, 0xFF, 95)
+}
+
+def axdr_length(n):
+    return bytes([n]) if n < 0x80 else bytes([0x81, n]) if n < 0x100 else bytes([0x82]) + n.to_bytes(2, 'big')
+
+class PullMeter:
+    def __init__(self, line, args):
+        self.line = line
+        self.args = args
+        self.list = not args.no_list
+        self.connected = False
+        self.polls = 0
+        self.client_info = 128
+        self.pending = []
+        self.blocks = []
+        self.invoke = 0
+        self.rx = bytearray()
+
+    def frame(self, control, info=b'', segmented=False):
+        # The client is the destination, address 0x10, and the meter the source, address 0x01
+        header = bytes([0x21, 0x03, control])
+        length = 2 + len(header) + (2 + len(info) if info else 0) + 2
+        fmt = 0xA000 | (0x0800 if segmented else 0) | length
+        h = bytes([fmt >> 8, fmt & 0xFF]) + header
+        body = h + (crc16_x25(h).to_bytes(2, 'little') + info if info else b'')
+        return b'\x7e' + body + crc16_x25(body).to_bytes(2, 'little') + b'\x7e'
+
+    def send_i(self, apdu):
+        # Split in segments the client asks for with RR, each one an I-frame of its own
+        info = b'\xe6\xe7\x00' + apdu
+        size = min(self.client_info, self.args.segment) if self.args.segment > 0 else self.client_info
+        parts = [info[i:i+size] for i in range(0, len(info), size)]
+        self.pending = [(p, i < len(parts) - 1) for i, p in enumerate(parts)]
+        self.send_next()
+
+    def send_next(self):
+        info, segmented = self.pending.pop(0)
+        self.line.write(self.frame((self.rseq << 5) | 0x10 | (self.sseq << 1), info, segmented))
+        self.sseq = (self.sseq + 1) & 0x07
+
+    def feed(self, data):
+        self.rx += data
+        while True:
+            start = self.rx.find(b'\x7e')
+            if start < 0:
+                self.rx.clear()
+                return
+            del self.rx[:start]
+            if len(self.rx) < 3:
+                return
+            if (self.rx[1] & 0xF0) != 0xA0:
+                del self.rx[:1]
+                continue
+            n = ((self.rx[1] << 8 | self.rx[2]) & 0x07FF) + 2
+            if len(self.rx) < n:
+                return
+            f = bytes(self.rx[:n])
+            if f[-1] != 0x7E or crc16_x25(f[1:-3]) != int.from_bytes(f[-3:-1], 'little'):
+                del self.rx[:1]
+                continue
+            del self.rx[:n]
+            self.handle(f[5], f[8:-3] if n > 9 else b'')
+
+    def handle(self, control, info):
+        if control == 0x93: # SNRM
+            if len(info) >= 3 and info[0] == 0x81:
+                i = 3
+                while i + 2 <= len(info):
+                    if info[i] == 0x06:
+                        self.client_info = int.from_bytes(info[i+2:i+2+info[i+1]], 'big')
+                    i += 2 + info[i+1]
+            self.connected = True
+            self.sseq = self.rseq = 0
+            self.pending = []
+            info = self.args.pull_info
+            params = bytes([0x05, 0x02]) + self.client_info.to_bytes(2, 'big') + bytes([0x06, 0x02]) + info.to_bytes(2, 'big')
+            params += bytes([0x07, 0x04, 0, 0, 0, 1, 0x08, 0x04, 0, 0, 0, 1])
+            self.line.write(self.frame(0x73, bytes([0x81, 0x80, len(params)]) + params))
+        elif control == 0x53: # DISC
+            self.line.write(self.frame(0x73 if self.connected else 0x1F))
+            self.connected = False
+        elif not self.connected:
+            self.line.write(self.frame(0x1F)) # DM
+        elif control & 0x0F == 0x01: # RR, the client wants the next segment
+            if self.pending:
+                self.send_next()
+        elif control & 0x01 == 0x00: # I-frame
+            self.rseq = ((control >> 1) + 1) & 0x07
+            if info[:3] == b'\xe6\xe6\x00':
+                response = self.apdu(info[3:])
+                if response:
+                    self.send_i(response)
+
+    def apdu(self, apdu):
+        if apdu[0] == 0x60: # AARQ
+            conformance = 0x001A1D if self.list else 0x00181D
+            initiate = bytes([0x08, 0x00, 0x06, 0x5F, 0x1F, 0x04, 0x00]) + conformance.to_bytes(3, 'big') + bytes([0x01, 0x00, 0x00, 0x07])
+            body = bytes([0xA1, 0x09, 0x06, 0x07, 0x60, 0x85, 0x74, 0x05, 0x08, 0x01, 0x01, 0xA2, 0x03, 0x02, 0x01, 0x00])
+            body += bytes([0xBE, len(initiate) + 2, 0x04, len(initiate)]) + initiate
+            return bytes([0x61, len(body)]) + body
+        if apdu[0] != 0xC0:
+            return None
+        invoke = apdu[2]
+        if apdu[1] == 0x02: # Next data block
+            number = int.from_bytes(apdu[3:7], 'big')
+            return self.block(invoke, number + 1)
+        if apdu[1] == 0x01:
+            refs = [apdu[3:13]]
+        elif apdu[1] == 0x03 and self.list:
+            refs = [apdu[4+i*10:14+i*10] for i in range(apdu[3])]
+        else:
+            return bytes([0xC4, 0x01, invoke, 0x01, 0x0C]) # Type unmatched
+        results = [self.attribute(r) for r in refs]
+        if apdu[1] == 0x01:
+            data = results[0] if results[0][0] == 0x00 else None
+            if data is None:
+                return bytes([0xC4, 0x01, invoke]) + results[0]
+            raw = data[1:]
+        else:
+            raw = bytes([len(results)]) + b''.join(results)
+        response = bytes([0xC4, apdu[1], invoke]) + (raw if apdu[1] == 0x03 else b'\x00' + raw)
+        if self.args.pdu == 0 or len(response) <= self.args.pdu:
+            return response
+        # Larger than the PDU size, sent as a get response with data blocks, the raw data is what would have
+        # followed the invoke id, less the result choice of a normal response
+        size = max(1, self.args.pdu - 12)
+        self.blocks = [raw[i:i+size] for i in range(0, len(raw), size)]
+        return self.block(invoke, 1)
+
+    def block(self, invoke, number):
+        if number < 1 or number > len(self.blocks):
+            return bytes([0xC4, 0x02, invoke, 0x01]) + number.to_bytes(4, 'big') + bytes([0x01, 0x13]) # No long get
+        last = 1 if number == len(self.blocks) else 0
+        data = self.blocks[number - 1]
+        return bytes([0xC4, 0x02, invoke, last]) + number.to_bytes(4, 'big') + b'\x00' + axdr_length(len(data)) + data
+
+    def attribute(self, ref):
+        # Class, logical name and attribute, as a result choice followed by data or a data access result
+        cls = int.from_bytes(ref[0:2], 'big')
+        obis = tuple(ref[2:8])
+        attr = ref[8]
+        if cls == 1 and obis[:5] == (1, 1, 96, 1, 0) and attr == 2:
+            return bytes([0x00, 0x09, len(PULL_METER_ID)]) + PULL_METER_ID
+        if cls == 1 and obis[:5] == (1, 1, 96, 1, 1) and attr == 2:
+            return bytes([0x00, 0x09, len(PULL_METER_MODEL)]) + PULL_METER_MODEL
+        if cls == 8 and obis[:5] == (0, 1, 1, 0, 0) and attr == 2:
+            t = time.gmtime()
+            clock = t.tm_year.to_bytes(2, 'big') + bytes([t.tm_mon, t.tm_mday, t.tm_wday + 1, t.tm_hour, t.tm_min, t.tm_sec, 0, 0, 0, 0])
+            return bytes([0x00, 0x09, 0x0C]) + clock
+        register = PULL_REGISTERS.get(obis[2:5]) if cls == 3 and obis[:2] == (1, 1) else None
+        if register is None:
+            return bytes([0x01, 0x04]) # Object undefined
+        t, scaler, unit, value = register
+        if attr == 3:
+            return bytes([0x00, 0x02, 0x02, 0x0F, scaler & 0xFF, 0x16, unit])
+        if attr != 2:
+            return bytes([0x01, 0x03]) # Read access denied
+        if obis[2:5] == (1, 8, 0):
+            value += self.polls
+            self.polls += 1
+        size = {0x06: 4, 0x10: 2, 0x12: 2}[t]
+        return bytes([0x00, t]) + value.to_bytes(size, 'big', signed=t == 0x10)
+
+def serve(fd, line, args):
+    meter = PullMeter(line, args)
+    while True:
+        r, _, _ = select.select([fd], [], [], 1.0)
+        if not r:
+            continue
+        try:
+            data = os.read(fd, 256)
+        except OSError:
+            # The other side of the pseudo-terminal is not open
+            time.sleep(0.1)
+            continue
+        meter.feed(data)
+
+# Output
+
+def open_port(args):
+    if args.port:
+        fd = os.open(args.port, os.O_RDWR | os.O_NOCTTY)
+        name = args.port
+        keep = None
+    else:
+        fd, keep = os.openpty()
+        name = os.ttyname(keep)
+    tty.setraw(fd)
+    attr = termios.tcgetattr(fd)
+    attr[2] &= ~(termios.CSIZE | termios.PARENB | termios.PARODD | termios.CSTOPB)
+    attr[2] |= termios.CS7 if args.bits == 7 else termios.CS8
+    if args.parity != 'N':
+        attr[2] |= termios.PARENB | (termios.PARODD if args.parity == 'O' else 0)
+    attr[4] = attr[5] = BAUDS[args.baud]
+    termios.tcsetattr(fd, termios.TCSANOW, attr)
+    if keep is not None:
+        tty.setraw(keep)
+        if args.link:
+            if os.path.islink(args.link):
+                os.unlink(args.link)
+            os.symlink(name, args.link)
+            name = args.link
+    return fd, keep, name
+
+class Line:
+    # A pty takes bytes as fast as they are written, so the time each character takes on the wire is added here
+    def __init__(self, fd, args, rnd):
+        self.fd = fd
+        self.rnd = rnd
+        self.flip = args.flip
+        self.drop = args.drop
+        self.char = (1 + args.bits + (0 if args.parity == 'N' else 1) + args.stop) / args.baud
+        self.mask = 0x7F if args.bits == 7 else 0xFF
+        self.due = time.monotonic()
+        self.bytes = 0
+        self.flipped = 0
+        self.dropped = 0
+
+    def write(self, data):
+        if self.flip or self.drop:
+            out = bytearray()
+            for b in data:
+                if self.drop and self.rnd.random() < self.drop:
+                    self.dropped += 1
+                    continue
+                if self.flip and self.rnd.random() < self.flip:
+                    b ^= 1 << self.rnd.randrange(8)
+                    self.flipped += 1
+                out.append(b & self.mask)
+            data = bytes(out)
+        elif self.mask != 0xFF:
+            data = bytes(b & self.mask for b in data)
+        # Written in small pieces when their last character would have been received, not whole frames at once
+        step = max(1, int(0.002 / self.char))
+        for i in range(0, len(data), step):
+            chunk = data[i:i+step]
+            self.due = max(self.due, time.monotonic()) + len(chunk) * self.char
+            self.wait(self.due)
+            os.write(self.fd, chunk)
+            self.bytes += len(chunk)
+
+    def pause(self, seconds):
+        self.due = max(self.due, time.monotonic()) + seconds
+        self.wait(self.due)
+
+    def wait(self, until):
+        d = until - time.monotonic()
+        if d > 0:
+            time.sleep(d)
+
+def main():
+    p = argparse.ArgumentParser(description='Simulates a meter on a pseudo-terminal or serial port')
+    src = p.add_mutually_exclusive_group(required=True)
+    src.add_argument('--replay', metavar='FILE', nargs='+', help='captures to replay, hex text as in frames/ or binary')
+    src.add_argument('--synth', choices=['hdlc', 'mbus', 'gbt', 'gcm', 'dsmr'], help='generate frames of this kind')
+    src.add_argument('--pull', action='store_true', help='answer a client reading the meter over DLMS/COSEM')
+    p.add_argument('--port', help='serial port to write to, default is a new pseudo-terminal')
+    p.add_argument('--link', help='symlink to the pseudo-terminal, so the receiver has a fixed path')
+    p.add_argument('--baud', type=int, default=2400, choices=sorted(BAUDS))
+    p.add_argument('--parity', choices=['N', 'E', 'O'], default='E')
+    p.add_argument('--bits', type=int, choices=[7, 8], default=8)
+    p.add_argument('--stop', type=int, choices=[1, 2], default=1)
+    p.add_argument('--segment', type=int, default=0, help='largest payload in each HDLC, M-Bus or GBT segment')
+    p.add_argument('--key', help='encryption key in hex for --synth gcm')
+    p.add_argument('--auth', help='authentication key in hex for --synth gcm, no authentication if left out')
+    p.add_argument('--gcm-over', choices=['hdlc', 'mbus'], default='hdlc', help='framing of encrypted frames')
+    p.add_argument('--interval', type=float, default=2.5, help='seconds from the start of one burst to the next')
+    p.add_argument('--burst', type=int, default=1, help='messages in each burst')
+    p.add_argument('--gap', type=float, default=0.0, help='milliseconds of idle line between frames in a burst')
+    p.add_argument('--flip', type=float, default=0.0, help='probability of a flipped bit in each byte')
+    p.add_argument('--drop', type=float, default=0.0, help='probability of each byte being lost')
+    p.add_argument('--garbage', type=float, default=0.0, help='probability of random bytes before each message')
+    p.add_argument('--count', type=int, default=0, help='messages to send, 0 sends until interrupted')
+    p.add_argument('--start', type=int, default=1, help='first frame number')
+    p.add_argument('--wait', type=float, default=1.0, help='seconds to wait before the first message')
+    p.add_argument('--seed', type=int, default=None)
+    p.add_argument('--pdu', type=int, default=0, help='largest get response in --pull mode, larger in data blocks')
+    p.add_argument('--pull-info', type=int, default=128, help='largest information field received in --pull mode')
+    p.add_argument('--no-list', action='store_true', help='no get requests with a list of attributes in --pull mode')
+    p.add_argument('--log', help='writes frame number, monotonic time of the last byte and length of each message')
+    args = p.parse_args()
+
+    rnd = random.Random(args.seed)
+    key = bytes.fromhex(args.key) if args.key else bytes(16)
+    auth = bytes.fromhex(args.auth) if args.auth else None
+    title = b'SIMULATE'
+
+    captures = []
+    for f in args.replay or []:
+        captures += load_capture(f)
+    if args.replay and not captures:
+        sys.exit('No frames found in ' + ' '.join(args.replay))
+
+    def message(seq):
+        if captures:
+            return [captures[(seq - args.start) % len(captures)]]
+        if args.synth == 'dsmr':
+            return [dsmr_telegram(seq, rnd)]
+        apdu = obis_apdu(seq, rnd)
+        if args.synth == 'mbus':
+            return mbus(apdu, args.segment)
+        if args.synth == 'gbt':
+            return gbt(apdu, args.segment)
+        if args.synth == 'gcm':
+            apdu = gcm(apdu, key, auth, title, seq)
+            return mbus(apdu, args.segment) if args.gcm_over == 'mbus' else hdlc(apdu, args.segment)
+        return hdlc(apdu, args.segment)
+
+    fd, keep, name = open_port(args)
+    print('Writing to %s at %d %d%s%d' % (name, args.baud, args.bits, args.parity, args.stop), flush=True)
+    log = open(args.log, 'w', buffering=1) if args.log else None
+    line = Line(fd, args, rnd)
+    signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+    if args.pull:
+        try:
+            serve(fd, line, args)
+        except (KeyboardInterrupt, SystemExit):
+            pass
+        print('Sent %d bytes, %d bits flipped, %d bytes dropped' % (line.bytes, line.flipped, line.dropped), flush=True)
+        os.close(fd)
+        if keep is not None:
+            os.close(keep)
+        return
+    seq = args.start
+    sent = 0
+    started = time.monotonic()
+    try:
+        line.pause(args.wait)
+        while args.count == 0 or sent < args.count:
+            burst = time.monotonic()
+            for b in range(args.burst):
+                if args.count and sent >= args.count:
+                    break
+                if args.garbage and rnd.random() < args.garbage:
+                    line.write(bytes(rnd.randrange(256) for _ in range(rnd.randint(1, 32))))
+                frames = message(seq)
+                for i, f in enumerate(frames):
+                    if i > 0 or b > 0:
+                        line.pause(args.gap / 1000.0)
+                    line.write(f)
+                if log:
+                    log.write('%d %.6f %d\n' % (seq, line.due, sum(len(f) for f in frames)))
+                seq += 1
+                sent += 1
+            line.wait(burst + args.interval)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        elapsed = time.monotonic() - started
+        print('Sent %d messages, %d bytes in %.1f s, %.1f messages/s, %d bits flipped, %d bytes dropped' %
+            (sent, line.bytes, elapsed, sent / elapsed if elapsed else 0, line.flipped, line.dropped), flush=True)
+        if log:
+            log.close()
+        # Lets the receiver read what is left before the pseudo-terminal goes away
+        time.sleep(0.5)
+        os.close(fd)
+        if keep is not None:
+            os.close(keep)
+
+if __name__ == '__main__':
+    main()
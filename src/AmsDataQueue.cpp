@@ -0,0 +1,41 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "AmsDataQueue.h"
+
+#if defined(ESP32)
+
+// Returns NULL when full, the entry is not visible to the consumer until push()
+AmsData* AmsDataQueue::reserve() {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    if((h + 1) % AMS_DATA_QUEUE_SIZE == tail.load(std::memory_order_acquire)) {
+        dropped++;
+        return NULL;
+    }
+    return &slots[h];
+}
+
+void AmsDataQueue::push() {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    head.store((h + 1) % AMS_DATA_QUEUE_SIZE, std::memory_order_release);
+}
+
+AmsData* AmsDataQueue::front() {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) return NULL;
+    return &slots[t];
+}
+
+void AmsDataQueue::pop() {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    tail.store((t + 1) % AMS_DATA_QUEUE_SIZE, std::memory_order_release);
+}
+
+uint32_t AmsDataQueue::getDropped() {
+    return dropped;
+}
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _AMSDATAQUEUE_H
+#define _AMSDATAQUEUE_H
+
+#if defined(ESP32)
+
+#include "AmsData.h"
+#include <atomic>
+
+#define AMS_DATA_QUEUE_SIZE 4
+
+/**
+ * Lock-free queue of decoded AmsData from the task decoding the HAN port to loop(), one producer and one consumer.
+ * The slots are preallocated, the producer decodes straight into the one from reserve() and the consumer
+ * handles it in place before releasing it with pop().
+ */
+class AmsDataQueue {
+public:
+    AmsData* reserve();
+    void push();
+    AmsData* front();
+    void pop();
+    uint32_t getDropped();
+
+private:
+    AmsData slots[AMS_DATA_QUEUE_SIZE];
+    std::atomic<uint8_t> head{0};
+    std::atomic<uint8_t> tail{0};
+    std::atomic<uint32_t> dropped{0};
+};
+
+#endif
+#endif
@@ -66,6 +66,7 @@ ADC_MODE(ADC_VCC);
 #include "EthernetConnectionHandler.h"
 #include "PriceService.h"
 #include "RealtimePlot.h"
+#include "PersistenceScheduler.h"
 #include "AmsWebServer.h"
 #include "AmsConfiguration.h"
 
@@ -78,9 +79,16 @@ ADC_MODE(ADC_VCC);
 
 #include "MeterCommunicator.h"
 #include "PassiveMeterCommunicator.h"
-//#include "KmpCommunicator.h"
+#include "KamstrupPullCommunicator.h"
 #include "PulseMeterCommunicator.h"
 
+// Decoding of the HAN port in a task on the other core, only where there is one
+#if defined(ESP32) && defined(HAN_DECODE_TASK) && !defined(CONFIG_FREERTOS_UNICORE)
+#define HAN_DECODE_PIPELINE
+#include "AmsDataQueue.h"
+#include "HanLogBuffer.h"
+#endif
+
 #include "Uptime.h"
 
 #include "RemoteDebug.h"
@@ -154,26 +162,45 @@ GpioConfig gpioConfig;
 
 MeterConfig meterConfig;
 AmsData meterState;
+AmsData hanData; // Decoded frame, reused so that reading the meter does not allocate
 bool ntpEnabled = false;
 
 bool mdnsEnabled = false;
 
-AmsDataStorage ds(&Debug);
+RecordLog records(&Debug);
+AmsDataStorage ds(&Debug, &records);
 #if defined(ESP32)
 CloudConnector *cloud = NULL;
 __NOINIT_ATTR EnergyAccountingRealtimeData rtd;
 #else
 EnergyAccountingRealtimeData rtd;
 #endif
-EnergyAccounting ea(&Debug, &rtd);
+EnergyAccounting ea(&Debug, &rtd, &records);
+PersistenceScheduler persistence(&Debug, &records);
 
 RealtimePlot rtp;
 
 MeterCommunicator* mc = NULL;
 PassiveMeterCommunicator* passiveMc = NULL;
-//KmpCommunicator* kmpMc = NULL;
+KamstrupPullCommunicator* kmpMc = NULL;
 PulseMeterCommunicator* pulseMc = NULL;
 
+#if defined(HAN_DECODE_PIPELINE)
+#define HAN_DECODE_STACK 8192
+#define HAN_DECODE_PRIORITY 2
+
+// Meter state as seen by the decoder, meterState is only touched by loop()
+AmsData decoderState;
+AmsData decoderOverflow;
+AmsDataQueue decoded;
+SemaphoreHandle_t decoderLock = NULL;
+TaskHandle_t decoderTask = NULL;
+std::atomic<int> decoderError{0};
+uint32_t decoderDropped = 0;
+// What the communicator prints, written to Debug by loop()
+HanLogBuffer decoderLog;
+#endif
+
 bool networkConnected = false;
 bool setupMode = false;
 
@@ -193,6 +220,11 @@ void handleUiLanguage();
 void handleEnergyAccountingChanged();
 bool handleVoltageCheck();
 bool readHanPort();
+bool isHanBusy();
+#if defined(HAN_DECODE_PIPELINE)
+bool readDecodedData();
+void decodeHanPort(void* arg);
+#endif
 void errorBlink();
 
 uint8_t pulses = 0;
@@ -260,11 +292,9 @@ void rxerr(int err) {
 	if(passiveMc != NULL) {
 		passiveMc->rxerr(err);
 	}
-	/*
 	if(kmpMc != NULL) {
 		kmpMc->rxerr(err);
 	}
-	*/
 }
 #endif
 
@@ -427,6 +457,7 @@ void setup() {
 				if(!LittleFS.format()) {
 					debugE_P(PSTR("Unable to format broken filesystem"));
 				}
+				records.reset();
 			}
 		#endif
 		bool flashed = false;
@@ -515,6 +546,18 @@ void setup() {
 	ea.setPriceService(ps);
 	ws.setup(&config, &gpioConfig, &meterState, &ds, &ea, &rtp);
 
+	persistence.attach(PERSIST_DATA, ds.getStreams(), 1 << PERSIST_HISTORY);
+	persistence.attach(PERSIST_ACCOUNTING, ea.getStreams());
+	persistence.attach(PERSIST_HISTORY, []() -> int32_t {
+		return ds.writePending();
+	});
+	persistence.attach(PERSIST_PRICES, []() -> int32_t {
+		if(ps == NULL) return 0;
+		if(!ps->save()) return -1;
+		return 1 + ps->getPriceConfig().size() * sizeof(PriceConfig);
+	});
+	ws.setPersistenceScheduler(&persistence);
+
 	UiConfig ui;
 	if(config.getUiConfig(ui)) {
 		if(strlen(ui.language) == 0) {
@@ -612,7 +655,7 @@ void loop() {
 
 			#if defined(ESP32) && defined(ENERGY_SPEEDOMETER_PASS)
 			if(sysConfig.energyspeedometer == 7) {
-				if(!meterState.getMeterId().isEmpty()) {
+				if(strlen(meterState.getMeterId()) > 0) {
 					if(energySpeedometer == NULL) {
 						uint16_t chipId;
 						#if defined(ESP32)
@@ -713,6 +756,7 @@ void loop() {
 			config.setSystemConfig(sys);
 			config.save();
 
+			persistence.flush();
 			ESP.restart();
 		}
 		if(dnsServer != NULL) {
@@ -722,6 +766,10 @@ void loop() {
 	}
 
 	if(config.isMeterChanged()) {
+		#if defined(HAN_DECODE_PIPELINE)
+		// Hold the decoder while the communicator is replaced or its buffers are reallocated
+		if(decoderLock != NULL) xSemaphoreTake(decoderLock, portMAX_DELAY);
+		#endif
 		config.getMeterConfig(meterConfig);
 		if(meterConfig.source == METER_SOURCE_GPIO) {
 			switch(meterConfig.parser) {
@@ -730,45 +778,60 @@ void loop() {
 						delete pulseMc;
 						pulseMc = NULL;
 					}
-					/*
 					if(kmpMc != NULL) {
+						ws.setHanOccupancy(NULL, NULL);
 						delete(kmpMc);
 						kmpMc = NULL;
 					}
-					*/
 					if(passiveMc == NULL) {
 						passiveMc = new PassiveMeterCommunicator(&Debug);
+						#if defined(HAN_DECODE_PIPELINE)
+						passiveMc->setLogOutput(&decoderLog);
+						#endif
 					}
 					passiveMc->configure(meterConfig, tz);
 					hwSerial = passiveMc->getHwSerial();
+					ws.setHanOccupancy(&passiveMc->getRxOccupancy(), &passiveMc->getFrameOccupancy());
 					mc = passiveMc;
 					break;
-					/*
 				case METER_PARSER_KAMSTRUP:
 					if(pulseMc != NULL) {
 						delete pulseMc;
 						pulseMc = NULL;
 					}
 					if(passiveMc != NULL) {
+						ws.setHanOccupancy(NULL, NULL);
 						delete(passiveMc);
 						passiveMc = NULL;
 					}
+					// Every reading is asked for, without a TX pin the meter never sends anything
+					if(meterConfig.txPin == 0xFF) {
+						debugE_P(PSTR("No GPIO configured for HAN TX, pull mode needs one"));
+						if(kmpMc != NULL) {
+							ws.setHanOccupancy(NULL, NULL);
+							delete(kmpMc);
+							kmpMc = NULL;
+						}
+						hwSerial = NULL;
+						mc = NULL;
+						break;
+					}
 					if(kmpMc == NULL) {
-						kmpMc = new KmpCommunicator(&Debug);
+						kmpMc = new KamstrupPullCommunicator(&Debug);
 					}
 					kmpMc->configure(meterConfig, tz);
 					hwSerial = kmpMc->getHwSerial();
+					ws.setHanOccupancy(&kmpMc->getRxOccupancy(), &kmpMc->getFrameOccupancy());
 					mc = kmpMc;
 					break;
-					*/
 				case METER_PARSER_PULSE:
-					/*
 					if(kmpMc != NULL) {
+						ws.setHanOccupancy(NULL, NULL);
 						delete(kmpMc);
 						kmpMc = NULL;
 					}
-					*/
 					if(passiveMc != NULL) {
+						ws.setHanOccupancy(NULL, NULL);
 						delete(passiveMc);
 						passiveMc = NULL;
 					}
@@ -793,6 +856,9 @@ void loop() {
 		}
 		ws.setMeterConfig(meterConfig.distributionSystem, meterConfig.mainFuse, meterConfig.productionCapacity);
 		config.ackMeterChanged();
+		#if defined(HAN_DECODE_PIPELINE)
+		if(decoderLock != NULL) xSemaphoreGive(decoderLock);
+		#endif
 	}
 
 	if(config.isEnergyAccountingChanged()) {
@@ -817,6 +883,17 @@ void loop() {
 		if(millis() - meterState.getLastUpdateMillis() > 1800000 && !ds.isHappy()) {
 			handleClear(now);
 		}
+
+		// A closed quarter hour day or history slot is written to its file, then the record log that no longer has it.
+		// Closed hours wait with the hourly changes for the day to close
+		if(ds.hasPendingWrites()) {
+			bool hold = !ds.isWriteDue();
+			persistence.setDirty(PERSIST_HISTORY, hold);
+			persistence.setDirty(PERSIST_DATA, hold);
+		}
+
+		// Right after a frame is handled is the best time to write, unless the next one has started arriving
+		persistence.loop(isHanBusy());
 	} catch(const std::exception& e) {
 		debugE_P(PSTR("Exception in readHanPort (%s)"), e.what());
 		meterState.setLastError(METER_ERROR_EXCEPTION);
@@ -993,6 +1070,7 @@ bool handleVoltageCheck() {
 			if(diff > 0.4) {
 				debugW_P(PSTR("Vcc dropped to %.2f, disconnecting WiFi for 5 seconds to preserve power"), vcc);
 				ch->disconnect(5000);
+				persistence.flush();
 				return false;
 			}
 		}
@@ -1236,6 +1314,9 @@ void toggleSetupMode() {
 
 bool readHanPort() {
 	if(mc == NULL) return false;
+	#if defined(HAN_DECODE_PIPELINE)
+	if(mc == passiveMc) return readDecodedData();
+	#endif
 	if(pulseMc != NULL) {
 		pulseMc->onPulse(pulses);
 		pulses = 0;
@@ -1257,18 +1338,95 @@ bool readHanPort() {
 	}
 	meterState.setLastError(mc->getLastError());
 
-	AmsData* data = mc->getData(meterState);
+	if(mc->getData(meterState, hanData) && hanData.getListType() > 0) {
+		handleDataSuccess(&hanData);
+	}
+	yield();
+	return true;
+}
+
+// True while a frame is arriving or being read. The decoder task changes the communicator on the other core, so it is
+// only looked at while the task is not in it, and taken as busy when it is
+bool isHanBusy() {
+	if(mc == NULL) return false;
+	#if defined(HAN_DECODE_PIPELINE)
+	if(mc == passiveMc && decoderLock != NULL) {
+		if(xSemaphoreTake(decoderLock, 0) != pdTRUE) return true;
+		bool busy = mc->isBusy();
+		xSemaphoreGive(decoderLock);
+		return busy;
+	}
+	#endif
+	return mc->isBusy();
+}
 
-	if(data != NULL) {
-		if(data->getListType() > 0) {
-			handleDataSuccess(data);
+#if defined(HAN_DECODE_PIPELINE)
+// Publishing, storage and accounting for data decoded by decodeHanPort(), returns true when there was any
+bool readDecodedData() {
+	if(decoderTask == NULL) {
+		decoderLock = xSemaphoreCreateMutex();
+		decoderState.apply(meterState);
+		if(xTaskCreatePinnedToCore(decodeHanPort, "decode", HAN_DECODE_STACK, NULL, HAN_DECODE_PRIORITY, &decoderTask, 1 - ARDUINO_RUNNING_CORE) != pdPASS) {
+			debugE_P(PSTR("Unable to start HAN decoder task"));
+			decoderTask = NULL;
+			return false;
 		}
-		delete data;
+		debugI_P(PSTR("Decoding HAN port on core %d"), 1 - ARDUINO_RUNNING_CORE);
 	}
-	yield();
+
+	meterState.setLastError(decoderError);
+	// The port is set up again from here and not by the decoder, when it is not in the middle of a frame
+	if(xSemaphoreTake(decoderLock, 0) == pdTRUE) {
+		passiveMc->handlePort();
+		bool changed = passiveMc->isConfigChanged();
+		if(changed) passiveMc->getCurrentConfig(meterConfig);
+		xSemaphoreGive(decoderLock);
+		if(changed) config.setMeterConfig(meterConfig);
+	}
+	decoderLog.writeTo(&Debug);
+	if(decoded.getDropped() != decoderDropped) {
+		decoderDropped = decoded.getDropped();
+		debugW_P(PSTR("Dropped decoded data, %lu in total"), decoderDropped);
+	}
+
+	AmsData* data = decoded.front();
+	if(data == NULL) return false;
+	handleDataSuccess(data);
+	decoded.pop();
 	return true;
 }
 
+// Runs readHanPort() up to the point where data is handed over, loop() takes care of the rest and of the port setup.
+// Nothing here may use Debug, the communicator prints to decoderLog.
+void decodeHanPort(void* arg) {
+	while(true) {
+		bool received = false;
+		xSemaphoreTake(decoderLock, portMAX_DELAY);
+		try {
+			if(passiveMc != NULL && mc == passiveMc) {
+				received = passiveMc->receive();
+				decoderError = passiveMc->getLastError();
+				if(received) {
+					// When loop() is behind, the frame is still decoded to keep the decoder state current
+					AmsData* data = decoded.reserve();
+					bool queued = data != NULL;
+					if(!queued) data = &decoderOverflow;
+					if(passiveMc->getData(decoderState, *data) && data->getListType() > 0) {
+						decoderState.apply(*data);
+						if(queued) decoded.push();
+					}
+				}
+			}
+		} catch(const std::exception& e) {
+			if(Debug.isActive(RemoteDebug::ERROR)) decoderLog.printf_P(PSTR("Exception in HAN decoder (%s)\n"), e.what());
+			decoderError = METER_ERROR_EXCEPTION;
+		}
+		xSemaphoreGive(decoderLock);
+		if(!received) delay(10);
+	}
+}
+#endif
+
 void handleDataSuccess(AmsData* data) {
 	if(!setupMode && !hw.ledBlink(LED_GREEN, 1))
 		hw.ledBlink(LED_INTERNAL, 1);
@@ -1307,6 +1465,7 @@ void handleDataSuccess(AmsData* data) {
 
 	meterState.apply(*data);
 	rtp.update(meterState);
+	ds.sample(data);
 
 	bool saveData = false;
 	if(!ds.isHappy() && now > FirmwareVersion::BuildEpoch) { // Must use "isHappy()" in case day state gets reset and lastTimestamp is "now"
@@ -1325,14 +1484,14 @@ void handleDataSuccess(AmsData* data) {
 			saveData = ds.update(&nullData);
 		}
 		if(saveData) {
-			debugI_P(PSTR("Saving data"));
-			ds.save();
+			debugI_P(PSTR("Data storage changed"));
+			persistence.setDirty(PERSIST_DATA, true);
 		}
 	}
 
 	if(ea.update(data)) {
-		debugI_P(PSTR("Saving energy accounting"));
-		ea.save();
+		debugI_P(PSTR("Energy accounting changed"));
+		persistence.setDirty(PERSIST_ACCOUNTING, true);
 	}
 }
 
@@ -1956,6 +2115,7 @@ void configFileParse() {
 		if(!LittleFS.format()) {
 			debugE_P(PSTR("Unable to format broken filesystem"));
 		}
+		records.reset();
 	}
 
 	debugI_P(PSTR("Saving configuration now..."));
@@ -0,0 +1,305 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "CompactProfile.h"
+#include "CosemIndex.h"
+#include "Uptime.h"
+
+// Size of one Landis+Gyr object descriptor, structure of class id, logical name, attribute and data index
+#define LNG_DESCRIPTOR_LENGTH 18
+
+// Divisor from OBIS_VALUE_REGISTERS, registers summed in CompactProfile are not in there
+#define COMPACT_PROFILE_DIVISOR_CASE(name, sensor, gr, tariff, field, bit, list, divisor) \
+        case OBIS_KEY(sensor, gr, tariff): return divisor;
+
+static uint16_t compactProfileDivisor(const OBIS_code_t& obis) {
+    switch(OBIS_KEY(obis.sensor, obis.gr, obis.tariff)) {
+        OBIS_VALUE_REGISTERS(COMPACT_PROFILE_DIVISOR_CASE)
+    }
+    return obis.gr == 8 ? 1000 : 1;
+}
+
+// FNV-1a over 32 bit words, the descriptor array is hashed on every payload that carries it
+static uint32_t compactProfileFingerprint(const uint8_t* p, uint16_t length) {
+    uint32_t h = 2166136261UL;
+    uint16_t i = 0;
+    for(; i + 4 <= length; i += 4) {
+        uint32_t w;
+        memcpy(&w, p + i, 4);
+        h = (h ^ w) * 16777619UL;
+    }
+    for(; i < length; i++) {
+        h = (h ^ p[i]) * 16777619UL;
+    }
+    return h == 0 ? 1 : h;
+}
+
+// Big endian integer of any of the COSEM integer types
+static double compactProfileNumber(const uint8_t* p) {
+    switch(p[0]) {
+        case CosemTypeInteger:
+            return (int8_t) p[1];
+        case CosemTypeUnsigned:
+        case CosemTypeEnum:
+            return p[1];
+        case CosemTypeLongSigned:
+            return (int16_t) ((p[1] << 8) | p[2]);
+        case CosemTypeLongUnsigned:
+            return (uint16_t) ((p[1] << 8) | p[2]);
+        case CosemTypeDLongSigned:
+            return (int32_t) (((uint32_t) p[1] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 8) | p[4]);
+        case CosemTypeDLongUnsigned:
+            return ((uint32_t) p[1] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 8) | p[4];
+        case CosemTypeLong64Signed:
+        case CosemTypeLong64Unsigned: {
+            uint64_t v = 0;
+            for(uint8_t i = 1; i < 9; i++) v = (v << 8) | p[i];
+            return p[0] == CosemTypeLong64Signed ? (double) (int64_t) v : (double) v;
+        }
+    }
+    return 0;
+}
+
+// Checks the values from pos against the columns and notes where each of them starts
+static bool compactProfileMatch(CompactProfileLayout& layout, const uint8_t* payload, uint16_t pos, uint16_t length) {
+    for(uint8_t i = 0; i < layout.count; i++) {
+        if(pos + 2 > length || payload[pos] != layout.columns[i].type) return false;
+        layout.offsets[i] = pos;
+        pos += CosemIndex::itemLength((CosemData*) (payload + pos));
+    }
+    return pos <= length;
+}
+
+/**
+ * Landis+Gyr push with descriptors, a structure holding an array of descriptors followed by the values. The first
+ * descriptor is the push object list, which is the array itself, so the values start with the second descriptor.
+ * Values have no scalers, current is in centiampere and voltage in decivolt.
+ */
+static bool compactProfileLandisGyr(const uint8_t* payload, uint16_t length, CompactProfileLayout& layout) {
+    uint8_t n = payload[3];
+    if(payload[2] != CosemTypeArray || payload[1] != n || n < 2 || n - 1 > COMPACT_PROFILE_COLUMNS) return false;
+    uint16_t descriptorLength = 2 + n * LNG_DESCRIPTOR_LENGTH;
+    if(2 + descriptorLength > length) return false;
+
+    const uint8_t* d = payload + 4;
+    for(uint8_t i = 0; i < n; i++, d += LNG_DESCRIPTOR_LENGTH) {
+        if(d[0] != CosemTypeStructure || d[1] != 4 || d[2] != CosemTypeLongUnsigned || d[5] != CosemTypeOctetString || d[6] != 6 || d[13] != CosemTypeInteger || d[15] != CosemTypeLongUnsigned) return false;
+    }
+
+    layout.count = 0;
+    d = payload + 4 + LNG_DESCRIPTOR_LENGTH;
+    uint16_t pos = 2 + descriptorLength;
+    for(uint8_t i = 0; i < n - 1; i++, d += LNG_DESCRIPTOR_LENGTH) {
+        CompactProfileColumn& c = layout.columns[i];
+        const uint8_t* obis = d + 7;
+        c.obis = { obis[2], obis[3], obis[4] };
+        c.scaler = 0;
+        if(obis[2] == 96 && obis[3] == 1 && obis[4] <= 1) {
+            c.kind = obis[4] == 0 ? COMPACT_PROFILE_METER_ID : COMPACT_PROFILE_METER_MODEL;
+        } else if(d[14] == 2 && (obis[3] == 7 || obis[3] == 8)) {
+            c.kind = COMPACT_PROFILE_REGISTER;
+            if(obis[3] == 7 && (obis[2] == 31 || obis[2] == 51 || obis[2] == 71)) c.scaler = -2;
+            if(obis[3] == 7 && (obis[2] == 32 || obis[2] == 52 || obis[2] == 72)) c.scaler = -1;
+        } else {
+            c.kind = COMPACT_PROFILE_SKIP;
+        }
+
+        if(pos + 2 > length) return false;
+        c.type = payload[pos];
+        pos += CosemIndex::itemLength((CosemData*) (payload + pos));
+    }
+    if(pos > length) return false;
+
+    layout.count = n - 1;
+    layout.meterType = AmsTypeLandisGyr;
+    layout.descriptorLength = descriptorLength;
+    layout.fingerprint = compactProfileFingerprint(payload + 2, descriptorLength);
+    return true;
+}
+
+// Landis+Gyr list with 14 values and no descriptors, voltage is in whole volts here
+static const CompactProfileColumn LNG_COMPACT_COLUMNS[] PROGMEM = {
+    { COMPACT_PROFILE_REGISTER, CosemTypeLongUnsigned, { 32, 7, 0 }, 0 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeLongUnsigned, { 52, 7, 0 }, 0 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeLongUnsigned, { 72, 7, 0 }, 0 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeLongUnsigned, { 31, 7, 0 }, -2 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeLongUnsigned, { 51, 7, 0 }, -2 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeLongUnsigned, { 71, 7, 0 }, -2 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeDLongUnsigned, { 1, 7, 0 }, 0 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeDLongUnsigned, { 2, 7, 0 }, 0 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeDLongUnsigned, { 1, 8, 0 }, 0 },
+    { COMPACT_PROFILE_REGISTER, CosemTypeDLongUnsigned, { 2, 8, 0 }, 0 },
+    { COMPACT_PROFILE_SKIP, CosemTypeLongUnsigned, { 0, 0, 0 }, 0 },
+    { COMPACT_PROFILE_SKIP, CosemTypeLongUnsigned, { 0, 0, 0 }, 0 },
+    { COMPACT_PROFILE_SKIP, CosemTypeLongUnsigned, { 0, 0, 0 }, 0 },
+    { COMPACT_PROFILE_METER_ID, CosemTypeOctetString, { 96, 1, 0 }, 0 }
+};
+
+static bool compactProfileLandisGyrValues(const uint8_t* payload, uint16_t length, CompactProfileLayout& layout) {
+    uint8_t n = sizeof(LNG_COMPACT_COLUMNS) / sizeof(LNG_COMPACT_COLUMNS[0]);
+    if(payload[1] != n || payload[2] != CosemTypeLongUnsigned) return false;
+    layout.count = 0;
+    memcpy_P(layout.columns, LNG_COMPACT_COLUMNS, sizeof(LNG_COMPACT_COLUMNS));
+    layout.count = n;
+    layout.meterType = AmsTypeLandisGyr;
+    layout.descriptorLength = 0;
+    layout.fingerprint = 0;
+    return compactProfileMatch(layout, payload, 2, length);
+}
+
+// Tried in order on a structure that matches no cached layout
+static const CompactProfileProbe COMPACT_PROFILE_PROBES[] = {
+    compactProfileLandisGyr,
+    compactProfileLandisGyrValues
+};
+
+CompactProfileLayout* CompactProfileCache::load(const uint8_t* payload, uint16_t length) {
+    if(length < 4 || payload[0] != CosemTypeStructure) return NULL;
+    bool descriptors = payload[2] == CosemTypeArray;
+
+    for(uint8_t i = 0; i < COMPACT_PROFILE_CACHE_SIZE; i++) {
+        CompactProfileLayout& layout = layouts[i];
+        if(layout.count == 0) continue;
+        uint16_t pos = 2;
+        if(descriptors) {
+            if(layout.fingerprint == 0 || payload[1] != layout.count + 1 || 2 + layout.descriptorLength > length) continue;
+            if(compactProfileFingerprint(payload + 2, layout.descriptorLength) != layout.fingerprint) continue;
+            pos += layout.descriptorLength;
+        } else if(payload[1] != layout.count) {
+            continue;
+        }
+        if(compactProfileMatch(layout, payload, pos, length)) {
+            layout.hits++;
+            return &layout;
+        }
+    }
+
+    // Empty slots first. Probes only write to the layout once the payload looks like theirs, and clear it before they do
+    uint8_t slot = replace;
+    for(uint8_t i = 0; i < COMPACT_PROFILE_CACHE_SIZE; i++) {
+        if(layouts[i].count == 0) {
+            slot = i;
+            break;
+        }
+    }
+    CompactProfileLayout& layout = layouts[slot];
+    for(uint8_t p = 0; p < sizeof(COMPACT_PROFILE_PROBES) / sizeof(COMPACT_PROFILE_PROBES[0]); p++) {
+        if(!COMPACT_PROFILE_PROBES[p](payload, length, layout)) continue;
+
+        for(uint8_t i = 0; i < layout.count; i++) {
+            CompactProfileColumn& c = layout.columns[i];
+            float divisor = compactProfileDivisor(c.obis);
+            for(int8_t s = c.scaler; s < 0; s++) divisor *= 10;
+            for(int8_t s = c.scaler; s > 0; s--) divisor /= 10;
+            layout.divisors[i] = divisor;
+        }
+        if(!descriptors) compactProfileMatch(layout, payload, 2, length);
+        else compactProfileMatch(layout, payload, 2 + layout.descriptorLength, length);
+        layout.hits = 0;
+        if(slot == replace) replace = (replace + 1) % COMPACT_PROFILE_CACHE_SIZE;
+        return &layout;
+    }
+    return NULL;
+}
+
+CompactProfile::CompactProfile(AmsData& meterState, const uint8_t* payload, CompactProfileLayout& layout, DataParserContext &ctx) {
+    apply(meterState);
+    meterType = layout.meterType;
+    presentFields |= AMS_FIELD(AmsFieldMeterType);
+    this->packageTimestamp = ctx.timestamp;
+
+    // Net power and totals of tariffs and quadrants are worked out after all values are read
+    double importPower = 0, exportPower = 0;
+    double importTariffs = 0, exportTariffs = 0, q12 = 0, q34 = 0;
+    bool power = false, tariffs = false, quadrants = false;
+    char str[64];
+    for(uint8_t i = 0; i < layout.count; i++) {
+        const CompactProfileColumn& c = layout.columns[i];
+        const uint8_t* p = payload + layout.offsets[i];
+        switch(c.kind) {
+            case COMPACT_PROFILE_METER_ID:
+            case COMPACT_PROFILE_METER_MODEL: {
+                uint8_t len = min((uint8_t) p[1], (uint8_t) (sizeof(str) - 1));
+                memcpy(str, p + 2, len);
+                str[len] = '\0';
+                if(c.kind == COMPACT_PROFILE_METER_ID) {
+                    setMeterId(str);
+                } else {
+                    setMeterModel(str);
+                }
+                listType = max(listType, (uint8_t) 2);
+                break;
+            }
+            case COMPACT_PROFILE_REGISTER: {
+                double value = compactProfileNumber(p) / layout.divisors[i];
+                switch(OBIS_KEY(c.obis.sensor, c.obis.gr, c.obis.tariff)) {
+                    case OBIS_KEY(1, 7, 0):
+                        importPower = value;
+                        power = true;
+                        break;
+                    case OBIS_KEY(2, 7, 0):
+                        exportPower = value;
+                        power = true;
+                        break;
+                    case OBIS_KEY(1, 8, 1):
+                    case OBIS_KEY(1, 8, 2):
+                        importTariffs += value;
+                        tariffs = true;
+                        break;
+                    case OBIS_KEY(2, 8, 1):
+                    case OBIS_KEY(2, 8, 2):
+                        exportTariffs += value;
+                        tariffs = true;
+                        break;
+                    case OBIS_KEY(5, 8, 0):
+                    case OBIS_KEY(6, 8, 0):
+                        q12 += value;
+                        quadrants = true;
+                        break;
+                    case OBIS_KEY(7, 8, 0):
+                    case OBIS_KEY(8, 8, 0):
+                        q34 += value;
+                        quadrants = true;
+                        break;
+                    default:
+                        AmsData::apply(c.obis, value);
+                }
+                break;
+            }
+        }
+    }
+
+    if(power) {
+        double net = importPower - exportPower;
+        activeImportPower = net > 0 ? net : 0;
+        activeExportPower = net < 0 ? -net : 0;
+        presentFields |= AMS_FIELD(AmsFieldActiveImportPower) | AMS_FIELD(AmsFieldActiveExportPower);
+        listType = max(listType, (uint8_t) (net < 0 ? 2 : 1));
+    }
+    if(tariffs) {
+        if(importTariffs > 0) {
+            activeImportCounter = importTariffs;
+            presentFields |= AMS_FIELD(AmsFieldActiveImportCounter);
+        }
+        if(exportTariffs > 0) {
+            activeExportCounter = exportTariffs;
+            presentFields |= AMS_FIELD(AmsFieldActiveExportCounter);
+        }
+        listType = max(listType, (uint8_t) 3);
+    }
+    if(quadrants) {
+        if(q12 > 0) {
+            reactiveImportCounter = q12;
+            presentFields |= AMS_FIELD(AmsFieldReactiveImportCounter);
+        }
+        if(q34 > 0) {
+            reactiveExportCounter = q34;
+            presentFields |= AMS_FIELD(AmsFieldReactiveExportCounter);
+        }
+        listType = max(listType, (uint8_t) 3);
+    }
+    lastUpdateMillis = millis64();
+}
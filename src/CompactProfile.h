@@ -0,0 +1,78 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _COMPACTPROFILE_H
+#define _COMPACTPROFILE_H
+
+#include "AmsData.h"
+#include "DataParser.h"
+#include "Cosem.h"
+#include "OBIScodes.h"
+
+#define COMPACT_PROFILE_COLUMNS 32
+
+#if defined(ESP8266)
+#define COMPACT_PROFILE_CACHE_SIZE 2
+#else
+#define COMPACT_PROFILE_CACHE_SIZE 4
+#endif
+
+// What the value in a column is
+#define COMPACT_PROFILE_SKIP 0
+#define COMPACT_PROFILE_REGISTER 1
+#define COMPACT_PROFILE_METER_ID 2
+#define COMPACT_PROFILE_METER_MODEL 3
+
+struct CompactProfileColumn {
+    uint8_t kind;
+    uint8_t type; // COSEM type of the value, a payload with another type here is a different layout
+    OBIS_code_t obis; // C, D and E of registers
+    int8_t scaler; // Power of ten from the value to the unit in OBIS_VALUE_REGISTERS, the payload has no scalers
+};
+
+/**
+ * What each value in a payload is. Built from the descriptor array of the first payload with a new layout, or
+ * copied from a format with a fixed layout. Offsets are where the values were found in the last matching payload.
+ */
+struct CompactProfileLayout {
+    uint32_t fingerprint = 0; // Of the descriptor array, 0 when there is none
+    uint16_t descriptorLength = 0;
+    uint16_t hits = 0;
+    uint8_t count = 0;
+    uint8_t meterType = AmsTypeUnknown;
+    CompactProfileColumn columns[COMPACT_PROFILE_COLUMNS];
+    float divisors[COMPACT_PROFILE_COLUMNS]; // Scaler and divisor combined, worked out once
+    uint16_t offsets[COMPACT_PROFILE_COLUMNS];
+};
+
+/**
+ * Probe for one vendor format, in the registry in CompactProfile.cpp. Given a structure payload that matched none of
+ * the cached layouts, it fills in the layout and returns true when the payload is in its format. Supporting a new
+ * layout takes a probe and an entry in the registry.
+ */
+typedef bool (*CompactProfileProbe)(const uint8_t* payload, uint16_t length, CompactProfileLayout& layout);
+
+/**
+ * Descriptor + values payloads are a structure whose first item is an array of object descriptors, followed by one
+ * value per descriptor. Decoding the descriptors again for every payload is wasted work when they do not change, so
+ * the layout they describe is kept and later payloads only have their descriptor array fingerprinted. Payloads with
+ * only the values match a layout with the same number and types of values.
+ */
+class CompactProfileCache {
+public:
+    CompactProfileLayout* load(const uint8_t* payload, uint16_t length);
+
+private:
+    CompactProfileLayout layouts[COMPACT_PROFILE_CACHE_SIZE];
+    uint8_t replace = 0;
+};
+
+class CompactProfile : public AmsData {
+public:
+    CompactProfile(AmsData& meterState, const uint8_t* payload, CompactProfileLayout& layout, DataParserContext &ctx);
+};
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "HanAutodetect.h"
+
+static const uint32_t HAN_AUTODETECT_BAUDS[] = { 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+
+struct HanAutodetectFormat {
+    uint8_t dataBits;
+    bool parity;
+    uint8_t ordinal;
+};
+
+// Tried in this order, 7E1 is also read without framing errors as 8N1, 8N1 has no check beyond the stop bit
+static const HanAutodetectFormat HAN_AUTODETECT_FORMATS[] = {
+    { 7, true, 10 },  // 7E1
+    { 8, true, 11 },  // 8E1
+    { 8, false, 3 }   // 8N1
+};
+
+// Anything longer than this is the line idling between characters
+#define HAN_AUTODETECT_MAX_IDLE 12
+
+void HanAutodetect::reset() {
+    count = 0;
+}
+
+// Called from the pin change interrupt
+void IRAM_ATTR HanAutodetect::edge(uint32_t micros) {
+    last = micros;
+    uint16_t i = count;
+    if(i < HAN_AUTODETECT_EDGES) {
+        edges[i] = micros;
+        count = i + 1;
+    }
+}
+
+uint16_t HanAutodetect::getEdgeCount() {
+    return count;
+}
+
+// Keeps going after the buffer is full, so the end of the burst can be seen
+uint32_t HanAutodetect::getLastEdge() {
+    return last;
+}
+
+bool HanAutodetect::analyze(bool idleLevel, HanAutodetectResult& result) {
+    uint16_t n = count;
+    if(n < 64) return false;
+
+    for(uint8_t i = 0; i < sizeof(HAN_AUTODETECT_BAUDS) / sizeof(HAN_AUTODETECT_BAUDS[0]); i++) {
+        float bit = 1000000.0 / HAN_AUTODETECT_BAUDS[i];
+        if(countShort(n, bit) > n / 50) continue;
+
+        uint16_t first = findStart(n, bit), last = first;
+        if(first == n) {
+            // No idle gap, the first edge can go either way
+            first = 0;
+            last = 1;
+        }
+        for(uint8_t f = 0; f < sizeof(HAN_AUTODETECT_FORMATS) / sizeof(HAN_AUTODETECT_FORMATS[0]); f++) {
+            for(uint16_t start = first; start <= last; start++) {
+                uint16_t bytes, errors;
+                decode(n, start, bit, HAN_AUTODETECT_FORMATS[f].dataBits, HAN_AUTODETECT_FORMATS[f].parity, bytes, errors);
+                // A wrong guess gives errors on a large part of the characters, allow a few from timing jitter
+                if(bytes < 16 || errors * 20 > bytes) continue;
+
+                result.baud = HAN_AUTODETECT_BAUDS[i];
+                result.parity = HAN_AUTODETECT_FORMATS[f].ordinal;
+                result.invert = !idleLevel;
+                result.bytes = bytes;
+                result.errors = errors;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Pulses much shorter than a bit means the rate is too low, even though a few can decode without errors
+uint16_t HanAutodetect::countShort(uint16_t n, float bit) {
+    uint16_t c = 0;
+    for(uint16_t e = 1; e < n; e++) {
+        if(edges[e] - edges[e-1] < bit / 2) c++;
+    }
+    return c;
+}
+
+// The first edge after the line has been idle is the leading edge of a start bit
+uint16_t HanAutodetect::findStart(uint16_t n, float bit) {
+    for(uint16_t e = 1; e < n / 2; e++) {
+        if(edges[e] - edges[e-1] > bit * HAN_AUTODETECT_MAX_IDLE) return e;
+    }
+    return n;
+}
+
+/**
+ * Software UART over the captured edges. Like a hardware UART each character is timed from the leading edge
+ * of its start bit and sampled in the middle of each bit, so timing errors from the interrupt do not add up.
+ * Edges an even number of steps from the start edge go from idle to active.
+ */
+void HanAutodetect::decode(uint16_t n, uint16_t start, float bit, uint8_t dataBits, bool parity, uint16_t& bytes, uint16_t& errors) {
+    bytes = 0;
+    errors = 0;
+
+    uint8_t frameBits = dataBits + (parity ? 3 : 2);
+    uint16_t e = start;
+    while(e < n) {
+        uint32_t t0 = edges[e];
+        uint16_t i = e;
+        uint8_t ones = 0;
+        bool ok = true;
+        for(uint8_t b = 1; b < frameBits; b++) {
+            uint32_t t = t0 + (uint32_t) ((b + 0.5) * bit);
+            if(t > edges[n-1]) return; // Last character is not complete
+            while(i + 1 < n && edges[i+1] <= t) i++;
+            bool level = ((i - start) & 1) == 1;
+
+            if(b <= dataBits) {
+                if(level) ones++;
+            } else if(parity && b == dataBits + 1) {
+                if(((ones + level) & 1) != 0) ok = false;
+            } else if(!level) {
+                ok = false; // Stop bit
+            }
+        }
+        bytes++;
+        if(!ok) errors++;
+
+        // Next start bit
+        e = i + 1;
+        if(((e - start) & 1) == 1) e++;
+    }
+}
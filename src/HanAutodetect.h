@@ -0,0 +1,47 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _HANAUTODETECT_H
+#define _HANAUTODETECT_H
+
+#include "Arduino.h"
+
+#define HAN_AUTODETECT_EDGES 512
+
+struct HanAutodetectResult {
+    uint32_t baud;
+    uint8_t parity; // Same ordinals as MeterConfig
+    bool invert;
+    uint16_t bytes;
+    uint16_t errors;
+};
+
+/**
+ * Works out baud rate, character format and polarity from one burst of data from the meter, instead of
+ * trying each configuration for 20 seconds. A pin change interrupt stores the time of each edge, the burst
+ * is then run through a software UART for each standard baud rate and character format. The one with fewest
+ * framing and parity errors wins. Polarity is given by the level of the idle line.
+ */
+class HanAutodetect {
+public:
+    void reset();
+    void edge(uint32_t micros);
+
+    uint16_t getEdgeCount();
+    uint32_t getLastEdge();
+    bool analyze(bool idleLevel, HanAutodetectResult& result);
+
+private:
+    volatile uint16_t count = 0;
+    volatile uint32_t last = 0;
+    volatile uint32_t edges[HAN_AUTODETECT_EDGES];
+
+    uint16_t countShort(uint16_t n, float bit);
+    uint16_t findStart(uint16_t n, float bit);
+    void decode(uint16_t n, uint16_t start, float bit, uint8_t dataBits, bool parity, uint16_t& bytes, uint16_t& errors);
+};
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "HanLogBuffer.h"
+
+#if defined(ESP32)
+
+size_t HanLogBuffer::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+size_t HanLogBuffer::write(const uint8_t* buf, size_t len) {
+    portENTER_CRITICAL(&mux);
+    size_t i = 0;
+    for(; i < len; i++) {
+        uint16_t next = (head + 1) % HAN_LOG_BUFFER_SIZE;
+        if(next == tail) break;
+        buffer[head] = buf[i];
+        head = next;
+    }
+    dropped += len - i;
+    portEXIT_CRITICAL(&mux);
+    return len;
+}
+
+// Copies out a chunk at a time, so the decoder is never held up by the output
+void HanLogBuffer::writeTo(Print* out) {
+    char chunk[128];
+    while(true) {
+        uint16_t n = 0;
+        uint32_t lost = 0;
+        portENTER_CRITICAL(&mux);
+        while(tail != head && n < sizeof(chunk)) {
+            chunk[n++] = buffer[tail];
+            tail = (tail + 1) % HAN_LOG_BUFFER_SIZE;
+        }
+        if(n == 0) {
+            lost = dropped;
+            dropped = 0;
+        }
+        portEXIT_CRITICAL(&mux);
+        if(n == 0) {
+            if(lost > 0) out->printf_P(PSTR("(%lu bytes of HAN log dropped)\n"), lost);
+            return;
+        }
+        out->write((const uint8_t*) chunk, n);
+    }
+}
+
+#endif
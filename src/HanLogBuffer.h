@@ -0,0 +1,37 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _HANLOGBUFFER_H
+#define _HANLOGBUFFER_H
+
+#if defined(ESP32)
+
+#include "Arduino.h"
+
+#define HAN_LOG_BUFFER_SIZE 2048
+
+/**
+ * Holds what the HAN decoder task prints until loop() writes it to RemoteDebug, which is not safe to use from
+ * the other core. Output that does not fit is dropped, and the number of dropped bytes is noted when it is written.
+ */
+class HanLogBuffer : public Print {
+public:
+    size_t write(uint8_t);
+    size_t write(const uint8_t* buf, size_t len);
+    using Print::write;
+
+    void writeTo(Print* out);
+
+private:
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    char buffer[HAN_LOG_BUFFER_SIZE];
+    uint16_t head = 0;
+    uint16_t tail = 0;
+    uint32_t dropped = 0;
+};
+
+#endif
+#endif
@@ -0,0 +1,225 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "HanUartReader.h"
+
+#if defined(ESP32)
+
+#define HAN_READER_QUEUE_SIZE 20
+#define HAN_READER_PRIORITY 12
+#define HAN_READER_STACK 3072
+#define HAN_READER_IDLE_SYMBOLS 10
+#define HAN_READER_HDLC_FLAG 0x7E
+#define HAN_READER_TX_TIMEOUT 1000
+
+HanUartReader::~HanUartReader() {
+    end();
+    if(ring != NULL) free(ring);
+}
+
+bool HanUartReader::begin(uart_port_t uart, uint32_t baud, uint32_t config, int8_t rxpin, int8_t txpin, bool invert, uint16_t rxBufferSize, uint16_t ringSize) {
+    end();
+
+    if(ring == NULL || size != ringSize) {
+        if(ring != NULL) free(ring);
+        ring = (uint8_t*) malloc(ringSize);
+        size = ring == NULL ? 0 : ringSize;
+        if(ring == NULL) return false;
+    }
+    head = 0;
+    tail = 0;
+    pending = 0;
+    discard = false;
+    receiving = false;
+    error = 0;
+
+    // Same encoding of data bits, parity and stop bits as the Arduino SERIAL_xxx constants
+    uart_config_t uartConfig = {};
+    uartConfig.baud_rate = baud;
+    uartConfig.data_bits = (uart_word_length_t) ((config & 0xc) >> 2);
+    uartConfig.parity = (uart_parity_t) (config & 0x3);
+    uartConfig.stop_bits = (uart_stop_bits_t) ((config & 0x30) >> 4);
+    uartConfig.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    uartConfig.source_clk = UART_SCLK_APB;
+
+    if(uart_is_driver_installed(uart)) uart_driver_delete(uart);
+    if(rxBufferSize <= UART_FIFO_LEN) rxBufferSize = UART_FIFO_LEN * 2;
+    if(uart_driver_install(uart, rxBufferSize, 0, HAN_READER_QUEUE_SIZE, &queue, 0) != ESP_OK) return false;
+    this->uart = uart;
+    uart_param_config(uart, &uartConfig);
+    uart_set_pin(uart, txpin, rxpin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    // Both lines, like HardwareSerial::begin
+    uart_set_line_inverse(uart, invert ? (UART_SIGNAL_RXD_INV | UART_SIGNAL_TXD_INV) : UART_SIGNAL_INV_DISABLE);
+    uart_set_rx_timeout(uart, HAN_READER_IDLE_SYMBOLS);
+    uart_enable_pattern_det_baud(uart, HAN_READER_HDLC_FLAG, 1, 9, 0, 0);
+    uart_pattern_queue_reset(uart, HAN_READER_QUEUE_SIZE);
+
+    if(xTaskCreatePinnedToCore(task, "han", HAN_READER_STACK, this, HAN_READER_PRIORITY, &handle, ARDUINO_RUNNING_CORE) != pdPASS) {
+        handle = NULL;
+        end();
+        return false;
+    }
+    return true;
+}
+
+void HanUartReader::end() {
+    if(handle != NULL) {
+        vTaskDelete(handle);
+        handle = NULL;
+    }
+    if(uart != UART_NUM_MAX) {
+        uart_driver_delete(uart);
+        uart = UART_NUM_MAX;
+        queue = NULL;
+    }
+}
+
+void HanUartReader::task(void* arg) {
+    ((HanUartReader*) arg)->run();
+}
+
+void HanUartReader::run() {
+    uart_event_t event;
+    uint8_t buf[128];
+    while(true) {
+        if(xQueueReceive(queue, &event, portMAX_DELAY) != pdTRUE) continue;
+        switch(event.type) {
+            case UART_DATA:
+            case UART_PATTERN_DET:
+                break;
+            case UART_BUFFER_FULL:
+            case UART_FIFO_OVF:
+                error = event.type == UART_FIFO_OVF ? 3 : 2;
+                uart_flush_input(uart);
+                xQueueReset(queue);
+                // What was received of the current frame is incomplete
+                discard = true;
+                pending = head.load(std::memory_order_relaxed);
+                dropped++;
+                receiving = true;
+                continue;
+            case UART_FRAME_ERR:
+                error = 4;
+                break;
+            case UART_PARITY_ERR:
+                error = 5;
+                break;
+            default:
+                continue;
+        }
+
+        // Reading also drops the pattern positions that are consumed, so the pattern queue does not fill up
+        size_t available = 0;
+        uart_get_buffered_data_len(uart, &available);
+        while(available > 0) {
+            int len = uart_read_bytes(uart, buf, available > sizeof(buf) ? sizeof(buf) : available, 0);
+            if(len <= 0) break;
+            push(buf, len);
+            available -= len;
+        }
+        commit(event.type == UART_DATA && event.timeout_flag);
+    }
+}
+
+uint8_t HanUartReader::at(uint16_t start, uint16_t offset) {
+    return ring[(start + offset) % size];
+}
+
+void HanUartReader::push(const uint8_t* buf, uint16_t len) {
+    if(discard) return;
+
+    uint16_t used = (pending + size - tail.load(std::memory_order_acquire)) % size;
+    if(used + len >= size) {
+        // Consumer is too far behind, drop the frame being received rather than corrupting one already queued
+        discard = true;
+        pending = head.load(std::memory_order_relaxed);
+        dropped++;
+        error = 2;
+        return;
+    }
+
+    uint16_t first = size - pending;
+    if(first > len) first = len;
+    memcpy(ring + pending, buf, first);
+    memcpy(ring, buf + first, len - first);
+    pending = (pending + len) % size;
+}
+
+// Makes complete frames visible to the consumer, HDLC frames by their length field and anything else when the line goes idle
+void HanUartReader::commit(bool idle) {
+    uint16_t start = head.load(std::memory_order_relaxed);
+    if(!discard) {
+        while(true) {
+            uint16_t len = (pending + size - start) % size;
+            if(len < 3 || at(start, 0) != HAN_READER_HDLC_FLAG || (at(start, 1) & 0xF0) != 0xA0) break;
+            uint16_t expected = (((at(start, 1) << 8) | at(start, 2)) & 0x7FF) + 2;
+            if(len < expected) break;
+            start = (start + expected) % size;
+            frames++;
+        }
+        // Without idle time between frames, avoid holding back more than half the ring
+        if(idle || (pending + size - start) % size > size / 2) {
+            if(start != pending) frames++;
+            start = pending;
+        }
+        head.store(start, std::memory_order_release);
+    }
+    if(idle) discard = false;
+    receiving = discard || start != pending;
+}
+
+int HanUartReader::available() {
+    if(size == 0) return 0;
+    return (head.load(std::memory_order_acquire) + size - tail.load(std::memory_order_relaxed)) % size;
+}
+
+int HanUartReader::read() {
+    if(size == 0) return -1;
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) return -1;
+    uint8_t b = ring[t];
+    tail.store((t + 1) % size, std::memory_order_release);
+    return b;
+}
+
+int HanUartReader::peek() {
+    if(size == 0) return -1;
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) return -1;
+    return ring[t];
+}
+
+void HanUartReader::flush() {
+    if(uart != UART_NUM_MAX) uart_wait_tx_done(uart, pdMS_TO_TICKS(HAN_READER_TX_TIMEOUT));
+}
+
+size_t HanUartReader::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+size_t HanUartReader::write(const uint8_t* buf, size_t len) {
+    if(uart == UART_NUM_MAX) return 0;
+    int written = uart_write_bytes(uart, (const char*) buf, len);
+    return written < 0 ? 0 : written;
+}
+
+bool HanUartReader::isReceiving() {
+    return receiving;
+}
+
+uint8_t HanUartReader::takeError() {
+    return error.exchange(0);
+}
+
+uint32_t HanUartReader::getFrames() {
+    return frames;
+}
+
+uint32_t HanUartReader::getDropped() {
+    return dropped;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _HANUARTREADER_H
+#define _HANUARTREADER_H
+
+#if defined(ESP32)
+
+#include "Arduino.h"
+#include <atomic>
+#include <driver/uart.h>
+
+/**
+ * Reads the HAN UART from a FreeRTOS task driven by the IDF event queue, so bytes are drained even while
+ * loop() is busy with MQTT, web or HTTP work. Received bytes go into a single producer, single consumer
+ * ring and only become visible to the reader once a frame is complete, either by the declared HDLC
+ * length (woken up by pattern detection on the HDLC flag) or by the line going idle.
+ * Errors are reported with the same codes as HardwareSerial::onReceiveError. Writes go straight to the driver,
+ * which has no TX buffer, so they return once the bytes are in the hardware FIFO.
+ */
+class HanUartReader : public Stream {
+public:
+    ~HanUartReader();
+    bool begin(uart_port_t uart, uint32_t baud, uint32_t config, int8_t rxpin, int8_t txpin, bool invert, uint16_t rxBufferSize, uint16_t ringSize);
+    void end();
+
+    int available();
+    int read();
+    int peek();
+    void flush();
+    size_t write(uint8_t);
+    size_t write(const uint8_t* buf, size_t len);
+    using Print::write;
+
+    // A frame is being received that is not available yet
+    bool isReceiving();
+
+    uint8_t takeError();
+    uint32_t getFrames();
+    uint32_t getDropped();
+
+private:
+    uart_port_t uart = UART_NUM_MAX;
+    QueueHandle_t queue = NULL;
+    TaskHandle_t handle = NULL;
+
+    uint8_t* ring = NULL;
+    uint16_t size = 0;
+    std::atomic<uint16_t> head{0}; // End of complete frames, written by the task
+    std::atomic<uint16_t> tail{0}; // Read position, written by the consumer
+    uint16_t pending = 0; // End of received bytes not yet committed, task only
+    bool discard = false;
+
+    std::atomic<bool> receiving{false};
+    std::atomic<uint8_t> error{0};
+    std::atomic<uint32_t> frames{0};
+    std::atomic<uint32_t> dropped{0};
+
+    static void task(void* arg);
+    void run();
+    void push(const uint8_t* buf, uint16_t len);
+    void commit(bool idle);
+    uint8_t at(uint16_t start, uint16_t offset);
+};
+
+#endif
+#endif
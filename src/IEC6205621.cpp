@@ -7,131 +7,187 @@
 #include "IEC6205621.h"
 #include "Uptime.h"
 
+// Values picked from the telegram, the first line with a given C.D.E wins. The registers are the ones in
+// OBIS_VALUE_REGISTERS, followed by the tariff registers C.8.1 to C.8.8
+#define IEC6205621_REGISTER_FIELD(name, sensor, gr, tariff, field, bit, list, divisor) IEC6205621_##name,
+#define IEC6205621_REGISTER_PRESENT(name, sensor, gr, tariff, field, bit, list, divisor) \
+		if(values[IEC6205621_##name].ptr != NULL) presentFields |= AMS_FIELD(bit);
+#define IEC6205621_REGISTER_CASE(name, sensor, gr, tariff, field, bit, list, divisor) \
+		case OBIS_KEY(sensor, gr, tariff): return IEC6205621_##name;
+
+enum IEC6205621Field {
+	IEC6205621_METER_ID,
+	IEC6205621_METER_ID_2,
+	IEC6205621_METER_MODEL,
+	IEC6205621_METER_MODEL_2,
+	IEC6205621_TIMESTAMP,
+	OBIS_VALUE_REGISTERS(IEC6205621_REGISTER_FIELD)
+	IEC6205621_TARIFF_COUNTERS // C = 1 to 4, one per tariff
+};
+
+#define IEC6205621_TARIFFS 8
+#define IEC6205621_FIELDS (IEC6205621_TARIFF_COUNTERS + 4 * IEC6205621_TARIFFS)
+
+static int8_t IEC6205621_field(uint32_t key) {
+	switch(key) {
+		case OBIS_KEY(96, 1, 0): return IEC6205621_METER_ID;
+		case OBIS_KEY( 0, 0, 5): return IEC6205621_METER_ID_2;
+		case OBIS_KEY(96, 1, 1): return IEC6205621_METER_MODEL;
+		case OBIS_KEY(96, 1, 7): return IEC6205621_METER_MODEL_2;
+		case OBIS_KEY( 1, 0, 0): return IEC6205621_TIMESTAMP;
+		OBIS_VALUE_REGISTERS(IEC6205621_REGISTER_CASE)
+	}
+	uint8_t c = key >> 16, d = key >> 8, e = key;
+	if(c >= 1 && c <= 4 && d == 8 && e >= 1 && e <= IEC6205621_TARIFFS) {
+		return IEC6205621_TARIFF_COUNTERS + (c - 1) * IEC6205621_TARIFFS + e - 1;
+	}
+	return -1;
+}
+
 IEC6205621::IEC6205621(const char* p, Timezone* tz, MeterConfig* meterConfig) {
 	if(strlen(p) < 16)
 		return;
 
-	String payload(p+1);
+	const char* payload = p+1;
+	char str[64];
 
 	lastUpdateMillis = millis64();
-	listId = payload.substring(payload.startsWith("/") ? 1 : 0, payload.indexOf("\n"));
 
-	if(listId.startsWith(F("ADN"))) {
+	const char* eol = strchr(payload, '\n');
+	const char* id = payload[0] == '/' ? payload+1 : payload;
+	uint16_t idLength = eol == NULL ? strlen(id) : (eol > id ? eol - id : 0);
+
+	uint8_t listIdLength = 4;
+	if(strncmp_P(id, PSTR("ADN"), 3) == 0) {
 		meterType = AmsTypeAidon;
-		listId = listId.substring(0,4);
-	} else if(listId.startsWith(F("KFM"))) {
+	} else if(strncmp_P(id, PSTR("KFM"), 3) == 0) {
 		meterType = AmsTypeKaifa;
-		listId = listId.substring(0,4);
-	} else if(listId.startsWith(F("KMP"))) {
+	} else if(strncmp_P(id, PSTR("KMP"), 3) == 0) {
 		meterType = AmsTypeKamstrup;
-		listId = listId.substring(0,4);
-	} else if(listId.startsWith(F("KAM"))) {
+	} else if(strncmp_P(id, PSTR("KAM"), 3) == 0) {
 		meterType = AmsTypeKamstrup;
-		listId = listId.substring(0,4);
-	} else if(listId.startsWith(F("ISk"))) {
+	} else if(strncmp_P(id, PSTR("ISk"), 3) == 0) {
 		meterType = AmsTypeIskra;
-		listId = listId.substring(0,5);
-	} else if(listId.startsWith(F("XMX"))) {
+		listIdLength = 5;
+	} else if(strncmp_P(id, PSTR("XMX"), 3) == 0) {
 		meterType = AmsTypeLandisGyr;
-		listId = listId.substring(0,6);
-	} else if(listId.startsWith(F("Ene")) || listId.startsWith(F("EST"))) {
+		listIdLength = 6;
+	} else if(strncmp_P(id, PSTR("Ene"), 3) == 0 || strncmp_P(id, PSTR("EST"), 3) == 0) {
 		meterType = AmsTypeSagemcom;
-		listId = listId.substring(0,4);
-	} else if(listId.startsWith(F("LGF"))) {
+	} else if(strncmp_P(id, PSTR("LGF"), 3) == 0) {
 		meterType = AmsTypeLandisGyr;
-		listId = listId.substring(0,4);
 	} else {
 		meterType = AmsTypeUnknown;
-		listId = listId.substring(0,4);
-	}
-	
-	meterId = extract(payload, F("96.1.0"));
-	if(meterId.isEmpty()) {
-		meterId = extract(payload, F("0.0.5"));
 	}
+	presentFields |= AMS_FIELD(AmsFieldMeterType);
+	if(listIdLength > idLength) listIdLength = idLength;
+	IEC6205621Value ident = { id, listIdLength };
+	toString(ident, str);
+	setListId(str);
 
-	meterModel = extract(payload, F("96.1.1"));
-	if(meterModel.isEmpty()) {
-		meterModel = extract(payload, F("96.1.7"));
-		if(meterModel.isEmpty()) {
-			meterModel = payload.substring(payload.indexOf(listId) + listId.length(), payload.indexOf(F("\n")));
-			meterModel.trim();
+	// One pass over the lines, each value is left in the payload until it is converted below
+	IEC6205621Value values[IEC6205621_FIELDS];
+	memset(values, 0, sizeof(values));
+	const char* line = eol;
+	while(line != NULL && *(++line) != '\0' && *line != '!') {
+		eol = strchr(line, '\n');
+		uint32_t key;
+		IEC6205621Value value;
+		if(readLine(line, eol == NULL ? line + strlen(line) : eol, &key, &value)) {
+			int8_t field = IEC6205621_field(key);
+			if(field >= 0 && values[field].ptr == NULL) values[field] = value;
 		}
+		line = eol;
 	}
 
-	String timestamp = extract(payload, F("1.0.0"));
-	if(timestamp.length() > 10) {
+	if(toString(values[IEC6205621_METER_ID], str) > 0 || toString(values[IEC6205621_METER_ID_2], str) > 0) {
+		setMeterId(str);
+	}
+
+	if(toString(values[IEC6205621_METER_MODEL], str) > 0 || toString(values[IEC6205621_METER_MODEL_2], str) > 0) {
+		setMeterModel(str);
+	} else {
+		// Rest of the identification line
+		const char* start = id + listIdLength;
+		const char* end = id + idLength;
+		while(start < end && isspace(*start)) start++;
+		while(end > start && isspace(*(end-1))) end--;
+		IEC6205621Value model = { start, (uint8_t) (end - start > 255 ? 255 : end - start) };
+		toString(model, str);
+		setMeterModel(str);
+	}
+
+	// YYMMDDhhmmssX
+	IEC6205621Value& timestamp = values[IEC6205621_TIMESTAMP];
+	if(timestamp.length > 10) {
 		tmElements_t tm;
-		tm.Year = (timestamp.substring(0,2).toInt() + 2000) - 1970;
-		tm.Month = timestamp.substring(4,6).toInt();
-		tm.Day = timestamp.substring(2,4).toInt();
-		tm.Hour = timestamp.substring(6,8).toInt();
-		tm.Minute = timestamp.substring(8,10).toInt();
-		tm.Second = timestamp.substring(10,12).toInt();
+		memset(&tm, 0, sizeof(tm));
+		tm.Year = (toInt(timestamp.ptr, 2) + 2000) - 1970;
+		tm.Month = toInt(timestamp.ptr+2, 2);
+		tm.Day = toInt(timestamp.ptr+4, 2);
+		tm.Hour = toInt(timestamp.ptr+6, 2);
+		tm.Minute = toInt(timestamp.ptr+8, 2);
+		tm.Second = toInt(timestamp.ptr+10, timestamp.length > 11 ? 2 : 1);
 		meterTimestamp = makeTime(tm);
 		if(tz != NULL) meterTimestamp = tz->toUTC(meterTimestamp);
+		presentFields |= AMS_FIELD(AmsFieldMeterTimestamp);
 	}
 
-	activeImportPower = (uint16_t) (extractDouble(payload, F("1.7.0")));
-	activeExportPower = (uint16_t) (extractDouble(payload, F("2.7.0")));
-	reactiveImportPower = (uint16_t) (extractDouble(payload, F("3.7.0")));
-	reactiveExportPower = (uint16_t) (extractDouble(payload, F("4.7.0")));
+	// Only the lines in the telegram, a counter can also come from the tariff registers below
+	OBIS_VALUE_REGISTERS(IEC6205621_REGISTER_PRESENT)
+
+	activeImportPower = (uint16_t) (toDouble(values[IEC6205621_ACTIVE_IMPORT]));
+	activeExportPower = (uint16_t) (toDouble(values[IEC6205621_ACTIVE_EXPORT]));
+	reactiveImportPower = (uint16_t) (toDouble(values[IEC6205621_REACTIVE_IMPORT]));
+	reactiveExportPower = (uint16_t) (toDouble(values[IEC6205621_REACTIVE_EXPORT]));
 
 	if(activeImportPower > 0)
 		listType = 1;
 	
-	l1voltage = extractFloat(payload, F("32.7.0"));
-	l2voltage = extractFloat(payload, F("52.7.0"));
-	l3voltage = extractFloat(payload, F("72.7.0"));
+	l1voltage = toFloat(values[IEC6205621_VOLTAGE_L1]);
+	l2voltage = toFloat(values[IEC6205621_VOLTAGE_L2]);
+	l3voltage = toFloat(values[IEC6205621_VOLTAGE_L3]);
 
-	l1current = extractFloat(payload, F("31.7.0"));
-	l2current = extractFloat(payload, F("51.7.0"));
-	l3current = extractFloat(payload, F("71.7.0"));
+	l1current = toFloat(values[IEC6205621_CURRENT_L1]);
+	l2current = toFloat(values[IEC6205621_CURRENT_L2]);
+	l3current = toFloat(values[IEC6205621_CURRENT_L3]);
 
-	l1activeImportPower = extractFloat(payload, F("21.7.0"));
-	l2activeImportPower = extractFloat(payload, F("41.7.0"));
-	l3activeImportPower = extractFloat(payload, F("61.7.0"));
+	l1activeImportPower = toFloat(values[IEC6205621_ACTIVE_IMPORT_L1]);
+	l2activeImportPower = toFloat(values[IEC6205621_ACTIVE_IMPORT_L2]);
+	l3activeImportPower = toFloat(values[IEC6205621_ACTIVE_IMPORT_L3]);
 	
-	l1activeExportPower = extractFloat(payload, F("22.7.0"));
-	l2activeExportPower = extractFloat(payload, F("42.7.0"));
-	l3activeExportPower = extractFloat(payload, F("62.7.0"));
+	l1activeExportPower = toFloat(values[IEC6205621_ACTIVE_EXPORT_L1]);
+	l2activeExportPower = toFloat(values[IEC6205621_ACTIVE_EXPORT_L2]);
+	l3activeExportPower = toFloat(values[IEC6205621_ACTIVE_EXPORT_L3]);
 	
 	if(l1voltage > 0 || l2voltage > 0 || l3voltage > 0)
 		listType = 2;
 
 	double val = 0.0;
 	
-	val = extractDouble(payload, F("1.8.0"));
-	if(val == 0) {
-		for(int i = 1; i < 9; i++) {
-			val += extractDouble(payload, "1.8." + String(i,10));
-		}
+	val = sumCounter(values[IEC6205621_ACTIVE_IMPORT_COUNT], values + IEC6205621_TARIFF_COUNTERS);
+	if(val > 0) {
+		activeImportCounter = val / 1000;
+		presentFields |= AMS_FIELD(AmsFieldActiveImportCounter);
 	}
-	if(val > 0) activeImportCounter = val / 1000;
 
-	val = extractDouble(payload, F("2.8.0"));
-	if(val == 0) {
-		for(int i = 1; i < 9; i++) {
-			val += extractDouble(payload, "2.8." + String(i,10));
-		}
+	val = sumCounter(values[IEC6205621_ACTIVE_EXPORT_COUNT], values + IEC6205621_TARIFF_COUNTERS + IEC6205621_TARIFFS);
+	if(val > 0) {
+		activeExportCounter = val / 1000;
+		presentFields |= AMS_FIELD(AmsFieldActiveExportCounter);
 	}
-	if(val > 0) activeExportCounter = val / 1000;
 
-	val = extractDouble(payload, F("3.8.0"));
-	if(val == 0) {
-		for(int i = 1; i < 9; i++) {
-			val += extractDouble(payload, "3.8." + String(i,10));
-		}
+	val = sumCounter(values[IEC6205621_REACTIVE_IMPORT_COUNT], values + IEC6205621_TARIFF_COUNTERS + 2 * IEC6205621_TARIFFS);
+	if(val > 0) {
+		reactiveImportCounter = val / 1000;
+		presentFields |= AMS_FIELD(AmsFieldReactiveImportCounter);
 	}
-	if(val > 0) reactiveImportCounter = val / 1000;
 
-	val = extractDouble(payload, F("4.8.0"));
-	if(val == 0) {
-		for(int i = 1; i < 9; i++) {
-			val += extractDouble(payload, "4.8." + String(i,10));
-		}
+	val = sumCounter(values[IEC6205621_REACTIVE_EXPORT_COUNT], values + IEC6205621_TARIFF_COUNTERS + 3 * IEC6205621_TARIFFS);
+	if(val > 0) {
+		reactiveExportCounter = val / 1000;
+		presentFields |= AMS_FIELD(AmsFieldReactiveExportCounter);
 	}
-	if(val > 0) reactiveExportCounter = val / 1000;
 
 	if(activeImportCounter > 0 || activeExportCounter > 0 || reactiveImportCounter > 0 || reactiveExportCounter > 0)
 		listType = 3;
@@ -162,43 +218,113 @@ IEC6205621::IEC6205621(const char* p, Timezone* tz, MeterConfig* meterConfig) {
         reactiveExportCounter = reactiveExportCounter > 0 ? reactiveExportCounter * (meterConfig->accumulatedMultiplier / 1000.0) : 0;
     }
 
+	if(presentFields & (AMS_FIELD(AmsFieldL1Voltage) | AMS_FIELD(AmsFieldL2Voltage) | AMS_FIELD(AmsFieldL3Voltage)))
+		presentFields |= AMS_FIELD(AmsFieldPhases);
 	threePhase = l1voltage > 0 && l2voltage > 0 && l3voltage > 0;
 	twoPhase = (l1voltage > 0 && l2voltage > 0) || (l2voltage > 0 && l3voltage > 0) || (l3voltage > 0  && l1voltage > 0);
 }
 
-String IEC6205621::extract(String payload, String obis) {
-	int a = payload.indexOf(String(":" + obis + "("));
-	if(a > 0) {
-		int b = payload.indexOf(F(")"), a);
-		if(b > a) {
-			return payload.substring(a+obis.length()+2, b);
+// Splits "A-B:C.D.E(value)" into the key of C.D.E and the value between the parentheses
+bool IEC6205621::readLine(const char* line, const char* end, uint32_t* key, IEC6205621Value* value) {
+	const char* pos = (const char*) memchr(line, ':', end - line);
+	if(pos == NULL) return false;
+
+	uint32_t k = 0;
+	for(uint8_t group = 0; group < 3; group++) {
+		const char* start = ++pos;
+		uint16_t n = 0;
+		while(pos < end && *pos >= '0' && *pos <= '9' && n <= 255) {
+			n = n * 10 + (*pos++ - '0');
 		}
+		if(pos == start || n > 255 || pos == end || *pos != (group < 2 ? '.' : '(')) return false;
+		k = (k << 8) | n;
 	}
-	return "";
+	pos++;
+
+	const char* close = (const char*) memchr(pos, ')', end - pos);
+	if(close == NULL) close = end;
+	*key = k;
+	value->ptr = pos;
+	value->length = close - pos > 255 ? 255 : close - pos;
+	return true;
 }
 
-double IEC6205621::extractDouble(String payload, String obis) {
-	String str = extract(payload, obis);
-	if(str.isEmpty()) {
-		return 0.0;
+static const double IEC6205621_POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+// Decimal digits are collected as an integer and scaled once, which rounds the same as strtod for up to 15 significant digits
+double IEC6205621::parseNumber(IEC6205621Value& value, bool* kilo) {
+	const char* pos = value.ptr;
+	const char* end = value.ptr + value.length;
+	while(pos < end && *pos == ' ') pos++;
+
+	bool negative = false;
+	if(pos < end && (*pos == '-' || *pos == '+')) negative = *pos++ == '-';
+
+	uint64_t mantissa = 0;
+	uint8_t digits = 0, decimals = 0;
+	bool fraction = false;
+	for(; pos < end; pos++) {
+		if(*pos >= '0' && *pos <= '9') {
+			// The mantissa holds 18 digits and IEC6205621_POW10 goes to 18 decimals, leading zeros in the fraction
+			// count as decimals but not as digits, so both are capped and the digits after are dropped
+			if(digits >= 18 || (fraction && decimals >= 18)) continue;
+			mantissa = mantissa * 10 + (*pos - '0');
+			if(mantissa > 0) digits++;
+			if(fraction) decimals++;
+		} else if(*pos == '.' && !fraction) {
+			fraction = true;
+		} else {
+			break;
+		}
 	}
 
-	int a = str.indexOf(F("*"));
-	String val = str.substring(0,a);
-	String unit = str.substring(a+1);
+	// Unit follows '*', without one the whole value is taken as the unit like before
+	const char* unit = (const char*) memchr(value.ptr, '*', value.length);
+	unit = unit == NULL ? value.ptr : unit + 1;
+	*kilo = unit < end && *unit == 'k';
 
-	return unit.startsWith(F("k")) ? val.toDouble() * 1000 : val.toDouble();
+	double ret = (double) mantissa;
+	if(decimals > 0) ret /= IEC6205621_POW10[decimals];
+	return negative ? -ret : ret;
 }
 
-float IEC6205621::extractFloat(String payload, String obis) {
-	String str = extract(payload, obis);
-	if(str.isEmpty()) {
-		return 0.0;
+double IEC6205621::toDouble(IEC6205621Value& value) {
+	if(value.length == 0) return 0.0;
+	bool kilo;
+	double val = parseNumber(value, &kilo);
+	return kilo ? val * 1000 : val;
+}
+
+float IEC6205621::toFloat(IEC6205621Value& value) {
+	if(value.length == 0) return 0.0;
+	bool kilo;
+	float val = parseNumber(value, &kilo);
+	return kilo ? val * 1000 : val;
+}
+
+// Total register when the meter has one, otherwise the sum of the tariff registers
+double IEC6205621::sumCounter(IEC6205621Value& total, IEC6205621Value* tariffs) {
+	double val = toDouble(total);
+	if(val == 0) {
+		for(int i = 0; i < IEC6205621_TARIFFS; i++) {
+			val += toDouble(tariffs[i]);
+		}
 	}
+	return val;
+}
 
-	int a = str.indexOf(F("*"));
-	String val = str.substring(0,a);
-	String unit = str.substring(a+1);
+// target must hold 64 bytes
+uint8_t IEC6205621::toString(IEC6205621Value& value, char* target) {
+	uint8_t len = value.length > 63 ? 63 : value.length;
+	if(len > 0) memcpy(target, value.ptr, len);
+	target[len] = '\0';
+	return len;
+}
 
-	return unit.startsWith(F("k")) ? val.toFloat() * 1000 : val.toFloat();
+uint8_t IEC6205621::toInt(const char* ptr, uint8_t length) {
+	uint8_t ret = 0;
+	for(uint8_t i = 0; i < length && ptr[i] >= '0' && ptr[i] <= '9'; i++) {
+		ret = ret * 10 + (ptr[i] - '0');
+	}
+	return ret;
 }
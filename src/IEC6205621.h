@@ -12,13 +12,23 @@
 #include "Timezone.h"
 #include "AmsConfiguration.h"
 
+// One value in a telegram line, points into the payload and is not null terminated
+struct IEC6205621Value {
+    const char* ptr;
+    uint8_t length;
+};
+
 class IEC6205621 : public AmsData {
 public:
     IEC6205621(const char* payload, Timezone* tz, MeterConfig* meterConfig);
 
 private:
-    String extract(String payload, String obis);
-    double extractDouble(String payload, String obis);
-    float extractFloat(String payload, String obis);
+    static bool readLine(const char* line, const char* end, uint32_t* key, IEC6205621Value* value);
+    static double parseNumber(IEC6205621Value& value, bool* kilo);
+    static double toDouble(IEC6205621Value& value);
+    static float toFloat(IEC6205621Value& value);
+    static double sumCounter(IEC6205621Value& total, IEC6205621Value* tariffs);
+    static uint8_t toString(IEC6205621Value& value, char* target);
+    static uint8_t toInt(const char* ptr, uint8_t length);
 };
 #endif
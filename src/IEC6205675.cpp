@@ -10,7 +10,24 @@
 #include "ntohll.h"
 #include "Uptime.h"
 
-IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterConfig, DataParserContext &ctx, AmsData &state) {
+#define IEC6205675_POWERS (AMS_FIELD(AmsFieldActiveImportPower) | AMS_FIELD(AmsFieldActiveExportPower) \
+        | AMS_FIELD(AmsFieldReactiveImportPower) | AMS_FIELD(AmsFieldReactiveExportPower))
+#define IEC6205675_COUNTERS (AMS_FIELD(AmsFieldActiveImportCounter) | AMS_FIELD(AmsFieldActiveExportCounter) \
+        | AMS_FIELD(AmsFieldReactiveImportCounter) | AMS_FIELD(AmsFieldReactiveExportCounter))
+#define IEC6205675_VOLTAGES (AMS_FIELD(AmsFieldL1Voltage) | AMS_FIELD(AmsFieldL2Voltage) | AMS_FIELD(AmsFieldL3Voltage))
+#define IEC6205675_CURRENTS (AMS_FIELD(AmsFieldL1Current) | AMS_FIELD(AmsFieldL2Current) | AMS_FIELD(AmsFieldL3Current))
+
+#define IEC6205675_READ_REGISTER(name, sensor, gr, tariff, field, bit, list, divisor) \
+        val = getNumber(OBIS_##name, ((char *) (d))); \
+        if(val != NOVALUE) { \
+            field = divisor == 1 ? val : val / (double) divisor; \
+            presentFields |= AMS_FIELD(bit); \
+            listType = max(listType, (uint8_t) list); \
+        } else if(listType == 2 && OBIS_KEY(sensor, gr, tariff) == OBIS_KEY(51, 7, 0)) { \
+            l2currentMissing = true; \
+        }
+
+IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterConfig, DataParserContext &ctx, AmsData &state, CosemIndex* index) {
     float val;
     char str[64];
 
@@ -20,7 +37,10 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
 
     this->packageTimestamp = ctx.timestamp;
 
-    val = getNumber(AMS_OBIS_ACTIVE_IMPORT, sizeof(AMS_OBIS_ACTIVE_IMPORT), ((char *) (d)));
+    // Lookups below use the index of this payload when there is one, otherwise they scan it
+    this->index = index;
+
+    val = getNumber(OBIS_ACTIVE_IMPORT, ((char *) (d)));
     if(val == NOVALUE) {
         CosemData* data = getCosemDataAt(1, ((char *) (d)));
         
@@ -30,10 +50,10 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
 
             memcpy(str, data->oct.data, data->oct.length);
             str[data->oct.length] = 0x00;
-            String listId = String(str);
-            if(listId.startsWith(F("KFM_001"))) {
-                this->listId = listId;
+            if(strncmp_P(str, PSTR("KFM_001"), 7) == 0) {
+                setListId(str);
                 meterType = AmsTypeKaifa;
+                presentFields |= AMS_FIELD(AmsFieldMeterType);
 
                 int idx = 0;
                 data = getCosemDataAt(idx, ((char *) (d)));
@@ -44,12 +64,12 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     memcpy(str, data->oct.data, data->oct.length);
                     str[data->oct.length] = 0x00;
-                    meterId = String(str);
+                    setMeterId(str);
 
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     memcpy(str, data->oct.data, data->oct.length);
                     str[data->oct.length] = 0x00;
-                    meterModel = String(str);
+                    setMeterModel(str);
 
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     activeImportPower = ntohl(data->dlu.data);
@@ -74,18 +94,19 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                     l2voltage = ntohl(data->dlu.data) / 10.0;
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     l3voltage = ntohl(data->dlu.data) / 10.0;
+                    presentFields |= IEC6205675_POWERS | IEC6205675_CURRENTS | IEC6205675_VOLTAGES;
                 } else if(data->base.length == 0x09 || data->base.length == 0x0E) {
                     listType = data->base.length == 0x0E ? 3 : 2;
 
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     memcpy(str, data->oct.data, data->oct.length);
                     str[data->oct.length] = 0x00;
-                    meterId = String(str);
+                    setMeterId(str);
 
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     memcpy(str, data->oct.data, data->oct.length);
                     str[data->oct.length] = 0x00;
-                    meterModel = String(str);
+                    setMeterModel(str);
 
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     activeImportPower = ntohl(data->dlu.data);
@@ -102,11 +123,13 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
 
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     l1voltage = ntohl(data->dlu.data) / 10.0;
+                    presentFields |= IEC6205675_POWERS | AMS_FIELD(AmsFieldL1Current) | AMS_FIELD(AmsFieldL1Voltage);
                 }
 
-                if(listType >= 2 && memcmp(meterModel.c_str(), "MA304T3", 7) == 0) {
+                if(listType >= 2 && memcmp(meterModel, "MA304T3", 7) == 0) {
                     l2voltage = sqrt(pow(l1voltage - l3voltage * cos(60 * (PI/180)), 2) + pow(l3voltage * sin(60 * (PI/180)),2));
                     l2currentMissing = true;
+                    presentFields |= AMS_FIELD(AmsFieldL2Voltage);
                 }
 
                 if(listType == 3) {
@@ -117,6 +140,7 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                                 AmsOctetTimestamp* amst = (AmsOctetTimestamp*) data;
                                 time_t ts = decodeCosemDateTime(amst->dt);
                                 meterTimestamp = tz.toUTC(ts);
+                                presentFields |= AMS_FIELD(AmsFieldMeterTimestamp);
                             }
                         }
                     }
@@ -130,12 +154,14 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                     reactiveImportCounter = ntohl(data->dlu.data) / 1000.0;
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     reactiveExportCounter = ntohl(data->dlu.data) / 1000.0;
+                    presentFields |= IEC6205675_COUNTERS;
                 }
 
                 lastUpdateMillis = millis64();
-            } else if(listId.startsWith("ISK")) { // Iskra special case
-                this->listId = listId;
+            } else if(strncmp_P(str, PSTR("ISK"), 3) == 0) { // Iskra special case
+                setListId(str);
                 meterType = AmsTypeIskra;
+                presentFields |= AMS_FIELD(AmsFieldMeterType);
 
                 int idx = 0;
                 data = getCosemDataAt(idx++, ((char *) (d)));
@@ -146,7 +172,7 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     memcpy(str, data->oct.data, data->oct.length);
                     str[data->oct.length] = 0x00;
-                    meterId = String(str);
+                    setMeterId(str);
 
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     activeImportPower = ntohl(data->dlu.data);
@@ -185,6 +211,9 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                     l2activeExportPower = ntohl(data->dlu.data);
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     l3activeExportPower = ntohl(data->dlu.data);
+                    presentFields |= IEC6205675_POWERS | IEC6205675_VOLTAGES | IEC6205675_CURRENTS
+                        | AMS_FIELD(AmsFieldL1ActiveImportPower) | AMS_FIELD(AmsFieldL2ActiveImportPower) | AMS_FIELD(AmsFieldL3ActiveImportPower)
+                        | AMS_FIELD(AmsFieldL1ActiveExportPower) | AMS_FIELD(AmsFieldL2ActiveExportPower) | AMS_FIELD(AmsFieldL3ActiveExportPower);
                     
                     lastUpdateMillis = millis64();
                 } else if(data->base.length == 0x0C) {
@@ -205,6 +234,7 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                     reactiveImportCounter = ntohl(data->dlu.data) / 1000.0;
                     data = getCosemDataAt(idx++, ((char *) (d)));
                     reactiveExportCounter = ntohl(data->dlu.data) / 1000.0;
+                    presentFields |= IEC6205675_COUNTERS;
 
                     lastUpdateMillis = millis64();
                 }
@@ -214,15 +244,17 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
             listType = 1;
             meterType = AmsTypeKaifa;
             activeImportPower = ntohl(data->dlu.data);
+            presentFields |= AMS_FIELD(AmsFieldMeterType) | AMS_FIELD(AmsFieldActiveImportPower);
             lastUpdateMillis = millis64();
         }
         // Kaifa end
     } else {
         listType = 1;
         activeImportPower = val;
+        presentFields |= AMS_FIELD(AmsFieldActiveImportPower) | AMS_FIELD(AmsFieldMeterType);
 
         meterType = AmsTypeUnknown;
-        CosemData* version = findObis(AMS_OBIS_VERSION, sizeof(AMS_OBIS_VERSION), d);
+        CosemData* version = findObis(OBIS_VERSION, d);
         if(version != NULL && (version->base.type == CosemTypeString || version->base.type == CosemTypeOctetString)) {
             if(memcmp(version->str.data, "AIDON", 5) == 0) {
                 meterType = AmsTypeAidon;
@@ -255,102 +287,35 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
         }
 
         uint8_t str_len = 0;
-        str_len = getString(AMS_OBIS_VERSION, sizeof(AMS_OBIS_VERSION), ((char *) (d)), str);
+        str_len = getString(OBIS_VERSION, ((char *) (d)), str);
         if(str_len > 0) {
-            listId = String(str);
-        }
-
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT, sizeof(AMS_OBIS_ACTIVE_EXPORT), ((char *) (d)));
-        if(val != NOVALUE) {
-            activeExportPower = val;
-        }
-
-        val = getNumber(AMS_OBIS_REACTIVE_IMPORT, sizeof(AMS_OBIS_REACTIVE_IMPORT), ((char *) (d)));
-        if(val != NOVALUE) {
-            reactiveImportPower = val;
-        }
-
-        val = getNumber(AMS_OBIS_REACTIVE_EXPORT, sizeof(AMS_OBIS_REACTIVE_EXPORT), ((char *) (d)));
-        if(val != NOVALUE) {
-            reactiveExportPower = val;
-        }
-
-        val = getNumber(AMS_OBIS_VOLTAGE_L1, sizeof(AMS_OBIS_VOLTAGE_L1), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 2;
-            l1voltage = val;
-        }
-        val = getNumber(AMS_OBIS_VOLTAGE_L2, sizeof(AMS_OBIS_VOLTAGE_L2), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 2;
-            l2voltage = val;
-        }
-        val = getNumber(AMS_OBIS_VOLTAGE_L3, sizeof(AMS_OBIS_VOLTAGE_L3), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 2;
-            l3voltage = val;
+            setListId(str);
         }
 
-        val = getNumber(AMS_OBIS_CURRENT_L1, sizeof(AMS_OBIS_CURRENT_L1), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 2;
-            l1current = val;
-        }
-        val = getNumber(AMS_OBIS_CURRENT_L2, sizeof(AMS_OBIS_CURRENT_L2), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 2;
-            l2current = val;
-        } else if(listType == 2) {
-            l2currentMissing = true;
-        }
-        val = getNumber(AMS_OBIS_CURRENT_L3, sizeof(AMS_OBIS_CURRENT_L3), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 2;
-            l3current = val;
-        }
+        // Expands to one lookup per register in table order, listType only ever goes up so it ends at the highest list seen
+        OBIS_VALUE_REGISTERS(IEC6205675_READ_REGISTER)
 
-        val = getNumber(AMS_OBIS_ACTIVE_IMPORT_COUNT, sizeof(AMS_OBIS_ACTIVE_IMPORT_COUNT), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 3;
-            activeImportCounter = val / 1000.0;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT_COUNT, sizeof(AMS_OBIS_ACTIVE_EXPORT_COUNT), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 3;
-            activeExportCounter = val / 1000.0;
-        }
-        val = getNumber(AMS_OBIS_REACTIVE_IMPORT_COUNT, sizeof(AMS_OBIS_REACTIVE_IMPORT_COUNT), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 3;
-            reactiveImportCounter = val / 1000.0;
-        }
-        val = getNumber(AMS_OBIS_REACTIVE_EXPORT_COUNT, sizeof(AMS_OBIS_REACTIVE_EXPORT_COUNT), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 3;
-            reactiveExportCounter = val / 1000.0;
-        }
-
-        str_len = getString(AMS_OBIS_METER_MODEL, sizeof(AMS_OBIS_METER_MODEL), ((char *) (d)), str);
+        str_len = getString(OBIS_METER_MODEL, ((char *) (d)), str);
         if(str_len > 0) {
-            meterModel = String(str);
+            setMeterModel(str);
         } else {
-            str_len = getString(AMS_OBIS_METER_MODEL_2, sizeof(AMS_OBIS_METER_MODEL_2), ((char *) (d)), str);
+            str_len = getString(OBIS_METER_MODEL_2, ((char *) (d)), str);
             if(str_len > 0) {
-                meterModel = String(str);
+                setMeterModel(str);
             }
         }
 
-        str_len = getString(AMS_OBIS_METER_ID, sizeof(AMS_OBIS_METER_ID), ((char *) (d)), str);
+        str_len = getString(OBIS_METER_ID, ((char *) (d)), str);
         if(str_len > 0) {
-            meterId = String(str);
+            setMeterId(str);
         } else {
-            str_len = getString(AMS_OBIS_METER_ID_2, sizeof(AMS_OBIS_METER_ID_2), ((char *) (d)), str);
+            str_len = getString(OBIS_METER_ID_2, ((char *) (d)), str);
             if(str_len > 0) {
-                meterId = String(str);
+                setMeterId(str);
             }
         }
 
-        CosemData* meterTs = findObis(AMS_OBIS_METER_TIMESTAMP, sizeof(AMS_OBIS_METER_TIMESTAMP), ((char *) (d)));
+        CosemData* meterTs = findObis(OBIS_METER_TIMESTAMP, ((char *) (d)));
         if(meterTs != NULL) {
             AmsOctetTimestamp* amst = (AmsOctetTimestamp*) meterTs;
             time_t ts = decodeCosemDateTime(amst->dt);
@@ -359,93 +324,9 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
             } else {
                 meterTimestamp = ts;
             }
+            presentFields |= AMS_FIELD(AmsFieldMeterTimestamp);
         }
 
-        val = getNumber(AMS_OBIS_POWER_FACTOR, sizeof(AMS_OBIS_POWER_FACTOR), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 4;
-            powerFactor = val;
-        }
-        val = getNumber(AMS_OBIS_POWER_FACTOR_L1, sizeof(AMS_OBIS_POWER_FACTOR_L1), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 4;
-            l1PowerFactor = val;
-        }
-        val = getNumber(AMS_OBIS_POWER_FACTOR_L2, sizeof(AMS_OBIS_POWER_FACTOR_L2), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 4;
-            l2PowerFactor = val;
-        }
-        val = getNumber(AMS_OBIS_POWER_FACTOR_L3, sizeof(AMS_OBIS_POWER_FACTOR_L3), ((char *) (d)));
-        if(val != NOVALUE) {
-            listType = 4;
-            l3PowerFactor = val;
-        }
-
-        val = getNumber(AMS_OBIS_ACTIVE_IMPORT_L1, sizeof(AMS_OBIS_ACTIVE_IMPORT_L1), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l1activeImportPower = val;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_IMPORT_L2, sizeof(AMS_OBIS_ACTIVE_IMPORT_L2), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l2activeImportPower = val;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_IMPORT_L3, sizeof(AMS_OBIS_ACTIVE_IMPORT_L3), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l3activeImportPower = val;
-        }
-
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT_L1, sizeof(AMS_OBIS_ACTIVE_EXPORT_L1), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l1activeExportPower = val;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT_L2, sizeof(AMS_OBIS_ACTIVE_EXPORT_L2), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l2activeExportPower = val;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT_L3, sizeof(AMS_OBIS_ACTIVE_EXPORT_L3), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l3activeExportPower = val;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_IMPORT_L1_COUNT, sizeof(AMS_OBIS_ACTIVE_IMPORT_L1_COUNT), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l1activeImportCounter = val/1000;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_IMPORT_L2_COUNT, sizeof(AMS_OBIS_ACTIVE_IMPORT_L2_COUNT), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l2activeImportCounter = val/1000;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_IMPORT_L3_COUNT, sizeof(AMS_OBIS_ACTIVE_IMPORT_L3_COUNT), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l3activeImportCounter = val/1000;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT_L1_COUNT, sizeof(AMS_OBIS_ACTIVE_EXPORT_L1_COUNT), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l1activeExportCounter = val/1000;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT_L2_COUNT, sizeof(AMS_OBIS_ACTIVE_EXPORT_L2_COUNT), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l2activeExportCounter = val/1000;
-        }
-        val = getNumber(AMS_OBIS_ACTIVE_EXPORT_L2_COUNT, sizeof(AMS_OBIS_ACTIVE_EXPORT_L2_COUNT), ((char *) (d)));
-        if (val != NOVALUE) {
-            listType = 4;
-            l3activeExportCounter = val/1000;
-        }
-
-
-
         if(meterType == AmsTypeKamstrup) {
             if(listType >= 3) {
                 activeImportCounter *= 10;
@@ -479,6 +360,7 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                 AmsOctetTimestamp* amst = (AmsOctetTimestamp*) meterTs;
                 time_t ts = decodeCosemDateTime(amst->dt);
                 meterTimestamp = ts;
+                presentFields |= AMS_FIELD(AmsFieldMeterTimestamp);
             }
 
             CosemData* mid = getCosemDataAt(58, ((char *) (d))); // TODO: Get last item
@@ -487,12 +369,12 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
                     case CosemTypeString:
                         memcpy(str, mid->oct.data, mid->oct.length);
                         str[mid->oct.length] = 0x00;
-                        meterId = String(str);
+                        setMeterId(str);
                         break;
                     case CosemTypeOctetString:
                         memcpy(str, mid->str.data, mid->str.length);
                         str[mid->str.length] = 0x00;
-                        meterId = String(str);
+                        setMeterId(str);
                         break;
                 }
             }
@@ -524,6 +406,8 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
         reactiveExportCounter = reactiveExportCounter > 0 ? reactiveExportCounter * (meterConfig->accumulatedMultiplier / 1000.0) : 0;
     }
 
+    // The phases follow from the voltages, only known when there are any
+    if(presentFields & IEC6205675_VOLTAGES) presentFields |= AMS_FIELD(AmsFieldPhases);
     threePhase = l1voltage > 0 && l2voltage > 0 && l3voltage > 0;
     if(!threePhase)
         twoPhase = (l1voltage > 0 && l2voltage > 0) || (l2voltage > 0 && l3voltage > 0) || (l3voltage > 0  && l1voltage > 0);
@@ -532,13 +416,19 @@ IEC6205675::IEC6205675(const char* d, uint8_t useMeterType, MeterConfig* meterCo
     if(meterConfig->distributionSystem == 1) {
         if(twoPhase && l1current > 0.0 && l2current > 0.0 && l3current > 0.0) {
             l2voltage = sqrt(pow(l1voltage - l3voltage * cos(60.0 * (PI/180.0)), 2) + pow(l3voltage * sin(60.0 * (PI/180.0)),2));
+            presentFields |= AMS_FIELD(AmsFieldL2Voltage);
             threePhase = true;
         }
     }
 }
 
+// Scalers are almost always in this range, pow() is slow on the ESPs
+static const double IEC6205675_POW10[] = { 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6 };
+
 CosemData* IEC6205675::getCosemDataAt(uint8_t index, const char* ptr) {
     CosemData* item = (CosemData*) ptr;
+    if(this->index != NULL && this->index->at(index, &item)) return item;
+
     int i = 0;
     char* pos = (char*) ptr;
     while(pos-ptr < 900) {
@@ -576,8 +466,17 @@ CosemData* IEC6205675::getCosemDataAt(uint8_t index, const char* ptr) {
     return NULL;
 }
 
-CosemData* IEC6205675::findObis(uint8_t* obis, int matchlength, const char* ptr) {
+// Matches the last four bytes of the logical name, A and B vary between meters
+CosemData* IEC6205675::findObis(const OBIS_code_t& code, const char* ptr) {
+    OBIS_code_t c;
+    memcpy_P(&c, &code, sizeof(c));
+    uint8_t obis[4] = { c.sensor, c.gr, c.tariff, OBIS_RANGE_NA };
+    int matchlength = sizeof(obis);
+
+    // Key is built in a register, reading back the byte array just written stalls on the store
     CosemData* item = (CosemData*) ptr;
+    if(index != NULL && index->find((OBIS_KEY(c.sensor, c.gr, c.tariff) << 8) | OBIS_RANGE_NA, &item)) return item;
+
     int ret = 0;
     char* pos = (char*) ptr;
     while(pos-ptr < 900) {
@@ -622,8 +521,8 @@ CosemData* IEC6205675::findObis(uint8_t* obis, int matchlength, const char* ptr)
     return NULL;
 }
 
-uint8_t IEC6205675::getString(uint8_t* obis, int matchlength, const char* ptr, char* target) {
-    CosemData* item = findObis(obis, matchlength, ptr);
+uint8_t IEC6205675::getString(const OBIS_code_t& obis, const char* ptr, char* target) {
+    CosemData* item = findObis(obis, ptr);
     if(item != NULL) {
         switch(item->base.type) {
             case CosemTypeString:
@@ -639,8 +538,8 @@ uint8_t IEC6205675::getString(uint8_t* obis, int matchlength, const char* ptr, c
     return 0;
 }
 
-float IEC6205675::getNumber(uint8_t* obis, int matchlength, const char* ptr) {
-    CosemData* item = findObis(obis, matchlength, ptr);
+float IEC6205675::getNumber(const OBIS_code_t& obis, const char* ptr) {
+    CosemData* item = findObis(obis, ptr);
     return getNumber(item);
 }
 
@@ -689,7 +588,7 @@ float IEC6205675::getNumber(CosemData* item) {
         if(pos != NULL) {
             if(*pos++ == 0x02 && *pos++ == 0x02) {
                 int8_t scale = *++pos;
-                ret *= pow(10, scale);
+                ret *= scale >= -6 && scale <= 6 ? IEC6205675_POW10[scale + 6] : pow(10, scale);
             }
         }
         return ret;
@@ -697,8 +596,8 @@ float IEC6205675::getNumber(CosemData* item) {
     return NOVALUE;
 }
 
-time_t IEC6205675::getTimestamp(uint8_t* obis, int matchlength, const char* ptr) {
-    CosemData* item = findObis(obis, matchlength, ptr);
+time_t IEC6205675::getTimestamp(const OBIS_code_t& obis, const char* ptr) {
+    CosemData* item = findObis(obis, ptr);
     if(item != NULL) {
         switch(item->base.type) {
             case CosemTypeOctetString: {
@@ -3,6 +3,7 @@
 
 ImpulseAmsData::ImpulseAmsData(AmsData& state, uint16_t pulsePerKwh, uint8_t pulses) {
     listType = 1;
+    presentFields |= AMS_FIELD(AmsFieldActiveImportPower);
     if(pulses > 0) {
         lastUpdateMillis = millis64();
         uint64_t lastStateMillis = state.getLastUpdateMillis();
@@ -17,5 +18,6 @@ ImpulseAmsData::ImpulseAmsData(AmsData& state, uint16_t pulsePerKwh, uint8_t pul
 
 ImpulseAmsData::ImpulseAmsData(double activeImportCounter) {
     this->activeImportCounter = activeImportCounter;
+    this->presentFields |= AMS_FIELD(AmsFieldActiveImportCounter);
     this->listType = 3;
 }
\ No newline at end of file
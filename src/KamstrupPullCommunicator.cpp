@@ -0,0 +1,745 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#include "KamstrupPullCommunicator.h"
+#include "HdlcParser.h"
+#include "Cosem.h"
+#include "crc.h"
+#include "Uptime.h"
+
+#define KMP_PULL_REGISTER(name, sensor, gr, tariff, field, bit, list, divisor) { 3, { 1, 1, sensor, gr, tariff, 0xFF }, divisor },
+
+// Kamstrup uses channel 1 in the OBIS codes. Identification first, so it is read before the first values are handed over.
+static const KamstrupPullObject KMP_OBJECTS[] PROGMEM = {
+	{ 1, { 1, 1, 96, 1, 0, 0xFF }, 0 }, // Meter ID
+	{ 1, { 1, 1, 96, 1, 1, 0xFF }, 0 }, // Meter model
+	{ 8, { 0, 1, 1, 0, 0, 0xFF }, 0 },  // Clock
+	OBIS_VALUE_REGISTERS(KMP_PULL_REGISTER)
+};
+
+#define KMP_OBJECT_COUNT (sizeof(KMP_OBJECTS) / sizeof(KMP_OBJECTS[0]))
+#define KMP_OBJECT_METER_ID 0
+#define KMP_OBJECT_METER_MODEL 1
+#define KMP_OBJECT_CLOCK 2
+#define KMP_OBJECT_BIT(o) (((uint64_t) 1) << (o))
+#define KMP_IDENTIFICATION (KMP_OBJECT_BIT(KMP_OBJECT_METER_ID) | KMP_OBJECT_BIT(KMP_OBJECT_METER_MODEL))
+#define KMP_REGISTERS ((KMP_OBJECT_BIT(KMP_OBJECT_COUNT) - 1) & ~KMP_OBJECT_BIT(KMP_OBJECT_CLOCK) & ~KMP_IDENTIFICATION)
+
+// Size of a class id, logical name, attribute and access selection in a GET request
+#define KMP_ATTRIBUTE_DESCRIPTOR 10
+
+// Application context name, logical name referencing without ciphering
+static const uint8_t KMP_CONTEXT_NAME[] PROGMEM = { 0xA1, 0x09, 0x06, 0x07, 0x60, 0x85, 0x74, 0x05, 0x08, 0x01, 0x01 };
+
+// Length of an A-XDR length field in size, returns the length
+static uint16_t kmpLength(const uint8_t* p, uint16_t avail, uint8_t& size) {
+	size = 0;
+	if(avail < 1) return 0;
+	if(p[0] < 0x80) {
+		size = 1;
+		return p[0];
+	}
+	uint8_t n = p[0] & 0x7F;
+	if(n < 1 || n > 2 || avail < n + 1) return 0;
+	size = n + 1;
+	return n == 1 ? p[1] : (p[1] << 8) | p[2];
+}
+
+// Size of one encoded data item including the type, 0 when it is not complete or of an unknown type
+static uint16_t kmpDataLength(const uint8_t* p, uint16_t avail) {
+	if(avail < 1) return 0;
+	uint16_t size = 0;
+	uint8_t lsize;
+	uint16_t l;
+	switch(p[0]) {
+		case CosemTypeNull:
+			size = 1;
+			break;
+		case CosemTypeBoolean:
+		case CosemTypeInteger:
+		case CosemTypeUnsigned:
+		case CosemTypeEnum:
+			size = 2;
+			break;
+		case CosemTypeLongSigned:
+		case CosemTypeLongUnsigned:
+			size = 3;
+			break;
+		case CosemTypeDLongSigned:
+		case CosemTypeDLongUnsigned:
+		case CosemTypeFloat32:
+		case CosemTypeTime:
+			size = 5;
+			break;
+		case CosemTypeDate:
+			size = 6;
+			break;
+		case CosemTypeLong64Signed:
+		case CosemTypeLong64Unsigned:
+		case CosemTypeFloat64:
+			size = 9;
+			break;
+		case CosemTypeDateTime:
+			size = 13;
+			break;
+		case CosemTypeOctetString:
+		case CosemTypeString:
+		case CosemTypeUtf8String:
+			l = kmpLength(p + 1, avail - 1, lsize);
+			if(lsize == 0) return 0;
+			size = 1 + lsize + l;
+			break;
+		case CosemTypeBitString:
+			l = kmpLength(p + 1, avail - 1, lsize);
+			if(lsize == 0) return 0;
+			size = 1 + lsize + (l + 7) / 8;
+			break;
+		case CosemTypeArray:
+		case CosemTypeStructure:
+			l = kmpLength(p + 1, avail - 1, lsize);
+			if(lsize == 0) return 0;
+			size = 1 + lsize;
+			for(uint16_t i = 0; i < l; i++) {
+				uint16_t item = kmpDataLength(p + size, avail - size);
+				if(item == 0) return 0;
+				size += item;
+			}
+			break;
+		default:
+			return 0;
+	}
+	return size <= avail ? size : 0;
+}
+
+static bool kmpNumber(const uint8_t* p, double& value) {
+	switch(p[0]) {
+		case CosemTypeInteger:
+			value = (int8_t) p[1];
+			return true;
+		case CosemTypeUnsigned:
+		case CosemTypeEnum:
+			value = p[1];
+			return true;
+		case CosemTypeLongSigned:
+			value = (int16_t) ((p[1] << 8) | p[2]);
+			return true;
+		case CosemTypeLongUnsigned:
+			value = (uint16_t) ((p[1] << 8) | p[2]);
+			return true;
+		case CosemTypeDLongSigned:
+			value = (int32_t) (((uint32_t) p[1] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 8) | p[4]);
+			return true;
+		case CosemTypeDLongUnsigned:
+			value = ((uint32_t) p[1] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 8) | p[4];
+			return true;
+		case CosemTypeLong64Signed:
+		case CosemTypeLong64Unsigned: {
+			uint64_t v = 0;
+			for(uint8_t i = 1; i < 9; i++) v = (v << 8) | p[i];
+			value = p[0] == CosemTypeLong64Signed ? (double) (int64_t) v : (double) v;
+			return true;
+		}
+		case CosemTypeFloat32: {
+			uint32_t v = ((uint32_t) p[1] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 8) | p[4];
+			float f;
+			memcpy(&f, &v, sizeof(f));
+			value = f;
+			return true;
+		}
+	}
+	return false;
+}
+
+void KamstrupPullData::setMeterTimestamp(time_t ts) {
+	meterTimestamp = ts;
+	presentFields |= AMS_FIELD(AmsFieldMeterTimestamp);
+}
+
+void KamstrupPullData::finish() {
+	meterType = AmsTypeKamstrup;
+	presentFields |= AMS_FIELD(AmsFieldMeterType);
+	// Attributes the meter did not have are left out, the phases are only known from voltages it did send
+	if(presentFields & (AMS_FIELD(AmsFieldL1Voltage) | AMS_FIELD(AmsFieldL2Voltage) | AMS_FIELD(AmsFieldL3Voltage)))
+		presentFields |= AMS_FIELD(AmsFieldPhases);
+	threePhase = l1voltage > 0 && l2voltage > 0 && l3voltage > 0;
+	twoPhase = (l1voltage > 0 && l2voltage > 0) || (l2voltage > 0 && l3voltage > 0) || (l3voltage > 0  && l1voltage > 0);
+	lastUpdateMillis = millis64();
+}
+
+KamstrupPullCommunicator::KamstrupPullCommunicator(RemoteDebug* debugger) : PassiveMeterCommunicator(debugger) {
+	memset(scalers, 0, sizeof(scalers));
+}
+
+KamstrupPullCommunicator::~KamstrupPullCommunicator() {
+	if(blockData != NULL) free(blockData);
+}
+
+void KamstrupPullCommunicator::configure(MeterConfig& meterConfig, Timezone* tz) {
+	MeterConfig config = meterConfig;
+	// The meter only talks when asked, there is nothing to detect the port settings from
+	if(config.baud == 0) {
+		config.baud = 9600;
+		config.parity = 3;
+	}
+	PassiveMeterCommunicator::configure(config, tz);
+	if(config.txPin == 0xFF) {
+		if (debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("No GPIO configured for HAN TX, pull mode needs one\n"));
+	}
+	resetSession();
+	state = STATE_DISCONNECTED;
+	lastMessageTime = millis() - KMP_RECONNECT_DELAY;
+	ready = false;
+}
+
+/**
+ * Never waits for the meter. Received frames are handled as they complete, then the state decides whether
+ * anything is to be sent. A request that is not answered in time breaks the connection, it is then set up again.
+ */
+bool KamstrupPullCommunicator::loop() {
+	if(hanBufferSize == 0 || meterConfig.txPin == 0xFF) return false;
+
+	if(PassiveMeterCommunicator::loop()) {
+		handleFrame(millis());
+	} else if(pos == DATA_PARSE_INTERMEDIATE_SEGMENT) {
+		// The meter sends the next segment when this one is acknowledged
+		acknowledge(hdlcParser->getControl());
+		sendReceiveReady();
+		pos = DATA_PARSE_INCOMPLETE;
+	}
+
+	unsigned long now = millis();
+	switch(state) {
+		case STATE_DISCONNECTED:
+			if(now - lastMessageTime >= KMP_RECONNECT_DELAY) {
+				sendConnectMessage();
+			}
+			break;
+		case STATE_CONNECTED_NOT_ASSOCIATED:
+			sendAssociateMessage();
+			break;
+		case STATE_CONNECTED_ASSOCIATED:
+			if(waiting) break;
+			if((pendingScalers | pendingValues) == 0) {
+				if(now - lastPoll < KMP_POLL_INTERVAL) break;
+				startPoll(now);
+			}
+			if(!requestData()) finishPoll();
+			break;
+		case STATE_CONNECTION_BROKEN:
+		case STATE_DISCONNECT:
+			sendDisconnectMessage();
+			break;
+	}
+
+	if(waiting && millis() - lastMessageTime > KMP_RESPONSE_TIMEOUT) {
+		handleTimeout();
+	}
+	return ready;
+}
+
+bool KamstrupPullCommunicator::getData(AmsData& /*meterState*/, AmsData& data) {
+	if(!ready) return false;
+	data = values;
+	validDataReceived = true;
+	ready = false;
+	return true;
+}
+
+// The meter answers within KMP_RESPONSE_TIMEOUT of a request
+bool KamstrupPullCommunicator::isBusy() {
+	return waiting || PassiveMeterCommunicator::isBusy();
+}
+
+void KamstrupPullCommunicator::handleFrame(unsigned long now) {
+	uint8_t* payload = hanBuffer + pos;
+	uint16_t length = ctx.length;
+	uint8_t control = hdlcParser == NULL ? 0 : hdlcParser->getControl();
+
+	// Nothing is left for getData(), it only hands over what has been collected
+	dataAvailable = false;
+	len = 0;
+
+	if(debugger->isActive(RemoteDebug::VERBOSE)) {
+		debugger->printf_P(PSTR("Received from meter in state %d, control %02X:\n"), state, control);
+		debugPrint(payload, 0, length);
+	}
+
+	uint8_t type = control & ~HDLC_PF;
+	if(type == HDLC_CONTROL_DM || type == HDLC_CONTROL_FRMR) {
+		if(state != STATE_DISCONNECTING && debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Meter is not connected (%02X)\n"), control);
+		resetSession();
+		state = STATE_DISCONNECTED;
+		return;
+	}
+	acknowledge(control);
+
+	switch(state) {
+		case STATE_CONNECTING:
+			if(type == HDLC_CONTROL_UA) {
+				waiting = false;
+				checkForConnectConfirmed(payload, length);
+			}
+			break;
+		case STATE_CONNECTED_ASSOCIATING:
+			if(ctx.type == DATA_TAG_AARE) {
+				waiting = false;
+				if(checkForAssociationConfirmed(payload, length)) {
+					state = STATE_CONNECTED_ASSOCIATED;
+					startPoll(now);
+					// Identification and scalers do not change during an association
+					pendingValues |= KMP_IDENTIFICATION;
+					pendingScalers = KMP_REGISTERS;
+				} else {
+					state = STATE_DISCONNECT;
+				}
+			}
+			break;
+		case STATE_CONNECTED_ASSOCIATED:
+			if(ctx.type == DATA_TAG_RES || ctx.type == DATA_TAG_EXCEPTION || ctx.type == DATA_TAG_SERVICE_ERROR) {
+				handleResponse(payload, length);
+			}
+			break;
+		case STATE_DISCONNECTING:
+			if(type == HDLC_CONTROL_UA) {
+				waiting = false;
+				state = STATE_DISCONNECTED;
+			}
+			break;
+	}
+}
+
+void KamstrupPullCommunicator::handleTimeout() {
+	waiting = false;
+	if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("No answer from meter in state %d\n"), state);
+	switch(state) {
+		case STATE_CONNECTING:
+		case STATE_DISCONNECTING:
+			state = STATE_DISCONNECTED;
+			break;
+		default:
+			// Can not tell if the request or the answer was lost, start over with a new connection
+			resetSession();
+			state = STATE_CONNECTION_BROKEN;
+	}
+}
+
+void KamstrupPullCommunicator::resetSession() {
+	waiting = false;
+	pendingScalers = 0;
+	pendingValues = 0;
+	requestCount = 0;
+	if(blockData != NULL) {
+		free(blockData);
+		blockData = NULL;
+	}
+}
+
+// Sequence numbers from an I-frame, N(R) of the meter is the next frame it expects from us
+void KamstrupPullCommunicator::acknowledge(uint8_t control) {
+	if((control & 0x01) == 0x00) {
+		recvSeq = ((control >> 1) + 1) & 0x07;
+		sendSeq = (control >> 5) & 0x07;
+	}
+}
+
+// Wraps the information field already written after the header in txBuffer, without one when infoLength is 0
+void KamstrupPullCommunicator::sendFrame(uint8_t control, uint16_t infoLength) {
+	uint8_t* f = txBuffer;
+	uint16_t i = infoLength > 0 ? 8 + infoLength : 6;
+	uint16_t format = 0xA000 | (i + 1); // Length excludes the flags
+	f[0] = HDLC_FLAG;
+	f[1] = format >> 8;
+	f[2] = format & 0xFF;
+	f[3] = serverSap;
+	f[4] = clientSap;
+	f[5] = control;
+	if(infoLength > 0) {
+		uint16_t hcs = crc16_x25(f + 1, 5);
+		f[6] = hcs >> 8;
+		f[7] = hcs & 0xFF;
+	}
+	uint16_t fcs = crc16_x25(f + 1, i - 1);
+	f[i++] = fcs >> 8;
+	f[i++] = fcs & 0xFF;
+	f[i++] = HDLC_FLAG;
+
+	// Fits in the UART FIFO or TX buffer, nothing waits for it to be sent. A frame that is not sent in full is
+	// left to the response timeout, as one the meter did not answer
+	size_t sent = hanSerial->write(f, i);
+	if(sent != i) {
+		if (debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Sent %d of %d bytes to meter\n"), (int) sent, i);
+	}
+	if(debugger->isActive(RemoteDebug::VERBOSE)) {
+		debugger->printf_P(PSTR("Sending to meter in state %d:\n"), state);
+		debugPrint(f, 0, i);
+	}
+	waiting = true;
+	lastMessageTime = millis();
+}
+
+void KamstrupPullCommunicator::sendReceiveReady() {
+	sendFrame((recvSeq << 5) | HDLC_PF | HDLC_CONTROL_RR, 0);
+}
+
+void KamstrupPullCommunicator::sendConnectMessage() {
+	uint8_t* p = txBuffer + 8;
+	uint16_t i = 0;
+	p[i++] = 0x81; // Format identifier
+	p[i++] = 0x80; // Group identifier
+	uint16_t groupLength = i++;
+	p[i++] = 0x05; // Maximum information field length, transmit
+	p[i++] = 0x01;
+	p[i++] = KMP_TX_SIZE - 11; // Less header, LLC and footer
+	p[i++] = 0x06; // Maximum information field length, receive
+	p[i++] = 0x02;
+	p[i++] = KMP_MAX_INFO >> 8;
+	p[i++] = KMP_MAX_INFO & 0xFF;
+	p[i++] = 0x07; // Window size, transmit
+	p[i++] = 0x04;
+	p[i++] = 0x00;
+	p[i++] = 0x00;
+	p[i++] = 0x00;
+	p[i++] = 0x01;
+	p[i++] = 0x08; // Window size, receive
+	p[i++] = 0x04;
+	p[i++] = 0x00;
+	p[i++] = 0x00;
+	p[i++] = 0x00;
+	p[i++] = 0x01;
+	p[groupLength] = i - groupLength - 1;
+
+	if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Connecting to meter\n"));
+	resetSession();
+	// Anything left from an earlier connection would be taken as the answer
+	while(hanSerial->available()) hanSerial->read();
+	serialInit = true;
+	segments.clear();
+	len = 0;
+	sendFrame(HDLC_CONTROL_SNRM | HDLC_PF, i);
+	state = STATE_CONNECTING;
+}
+
+// UA from the meter, the parameters are optional and given from its side
+void KamstrupPullCommunicator::checkForConnectConfirmed(uint8_t* payload, uint16_t length) {
+	maxInfoTx = 128;
+	if(ctx.type == DATA_TAG_SNRM && length >= 3 && payload[1] == 0x80) {
+		uint16_t end = min(length, (uint16_t) (payload[2] + 3));
+		uint16_t i = 3;
+		while(i + 2 <= end && i + 2 + payload[i+1] <= end) {
+			uint8_t id = payload[i];
+			uint8_t l = payload[i+1];
+			uint32_t value = 0;
+			for(uint8_t x = 0; x < l && x < 4; x++) {
+				value = (value << 8) | payload[i + 2 + x];
+			}
+			if(id == 0x06) maxInfoTx = value; // What the meter can receive
+			i += 2 + l;
+		}
+	}
+	if(maxInfoTx > KMP_TX_SIZE - 11) maxInfoTx = KMP_TX_SIZE - 11;
+	sendSeq = 0;
+	recvSeq = 0;
+	state = STATE_CONNECTED_NOT_ASSOCIATED;
+	if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Connected to meter, information field %d\n"), maxInfoTx);
+}
+
+void KamstrupPullCommunicator::sendAssociateMessage() {
+	uint8_t* p = txBuffer + 8;
+	uint16_t i = 0;
+	p[i++] = 0xE6; // LLC destination
+	p[i++] = 0xE6; // LLC source
+	p[i++] = 0x00; // LLC quality
+	p[i++] = DATA_TAG_AARQ;
+	uint16_t aarqLength = i++;
+	memcpy_P(p + i, KMP_CONTEXT_NAME, sizeof(KMP_CONTEXT_NAME));
+	i += sizeof(KMP_CONTEXT_NAME);
+	p[i++] = 0xBE; // User information
+	p[i++] = 0x10;
+	p[i++] = 0x04; // Octet string
+	p[i++] = 0x0E;
+	p[i++] = 0x01; // InitiateRequest
+	p[i++] = 0x00; // No dedicated key
+	p[i++] = 0x00; // Response allowed, default
+	p[i++] = 0x00; // No proposed quality of service
+	p[i++] = 0x06; // DLMS version
+	p[i++] = 0x5F; // Conformance
+	p[i++] = 0x1F;
+	p[i++] = 0x04;
+	p[i++] = 0x00;
+	p[i++] = 0x00;
+	p[i++] = 0x1A; // Block transfer with get and set, multiple references
+	p[i++] = 0x1D; // Get, set, selective access, action
+	p[i++] = (KMP_MAX_INFO - 3) >> 8; // Client max receive PDU size, a response fits in one frame
+	p[i++] = (KMP_MAX_INFO - 3) & 0xFF;
+	p[aarqLength] = i - aarqLength - 1;
+
+	if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Associating with meter\n"));
+	sendFrame((recvSeq << 5) | HDLC_PF | (sendSeq << 1), i);
+	state = STATE_CONNECTED_ASSOCIATING;
+}
+
+// Walks the AARE for the association result and the negotiated conformance from InitiateResponse
+bool KamstrupPullCommunicator::checkForAssociationConfirmed(uint8_t* payload, uint16_t length) {
+	bool accepted = false;
+	conformance = 0;
+	uint16_t end = min(length, (uint16_t) (payload[1] + 2));
+	uint16_t i = 2;
+	while(i + 2 <= end && i + 2 + payload[i+1] <= end) {
+		uint8_t tag = payload[i];
+		uint8_t l = payload[i+1];
+		uint8_t* v = payload + i + 2;
+		if(tag == 0xA2 && l == 3 && v[0] == 0x02) {
+			accepted = v[2] == 0x00;
+		} else if(tag == 0xBE && l >= 16 && v[0] == 0x04 && v[2] == 0x08) {
+			uint8_t* r = v + 3;
+			if(*r++ != 0x00) r++; // Negotiated quality of service
+			r++; // DLMS version
+			if(r[0] == 0x5F && r[1] == 0x1F) {
+				conformance = ((uint32_t) r[4] << 16) | ((uint32_t) r[5] << 8) | r[6];
+			}
+		}
+		i += 2 + l;
+	}
+	withList = (conformance & DLMS_CONFORMANCE_MULTIPLE_REFERENCES) != 0;
+	if(accepted) {
+		if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Associated with meter, conformance %06X\n"), conformance);
+	} else {
+		if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Meter rejected association\n"));
+	}
+	return accepted;
+}
+
+void KamstrupPullCommunicator::startPoll(unsigned long now) {
+	lastPoll = now;
+	values = KamstrupPullData();
+	pendingValues = (KMP_REGISTERS | KMP_OBJECT_BIT(KMP_OBJECT_CLOCK)) & ~unavailable;
+	if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Polling meter\n"));
+}
+
+// Asks for as many pending attributes as fit in one request, scalers first as the values depend on them
+bool KamstrupPullCommunicator::requestData() {
+	uint8_t max = 1;
+	if(withList) {
+		max = (maxInfoTx - 7) / KMP_ATTRIBUTE_DESCRIPTOR;
+		if(max > KMP_LIST_MAX) max = KMP_LIST_MAX;
+		if(max < 1) max = 1;
+	}
+	requestCount = 0;
+	for(uint8_t o = 0; o < KMP_OBJECT_COUNT && requestCount < max; o++) {
+		if(pendingScalers & KMP_OBJECT_BIT(o)) {
+			requestObjects[requestCount] = o;
+			requestAttributes[requestCount++] = 3;
+		}
+	}
+	for(uint8_t o = 0; o < KMP_OBJECT_COUNT && requestCount < max; o++) {
+		if(pendingValues & KMP_OBJECT_BIT(o)) {
+			requestObjects[requestCount] = o;
+			requestAttributes[requestCount++] = 2;
+		}
+	}
+	if(requestCount == 0) return false;
+
+	invokeId = (invokeId + 1) & 0x0F;
+	uint8_t* p = txBuffer + 8;
+	uint16_t i = 0;
+	p[i++] = 0xE6;
+	p[i++] = 0xE6;
+	p[i++] = 0x00;
+	p[i++] = 0xC0; // Get request
+	p[i++] = requestCount > 1 ? 0x03 : 0x01; // With list or normal
+	p[i++] = 0xC0 | invokeId; // High priority, confirmed
+	if(requestCount > 1) p[i++] = requestCount;
+	for(uint8_t r = 0; r < requestCount; r++) {
+		KamstrupPullObject obj;
+		memcpy_P(&obj, &KMP_OBJECTS[requestObjects[r]], sizeof(obj));
+		p[i++] = 0x00;
+		p[i++] = obj.classId;
+		memcpy(p + i, obj.obis, 6);
+		i += 6;
+		p[i++] = requestAttributes[r];
+		p[i++] = 0x00; // No selective access
+	}
+	blockNumber = 0;
+	blockLength = 0;
+	sendFrame((recvSeq << 5) | HDLC_PF | (sendSeq << 1), i);
+	return true;
+}
+
+void KamstrupPullCommunicator::requestNextBlock() {
+	uint8_t* p = txBuffer + 8;
+	uint16_t i = 0;
+	p[i++] = 0xE6;
+	p[i++] = 0xE6;
+	p[i++] = 0x00;
+	p[i++] = 0xC0; // Get request
+	p[i++] = 0x02; // Next data block
+	p[i++] = 0xC0 | invokeId;
+	p[i++] = blockNumber >> 24;
+	p[i++] = blockNumber >> 16;
+	p[i++] = blockNumber >> 8;
+	p[i++] = blockNumber & 0xFF;
+	sendFrame((recvSeq << 5) | HDLC_PF | (sendSeq << 1), i);
+}
+
+void KamstrupPullCommunicator::handleResponse(uint8_t* payload, uint16_t length) {
+	if(payload[0] != DATA_TAG_RES) {
+		waiting = false;
+		requestFailed();
+		return;
+	}
+	if(length < 4 || (payload[2] & 0x0F) != invokeId) return; // Not the answer to the last request
+	waiting = false;
+
+	bool ok = false;
+	switch(payload[1]) {
+		case 0x01: // Normal
+			ok = decodeResults(payload + 3, length - 3, false, true);
+			break;
+		case 0x03: // With list
+			ok = decodeResults(payload + 3, length - 3, true, true);
+			break;
+		case 0x02: { // With data block
+			if(length < 10 || payload[8] != 0x00) break; // Raw data, otherwise the request failed
+			uint32_t number = ((uint32_t) payload[4] << 24) | ((uint32_t) payload[5] << 16) | ((uint32_t) payload[6] << 8) | payload[7];
+			uint8_t lsize;
+			uint16_t l = kmpLength(payload + 9, length - 9, lsize);
+			if(lsize == 0 || 9 + lsize + l > length || number != blockNumber + 1 || blockLength + l > KMP_BLOCK_MAX) break;
+			if(blockData == NULL) blockData = (uint8_t*) malloc(KMP_BLOCK_MAX);
+			if(blockData == NULL) break;
+			memcpy(blockData + blockLength, payload + 9 + lsize, l);
+			blockLength += l;
+			blockNumber = number;
+			if(payload[3] == 0x00) {
+				requestNextBlock();
+				return;
+			}
+			// Together the blocks are the data of a normal response, or the results of a list response
+			ok = decodeResults(blockData, blockLength, requestCount > 1, requestCount > 1);
+			free(blockData);
+			blockData = NULL;
+			break;
+		}
+	}
+	if(!ok) {
+		requestFailed();
+	} else if((pendingScalers | pendingValues) == 0) {
+		finishPoll();
+	}
+}
+
+// Results in request order, each is data or a data access result as told by the choice before it
+bool KamstrupPullCommunicator::decodeResults(uint8_t* ptr, uint16_t length, bool list, bool choice) {
+	uint16_t i = 0;
+	uint8_t count = 1;
+	if(list) {
+		if(length < 1) return false;
+		count = ptr[i++];
+		if(count != requestCount) return false;
+	}
+	for(uint8_t r = 0; r < count; r++) {
+		if(i + 1 > length) return false;
+		uint8_t o = requestObjects[r];
+		uint8_t a = requestAttributes[r];
+		if(!choice || ptr[i++] == 0x00) {
+			uint16_t size = kmpDataLength(ptr + i, length - i);
+			if(size == 0) return false;
+			decodeValue(o, a, ptr + i, size);
+			i += size;
+		} else {
+			// Data access result, the meter does not have this object or attribute
+			if(i >= length) return false;
+			if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Object %d attribute %d not available (%d)\n"), o, a, ptr[i]);
+			if(a == 2) unavailable |= KMP_OBJECT_BIT(o);
+			i++;
+		}
+		if(a == 3) {
+			pendingScalers &= ~KMP_OBJECT_BIT(o);
+		} else {
+			pendingValues &= ~KMP_OBJECT_BIT(o);
+		}
+	}
+	return true;
+}
+
+void KamstrupPullCommunicator::decodeValue(uint8_t object, uint8_t attribute, uint8_t* ptr, uint16_t length) {
+	KamstrupPullObject obj;
+	memcpy_P(&obj, &KMP_OBJECTS[object], sizeof(obj));
+
+	if(attribute == 3) {
+		// Scaler and unit
+		if(ptr[0] == CosemTypeStructure && length >= 6 && ptr[2] == CosemTypeInteger) {
+			scalers[object] = (int8_t) ptr[3];
+		}
+		return;
+	}
+
+	switch(obj.classId) {
+		case 1:
+			if((ptr[0] == CosemTypeOctetString || ptr[0] == CosemTypeString) && length >= 2) {
+				char* target = object == KMP_OBJECT_METER_ID ? meterId : meterModel;
+				uint8_t size = object == KMP_OBJECT_METER_ID ? AMS_METER_ID_SIZE : AMS_METER_MODEL_SIZE;
+				uint8_t l = min((uint16_t) (length - 2), (uint16_t) (size - 1));
+				memcpy(target, ptr + 2, l);
+				target[l] = '\0';
+			}
+			break;
+		case 8:
+			if(ptr[0] == CosemTypeOctetString && ptr[1] == 0x0C) {
+				// Same layout as the date-time type, the length takes the place of the type
+				CosemDateTime dt;
+				memcpy(&dt, ptr + 1, sizeof(dt));
+				values.setMeterTimestamp(decodeCosemDateTime(dt));
+			}
+			break;
+		case 3: {
+			double value;
+			if(!kmpNumber(ptr, value)) break;
+			if(scalers[object] != 0) value *= pow(10, scalers[object]);
+			if(obj.divisor > 1) value /= obj.divisor;
+			OBIS_code_t code = { obj.obis[2], obj.obis[3], obj.obis[4] };
+			values.apply(code, value);
+			break;
+		}
+	}
+}
+
+// The meter could not handle the request, retried one attribute at a time, then the attribute is left out
+void KamstrupPullCommunicator::requestFailed() {
+	if(requestCount > 1) {
+		if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Meter did not answer list request, reading one attribute at a time\n"));
+		withList = false;
+	} else if(requestCount == 1) {
+		uint8_t o = requestObjects[0];
+		if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Meter did not answer request for object %d\n"), o);
+		if(requestAttributes[0] == 3) {
+			pendingScalers &= ~KMP_OBJECT_BIT(o);
+		} else {
+			unavailable |= KMP_OBJECT_BIT(o);
+			pendingValues &= ~KMP_OBJECT_BIT(o);
+		}
+	}
+	requestCount = 0;
+	if(blockData != NULL) {
+		free(blockData);
+		blockData = NULL;
+	}
+	if((pendingScalers | pendingValues) == 0) finishPoll();
+}
+
+void KamstrupPullCommunicator::finishPoll() {
+	if(meterId[0] != '\0') values.setMeterId(meterId);
+	if(meterModel[0] != '\0') values.setMeterModel(meterModel);
+	values.finish();
+	ready = values.getListType() > 0;
+	if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Poll finished, list type %d\n"), values.getListType());
+}
+
+void KamstrupPullCommunicator::sendDisconnectMessage() {
+	if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Disconnecting from meter\n"));
+	resetSession();
+	sendFrame(HDLC_CONTROL_DISC | HDLC_PF, 0);
+	state = STATE_DISCONNECTING;
+}
@@ -0,0 +1,123 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+#ifndef _KAMSTRUPPULLCOMMUNICATOR_H
+#define _KAMSTRUPPULLCOMMUNICATOR_H
+
+#include "PassiveMeterCommunicator.h"
+#include "AmsData.h"
+#include "OBIScodes.h"
+
+#define STATE_DISCONNECTED 0
+#define STATE_CONNECTING 1
+#define STATE_CONNECTED_NOT_ASSOCIATED 2
+#define STATE_CONNECTED_ASSOCIATING 3
+#define STATE_CONNECTED_ASSOCIATED 4
+#define STATE_CONNECTION_BROKEN 7
+#define STATE_DISCONNECT 8
+#define STATE_DISCONNECTING 9
+
+#define KMP_POLL_INTERVAL 10000
+#define KMP_RESPONSE_TIMEOUT 3000
+#define KMP_RECONNECT_DELAY 10000
+
+// Attribute references in one GET-WITH-LIST, keeps the request within the smallest information field of 128 bytes
+#define KMP_LIST_MAX 10
+// Proposed receive information field, a response has to fit the HAN buffer in one frame
+#define KMP_MAX_INFO 256
+#define KMP_TX_SIZE 128
+#define KMP_BLOCK_MAX 1024
+
+// Conformance block bits, bit 0 is the most significant of the three bytes
+#define DLMS_CONFORMANCE_BLOCK_TRANSFER_GET 0x001000
+#define DLMS_CONFORMANCE_MULTIPLE_REFERENCES 0x000200
+
+struct KamstrupPullObject {
+    uint8_t classId;
+    uint8_t obis[6];
+    uint16_t divisor; // From meter unit to AmsData field unit, as in OBIS_VALUE_REGISTERS
+};
+
+class KamstrupPullData : public AmsData {
+public:
+    using AmsData::setMeterId;
+    using AmsData::setMeterModel;
+    void setMeterTimestamp(time_t ts);
+    void finish();
+};
+
+/**
+ * Reads the meter over a DLMS/COSEM association instead of waiting for it to push data. The HDLC link, the
+ * association and each request are steps in a state machine driven from loop(), which never waits for the meter.
+ * Attribute reads are batched into GET-WITH-LIST requests when the meter negotiates multiple references, with
+ * one GET per attribute as fallback. Responses larger than the negotiated PDU size arrive in blocks, which are
+ * collected and decoded as one. Scalers are read once per association and cached.
+ */
+class KamstrupPullCommunicator : public PassiveMeterCommunicator {
+public:
+    KamstrupPullCommunicator(RemoteDebug* debugger);
+    ~KamstrupPullCommunicator();
+    void configure(MeterConfig&, Timezone*);
+    bool loop();
+    bool getData(AmsData& meterState, AmsData& data);
+    bool isBusy();
+
+private:
+    uint8_t state = STATE_DISCONNECTED;
+    unsigned long lastMessageTime = 0;
+    unsigned long lastPoll = 0;
+    bool waiting = false;
+    bool ready = false;
+
+    uint8_t clientSap = 0x21;
+    uint8_t serverSap = 0x03;
+    uint8_t sendSeq = 0;
+    uint8_t recvSeq = 0;
+    uint16_t maxInfoTx = 128;
+    uint32_t conformance = 0;
+    bool withList = false;
+    uint8_t invokeId = 0;
+
+    uint64_t unavailable = 0;
+    uint64_t pendingScalers = 0;
+    uint64_t pendingValues = 0;
+    int8_t scalers[64];
+    uint8_t requestCount = 0;
+    uint8_t requestObjects[KMP_LIST_MAX];
+    uint8_t requestAttributes[KMP_LIST_MAX];
+
+    uint8_t *blockData = NULL;
+    uint16_t blockLength = 0;
+    uint32_t blockNumber = 0;
+
+    char meterId[AMS_METER_ID_SIZE] = "";
+    char meterModel[AMS_METER_MODEL_SIZE] = "";
+    KamstrupPullData values;
+
+    uint8_t txBuffer[KMP_TX_SIZE];
+
+    void handleFrame(unsigned long now);
+    void handleTimeout();
+    void acknowledge(uint8_t control);
+    void sendFrame(uint8_t control, uint16_t infoLength);
+    void sendReceiveReady();
+    void sendConnectMessage();
+    void sendAssociateMessage();
+    void sendDisconnectMessage();
+    void checkForConnectConfirmed(uint8_t* payload, uint16_t length);
+    bool checkForAssociationConfirmed(uint8_t* payload, uint16_t length);
+    void startPoll(unsigned long now);
+    bool requestData();
+    void requestNextBlock();
+    void handleResponse(uint8_t* payload, uint16_t length);
+    bool decodeResults(uint8_t* ptr, uint16_t length, bool list, bool choice);
+    void decodeValue(uint8_t object, uint8_t attribute, uint8_t* ptr, uint16_t length);
+    void requestFailed();
+    void finishPoll();
+    void resetSession();
+};
+
+#endif
@@ -17,10 +17,12 @@ public:
     virtual ~MeterCommunicator() {};
     virtual void configure(MeterConfig&, Timezone*);
     virtual bool loop();
-    virtual AmsData* getData(AmsData& meterState);
+    virtual bool getData(AmsData& meterState, AmsData& data);
     virtual int getLastError();
     virtual bool isConfigChanged();
     virtual void getCurrentConfig(MeterConfig& meterConfig);
+    // Data from the meter is arriving or waiting to be handled, a bad time for anything that stalls the CPU
+    virtual bool isBusy() { return false; };
 };
 
 #endif
@@ -7,15 +7,23 @@
 #include "PassiveMeterCommunicator.h"
 #include "IEC6205675.h"
 #include "IEC6205621.h"
-#include "LNG.h"
-#include "LNG2.h"
 
 #if defined(ESP32)
 #include <driver/uart.h>
 #endif
 
+static void IRAM_ATTR hanLineEdge(void* arg) {
+	((HanAutodetect*) arg)->edge(micros());
+}
+
+// GPIO the HAN signal is read from, 113 is UART0 swapped to pin 13 on ESP8266
+static uint8_t hanLinePin(int8_t rxpin) {
+	return rxpin == 113 ? 13 : rxpin;
+}
+
 PassiveMeterCommunicator::PassiveMeterCommunicator(RemoteDebug* debugger) {
     this->debugger = debugger;
+    this->logger = debugger;
     bauds[0] = 2400;
     parities[0] = 11;
     inverts[0] = false;
@@ -41,11 +49,35 @@ PassiveMeterCommunicator::PassiveMeterCommunicator(RemoteDebug* debugger) {
     inverts[5] = true;
 }
 
+PassiveMeterCommunicator::~PassiveMeterCommunicator() {
+	stopLineDetect();
+	#if defined(ESP32) && defined(HAN_READER_TASK)
+	if(reader != NULL) {
+		delete reader;
+		reader = NULL;
+	}
+	#endif
+}
+
 void PassiveMeterCommunicator::configure(MeterConfig& meterConfig, Timezone* tz) {
+	// Setting up the port again loses what is being received, not needed when only the buffer size changed
+	bool samePort = hanBufferSize > 0
+		&& meterConfig.baud == this->meterConfig.baud
+		&& meterConfig.parity == this->meterConfig.parity
+		&& meterConfig.invert == this->meterConfig.invert
+		&& meterConfig.rxPin == this->meterConfig.rxPin
+		&& meterConfig.rxPinPullup == this->meterConfig.rxPinPullup
+		&& meterConfig.txPin == this->meterConfig.txPin;
+	bool resize = meterConfig.bufferSize != this->meterConfig.bufferSize;
+
     this->meterConfig = meterConfig;
     this->configChanged = false;
     this->tz = tz;
-    setupHanPort(meterConfig.baud, meterConfig.parity, meterConfig.invert);
+	if(samePort) {
+		if(resize) resizePending = true;
+	} else {
+	    setupHanPort(meterConfig.baud, meterConfig.parity, meterConfig.invert);
+	}
     if(gcmParser != NULL) {
         delete gcmParser;
         gcmParser = NULL;
@@ -53,6 +85,27 @@ void PassiveMeterCommunicator::configure(MeterConfig& meterConfig, Timezone* tz)
 }
 
 bool PassiveMeterCommunicator::loop() {
+	// Before checking for data, there is none when the line is sampled with the port set up wrong
+	handlePort();
+	return receive();
+}
+
+// Changes to the port setup that follow from what has been received, done between frames
+void PassiveMeterCommunicator::handlePort() {
+	if(hanBufferSize == 0) return;
+
+	if(autodetect) handleAutodetect(millis());
+	// Not while a segmented message is being put together in hanBuffer, resizing or setting up the port again loses it
+	if(resizePending && len == 0 && segments.getLength() == 0 && !hanSerial->available()) resizeBuffers();
+
+	#if defined(ESP32) && defined(HAN_READER_TASK)
+	// The reader task can not log, errors are handled here like the ones from HardwareSerial::onReceiveError
+	if(reader != NULL) rxerr(reader->takeError());
+	#endif
+}
+
+// Reads from the port until a frame is complete and unwrapped, the port setup is only changed through configChanged
+bool PassiveMeterCommunicator::receive() {
 	if(hanBufferSize == 0) return false;
 
 	unsigned long start, end;
@@ -68,7 +121,6 @@ bool PassiveMeterCommunicator::loop() {
 	}
 
     unsigned long now = millis();
-    if(autodetect) handleAutodetect(now);
 
 	dataAvailable = false;
 	ctx = {0,0,0,0};
@@ -76,40 +128,60 @@ bool PassiveMeterCommunicator::loop() {
     pos = DATA_PARSE_INCOMPLETE;
 	// For each byte received, check if we have a complete frame we can handle
 	start = millis();
+	unsigned long startMicros = micros();
+	// Bytes waiting in the RX buffer, the worst case per frame is what the buffer has to hold
+	uint16_t waiting = hanSerial->available();
+	if(waiting > rxPeak) rxPeak = waiting;
+
+	// Segments of a message being reassembled occupy the start of the buffer, the next frame is read after them
+	uint16_t base = segments.getLength();
 	while(hanSerial->available() && pos == DATA_PARSE_INCOMPLETE) {
 		// If buffer was overflowed, reset
 		if(len >= hanBufferSize) {
 			hanSerial->readBytes(hanBuffer, hanBufferSize);
+			if(base > 0) segmentOverflow();
+			segments.clear();
 			len = 0;
-			if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Buffer overflow, resetting\n"));
+			if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Buffer overflow, resetting\n"));
 			return false;
 		}
 		hanBuffer[len++] = hanSerial->read();
-		ctx.length = len;
-		pos = unwrapData((uint8_t *) hanBuffer, ctx);
+		framedBytes++;
+
+		// Only unwrap when the framer says the declared length has arrived
+		if(framer.append(hanBuffer+base, len-base) == DATA_PARSE_INCOMPLETE) {
+			continue;
+		}
+		ctx.length = len-base;
+		pos = unwrapData((uint8_t *) hanBuffer+base, ctx);
 		if(ctx.type > 0 && pos >= 0) {
 			switch(ctx.type) {
 				case DATA_TAG_DLMS:
-					if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Received valid DLMS at %d\n"), pos);
+					if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Received valid DLMS at %d\n"), pos);
 					break;
 				case DATA_TAG_DSMR:
-					if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Received valid DSMR at %d\n"), pos);
+					if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Received valid DSMR at %d\n"), pos);
 					break;
 				case DATA_TAG_SNRM:
-					if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Received valid SNMR at %d\n"), pos);
+					if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Received valid SNMR at %d\n"), pos);
 					break;
 				case DATA_TAG_AARE:
-					if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Received valid AARE at %d\n"), pos);
+					if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Received valid AARE at %d\n"), pos);
 					break;
 				case DATA_TAG_RES:
-					if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Received valid Get Response at %d\n"), pos);
+					if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Received valid Get Response at %d\n"), pos);
+					break;
+				case DATA_TAG_EXCEPTION:
+				case DATA_TAG_SERVICE_ERROR:
+					if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Received DLMS error response at %d\n"), pos);
 					break;
 				case DATA_TAG_HDLC:
-					if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Received valid HDLC at %d\n"), pos);
+					if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Received valid HDLC at %d\n"), pos);
 					break;
 				default:
 					// TODO: Move this so that payload is sent to MQTT
-					if (debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Unknown tag %02X at pos %d\n"), ctx.type, pos);
+					if (debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Unknown tag %02X at pos %d\n"), ctx.type, pos);
+					segments.clear();
 					len = 0;
 					return false;
 			}
@@ -117,54 +189,70 @@ bool PassiveMeterCommunicator::loop() {
 		yield();
 	}
 	end = millis();
+	framedMicros += micros() - startMicros;
 	if(end-start > 1000) {
-		if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Used %dms to unwrap HAN data\n"), end-start);
+		if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Used %dms to unwrap HAN data\n"), end-start);
+	}
+	if(pos != DATA_PARSE_INCOMPLETE) {
+		frameOccupancy.add(len);
+		rxOccupancy.add(rxPeak);
+		rxPeak = 0;
+		if(debugger->isActive(RemoteDebug::DEBUG) && framedMicros > 0) logger->printf_P(PSTR("Framed %lu bytes in %lu us (%.2f bytes/us)\n"), framedBytes, framedMicros, ((float) framedBytes) / framedMicros);
+		framedBytes = 0;
+		framedMicros = 0;
 	}
 
 	if(pos == DATA_PARSE_INCOMPLETE) {
 		return false;
 	} else if(pos == DATA_PARSE_UNKNOWN_DATA) {
-		if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Unknown data received\n"));
+		if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Unknown data received\n"));
         lastError = pos;
 		len = len + hanSerial->readBytes(hanBuffer+len, hanBufferSize-len);
 		if(debugger->isActive(RemoteDebug::VERBOSE)) {
-			debugger->printf_P(PSTR("  payload:\n"));
-			debugPrint(hanBuffer, 0, len);
+			logger->printf_P(PSTR("  payload:\n"));
+			debugPrint(hanBuffer, base, len-base);
 		}
+		segments.clear();
 		len = 0;
 		return false;
 	}
 	if(pos == DATA_PARSE_INTERMEDIATE_SEGMENT) {
-		len = 0;
+		len = segments.getLength();
 		return false;
 	} else if(pos < 0) {
         lastError = pos;
 		printHanReadError(pos);
+		if(segments.getStats().overflows != segmentOverflows) segmentOverflow();
 		len += hanSerial->readBytes(hanBuffer+len, hanBufferSize-len);
         if(pt != NULL) {
-            pt->publishBytes(hanBuffer, len);
+            pt->publishBytes(hanBuffer+base, len-base);
         }
 		if(debugger->isActive(RemoteDebug::VERBOSE)) {
-			debugger->printf_P(PSTR("  payload:\n"));
-			debugPrint(hanBuffer, 0, len);
+			logger->printf_P(PSTR("  payload:\n"));
+			debugPrint(hanBuffer, base, len-base);
 		}
 		while(hanSerial->available()) hanSerial->read(); // Make sure it is all empty, in case we overflowed buffer above
+		segments.clear();
 		len = 0;
 		return false;
 	}
 
 	if(ctx.type == 0) {
-		if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Ended up with context type %d, return code %d and length: %lu/%lu\n"), ctx.type, pos, ctx.length, len);
+		if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Ended up with context type %d, return code %d and length: %lu/%lu\n"), ctx.type, pos, ctx.length, len);
         lastError = pos;
 		len = len + hanSerial->readBytes(hanBuffer+len, hanBufferSize-len);
 		if(debugger->isActive(RemoteDebug::VERBOSE)) {
-			debugger->printf_P(PSTR("  payload:\n"));
-			debugPrint(hanBuffer, 0, len);
+			logger->printf_P(PSTR("  payload:\n"));
+			debugPrint(hanBuffer, base, len-base);
 		}
+		segments.clear();
 		len = 0;
 		return false;
 	}
 
+	// A complete message in the middle of a segmented one means the rest of that one is lost
+	segments.clear();
+
 	// Data is valid, clear the rest of the buffer to avoid tainted parsing
 	for(int i = pos+ctx.length; i<hanBufferSize; i++) {
 		hanBuffer[i] = 0x00;
@@ -172,96 +260,76 @@ bool PassiveMeterCommunicator::loop() {
     dataAvailable = true;
 	lastError = DATA_PARSE_OK;
 
-	// After one hour, adjust buffer size to match the largest payload
-	if(!maxDetectPayloadDetectDone && now > 3600000) {
-		if(maxDetectedPayloadSize * 1.25 > meterConfig.bufferSize * 64) {
-			int bufferSize = min((double) 64, ceil((maxDetectedPayloadSize * 1.25) / 64));
-			#if defined(ESP8266)
-				if(meterConfig.rxPin != 3 && meterConfig.rxPin != 113) {
-					bufferSize = min(bufferSize, 2);
-				} else {
-					bufferSize = min(bufferSize, 8);
-				}
-			#endif
-			if(bufferSize != meterConfig.bufferSize) {
-				if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Increasing RX buffer to %d bytes\n"), meterConfig.bufferSize * 64);
-				meterConfig.bufferSize = bufferSize;
-            	configChanged = true;
-			}
-		}
-		maxDetectPayloadDetectDone = true;
-	}
+	checkBufferSize(now);
 
     return true;
 }
 
-AmsData* PassiveMeterCommunicator::getData(AmsData& meterState) {
-    if(!dataAvailable) return NULL;
+// Decodes into the caller's data, returns false when there was nothing to decode
+bool PassiveMeterCommunicator::getData(AmsData& meterState, AmsData& data) {
+    if(!dataAvailable) return false;
 	if(ctx.length > hanBufferSize) {
-        debugger->printf_P(PSTR("Invalid context length\n"));
+        logger->printf_P(PSTR("Invalid context length\n"));
 		dataAvailable = false;
-		return NULL;
+		return false;
 	}
     
-    AmsData* data = NULL;
+    bool decoded = false;
 	char* payload = ((char *) (hanBuffer)) + pos;
-	if(maxDetectedPayloadSize < pos) maxDetectedPayloadSize = pos;
 	if(ctx.type == DATA_TAG_DLMS) {
         if(pt != NULL) {
             pt->publishBytes((uint8_t*) payload, ctx.length);
         }
 
-		if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("Using application data:\n"));
+		if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("Using application data:\n"));
 		if(debugger->isActive(RemoteDebug::VERBOSE)) debugPrint((byte*) payload, 0, ctx.length);
 
-		// Rudimentary detector for L&G proprietary format, this is terrible code... Fix later
-		if(payload[0] == CosemTypeStructure && payload[2] == CosemTypeArray && payload[1] == payload[3]) {
-			if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("LNG\n"));
-			LNG lngData = LNG(meterState, payload, meterState.getMeterType(), &meterConfig, ctx, debugger);
-			if(lngData.getListType() >= 1) {
-				data = new AmsData();
-				data->apply(meterState);
-				data->apply(lngData);
-			}
-		} else if(payload[0] == CosemTypeStructure && 
-			payload[2] == CosemTypeLongUnsigned && 
-			payload[5] == CosemTypeLongUnsigned && 
-			payload[8] == CosemTypeLongUnsigned && 
-			payload[11] == CosemTypeLongUnsigned && 
-			payload[14] == CosemTypeLongUnsigned && 
-			payload[17] == CosemTypeLongUnsigned
-		) {
-			if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("LNG2\n"));
-			LNG2 lngData = LNG2(meterState, payload, meterState.getMeterType(), &meterConfig, ctx, debugger);
-			if(lngData.getListType() >= 1) {
-				data = new AmsData();
-				data->apply(meterState);
-				data->apply(lngData);
+		uint16_t length = ctx.length > 0 && ctx.length < 900 ? ctx.length : 900;
+		CompactProfileLayout* layout = NULL;
+		if(payload[0] == CosemTypeStructure) {
+			if(compactProfiles == NULL) compactProfiles = new CompactProfileCache();
+			layout = compactProfiles->load((uint8_t*) payload, length);
+		}
+		if(layout != NULL) {
+			if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("Compact profile\n"));
+			if(layout->hits == 0 && debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("New compact profile %08X with %d values\n"), layout->fingerprint, layout->count);
+			CompactProfile profileData = CompactProfile(meterState, (uint8_t*) payload, *layout, ctx);
+			if(profileData.getListType() >= 1) {
+				data = AmsData();
+				data.apply(meterState);
+				data.apply(profileData);
+				decoded = true;
 			}
 		} else {
-			if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("DLMS\n"));
+			if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("DLMS\n"));
+			if(cosemLayouts == NULL) cosemLayouts = new CosemLayoutCache();
+			CosemIndex* index = cosemLayouts->load(payload, length);
+			if(index->getHits() == 0 && debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("New COSEM layout %08X with %d items\n"), index->getFingerprint(), index->getItemCount());
+
 			// TODO: Split IEC6205675 into DataParserKaifa and DataParserObis. This way we can add other means of parsing, for those other proprietary formats
-			data = new IEC6205675(payload, meterState.getMeterType(), &meterConfig, ctx, meterState);
+			data = IEC6205675(payload, meterState.getMeterType(), &meterConfig, ctx, meterState, index);
+			decoded = true;
 		}
 	} else if(ctx.type == DATA_TAG_DSMR) {
-		data = new IEC6205621(payload, tz, &meterConfig);
+		data = IEC6205621(payload, tz, &meterConfig);
+		decoded = true;
 	}
 	len = 0;
-    if(data != NULL) {
-        if(data->getListType() > 0) {
+    if(decoded) {
+        if(data.getListType() > 0) {
             validDataReceived = true;
             if(rxBufferErrors > 0) rxBufferErrors--;
         }
     }
 	dataAvailable = false;
-    return data;
+    return decoded;
 }
 
 int PassiveMeterCommunicator::getLastError() {
 	#if defined ESP8266
 	if(hwSerial != NULL) {
 		if(hwSerial->hasRxError()) {
-			if(debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Serial RX error\n"));
+			if(debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Serial RX error\n"));
 			lastError = 96;
 		}
 		if(hwSerial->hasOverrun()) {
@@ -285,10 +353,11 @@ void PassiveMeterCommunicator::getCurrentConfig(MeterConfig& meterConfig) {
 }
 
 
+// Returns the position of the payload relative to the start of hanBuffer, or a negative error code
 int16_t PassiveMeterCommunicator::unwrapData(uint8_t *buf, DataParserContext &context) {
-	int16_t ret = 0;
+	int16_t ret = buf - hanBuffer;
 	bool doRet = false;
-	uint16_t end = hanBufferSize;
+	uint16_t end = hanBufferSize - ret;
 	uint8_t tag = (*buf);
 	uint8_t lastTag = DATA_TAG_NONE;
 	while(tag != DATA_TAG_NONE) {
@@ -296,16 +365,16 @@ int16_t PassiveMeterCommunicator::unwrapData(uint8_t *buf, DataParserContext &co
 		int8_t res = 0;
 		switch(tag) {
 			case DATA_TAG_HDLC:
-				if(hdlcParser == NULL) hdlcParser = new HDLCParser();
+				if(hdlcParser == NULL) hdlcParser = new HDLCParser(&segments);
 				res = hdlcParser->parse(buf, context);
 				if(context.length < 3) doRet = true;
 				break;
 			case DATA_TAG_MBUS:
-				if(mbusParser == NULL) mbusParser =  new MBUSParser();
+				if(mbusParser == NULL) mbusParser =  new MBUSParser(&segments);
 				res = mbusParser->parse(buf, context);
 				break;
 			case DATA_TAG_GBT:
-				if(gbtParser == NULL) gbtParser = new GBTParser();
+				if(gbtParser == NULL) gbtParser = new GBTParser(&segments);
 				res = gbtParser->parse(buf, context);
 				break;
 			case DATA_TAG_GCM:
@@ -322,18 +391,20 @@ int16_t PassiveMeterCommunicator::unwrapData(uint8_t *buf, DataParserContext &co
 				if(res >= 0) doRet = true;
 				break;
 			case DATA_TAG_DSMR:
-				if(dsmrParser == NULL) dsmrParser = new DSMRParser();
-				res = dsmrParser->parse(buf, context, lastTag != DATA_TAG_NONE);
+				// Same parser the framer has been feeding, a standalone telegram is already scanned
+				res = framer.getDSMRParser()->parse(buf, context, lastTag != DATA_TAG_NONE);
 				if(res >= 0) doRet = true;
 				break;
 			case DATA_TAG_SNRM:
 			case DATA_TAG_AARE:
 			case DATA_TAG_RES:
+			case DATA_TAG_EXCEPTION:
+			case DATA_TAG_SERVICE_ERROR:
 				res = DATA_PARSE_OK;
 				doRet = true;
 				break;
 			default:
-				if (debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Ended up in default case while unwrapping...(tag %02X)\n"), tag);
+				if (debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Ended up in default case while unwrapping...(tag %02X)\n"), tag);
 				return DATA_PARSE_UNKNOWN_DATA;
 		}
 		lastTag = tag;
@@ -341,57 +412,64 @@ int16_t PassiveMeterCommunicator::unwrapData(uint8_t *buf, DataParserContext &co
 			return res;
 		}
 		if(context.length > end) {
-			if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("Context length %lu > %lu:\n"), context.length, end);
+			if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("Context length %lu > %lu:\n"), context.length, end);
 			context.type = 0;
 			context.length = 0;
 			return false;
 		}
         switch(tag) {
             case DATA_TAG_HDLC:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("HDLC frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("HDLC frame:\n"));
                 if(pt != NULL) {
                     pt->publishBytes(buf, curLen);
                 }
                 break;
             case DATA_TAG_MBUS:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("MBUS frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("MBUS frame:\n"));
                 if(pt != NULL) {
                     pt->publishBytes(buf, curLen);
                 }
                 break;
             case DATA_TAG_GBT:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("GBT frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("GBT frame:\n"));
                 break;
             case DATA_TAG_GCM:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("GCM frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("GCM frame:\n"));
                 break;
             case DATA_TAG_LLC:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("LLC frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("LLC frame:\n"));
                 break;
             case DATA_TAG_DLMS:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("DLMS frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("DLMS frame:\n"));
                 break;
             case DATA_TAG_DSMR:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("DSMR frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("DSMR frame:\n"));
                 if(pt != NULL) {
                     pt->publishString((char*) buf);
                 }
                 break;
 			case DATA_TAG_SNRM:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("SNMR frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("SNMR frame:\n"));
                 break;
 			case DATA_TAG_AARE:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("AARE frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("AARE frame:\n"));
                 break;
 			case DATA_TAG_RES:
-                if(debugger->isActive(RemoteDebug::VERBOSE)) debugger->printf_P(PSTR("RES frame:\n"));
+                if(debugger->isActive(RemoteDebug::VERBOSE)) logger->printf_P(PSTR("RES frame:\n"));
                 break;
         }
         if(debugger->isActive(RemoteDebug::VERBOSE)) debugPrint(buf, 0, curLen);
 		if(res == DATA_PARSE_FINAL_SEGMENT) {
-			if(tag == DATA_TAG_MBUS) {
-				res = mbusParser->write(buf, context);
-			}
+			// The reassembled message is at the start of hanBuffer, continue unwrapping from there
+			context.length = segments.finish();
+			buf = segments.getData();
+			end = hanBufferSize;
+			ret = 0;
+			res = 0;
+			// Decided by the whole message, the last segment can be shorter than an LLC header
+			doRet = context.length < 3;
+			SegmentArenaStats& stats = segments.getStats();
+			if(debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Reassembled %lu bytes, %lu messages, max %u bytes in %u segments, %u gaps, %u overflows, %u dropped\n"), context.length, stats.messages, stats.maxLength, stats.maxSegments, stats.gaps, stats.overflows, stats.dropped);
 		}
 
 		if(res < 0) {
@@ -410,61 +488,61 @@ int16_t PassiveMeterCommunicator::unwrapData(uint8_t *buf, DataParserContext &co
 		// Use start byte of new buffer position as tag for next round in loop
 		tag = (*buf);
 	}
-	if(debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Got to end of unwrap method...\n"));
+	if(debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Got to end of unwrap method...\n"));
 	return DATA_PARSE_UNKNOWN_DATA;
 }
 
 void PassiveMeterCommunicator::debugPrint(byte *buffer, int start, int length) {
 	for (int i = start; i < start + length; i++) {
 		if (buffer[i] < 0x10)
-			debugger->print(F("0"));
-		debugger->print(buffer[i], HEX);
-		debugger->print(F(" "));
+			logger->print(F("0"));
+		logger->print(buffer[i], HEX);
+		logger->print(F(" "));
 		if ((i - start + 1) % 16 == 0)
-			debugger->println(F(""));
+			logger->println(F(""));
 		else if ((i - start + 1) % 4 == 0)
-			debugger->print(F(" "));
+			logger->print(F(" "));
 
 		yield(); // Let other get some resources too
 	}
-	debugger->println(F(""));
+	logger->println(F(""));
 }
 
 void PassiveMeterCommunicator::printHanReadError(int pos) {
 	if(debugger->isActive(RemoteDebug::WARNING)) {
 		switch(pos) {
 			case DATA_PARSE_BOUNDRY_FLAG_MISSING:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Boundry flag missing\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Boundry flag missing\n"));
 				break;
 			case DATA_PARSE_HEADER_CHECKSUM_ERROR:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Header checksum error\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Header checksum error\n"));
 				break;
 			case DATA_PARSE_FOOTER_CHECKSUM_ERROR:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Frame checksum error\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Frame checksum error\n"));
 				break;
 			case DATA_PARSE_INCOMPLETE:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Received frame is incomplete\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Received frame is incomplete\n"));
 				break;
 			case GCM_AUTH_FAILED:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Decrypt authentication failed\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Decrypt authentication failed\n"));
 				break;
 			case GCM_ENCRYPTION_KEY_FAILED:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Setting decryption key failed\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Setting decryption key failed\n"));
 				break;
 			case GCM_DECRYPT_FAILED:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Decryption failed\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Decryption failed\n"));
 				break;
 			case MBUS_FRAME_LENGTH_NOT_EQUAL:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Frame length mismatch\n"));
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Frame length mismatch\n"));
 				break;
 			case DATA_PARSE_INTERMEDIATE_SEGMENT:
-				if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Intermediate segment received\n"));
+				if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Intermediate segment received\n"));
 				break;
 			case DATA_PARSE_UNKNOWN_DATA:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Unknown data format %02X\n"), hanBuffer[0]);
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Unknown data format %02X\n"), hanBuffer[0]);
 				break;
 			default:
-				if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Unspecified error while reading data: %d\n"), pos);
+				if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Unspecified error while reading data: %d\n"), pos);
 		}
 	}
 }
@@ -473,12 +551,15 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 	int8_t rxpin = meterConfig.rxPin;
 	int8_t txpin = meterConfig.txPin;
 
-	if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("(setupHanPort) Setting up HAN on pin %d/%d with baud %d and parity %d\n"), rxpin, txpin, baud, parityOrdinal);
+	if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("(setupHanPort) Setting up HAN on pin %d/%d with baud %d and parity %d\n"), rxpin, txpin, baud, parityOrdinal);
 
-	if(baud == 0) {
-		baud = bauds[meterAutoIndex];
-		parityOrdinal = parities[meterAutoIndex];
-		invert = inverts[meterAutoIndex];
+	stopLineDetect();
+	bool detect = baud == 0;
+	if(detect) {
+		autodetect = true;
+		baud = autoBaud = bauds[meterAutoIndex];
+		parityOrdinal = autoParity = parities[meterAutoIndex];
+		invert = autoInvert = inverts[meterAutoIndex];
 	}
 	if(parityOrdinal == 0) {
 		parityOrdinal = 3; // 8N1
@@ -505,7 +586,7 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 	#endif
 
 	if(rxpin == 0) {
-		if (debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Invalid GPIO configured for HAN\n"));
+		if (debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Invalid GPIO configured for HAN\n"));
 		return;
 	}
 
@@ -513,7 +594,7 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 	if(meterConfig.bufferSize > 64) meterConfig.bufferSize = 64;
 
 	if(hwSerial != NULL) {
-		if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Hardware serial\n"));
+		if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Hardware serial\n"));
 		Serial.flush();
 		#if defined(ESP8266)
 			SerialConfig serialConfig;
@@ -539,20 +620,26 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 		}
 		if(meterConfig.bufferSize < 4) meterConfig.bufferSize = 4; // 64 bytes (1) is default for software serial, 256 bytes (4) for hardware
 
-		hwSerial->setRxBufferSize(64 * meterConfig.bufferSize);
-		#if defined(ESP32)
+		#if defined(ESP32) && defined(HAN_READER_TASK)
+			if(reader == NULL) reader = new HanUartReader();
+			if(!reader->begin((uart_port_t) uart_num, baud, serialConfig, rxpin, txpin, invert, 64 * meterConfig.bufferSize, max(64 * meterConfig.bufferSize * 2, 512))) {
+				if (debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Unable to start HAN reader task\n"));
+			}
+		#elif defined(ESP32)
+			hwSerial->setRxBufferSize(64 * meterConfig.bufferSize);
 			hwSerial->begin(baud, serialConfig, -1, -1, invert);
 			uart_set_pin(uart_num, txpin, rxpin, -1, -1);
 		#else
+			hwSerial->setRxBufferSize(64 * meterConfig.bufferSize);
 			hwSerial->begin(baud, serialConfig, SERIAL_FULL, 1, invert);
 		#endif
 		
 		#if defined(ESP8266)
 			if(rxpin == 3) {
-				if(debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Switching UART0 to pin 1 & 3\n"));
+				if(debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Switching UART0 to pin 1 & 3\n"));
 				Serial.pins(1,3);
 			} else if(rxpin == 113) {
-				if(debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Switching UART0 to pin 15 & 13\n"));
+				if(debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Switching UART0 to pin 15 & 13\n"));
 				Serial.pins(15,13);
 			}
 		#endif
@@ -574,7 +661,11 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 			}
 		#endif
 
-		hanSerial = hwSerial;
+		#if defined(ESP32) && defined(HAN_READER_TASK)
+			hanSerial = reader;
+		#else
+			hanSerial = hwSerial;
+		#endif
 		#if defined(ESP8266)
 		if(swSerial != NULL) {
 			swSerial->end();
@@ -584,7 +675,7 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 		#endif
 	} else {
 		#if defined(ESP8266)
-			if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Software serial\n"));
+			if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Software serial\n"));
 			Serial.flush();
 			
 			if(swSerial == NULL) {
@@ -616,7 +707,7 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 			#if defined(ESP8266)
 			if(bufferSize > 2) bufferSize = 2;
 			#endif
-			if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Using serial buffer size %d\n"), 64 * bufferSize);
+			if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Using serial buffer size %d\n"), 64 * bufferSize);
 			swSerial->begin(baud, serialConfig, rxpin, txpin, invert, meterConfig.bufferSize * 64);
 			hanSerial = swSerial;
 
@@ -624,7 +715,7 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 			Serial.begin(115200);
 			hwSerial = NULL;
 		#else
-			if (debugger->isActive(RemoteDebug::DEBUG)) debugger->printf_P(PSTR("Software serial not available\n"));
+			if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Software serial not available\n"));
 			return;
 		#endif
 	}
@@ -634,10 +725,13 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 	}
 	hanBufferSize = max(64 * meterConfig.bufferSize * 2, 512);
 	hanBuffer = (uint8_t*) malloc(hanBufferSize);
+	resizePending = false;
+	segments.begin(hanBuffer, hanBufferSize);
+	len = 0;
 
 	// The library automatically sets the pullup in Serial.begin()
 	if(!meterConfig.rxPinPullup) {
-		if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("HAN pin pullup disabled\n"));
+		if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("HAN pin pullup disabled\n"));
 		pinMode(meterConfig.rxPin, INPUT);
 	}
 
@@ -654,33 +748,140 @@ void PassiveMeterCommunicator::setupHanPort(uint32_t baud, uint8_t parityOrdinal
 		swSerial->overflow();
 	}
 	#endif
+
+	// Software serial uses the pin change interrupt itself
+	if(detect && hwSerial != NULL) startLineDetect();
+}
+
+// Bytes in the port, a frame the reader task is receiving or part of a frame or message in hanBuffer
+bool PassiveMeterCommunicator::isBusy() {
+	if(hanBufferSize == 0) return false;
+	#if defined(ESP32) && defined(HAN_READER_TASK)
+	if(reader != NULL && reader->isReceiving()) return true;
+	#endif
+	return len > 0 || segments.getLength() > 0 || hanSerial->available() > 0;
+}
+
+void PassiveMeterCommunicator::setLogOutput(Print* logger) {
+	this->logger = logger == NULL ? debugger : logger;
 }
 
 HardwareSerial* PassiveMeterCommunicator::getHwSerial() {
+	#if defined(ESP32) && defined(HAN_READER_TASK)
+	// The UART is owned by the reader task, there is no HardwareSerial to attach an error handler to
+	return NULL;
+	#else
     return hwSerial;
+	#endif
+}
+
+// A segmented message did not fit in hanBuffer, grow it the same way as for serial buffer overflows
+void PassiveMeterCommunicator::segmentOverflow() {
+	segmentOverflows = segments.getStats().overflows;
+	if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Segmented message does not fit in %d byte buffer\n"), hanBufferSize);
+	rxerr(2);
+}
+
+SegmentArenaStats& PassiveMeterCommunicator::getSegmentStats() {
+	return segments.getStats();
+}
+
+BufferOccupancy& PassiveMeterCommunicator::getRxOccupancy() {
+	return rxOccupancy;
+}
+
+BufferOccupancy& PassiveMeterCommunicator::getFrameOccupancy() {
+	return frameOccupancy;
+}
+
+// Sizes the RX buffer to the worst case seen plus a margin, over two windows so one quiet hour does not shrink it
+void PassiveMeterCommunicator::checkBufferSize(unsigned long now) {
+	if(now - lastBufferCheck < HAN_BUFFER_CHECK_INTERVAL) return;
+	lastBufferCheck = now;
+
+	uint16_t rx = rxOccupancy.nextWindow();
+	uint16_t frame = frameOccupancy.nextWindow();
+	uint16_t worstRx = max(rx, lastRxWindowMax);
+	uint16_t worstFrame = max(frame, lastFrameWindowMax);
+	lastRxWindowMax = rx;
+	lastFrameWindowMax = frame;
+	if(worstRx == 0 && worstFrame == 0) return;
+
+	// hanBuffer is twice the RX buffer, it has to hold the largest frame
+	uint16_t worst = max(worstRx, (uint16_t) ((worstFrame + 1) / 2));
+	int bufferSize = ceil((worst * 1.25) / 64);
+	#if defined(ESP8266)
+		if(meterConfig.rxPin != 3 && meterConfig.rxPin != 113) {
+			bufferSize = min(bufferSize, 2);
+		} else {
+			bufferSize = min(bufferSize, 8);
+		}
+	#endif
+	if(hwSerial != NULL) bufferSize = max(bufferSize, 4); // Same minimum as in setupHanPort()
+	bufferSize = max(min(bufferSize, 64), 1);
+
+	if(bufferSize != meterConfig.bufferSize) {
+		if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Resizing RX buffer from %d to %d bytes, worst case seen was %d bytes waiting and %d byte frames\n"), meterConfig.bufferSize * 64, bufferSize * 64, worstRx, worstFrame);
+		meterConfig.bufferSize = bufferSize;
+		// configure() gets this size back and sees no change, so the resize is asked for here
+		resizePending = true;
+		configChanged = true;
+	}
+}
+
+// Applies a new buffer size between frames, configure() skips setting up the port when nothing else changed
+void PassiveMeterCommunicator::resizeBuffers() {
+	resizePending = false;
+	if(meterConfig.bufferSize < 1) meterConfig.bufferSize = 1;
+	if(meterConfig.bufferSize > 64) meterConfig.bufferSize = 64;
+	if(hwSerial != NULL && meterConfig.bufferSize < 4) meterConfig.bufferSize = 4;
+
+	#if defined(ESP8266)
+	if(hwSerial != NULL) {
+		// The UART ring is resized in place, with what is in it
+		hwSerial->setRxBufferSize(64 * meterConfig.bufferSize);
+
+		uint16_t size = max(64 * meterConfig.bufferSize * 2, 512);
+		if(size == hanBufferSize) return;
+		uint8_t* buf = (uint8_t*) realloc(hanBuffer, size);
+		if(buf == NULL) {
+			if (debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Unable to resize HAN buffer to %d bytes\n"), size);
+			return;
+		}
+		hanBuffer = buf;
+		hanBufferSize = size;
+		segments.begin(hanBuffer, hanBufferSize);
+		if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Resized RX buffer to %d bytes and HAN buffer to %d bytes\n"), 64 * meterConfig.bufferSize, hanBufferSize);
+		return;
+	}
+	#endif
+
+	// Software serial and the IDF driver only take a new buffer size when started again, done here where no frame is lost
+	setupHanPort(meterConfig.baud, meterConfig.parity, meterConfig.invert);
 }
 
 void PassiveMeterCommunicator::rxerr(int err) {
 	if(err == 0) return;
 	switch(err) {
 		case 2:
-			if (debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Serial buffer overflow\n"));
+			if (debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Serial buffer overflow\n"));
 			rxBufferErrors++;
 			if(rxBufferErrors > 3 && meterConfig.bufferSize < 64) {
 				meterConfig.bufferSize += 2;
-				if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Increasing RX buffer to %d bytes\n"), meterConfig.bufferSize * 64);
+				if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Increasing RX buffer to %d bytes\n"), meterConfig.bufferSize * 64);
+				resizePending = true;
                 configChanged = true;
 				rxBufferErrors = 0;
 			}
 			break;
 		case 3:
-			if (debugger->isActive(RemoteDebug::ERROR)) debugger->printf_P(PSTR("Serial FIFO overflow\n"));
+			if (debugger->isActive(RemoteDebug::ERROR)) logger->printf_P(PSTR("Serial FIFO overflow\n"));
 			break;
 		case 4:
-			if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Serial frame error\n"));
+			if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Serial frame error\n"));
 			break;
 		case 5:
-			if (debugger->isActive(RemoteDebug::WARNING)) debugger->printf_P(PSTR("Serial parity error\n"));
+			if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Serial parity error\n"));
 			break;
 	}
 	// Do not include serial break
@@ -691,21 +892,78 @@ void PassiveMeterCommunicator::handleAutodetect(unsigned long now) {
     if(!autodetect) return;
 
 	if(!validDataReceived) {
+		if(lineDetect != NULL && handleLineDetect(now)) return;
+
 		if(now - meterAutodetectLastChange > 20000 && (meterConfig.baud == 0 || meterConfig.parity == 0)) {
 			autodetect = true;
 			meterAutoIndex++; // Default is to try the first one in setup()
-			if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Meter serial autodetect, swapping to: %d, %d, %s\n"), bauds[meterAutoIndex], parities[meterAutoIndex], inverts[meterAutoIndex] ? "true" : "false");
 			if(meterAutoIndex >= 6) meterAutoIndex = 0;
-			setupHanPort(bauds[meterAutoIndex], parities[meterAutoIndex], inverts[meterAutoIndex]);
+			autoBaud = bauds[meterAutoIndex];
+			autoParity = parities[meterAutoIndex];
+			autoInvert = inverts[meterAutoIndex];
+			if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Meter serial autodetect, swapping to: %d, %d, %s\n"), autoBaud, autoParity, autoInvert ? "true" : "false");
+			setupHanPort(autoBaud, autoParity, autoInvert);
 			meterAutodetectLastChange = now;
 		}
 	} else if(autodetect) {
-		if (debugger->isActive(RemoteDebug::INFO)) debugger->printf_P(PSTR("Meter serial autodetected, saving: %d, %d, %s\n"), bauds[meterAutoIndex], parities[meterAutoIndex], inverts[meterAutoIndex] ? "true" : "false");
+		if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Meter serial autodetected, saving: %d, %d, %s\n"), autoBaud, autoParity, autoInvert ? "true" : "false");
 		autodetect = false;
-		meterConfig.baud = bauds[meterAutoIndex];
-		meterConfig.parity = parities[meterAutoIndex];
-		meterConfig.invert = inverts[meterAutoIndex];
+		meterConfig.baud = autoBaud;
+		meterConfig.parity = autoParity;
+		meterConfig.invert = autoInvert;
 		configChanged = true;
 		setupHanPort(meterConfig.baud, meterConfig.parity, meterConfig.invert);
 	}
 }
+
+void PassiveMeterCommunicator::startLineDetect() {
+	if(lineDetect == NULL) lineDetect = new HanAutodetect();
+	lineDetect->reset();
+	lineDetectStart = millis();
+	lineDetectAttempts = 0;
+	attachInterruptArg(digitalPinToInterrupt(hanLinePin(meterConfig.rxPin)), hanLineEdge, lineDetect, CHANGE);
+}
+
+void PassiveMeterCommunicator::stopLineDetect() {
+	if(lineDetect == NULL) return;
+	detachInterrupt(digitalPinToInterrupt(hanLinePin(meterConfig.rxPin)));
+	delete lineDetect;
+	lineDetect = NULL;
+}
+
+// Returns true while the line is being sampled, trying each setup in turn waits for it
+bool PassiveMeterCommunicator::handleLineDetect(unsigned long now) {
+	uint16_t edges = lineDetect->getEdgeCount();
+	if(edges == 0) {
+		if(now - lineDetectStart < 30000) return true;
+		if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("No signal seen on HAN pin, trying each serial setup instead\n"));
+		stopLineDetect();
+		return false;
+	}
+
+	// Analyze when the meter has finished sending, so the idle level can be read
+	if(micros() - lineDetect->getLastEdge() < 20000) return true;
+
+	HanAutodetectResult res;
+	if(lineDetect->analyze(digitalRead(hanLinePin(meterConfig.rxPin)) == HIGH, res)) {
+		if (debugger->isActive(RemoteDebug::INFO)) logger->printf_P(PSTR("Meter serial detected from %d edges: %d, %d, %s (%d characters, %d errors)\n"), edges, res.baud, res.parity, res.invert ? "true" : "false", res.bytes, res.errors);
+		stopLineDetect();
+		autoBaud = res.baud;
+		autoParity = res.parity;
+		autoInvert = res.invert;
+		setupHanPort(autoBaud, autoParity, autoInvert);
+		// Falls back to trying each setup if no valid data is received with this one
+		meterAutodetectLastChange = now;
+		return true;
+	}
+
+	if(++lineDetectAttempts >= 5) {
+		if (debugger->isActive(RemoteDebug::WARNING)) logger->printf_P(PSTR("Unable to detect meter serial setup from %d edges, trying each serial setup instead\n"), edges);
+		stopLineDetect();
+		return false;
+	}
+	if (debugger->isActive(RemoteDebug::DEBUG)) logger->printf_P(PSTR("Unable to detect meter serial setup from %d edges, waiting for next transmission\n"), edges);
+	lineDetect->reset();
+	lineDetectStart = now;
+	return true;
+}
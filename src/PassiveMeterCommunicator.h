@@ -13,27 +13,47 @@
 #include "DataParsers.h"
 #include "Timezone.h"
 #include "PassthroughMqttHandler.h"
+#include "HanAutodetect.h"
+#include "BufferOccupancy.h"
+#include "CompactProfile.h"
 
 #if defined(ESP8266)
 #include "SoftwareSerial.h"
 #endif
 
+#define HAN_BUFFER_CHECK_INTERVAL 3600000
+#if defined(ESP32) && defined(HAN_READER_TASK)
+#include "HanUartReader.h"
+#endif
+
 class PassiveMeterCommunicator : public MeterCommunicator  {
 public:
     PassiveMeterCommunicator(RemoteDebug* debugger);
+    ~PassiveMeterCommunicator();
     void configure(MeterConfig&, Timezone*);
     bool loop();
-    AmsData* getData(AmsData& meterState);
+    // loop() is handlePort() followed by receive(), split for when receive() and getData() run in another task
+    void handlePort();
+    bool receive();
+    bool getData(AmsData& meterState, AmsData& data);
     int getLastError();
     bool isConfigChanged();
     void getCurrentConfig(MeterConfig& meterConfig);
     void setPassthroughMqttHandler(PassthroughMqttHandler*);
+    // Where messages are printed, the level is still taken from the debugger
+    void setLogOutput(Print* logger);
+    bool isBusy();
 
+    // NULL when the port is not a HardwareSerial, like with the HAN reader task, use isBusy() to see if data is coming
     HardwareSerial* getHwSerial();
     void rxerr(int err);
+    SegmentArenaStats& getSegmentStats();
+    BufferOccupancy& getRxOccupancy();
+    BufferOccupancy& getFrameOccupancy();
 
 protected:
     RemoteDebug* debugger = NULL;
+    Print* logger = NULL;
     MeterConfig meterConfig;
     bool configChanged = false;
     Timezone* tz;
@@ -47,6 +67,9 @@ protected:
     SoftwareSerial *swSerial = NULL;
     #endif
     HardwareSerial *hwSerial = NULL;
+    #if defined(ESP32) && defined(HAN_READER_TASK)
+    HanUartReader *reader = NULL;
+    #endif
     uint8_t rxBufferErrors = 0;
 
     bool autodetect = false, validDataReceived = false;
@@ -55,15 +78,31 @@ protected:
     uint32_t bauds[6];
     uint8_t parities[6];
     bool inverts[6];
+    uint32_t autoBaud = 0;
+    uint8_t autoParity = 0;
+    bool autoInvert = false;
+    HanAutodetect *lineDetect = NULL;
+    unsigned long lineDetectStart = 0;
+    uint8_t lineDetectAttempts = 0;
 
     bool dataAvailable = false;
     int len = 0;
     int pos = DATA_PARSE_INCOMPLETE;
     int lastError = DATA_PARSE_OK;
     bool serialInit = false;
-    bool maxDetectPayloadDetectDone = false;
-    uint8_t maxDetectedPayloadSize = 64;
+    BufferOccupancy rxOccupancy;
+    BufferOccupancy frameOccupancy;
+    uint16_t rxPeak = 0;
+    uint16_t lastRxWindowMax = 0;
+    uint16_t lastFrameWindowMax = 0;
+    unsigned long lastBufferCheck = 0;
+    bool resizePending = false;
     DataParserContext ctx = {0,0,0,0};
+    DataFramer framer;
+    SegmentArena segments;
+    uint16_t segmentOverflows = 0;
+    uint32_t framedBytes = 0;
+    unsigned long framedMicros = 0;
 
     HDLCParser *hdlcParser = NULL;
     MBUSParser *mbusParser = NULL;
@@ -71,13 +110,20 @@ protected:
     GCMParser *gcmParser = NULL;
     LLCParser *llcParser = NULL;
     DLMSParser *dlmsParser = NULL;
-    DSMRParser *dsmrParser = NULL;
+    CosemLayoutCache *cosemLayouts = NULL;
+    CompactProfileCache *compactProfiles = NULL;
 
     void setupHanPort(uint32_t baud, uint8_t parityOrdinal, bool invert);
     int16_t unwrapData(uint8_t *buf, DataParserContext &context);
     void debugPrint(byte *buffer, int start, int length);
     void printHanReadError(int pos);
+    void segmentOverflow();
+    void checkBufferSize(unsigned long now);
+    void resizeBuffers();
     void handleAutodetect(unsigned long now);
+    void startLineDetect();
+    void stopLineDetect();
+    bool handleLineDetect(unsigned long now);
 };
 
 #endif
@@ -16,17 +16,17 @@ bool PulseMeterCommunicator::loop() {
     return updated || !initialized;
 }
 
-AmsData* PulseMeterCommunicator::getData(AmsData& meterState) {
+bool PulseMeterCommunicator::getData(AmsData& meterState, AmsData& data) {
     if(!initialized) {
         state.apply(meterState);
         initialized = true;
-        return NULL;
+        return false;
     }
     updated = false;
 
-    AmsData* ret = new AmsData();
-    ret->apply(state);
-    return ret;
+    data = AmsData();
+    data.apply(state);
+    return true;
 }
 
 int PulseMeterCommunicator::getLastError() {
@@ -18,7 +18,7 @@ public:
     PulseMeterCommunicator(RemoteDebug* debugger);
     void configure(MeterConfig& config, Timezone* tz);
     bool loop();
-    AmsData* getData(AmsData& meterState);
+    bool getData(AmsData& meterState, AmsData& data);
     int getLastError();
     bool isConfigChanged();
     void getCurrentConfig(MeterConfig& meterConfig);
@@ -0,0 +1,107 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// A serial port for the communicators made from the pseudo-terminal of scripts/hansim.py, which is started here
+#pragma once
+#include "Arduino.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+
+class PtyStream : public Stream {
+public:
+    ~PtyStream() {
+        close();
+    }
+
+    // Runs the simulator with a link to its pseudo-terminal and opens it, false if it did not show up in time
+    bool start(const std::vector<std::string>& args) {
+        static int count = 0;
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/hansim-%d-%d", (int) getpid(), ++count);
+        std::vector<std::string> cmd = { "python3", "scripts/hansim.py", "--link", path };
+        cmd.insert(cmd.end(), args.begin(), args.end());
+        std::vector<char*> argv;
+        for(std::string& a : cmd) argv.push_back((char*) a.c_str());
+        argv.push_back(NULL);
+
+        pid = fork();
+        if(pid == 0) {
+            if(!getenv("VERBOSE")) {
+                int null = open("/dev/null", O_WRONLY);
+                dup2(null, STDOUT_FILENO);
+            }
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+        for(int i = 0; i < 100 && fd < 0; i++) {
+            usleep(50000);
+            fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        }
+        unlink(path);
+        if(fd < 0) return false;
+        struct termios t;
+        tcgetattr(fd, &t);
+        cfmakeraw(&t);
+        tcsetattr(fd, TCSANOW, &t);
+        return true;
+    }
+
+    // False once the simulator has exited, after --count messages
+    bool running() {
+        if(pid <= 0) return false;
+        if(waitpid(pid, NULL, WNOHANG) == 0) return true;
+        pid = -1;
+        return false;
+    }
+
+    void close() {
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+        if(pid > 0) {
+            kill(pid, SIGTERM);
+            waitpid(pid, NULL, 0);
+        }
+        pid = -1;
+    }
+
+    int available() override {
+        int n = 0;
+        if(fd < 0 || ioctl(fd, FIONREAD, &n) < 0) return 0;
+        return n;
+    }
+
+    int read() override {
+        uint8_t b;
+        return fd >= 0 && ::read(fd, &b, 1) == 1 ? b : -1;
+    }
+
+    size_t readBytes(uint8_t* buf, size_t len) override {
+        ssize_t n = fd >= 0 ? ::read(fd, buf, len) : -1;
+        return n > 0 ? n : 0;
+    }
+
+    size_t write(uint8_t b) override {
+        return write(&b, 1);
+    }
+
+    size_t write(const uint8_t* buf, size_t len) override {
+        ssize_t n = fd >= 0 ? ::write(fd, buf, len) : -1;
+        written += n > 0 ? n : 0;
+        return n > 0 ? n : 0;
+    }
+
+    size_t written = 0;
+
+private:
+    int fd = -1;
+    pid_t pid = -1;
+};
@@ -0,0 +1,139 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Plays the captures in frames/ as line edges for each serial setup that autodetect tries, with interrupt latency
+// and the capture starting at a random point, and checks that HanAutodetect finds the setup from one burst
+#include "Arduino.h"
+#include "HanAutodetect.h"
+#include <dirent.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+struct Setup {
+    uint32_t baud;
+    uint8_t dataBits;
+    bool parity;
+    uint8_t ordinal;
+    bool invert;
+};
+
+static const Setup SETUPS[] = {
+    { 2400, 8, true, 11, false },
+    { 2400, 8, false, 3, false },
+    { 115200, 8, false, 3, false },
+    { 2400, 8, true, 11, true },
+    { 2400, 8, false, 3, true },
+    { 115200, 8, false, 3, true },
+    { 9600, 7, true, 10, false },
+    { 9600, 8, true, 11, false }
+};
+
+// Hex bytes, anything after // on a line is a comment
+static std::vector<uint8_t> readRaw(const std::string& path) {
+    std::vector<uint8_t> data;
+    std::ifstream in(path);
+    std::string line;
+    while(std::getline(in, line)) {
+        size_t comment = line.find("//");
+        if(comment != std::string::npos) line.resize(comment);
+        int nibble = -1;
+        for(char c : line) {
+            if(!isxdigit(c)) {
+                nibble = -1;
+                continue;
+            }
+            int v = isdigit(c) ? c - '0' : (toupper(c) - 'A' + 10);
+            if(nibble < 0) {
+                nibble = v;
+            } else {
+                data.push_back((nibble << 4) | v);
+                nibble = -1;
+            }
+        }
+    }
+    return data;
+}
+
+// Edge times in microseconds of the characters sent back to back, as meters do within a frame
+static void toEdges(const std::vector<uint8_t>& data, const Setup& s, double start, std::vector<double>& edges) {
+    double bit = 1000000.0 / s.baud;
+    double t = start;
+    bool level = true; // Idle
+    for(uint8_t byte : data) {
+        std::vector<bool> bits;
+        bits.push_back(false);
+        uint8_t ones = 0;
+        for(uint8_t b = 0; b < s.dataBits; b++) {
+            bool v = (byte >> b) & 1;
+            ones += v;
+            bits.push_back(v);
+        }
+        if(s.parity) bits.push_back(ones & 1);
+        bits.push_back(true);
+        for(bool v : bits) {
+            if(v != level) edges.push_back(t);
+            level = v;
+            t += bit;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string dir = argc > 1 ? argv[1] : "frames";
+    double latency = argc > 2 ? atof(argv[2]) : 3.0;
+    srand(1);
+
+    std::vector<std::string> files;
+    DIR* d = opendir(dir.c_str());
+    if(d == NULL) {
+        printf("Unable to open %s\n", dir.c_str());
+        return 1;
+    }
+    while(struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if(name.size() > 4 && name.substr(name.size() - 4) == ".raw") files.push_back(name);
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+
+    int runs = 0, failures = 0;
+    for(const std::string& name : files) {
+        std::vector<uint8_t> data = readRaw(dir + "/" + name);
+        if(data.size() < 32) continue;
+        for(const Setup& s : SETUPS) {
+            // Two frames with a second of idle line between them, the capture starts somewhere in the first one
+            std::vector<double> edges;
+            toEdges(data, s, 0, edges);
+            double second = edges.back() + 1000000;
+            toEdges(data, s, second, edges);
+            double from = (rand() % 1000) / 1000.0 * (second - 1000000);
+
+            HanAutodetect detect;
+            detect.reset();
+            for(double t : edges) {
+                if(t < from) continue;
+                detect.edge((uint32_t) (t + (rand() % 1000) / 1000.0 * latency));
+            }
+
+            HanAutodetectResult res = {};
+            bool found = detect.analyze(!s.invert, res);
+            bool ok = found && res.baud == s.baud && res.parity == s.ordinal && res.invert == s.invert;
+            printf("%-24s %6u/%2u/%d: %s", name.c_str(), s.baud, s.ordinal, s.invert, ok ? "ok  " : "FAIL");
+            if(found) {
+                printf(" %6u/%2u/%d from %u edges, %u characters, %u errors\n", res.baud, res.parity, res.invert, detect.getEdgeCount(), res.bytes, res.errors);
+            } else {
+                printf(" nothing found in %u edges\n", detect.getEdgeCount());
+            }
+            runs++;
+            if(!ok) failures++;
+        }
+    }
+    printf("%d of %d setups detected, %.1f us latency\n", runs - failures, runs, latency);
+    return failures == 0 && runs > 0 ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Grows the RX buffer of PassiveMeterCommunicator from overflows and from the occupancy seen, with the new size sent
+// back through configure() as the main loop does, and checks that the HAN buffer is resized between frames
+#include "PassiveMeterCommunicator.h"
+
+bool PassthroughMqttHandler::publishBytes(uint8_t*, uint16_t) { return false; }
+bool PassthroughMqttHandler::publishString(char*) { return false; }
+
+class Receiver : public PassiveMeterCommunicator {
+public:
+    Receiver(RemoteDebug* debugger) : PassiveMeterCommunicator(debugger) {}
+    uint16_t getHanBufferSize() { return hanBufferSize; }
+    void checkNow() { checkBufferSize(lastBufferCheck + HAN_BUFFER_CHECK_INTERVAL); }
+};
+
+static int failures = 0;
+
+static bool check(const char* test, const char* what, bool ok) {
+    printf("%-10s %-40s %s\n", test, what, ok ? "ok" : "FAIL");
+    if(!ok) failures++;
+    return ok;
+}
+
+// What the main loop does when the communicator has changed its configuration
+static void saveAndConfigure(Receiver& receiver) {
+    MeterConfig config;
+    receiver.getCurrentConfig(config);
+    receiver.configure(config, NULL);
+    receiver.loop();
+}
+
+static void start(Receiver& receiver) {
+    MeterConfig config;
+    memset(&config, 0, sizeof(config));
+    config.baud = 115200;
+    config.parity = 3;
+    config.bufferSize = 4;
+    config.rxPin = 16;
+    config.txPin = 0xFF;
+    receiver.configure(config, NULL);
+}
+
+int main(int argc, char** argv) {
+    RemoteDebug debugger;
+    debugger.level = getenv("VERBOSE") ? RemoteDebug::VERBOSE : RemoteDebug::ERROR;
+
+    {
+        Receiver receiver(&debugger);
+        start(receiver);
+        uint16_t before = receiver.getHanBufferSize();
+        for(int i = 0; i < 4; i++) receiver.rxerr(2);
+        check("overflow", "configuration changed", receiver.isConfigChanged());
+        saveAndConfigure(receiver);
+        check("overflow", "HAN buffer grown", receiver.getHanBufferSize() > before);
+        check("overflow", "configuration saved", !receiver.isConfigChanged());
+    }
+
+    {
+        Receiver receiver(&debugger);
+        start(receiver);
+        uint16_t before = receiver.getHanBufferSize();
+        receiver.getRxOccupancy().add(900);
+        receiver.getFrameOccupancy().add(1500);
+        receiver.checkNow();
+        check("occupancy", "configuration changed", receiver.isConfigChanged());
+        saveAndConfigure(receiver);
+        check("occupancy", "HAN buffer fits the largest frame", receiver.getHanBufferSize() >= 1500 && receiver.getHanBufferSize() > before);
+    }
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Checks the table driven CRC16 functions and the incremental API against bit by bit versions, and reports throughput
+#include "Arduino.h"
+#include "crc.h"
+#include <chrono>
+
+static uint16_t bitwise_crc16_x25(const uint8_t* p, int len) {
+    uint16_t crc = UINT16_MAX;
+    while(len--)
+        for(uint16_t i = 0, d = 0xff & *p++; i < 8; i++, d >>= 1)
+            crc = ((crc & 1) ^ (d & 1)) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
+    return (~crc << 8) | (~crc >> 8 & 0xff);
+}
+
+static uint16_t bitwise_crc16(const uint8_t* p, int len) {
+    uint16_t crc = 0;
+    while(len--) {
+        crc ^= *p++;
+        for(uint8_t i = 0; i < 8; i++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xa001 : (crc >> 1);
+    }
+    return crc;
+}
+
+static uint16_t bitwise_crc16_1021(const uint8_t* p, int len) {
+    uint32_t crc = 0;
+    for(int i = 0; i < len; i++) {
+        for(int mask = 0x80; mask > 0; mask >>= 1) {
+            crc <<= 1;
+            if(p[i] & mask) crc |= 1;
+            if(crc & 0x10000) {
+                crc &= 0xffff;
+                crc ^= 0x1021;
+            }
+        }
+    }
+    return crc;
+}
+
+template<typename F> static double mbps(F f, const uint8_t* buf, int len, int reps) {
+    auto start = std::chrono::steady_clock::now();
+    volatile uint16_t sink = 0;
+    for(int r = 0; r < reps; r++) sink ^= f(buf, len);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (double) reps * len / s / 1e6;
+}
+
+int main(int argc, char** argv) {
+    int reps = argc > 1 ? atoi(argv[1]) : 2000;
+    static uint8_t buf[4096];
+    srand(1);
+    for(uint16_t i = 0; i < sizeof(buf); i++) buf[i] = rand();
+
+    int failures = 0;
+    for(int n = 0; n < 1000; n++) {
+        if(bitwise_crc16_x25(buf + n % 7, n) != crc16_x25(buf + n % 7, n)) failures++;
+        if(bitwise_crc16(buf, n) != crc16(buf, n)) failures++;
+        if(bitwise_crc16_1021(buf + 3, n) != crc16_1021(buf + 3, n)) failures++;
+
+        // Fed one byte at a time, as the framers do
+        uint16_t x25 = CRC16_X25_INIT;
+        uint16_t arc = CRC16_INIT;
+        uint16_t ccitt = CRC16_1021_INIT;
+        for(int i = 0; i < n; i++) {
+            x25 = crc16_x25_update(x25, buf + i, 1);
+            arc = crc16_update(arc, buf + i, 1);
+            ccitt = crc16_1021_update(ccitt, buf + i, 1);
+        }
+        if(crc16_x25_final(x25) != crc16_x25(buf, n)) failures++;
+        if(arc != crc16(buf, n)) failures++;
+        if(ccitt != crc16_1021(buf, n)) failures++;
+    }
+
+    const uint8_t check[] = "123456789";
+    if(crc16(check, 9) != 0xBB3D) failures++;
+    if(crc16_x25(check, 9) != 0x6E90) failures++;
+    printf("check: arc %04X, x25 %04X, %d failures\n", crc16(check, 9), crc16_x25(check, 9), failures);
+
+    printf("x25:  bitwise %7.1f MB/s, table %7.1f MB/s\n", mbps(bitwise_crc16_x25, buf, sizeof(buf), reps), mbps(crc16_x25, buf, sizeof(buf), reps));
+    printf("arc:  bitwise %7.1f MB/s, table %7.1f MB/s\n", mbps(bitwise_crc16, buf, sizeof(buf), reps), mbps(crc16, buf, sizeof(buf), reps));
+    printf("1021: bitwise %7.1f MB/s, table %7.1f MB/s\n", mbps(bitwise_crc16_1021, buf, sizeof(buf), reps), mbps(crc16_1021, buf, sizeof(buf), reps));
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Encrypts APDUs of many lengths with mbedtls and checks that GCMParser gives back the plain text, rejects a changed
+// frame and decrypts without an authentication key. Built against the host mbedtls 2.x, the same API as ESP-IDF 4.4
+#include "Arduino.h"
+#include "GcmParser.h"
+#include "mbedtls/gcm.h"
+#include <chrono>
+
+static uint8_t encryptionKey[16];
+static uint8_t authenticationKey[16];
+static const uint8_t systemTitle[8] = { 0x4B, 0x41, 0x4D, 0x45, 0x01, 0xAC, 0x4D, 0x6E };
+
+static int makeFrame(uint8_t* frame, const uint8_t* plain, uint16_t plainlen, uint32_t counter, bool tagged) {
+    uint8_t sec = tagged ? 0x30 : 0x20;
+    uint16_t len = plainlen + 5 + (tagged ? 12 : 0);
+    int n = 0;
+    frame[n++] = GCM_TAG;
+    frame[n++] = sizeof(systemTitle);
+    memcpy(frame + n, systemTitle, sizeof(systemTitle));
+    n += sizeof(systemTitle);
+    frame[n++] = 0x82;
+    frame[n++] = len >> 8;
+    frame[n++] = len & 0xFF;
+    frame[n++] = sec;
+    for(int8_t i = 3; i >= 0; i--) frame[n++] = counter >> (i * 8);
+
+    uint8_t iv[12];
+    memcpy(iv, systemTitle, 8);
+    memcpy(iv + 8, frame + n - 4, 4);
+    uint8_t aad[17];
+    aad[0] = sec;
+    memcpy(aad + 1, authenticationKey, 16);
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, encryptionKey, 128);
+    uint8_t tag[16];
+    mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, plainlen, iv, 12, aad, 17, plain, frame + n, 16, tag);
+    mbedtls_gcm_free(&gcm);
+    n += plainlen;
+    if(tagged) {
+        memcpy(frame + n, tag, 12);
+        n += 12;
+    }
+    return n;
+}
+
+static int decrypt(GCMParser& parser, uint8_t* buf, int total) {
+    DataParserContext ctx = {};
+    ctx.length = total;
+    int ret = parser.parse(buf, ctx);
+    return ret < 0 ? ret : (ctx.length << 16) | ret;
+}
+
+int main(int argc, char** argv) {
+    int reps = argc > 1 ? atoi(argv[1]) : 20000;
+    for(uint8_t i = 0; i < 16; i++) {
+        encryptionKey[i] = 0x10 + i;
+        authenticationKey[i] = 0xA0 + i;
+    }
+    uint8_t noKey[16] = { 0 };
+    GCMParser parser(encryptionKey, authenticationKey);
+    GCMParser unauthenticated(encryptionKey, noKey);
+
+    static uint8_t plain[1024], frame[1100], buf[1100];
+    srand(1);
+    for(uint16_t i = 0; i < sizeof(plain); i++) plain[i] = rand();
+
+    int failures = 0;
+    for(uint16_t plainlen = 1; plainlen <= sizeof(plain); plainlen += plainlen < 70 ? 1 : 37) {
+        for(uint8_t tagged = 0; tagged < 2; tagged++) {
+            int total = makeFrame(frame, plain, plainlen, plainlen * 7 + tagged, tagged);
+
+            memcpy(buf, frame, total);
+            int ret = decrypt(parser, buf, total);
+            if(ret < 0 || (ret >> 16) != plainlen || memcmp(buf + (ret & 0xFFFF), plain, plainlen) != 0) {
+                printf("length %d%s: decrypt failed (%d)\n", plainlen, tagged ? " tagged" : "", ret);
+                failures++;
+            }
+
+            memcpy(buf, frame, total);
+            ret = decrypt(unauthenticated, buf, total);
+            if(ret < 0 || memcmp(buf + (ret & 0xFFFF), plain, plainlen) != 0) {
+                printf("length %d%s: decrypt without authentication key failed (%d)\n", plainlen, tagged ? " tagged" : "", ret);
+                failures++;
+            }
+
+            if(tagged) {
+                memcpy(buf, frame, total);
+                buf[total - 13 - plainlen / 2] ^= 0x01;
+                ret = decrypt(parser, buf, total);
+                if(ret != GCM_AUTH_FAILED) {
+                    printf("length %d: changed frame gave %d\n", plainlen, ret);
+                    failures++;
+                }
+            }
+        }
+    }
+    printf("%d failures\n", failures);
+
+    int total = makeFrame(frame, plain, 560, 1, true);
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < reps; i++) {
+        memcpy(buf, frame, total);
+        decrypt(parser, buf, total);
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("560 byte APDU: %.2f us per frame\n", s * 1e6 / reps);
+    return failures == 0 ? 0 : 1;
+}
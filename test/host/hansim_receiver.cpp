@@ -0,0 +1,127 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Receives what scripts/hansim.py sends over a pseudo-terminal with PassiveMeterCommunicator, and reports messages
+// per second, loss and the time from the last byte sent to the data being handed over. The arguments are passed on
+// to hansim.py, generated frames carry their number in the active import counter, which is matched with its --log.
+#include "PassiveMeterCommunicator.h"
+#include "PtyStream.h"
+#include "hexutils.h"
+#include <map>
+
+bool PassthroughMqttHandler::publishBytes(uint8_t*, uint16_t) { return false; }
+bool PassthroughMqttHandler::publishString(char*) { return false; }
+
+class Receiver : public PassiveMeterCommunicator {
+public:
+    Receiver(RemoteDebug* debugger) : PassiveMeterCommunicator(debugger) {}
+    // Nothing left from before in a new pseudo-terminal, so the first frame is not thrown away
+    void setPort(Stream* port) {
+        hanSerial = port;
+        serialInit = true;
+    }
+};
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    RemoteDebug debugger;
+    debugger.level = getenv("VERBOSE") ? RemoteDebug::VERBOSE : RemoteDebug::ERROR;
+
+    std::vector<std::string> args;
+    for(int i = 1; i < argc; i++) args.push_back(argv[i]);
+    if(args.empty()) args = { "--synth", "hdlc", "--baud", "115200", "--interval", "0.05", "--count", "100", "--seed", "1" };
+
+    MeterConfig config;
+    memset(&config, 0, sizeof(config));
+    config.baud = 115200;
+    config.parity = 3;
+    config.bufferSize = 4;
+    config.rxPin = 16;
+    config.txPin = 0xFF;
+    for(size_t i = 0; i + 1 < args.size(); i++) {
+        if(args[i] == "--key") fromHex(config.encryptionKey, String(args[i + 1].c_str()), 16);
+        if(args[i] == "--auth") fromHex(config.authenticationKey, String(args[i + 1].c_str()), 16);
+    }
+
+    char log[64];
+    snprintf(log, sizeof(log), "/tmp/hansim-%d.log", (int) getpid());
+    args.push_back("--log");
+    args.push_back(log);
+
+    PtyStream port;
+    if(!port.start(args)) {
+        printf("Simulator did not start\n");
+        return 1;
+    }
+    Receiver receiver(&debugger);
+    receiver.configure(config, NULL);
+    receiver.setPort(&port);
+
+    // Frame number and time the data was handed over
+    std::map<uint32_t, double> received;
+    uint32_t messages = 0, errors = 0;
+    int lastError = 0;
+    double first = 0, last = 0;
+    AmsData state;
+    bool running = true;
+    double idle = 0;
+    while(running || now() - idle < 0.5) {
+        if(running && !port.running()) {
+            running = false;
+            idle = now();
+        }
+        bool ok = receiver.loop();
+        // Kept until the next frame is decoded, so only counted when it changes
+        if(receiver.getLastError() < 0 && receiver.getLastError() != lastError) errors++;
+        lastError = receiver.getLastError();
+        if(!ok) {
+            if(!port.available()) usleep(50);
+            continue;
+        }
+        AmsData data;
+        if(!receiver.getData(state, data)) continue;
+        double t = now();
+        if(messages++ == 0) first = t;
+        last = t;
+        idle = t;
+        state.apply(data);
+        uint32_t number = lround(data.getActiveImportCounter() * 1000);
+        if(received.find(number) == received.end()) received[number] = t;
+    }
+
+    // Frame number, time of the last byte and length of each message sent
+    std::vector<double> latencies;
+    uint32_t sent = 0;
+    FILE* f = fopen(log, "r");
+    if(f != NULL) {
+        unsigned long number, length;
+        double t;
+        while(fscanf(f, "%lu %lf %lu", &number, &t, &length) == 3) {
+            sent++;
+            auto r = received.find(number);
+            if(r != received.end()) latencies.push_back((r->second - t) * 1000);
+        }
+        fclose(f);
+        unlink(log);
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double seconds = last - first;
+    printf("%u of %u messages received, %u lost, %u errors", messages, sent, sent > messages ? sent - messages : 0, errors);
+    if(messages > 1 && seconds > 0) printf(", %.1f messages/s", (messages - 1) / seconds);
+    printf("\n");
+    if(!latencies.empty()) {
+        printf("latency ms p50 %.2f p95 %.2f p99 %.2f max %.2f over %u numbered messages\n",
+            latencies[latencies.size() / 2], latencies[latencies.size() * 95 / 100], latencies[latencies.size() * 99 / 100],
+            latencies.back(), (unsigned) latencies.size());
+    }
+    return messages > 0 ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Reads the meter simulated by scripts/hansim.py --pull over a pseudo-terminal, with list requests, with data blocks
+// and HDLC segments, and one attribute at a time, and checks the values from the first poll
+#include "KamstrupPullCommunicator.h"
+#include "PtyStream.h"
+
+bool PassthroughMqttHandler::publishBytes(uint8_t*, uint16_t) { return false; }
+bool PassthroughMqttHandler::publishString(char*) { return false; }
+
+class PullHarness : public KamstrupPullCommunicator {
+public:
+    PullHarness(RemoteDebug* debugger) : KamstrupPullCommunicator(debugger) {}
+    void setPort(Stream* port) {
+        hanSerial = port;
+    }
+};
+
+struct Scenario {
+    const char* name;
+    std::vector<std::string> args;
+};
+
+static int failures = 0;
+
+static bool check(const char* scenario, const char* what, bool ok) {
+    if(!ok) {
+        printf("%s: %s FAIL\n", scenario, what);
+        failures++;
+    }
+    return ok;
+}
+
+static MeterConfig meterConfig(uint8_t txPin) {
+    MeterConfig config;
+    memset(&config, 0, sizeof(config));
+    config.baud = 115200;
+    config.parity = 3;
+    config.bufferSize = 4;
+    config.rxPin = 16;
+    config.txPin = txPin;
+    return config;
+}
+
+static void run(RemoteDebug& debugger, const Scenario& s) {
+    PtyStream port;
+    std::vector<std::string> args = { "--pull", "--baud", "115200", "--parity", "N" };
+    args.insert(args.end(), s.args.begin(), s.args.end());
+    if(!port.start(args)) {
+        check(s.name, "simulator", false);
+        return;
+    }
+
+    PullHarness pull(&debugger);
+    MeterConfig config = meterConfig(17);
+    pull.configure(config, NULL);
+    pull.setPort(&port);
+
+    AmsData state, data;
+    unsigned long start = millis();
+    bool received = false;
+    while(!received && millis() - start < 15000) {
+        if(pull.loop()) received = pull.getData(state, data);
+        usleep(200);
+    }
+    unsigned long ms = millis() - start;
+    if(!check(s.name, "data", received)) return;
+    int before = failures;
+
+    check(s.name, "meter id", strcmp(data.getMeterId(), "5706567000000000") == 0);
+    check(s.name, "meter model", strcmp(data.getMeterModel(), "6841131BN243101040") == 0);
+    check(s.name, "clock", labs((long) (data.getMeterTimestamp() - time(NULL))) < 10);
+    check(s.name, "active import", data.getActiveImportPower() == 1500);
+    check(s.name, "reactive import", data.getReactiveImportPower() == 120);
+    check(s.name, "reactive export", data.getReactiveExportPower() == 45);
+    check(s.name, "voltage", data.getL1Voltage() == 230 && data.getL2Voltage() == 231 && data.getL3Voltage() == 232);
+    check(s.name, "current", fabs(data.getL1Current() - 6.5) < 0.001 && fabs(data.getL2Current() - 1.2) < 0.001 && fabs(data.getL3Current() - 3.1) < 0.001);
+    check(s.name, "import counter", fabs(data.getActiveImportCounter() - 12345.67) < 0.0001);
+    check(s.name, "export counter", fabs(data.getActiveExportCounter() - 0.89) < 0.0001);
+    check(s.name, "power factor", fabs(data.getPowerFactor() - 0.95) < 0.001);
+    check(s.name, "three phase", data.isThreePhase());
+    uint64_t read = AMS_FIELD(AmsFieldActiveImportPower) | AMS_FIELD(AmsFieldL3Voltage) | AMS_FIELD(AmsFieldL3Current)
+        | AMS_FIELD(AmsFieldActiveImportCounter) | AMS_FIELD(AmsFieldPowerFactor) | AMS_FIELD(AmsFieldMeterTimestamp);
+    check(s.name, "fields read are present", (data.getPresentFields() & read) == read);
+    // The simulator has no phase powers or phase power factors, those must not be published as zeros
+    check(s.name, "fields not read are absent", (data.getPresentFields() & (AMS_FIELD(AmsFieldL1ActiveImportPower) | AMS_FIELD(AmsFieldL2PowerFactor))) == 0);
+    printf("%-10s %s, %u ms to the first reading, %u bytes sent\n", s.name, failures == before ? "ok" : "FAIL", (unsigned) ms, (unsigned) port.written);
+}
+
+int main(int argc, char** argv) {
+    RemoteDebug debugger;
+    debugger.level = getenv("VERBOSE") ? RemoteDebug::VERBOSE : RemoteDebug::ERROR;
+
+    Scenario scenarios[] = {
+        { "list", {} },
+        { "blocks", { "--pdu", "64", "--segment", "40", "--pull-info", "64" } },
+        { "single", { "--no-list" } }
+    };
+    for(const Scenario& s : scenarios) {
+        run(debugger, s);
+    }
+
+    // Without a TX pin nothing is sent, there would be no answer
+    {
+        PtyStream port;
+        PullHarness pull(&debugger);
+        MeterConfig config = meterConfig(0xFF);
+        pull.configure(config, NULL);
+        pull.setPort(&port);
+        for(int i = 0; i < 100; i++) pull.loop();
+        check("no tx", "nothing sent", port.written == 0);
+    }
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Runs AmsDataStorage with the persistence scheduler as the main loop does, for days of a meter sending power every
+// 10 s and counters every hour, once writing the hourly changes within the window and once holding them in RAM for
+// the day to close. Reports flash erases and page programs per day from the LittleFS stub, and checks what a boot
+// loads after a restart, and after power is lost without a flush
+#include "AmsDataStorage.h"
+#include "PersistenceScheduler.h"
+#include "FirmwareVersion.h"
+#include <memory>
+
+LittleFSClass LittleFS;
+long FirmwareVersion::BuildEpoch = 1700000000;
+const char* FirmwareVersion::VersionString = "host";
+
+// The simulated clock, for AmsDataStorage and the Timezone stub
+static time_t simulated = 0;
+extern "C" time_t time(time_t* t) throw() {
+    if(t != NULL) *t = simulated;
+    return simulated;
+}
+
+class TestData : public AmsData {
+public:
+    void set(uint8_t type, double imp, double exp, uint32_t power) {
+        listType = type;
+        activeImportCounter = imp;
+        activeExportCounter = exp;
+        activeImportPower = power;
+        lastUpdateMillis = millis();
+    }
+};
+
+// The storage and the scheduler, as after a boot
+class Device {
+public:
+    RecordLog records;
+    AmsDataStorage ds;
+    PersistenceScheduler persistence;
+
+    Device(RemoteDebug* debugger, Timezone* tz) : records(debugger), ds(debugger, &records), persistence(debugger, &records) {
+        ds.setTimezone(tz);
+        ds.load();
+        persistence.attach(PERSIST_DATA, ds.getStreams(), 1 << PERSIST_HISTORY);
+        AmsDataStorage* storage = &ds;
+        persistence.attach(PERSIST_HISTORY, [storage]() -> int32_t {
+            return storage->writePending();
+        });
+    }
+
+    uint16_t hours(time_t from, time_t to) {
+        HistorySlot slots[48];
+        return ds.getHistory(HISTORY_TIER_HOUR, from, to, slots, 48);
+    }
+};
+
+static int failures = 0;
+
+static bool check(const char* test, const char* what, bool ok) {
+    if(!ok) {
+        printf("%s: %s FAIL\n", test, what);
+        failures++;
+    }
+    return ok;
+}
+
+static void run(RemoteDebug* debugger, bool batched, int days) {
+    const char* name = batched ? "batched" : "hourly";
+    LittleFS.format();
+    TimeChangeRule rule = {};
+    Timezone tz(rule, rule);
+
+    // Local midnight, the stub zone is UTC+1
+    time_t start = 1760000400 - (1760000400 % 86400) - 3600;
+    simulated = start;
+    std::unique_ptr<Device> dev(new Device(debugger, &tz));
+    double imp = 12345.0;
+    uint32_t power = 500;
+    int restarts = 0;
+    uint32_t erases = 0, programs = 0, opens = 0, bytes = 0;
+    srand(11);
+    for(long s = 10; s <= (long) days * 86400 - 4 * 3600; s += 10) {
+        simulated = start + s;
+        hostMillisOffset += 10000;
+        if(s % 900 == 10) power = 200 + rand() % 4000;
+        imp += power * 10 / 3600000.0;
+
+        // Counters in the first frame of each hour
+        TestData d;
+        bool counters = s % 3600 == 10;
+        d.set(counters ? 3 : 1, counters ? floor(imp * 1000) / 1000 : 0, 0, power);
+        dev->ds.sample(&d);
+
+        // As handleDataSuccess() and readHanPort() do
+        tmElements_t tm;
+        breakTime(simulated, tm);
+        if(!dev->ds.isHappy()) {
+            bool changed = false;
+            if(tm.Minute == 0 && counters) {
+                changed = dev->ds.update(&d);
+            } else if(tm.Minute == 1) {
+                AmsData nullData;
+                changed = dev->ds.update(&nullData);
+            }
+            if(changed) dev->persistence.setDirty(PERSIST_DATA, batched);
+        }
+        if(dev->ds.hasPendingWrites()) {
+            bool hold = batched && !dev->ds.isWriteDue();
+            dev->persistence.setDirty(PERSIST_HISTORY, hold);
+            dev->persistence.setDirty(PERSIST_DATA, hold);
+        }
+        dev->persistence.loop(false);
+
+        // Counted from the second day, the first one writes the snapshots
+        if(s == 86400) {
+            erases = LittleFS.erases;
+            programs = LittleFS.programs;
+            opens = LittleFS.opensForWrite;
+            bytes = LittleFS.bytesWritten;
+        }
+
+        // Restarts from the web interface flush first
+        if(s % (86400 * 4 + 43210) == 0) {
+            // The hour that just started is only in RAM
+            time_t hour = simulated - simulated % 3600;
+            dev->persistence.flush();
+            uint16_t before = dev->hours(hour - 86400, hour);
+            dev.reset(new Device(debugger, &tz));
+            check(name, "hours after a restart", dev->hours(hour - 86400, hour) == before && before == 24);
+            restarts++;
+        }
+    }
+    erases = LittleFS.erases - erases;
+    programs = LittleFS.programs - programs;
+    opens = LittleFS.opensForWrite - opens;
+    bytes = LittleFS.bytesWritten - bytes;
+
+    // Power lost at 20:00 on the last day before the counters close the hour from 19:00, what the files and the record
+    // log had is loaded
+    time_t midnight = start + (days - 1) * 86400L;
+    uint16_t hours = dev->hours(midnight - 86400, simulated - 3600);
+    check(name, "hours of the last two days", hours == 43);
+    dev.reset(new Device(debugger, &tz));
+    uint16_t kept = dev->hours(midnight - 86400, simulated - 3600);
+    check(name, "closed day kept without a flush", kept >= (batched ? 24 : 43));
+
+    int counted = days - 1;
+    printf("%-7s %d days, %d restarts, per day %.1f erases, %.1f page programs, %.1f opens for write, %.0f bytes\n",
+        name, days, restarts, erases / (double) counted, programs / (double) counted, opens / (double) counted,
+        bytes / (double) counted);
+    printf("        %u of %u hours of the last two days kept when power is lost at 20:00\n", kept, hours);
+}
+
+int main(int argc, char** argv) {
+    RemoteDebug debugger;
+    debugger.level = getenv("VERBOSE") ? RemoteDebug::VERBOSE : RemoteDebug::ERROR + 1;
+    int days = argc > 1 ? atoi(argv[1]) : 30;
+
+    char dir[] = "/tmp/persistence-XXXXXX";
+    if(mkdtemp(dir) == NULL) return 1;
+    LittleFS.root = dir;
+
+    run(&debugger, false, days);
+    run(&debugger, true, days);
+
+    LittleFS.format();
+    rmdir(dir);
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Feeds QuarterHourStorage 70 days of a varying load with restarts, once with counters every 10 s and once with
+// counters once an hour, and compares the last 60 days with the energy used. Reports the bytes per day in the quarter
+// files and how fast a range is decoded, from the files and from the open day in RAM
+#include "QuarterHourStorage.h"
+#include "AmsStorage.h"
+#include <chrono>
+#include <memory>
+#include <vector>
+
+LittleFSClass LittleFS;
+
+class TestData : public AmsData {
+public:
+    void set(uint8_t type, double imp, double exp, uint32_t powerImp, uint32_t powerExp, uint64_t ms) {
+        listType = type;
+        activeImportCounter = imp;
+        activeExportCounter = exp;
+        activeImportPower = powerImp;
+        activeExportPower = powerExp;
+        lastUpdateMillis = ms;
+    }
+};
+
+// The record log and the storage, as after a boot
+class Device {
+public:
+    RecordLog log;
+    QuarterHourStorage quarters;
+
+    Device(RemoteDebug* debugger, Timezone* tz) : log(debugger), quarters(debugger, &log) {
+        quarters.setTimezone(tz);
+        quarters.load();
+    }
+};
+
+static int failures = 0;
+
+static bool check(const char* test, const char* what, bool ok) {
+    if(!ok) {
+        printf("%s: %s FAIL\n", test, what);
+        failures++;
+    }
+    return ok;
+}
+
+static size_t fileSize(const char* name) {
+    if(!LittleFS.exists(name)) return 0;
+    File f = LittleFS.open(name, "r");
+    return f.size();
+}
+
+static double seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+static void run(RemoteDebug* debugger, bool hourly, int days) {
+    const char* name = hourly ? "hourly" : "10 s";
+    LittleFS.format();
+    TimeChangeRule rule = {};
+    Timezone tz(rule, rule);
+    std::unique_ptr<Device> dev(new Device(debugger, &tz));
+
+    // Local midnight, the stub zone is UTC+1
+    time_t start = 1760000400 - (1760000400 % 86400) - 3600;
+    double imp = 12345.0, exp = 10.0;
+    uint64_t ms = 1000;
+    std::vector<double> truthImp, truthExp; // Wh in each quarter
+    uint32_t powerImp = 500, powerExp = 0;
+    int restarts = 0;
+    bool closing = false;
+    uint32_t written = LittleFS.bytesWritten;
+    srand(7);
+    for(long s = 0; s < (long) days * 86400; s += 10) {
+        if(s % 900 == 0) {
+            truthImp.push_back(0);
+            truthExp.push_back(0);
+            int h = (s / 3600) % 24;
+            powerImp = 200 + rand() % (h > 16 && h < 22 ? 9000 : 2500);
+            powerExp = h > 9 && h < 16 ? rand() % 4000 : 0;
+        }
+
+        // The energy of the 10 s that end now, the meter counters are whole Wh
+        double wi = powerImp * 10 / 3600.0, we = powerExp * 10 / 3600.0;
+        imp += wi / 1000;
+        exp += we / 1000;
+        truthImp.back() += wi;
+        truthExp.back() += we;
+        ms += 10000;
+        TestData d;
+        bool counters = !hourly || (s + 10) % 3600 == 10;
+        d.set(counters ? 3 : 1, counters ? floor(imp * 1000) / 1000 : 0, counters ? floor(exp * 1000) / 1000 : 0, powerImp, powerExp, ms);
+        dev->quarters.update(&d, start + s + 10);
+        if(dev->quarters.hasPending() && !closing) {
+            std::vector<uint32_t> a(96), b(96);
+            check(name, "closed day read before it is written", dev->quarters.getQuarters(start + s + 10 - 86400, 96, a.data(), b.data()) == 96);
+        }
+        closing = dev->quarters.hasPending();
+
+        // As the persistence scheduler does, the closed day a window later and then the record log. The stream is
+        // also saved with the rest of the data storage a minute past the hour
+        if(dev->quarters.hasPending() ? (s + 10) % 900 == 10 : (s + 10) % 3600 == 60) {
+            dev->quarters.writePending();
+            dev->log.save(1 << RECORD_LOG_STREAM_QUARTER);
+        }
+
+        // Restarts keep what was saved and lose the power readings since
+        if(s > 0 && s % (86400 * 9 + 33330) == 0) {
+            dev->quarters.writePending();
+            dev->log.save(1 << RECORD_LOG_STREAM_QUARTER);
+            dev.reset(new Device(debugger, &tz));
+            restarts++;
+        }
+    }
+    written = LittleFS.bytesWritten - written;
+
+    // The last 60 whole days
+    uint32_t count = 96 * 60;
+    std::vector<uint32_t> gotImp(count), gotExp(count);
+    time_t from = start + (days - 61) * 86400L;
+    size_t first = (from - start) / 900;
+    uint16_t found = dev->quarters.getQuarters(from, count, gotImp.data(), gotExp.data());
+    double errImp = 0, errExp = 0, total = 0, maxErr = 0;
+    int zeros = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        double e = fabs(gotImp[i] - truthImp[first + i]);
+        errImp += e;
+        errExp += fabs(gotExp[i] - truthExp[first + i]);
+        total += truthImp[first + i];
+        if(e > maxErr) maxErr = e;
+        if(gotImp[i] == 0) zeros++;
+    }
+    check(name, "all quarters found", found == count && zeros == 0);
+
+    size_t bytes = fileSize(FILE_QUARTER_HOUR_0) + fileSize(FILE_QUARTER_HOUR_1) + fileSize(FILE_QUARTER_HOUR_2);
+    printf("%-6s %d days, %d restarts, %u of %u quarters found, %d empty\n", name, days, restarts, found, count, zeros);
+    printf("       import error %.1f Wh per quarter (%.2f%%), max %.0f Wh, export error %.1f Wh per quarter\n",
+        errImp / count, 100 * errImp / total, maxErr, errExp / count);
+    printf("       quarter files %u bytes, %.1f bytes per day with the %u byte header, %.0f bytes per day written in all\n",
+        (unsigned) bytes, bytes / (double) (days - 1), (unsigned) sizeof(QuarterHourBlock), written / (double) days);
+
+    uint32_t sink = 0;
+    int reps = 200;
+    auto t = std::chrono::steady_clock::now();
+    for(int r = 0; r < reps; r++) sink += dev->quarters.getQuarters(from, count, gotImp.data(), gotExp.data());
+    double sec = seconds(t);
+    printf("       60 days from the files in %.1f us, %.1f M quarters/s\n", sec / reps * 1e6, reps * (double) count / sec / 1e6);
+
+    reps = 200000;
+    t = std::chrono::steady_clock::now();
+    for(int r = 0; r < reps; r++) sink += dev->quarters.getQuarters(start + days * 86400L - 4 * 3600, 16, gotImp.data(), gotExp.data());
+    sec = seconds(t);
+    printf("       4 hours from RAM in %.2f us%s\n", sec / reps * 1e6, sink == 0 ? " (nothing decoded)" : "");
+}
+
+int main(int argc, char** argv) {
+    RemoteDebug debugger;
+    debugger.level = getenv("VERBOSE") ? RemoteDebug::VERBOSE : RemoteDebug::ERROR;
+    int days = argc > 1 ? atoi(argv[1]) : 70;
+
+    char dir[] = "/tmp/quarterhour-XXXXXX";
+    if(mkdtemp(dir) == NULL) return 1;
+    LittleFS.root = dir;
+
+    run(&debugger, false, days);
+    run(&debugger, true, days);
+
+    LittleFS.format();
+    rmdir(dir);
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
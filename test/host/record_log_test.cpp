@@ -0,0 +1,177 @@
+/**
+ * @copyright Utilitech AS 2023
+ * License: Fair Source
+ * 
+ */
+
+// Saves two structs through RecordLog to a directory standing in for LittleFS, and checks what a new RecordLog loads
+// from it after many saves and compactions, after power is lost somewhere in a save, and after formatting
+#include "RecordLog.h"
+#include <memory>
+
+LittleFSClass LittleFS;
+
+struct Small {
+    uint32_t words[6];
+};
+
+struct Large {
+    uint32_t words[100];
+};
+
+struct State {
+    Small small;
+    Large large;
+    bool operator==(const State& o) const { return memcmp(this, &o, sizeof(State)) == 0; }
+};
+
+// The log and the structs attached to it, as after a boot
+class Device {
+public:
+    RecordLog log;
+    State state;
+
+    Device(RemoteDebug* debugger) : log(debugger) {
+        memset(&state, 0, sizeof(state));
+        log.attach(0, &state.small, sizeof(state.small));
+        log.attach(1, &state.large, sizeof(state.large));
+        log.load(0);
+        log.load(1);
+    }
+};
+
+static int failures = 0;
+
+static bool check(const char* test, const char* what, bool ok) {
+    if(!ok) {
+        printf("%s: %s FAIL\n", test, what);
+        failures++;
+    }
+    return ok;
+}
+
+// A few words change between saves, like counters and the hour that was just written
+static void change(State& s) {
+    int n = 1 + rand() % 4;
+    for(int i = 0; i < n; i++) {
+        if(rand() % 3 == 0) {
+            s.small.words[rand() % 6] = rand();
+        } else {
+            s.large.words[rand() % 100] = rand();
+        }
+    }
+}
+
+static State boot(RemoteDebug* debugger) {
+    Device d(debugger);
+    return d.state;
+}
+
+static void appends(RemoteDebug* debugger) {
+    LittleFS.format();
+    std::unique_ptr<Device> dev(new Device(debugger));
+    uint32_t before = LittleFS.bytesWritten;
+    int saves = 2000, reboots = 0;
+    for(int i = 0; i < saves; i++) {
+        change(dev->state);
+        dev->log.save(0x03);
+        if(i % 100 == 99) {
+            check("appends", "state after boot", boot(debugger) == dev->state);
+            // Carries on from what was loaded, the next compaction only has what the new log knows about
+            State s = dev->state;
+            dev.reset(new Device(debugger));
+            check("appends", "loaded by the device", dev->state == s);
+            reboots++;
+        }
+    }
+    uint32_t bytes = LittleFS.bytesWritten - before;
+    printf("appends    %d saves, %d boots, %.1f bytes per save, %u bytes for a whole rewrite\n", saves, reboots,
+        (double) bytes / saves, (unsigned) sizeof(State));
+}
+
+static void powerLoss(RemoteDebug* debugger) {
+    LittleFS.format();
+    std::unique_ptr<Device> dev(new Device(debugger));
+    int crashes = 0, asBefore = 0, asAfter = 0;
+    for(int i = 0; i < 1000; i++) {
+        State before = dev->state;
+        change(dev->state);
+        State after = dev->state;
+
+        // A compaction writes all of both structs, a few cuts land in one
+        LittleFS.crashAfter = rand() % (i % 10 == 0 ? 1024 : 96);
+        LittleFS.crashed = false;
+        dev->log.save(0x03);
+        bool crashed = LittleFS.crashed;
+        LittleFS.crashAfter = -1;
+        LittleFS.crashed = false;
+        if(!crashed) continue;
+
+        crashes++;
+        std::unique_ptr<Device> booted(new Device(debugger));
+        if(booted->state == before) {
+            asBefore++;
+        } else if(booted->state == after) {
+            asAfter++;
+        } else {
+            check("power loss", "state is from before or after the save", false);
+        }
+
+        // The booted device gets to the same state and saves, which has to leave a log that loads again
+        booted->state = after;
+        booted->log.save(0x03);
+        check("power loss", "recovered by the next save", boot(debugger) == after);
+        dev.swap(booted);
+    }
+    printf("power loss %d saves cut off, %d loaded as before and %d as after the save\n", crashes, asBefore, asAfter);
+}
+
+static void format(RemoteDebug* debugger) {
+    int before = failures;
+    LittleFS.format();
+    Device dev(debugger);
+    for(int i = 0; i < 50; i++) {
+        change(dev.state);
+        dev.log.save(0x03);
+    }
+
+    // Nothing changed since the last save, the snapshot is still written
+    LittleFS.format();
+    dev.log.reset();
+    dev.log.save(0x03);
+    check("format", "unchanged structs saved", boot(debugger) == dev.state);
+
+    // All of the structs, not only the word that changed
+    LittleFS.format();
+    dev.log.reset();
+    dev.state.small.words[0]++;
+    dev.log.save(0x01);
+    check("format", "structs saved in full", boot(debugger) == dev.state);
+
+    // And appended to as before
+    for(int i = 0; i < 50; i++) {
+        change(dev.state);
+        dev.log.save(0x03);
+    }
+    check("format", "appends after the snapshot", boot(debugger) == dev.state);
+    printf("format     %s\n", failures == before ? "ok" : "FAIL");
+}
+
+int main(int argc, char** argv) {
+    RemoteDebug debugger;
+    debugger.level = getenv("VERBOSE") ? RemoteDebug::VERBOSE : RemoteDebug::ERROR + 1;
+    srand(1);
+
+    char dir[] = "/tmp/recordlog-XXXXXX";
+    if(mkdtemp(dir) == NULL) return 1;
+    LittleFS.root = dir;
+
+    appends(&debugger);
+    powerLoss(&debugger);
+    format(&debugger);
+
+    LittleFS.format();
+    rmdir(dir);
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
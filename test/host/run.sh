@@ -0,0 +1,62 @@
+#!/bin/sh
+# Builds and runs the host harnesses against the library sources, with the stubs in test/host/stubs standing in for
+# the Arduino core. Usage: test/host/run.sh [harness...] [-- arguments], all harnesses when none is given.
+# Harnesses run from the root of the repository
+set -e
+HOST=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$HOST/../.." && pwd)
+OUT=${OUT:-$ROOT/_host_build}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -g}
+mkdir -p "$OUT"
+
+HARNESSES=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do HARNESSES="$HARNESSES $1"; shift; done
+[ "$1" = "--" ] && shift
+[ -z "$HARNESSES" ] && HARNESSES="crc_bench gcm_test autodetect_test kamstrup_pull_test hansim_receiver buffer_resize_test record_log_test quarter_hour_bench persistence_bench"
+
+for h in $HARNESSES; do
+    LIBS=""
+    case $h in
+        crc_bench)
+            SRC="lib/AmsDecoder/src/crc.cpp"
+            INC="lib/AmsDecoder/include"
+            ;;
+        autodetect_test)
+            SRC="src/HanAutodetect.cpp"
+            INC="src"
+            ;;
+        gcm_test)
+            SRC="lib/AmsDecoder/src/GcmParser.cpp"
+            INC="lib/AmsDecoder/include"
+            LIBS="${MBEDCRYPTO:--l:libmbedcrypto.so.7}"
+            ;;
+        record_log_test)
+            SRC="lib/AmsDataStorage/src/RecordLog.cpp lib/AmsDecoder/src/crc.cpp"
+            INC="lib/AmsDataStorage/include lib/AmsConfiguration/include lib/AmsDecoder/include"
+            ;;
+        quarter_hour_bench)
+            SRC="lib/AmsDataStorage/src/QuarterHourStorage.cpp lib/AmsDataStorage/src/RecordLog.cpp lib/AmsData/src/AmsData.cpp lib/AmsDecoder/src/crc.cpp lib/Uptime/src/Uptime.cpp test/host/stubs/Arduino.cpp"
+            INC="lib/AmsDataStorage/include lib/AmsData/include lib/AmsConfiguration/include lib/AmsDecoder/include lib/Uptime/include"
+            ;;
+        persistence_bench)
+            SRC="lib/AmsDataStorage/src/AmsDataStorage.cpp lib/AmsDataStorage/src/QuarterHourStorage.cpp lib/AmsDataStorage/src/HistoryStorage.cpp lib/AmsDataStorage/src/RecordLog.cpp lib/PersistenceScheduler/src/PersistenceScheduler.cpp lib/AmsData/src/AmsData.cpp lib/AmsDecoder/src/crc.cpp test/host/stubs/Arduino.cpp"
+            INC="lib/AmsDataStorage/include lib/PersistenceScheduler/include lib/FirmwareVersion/include lib/AmsData/include lib/AmsConfiguration/include lib/AmsDecoder/include"
+            ;;
+        hansim_receiver|kamstrup_pull_test|buffer_resize_test)
+            SRC="src/KamstrupPullCommunicator.cpp src/PassiveMeterCommunicator.cpp src/HanAutodetect.cpp src/IEC6205621.cpp src/IEC6205675.cpp src/CompactProfile.cpp lib/AmsDecoder/src/*.cpp lib/AmsData/src/AmsData.cpp lib/Uptime/src/Uptime.cpp lib/AmsConfiguration/src/hexutils.cpp test/host/stubs/Arduino.cpp"
+            INC="src lib/AmsDecoder/include lib/AmsData/include lib/Uptime/include lib/AmsConfiguration/include"
+            LIBS="${MBEDCRYPTO:--l:libmbedcrypto.so.7}"
+            ;;
+        *)
+            echo "Unknown harness $h"; exit 1
+            ;;
+    esac
+    FILES="$HOST/$h.cpp"
+    for s in $SRC; do FILES="$FILES $ROOT/$s"; done
+    INCS="-I$HOST/stubs"
+    for i in $INC; do INCS="$INCS -I$ROOT/$i"; done
+    echo "== $h"
+    $CXX -std=gnu++11 -fno-rtti -w -DESP32 $CXXFLAGS $INCS $FILES $LIBS -o "$OUT/$h"
+    (cd "$ROOT" && "$OUT/$h" "$@")
+done
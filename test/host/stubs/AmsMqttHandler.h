@@ -0,0 +1,13 @@
+#pragma once
+#include "Arduino.h"
+#include "RemoteDebug.h"
+#include "AmsData.h"
+#include "AmsConfiguration.h"
+class EnergyAccounting;
+class PriceService;
+class HwTools;
+class AmsMqttHandler {
+public:
+  AmsMqttHandler(MqttConfig&, RemoteDebug*, char*) {}
+  virtual ~AmsMqttHandler() {}
+};
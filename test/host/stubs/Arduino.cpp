@@ -0,0 +1,10 @@
+#include "Arduino.h"
+#include "TimeLib.h"
+#include <chrono>
+HardwareSerial Serial, Serial1, Serial2;
+static auto t0 = std::chrono::steady_clock::now();
+unsigned long hostMillisOffset = 0;
+unsigned long millis() { return hostMillisOffset + std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count(); }
+unsigned long micros() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count(); }
+time_t makeTime(const tmElements_t& e) { struct tm t = {}; t.tm_year = e.Year + 70; t.tm_mon = e.Month - 1; t.tm_mday = e.Day; t.tm_hour = e.Hour; t.tm_min = e.Minute; t.tm_sec = e.Second; return timegm(&t); }
+void breakTime(time_t t, tmElements_t& e) { struct tm r; gmtime_r(&t, &r); e.Year = r.tm_year - 70; e.Month = r.tm_mon + 1; e.Day = r.tm_mday; e.Hour = r.tm_hour; e.Minute = r.tm_min; e.Second = r.tm_sec; e.Wday = r.tm_wday + 1; }
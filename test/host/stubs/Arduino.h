@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <algorithm>
+#include <stdarg.h>
+#include <ctype.h>
+using std::min; using std::max;
+#define PROGMEM
+#define PSTR(x) (x)
+#define F(x) (x)
+#define FPSTR(x) (x)
+#define PI 3.14159265358979
+#define HEX 16
+#define DEC 10
+#define INPUT 0
+#define INPUT_PULLUP 2
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define IRAM_ATTR
+typedef uint8_t byte;
+unsigned long millis();
+// Added to millis(), for harnesses that simulate days
+extern unsigned long hostMillisOffset;
+unsigned long micros();
+#define snprintf_P snprintf
+#define CHANGE 3
+#define HIGH 1
+inline uint8_t digitalPinToInterrupt(uint8_t p) { return p; }
+inline void attachInterruptArg(uint8_t, void (*)(void*), void*, int) {}
+inline void detachInterrupt(uint8_t) {}
+inline int digitalRead(uint8_t) { return 1; }
+inline void yield() {}
+inline void delay(unsigned long) {}
+inline void pinMode(int, int) {}
+class String {
+public:
+  std::string s;
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& c) : s(c) {}
+  String(int v, int base = 10) { char b[32]; snprintf(b, 32, base == 16 ? "%x" : "%d", v); s = b; }
+  String(unsigned int v, int base = 10) { char b[32]; snprintf(b, 32, base == 16 ? "%x" : "%u", v); s = b; }
+  String(double v, int dec = 2) { char b[64]; snprintf(b, 64, "%.*f", dec, v); s = b; }
+  const char* c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  int indexOf(char c, unsigned from = 0) const { auto p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const String& c, unsigned from = 0) const { auto p = s.find(c.s, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const char* c, unsigned from = 0) const { auto p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  String substring(int a) const { if(a > (int)s.size()) return String(); return String(s.substr(a)); }
+  String substring(int a, int b) const { if(b < 0) b = s.size(); if(a > b) std::swap(a, b); if(a > (int)s.size()) return String(); return String(s.substr(a, b - a)); }
+  bool startsWith(const String& p) const { return s.rfind(p.s, 0) == 0; }
+  bool startsWith(const char* p) const { return s.rfind(p, 0) == 0; }
+  void trim() { size_t a = s.find_first_not_of(" \t\r\n"); size_t b = s.find_last_not_of(" \t\r\n"); s = a == std::string::npos ? "" : s.substr(a, b - a + 1); }
+  long toInt() const { return atol(s.c_str()); }
+  double toDouble() const { return atof(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+  void toUpperCase() { for(auto& c : s) c = toupper(c); }
+  char charAt(unsigned i) const { return s[i]; }
+  char operator[](unsigned i) const { return s[i]; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator!=(const String& o) const { return s != o.s; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(char o) { s += o; return *this; }
+};
+inline String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+inline String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+inline String operator+(const String& a, const char* b) { return String(a.s + b); }
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) { return 1; }
+  virtual size_t write(const uint8_t* b, size_t n) { size_t r = 0; while(n--) r += write(*b++); return r; }
+  size_t printf(const char* f, ...) { va_list a; va_start(a, f); int r = vprintf(f, a); va_end(a); return r; }
+  size_t printf_P(const char* f, ...) { va_list a; va_start(a, f); int r = vprintf(f, a); va_end(a); return r; }
+  size_t print(const char* s) { return ::printf("%s", s); }
+  size_t print(const String& s) { return ::printf("%s", s.c_str()); }
+  size_t print(int v, int base = 10) { return ::printf(base == 16 ? "%X" : "%d", v); }
+  size_t println(const char* s = "") { return ::printf("%s\n", s); }
+};
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+  virtual size_t readBytes(uint8_t* b, size_t l) { size_t n = 0; while(n < l && available()) b[n++] = read(); return n; }
+  void setTimeout(unsigned long) {}
+};
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long, uint32_t = 0, int = -1, int = -1, bool = false) {}
+  void end() {}
+  size_t setRxBufferSize(size_t s) { return s; }
+};
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+#define SERIAL_7N1 1
+#define SERIAL_8N1 2
+#define SERIAL_8N2 3
+#define SERIAL_7E1 4
+#define SERIAL_8E1 5
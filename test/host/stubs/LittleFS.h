@@ -0,0 +1,127 @@
+#pragma once
+#include "Arduino.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+
+// Flash geometry of the cost model below, as LittleFS is set up on the ESP32
+#define LFS_BLOCK_SIZE 4096
+#define LFS_PROG_SIZE 256
+// Files up to this size are kept in the metadata instead of blocks of their own
+#define LFS_INLINE_MAX 256
+
+// LittleFS backed by a directory on the host. Writes can be cut off after a number of bytes, as when power is lost.
+// Erases and page programs are counted as LittleFS would do them: files are copy on write, so a file opened for
+// writing again has its last block copied to a newly erased one, and each close or change to the directory commits a
+// padded page to the metadata pair, which erases a block to compact when it is full
+class LittleFSClass {
+public:
+    std::string root = "/tmp";
+    uint32_t opensForWrite = 0;
+    uint32_t bytesWritten = 0;
+    uint32_t bytesRead = 0;
+    uint32_t erases = 0;
+    uint32_t programs = 0;
+    uint32_t metadataUsed = 0;
+    long crashAfter = -1;
+    bool crashed = false;
+
+    std::string path(const char* name) { return root + name; }
+    bool begin() { return true; }
+    bool exists(const char* name) { struct stat st; return stat(path(name).c_str(), &st) == 0; }
+    long size(const char* name) { struct stat st; return stat(path(name).c_str(), &st) == 0 ? st.st_size : 0; }
+    bool remove(const char* name) { commit(0); return unlink(path(name).c_str()) == 0; }
+    bool rename(const char* from, const char* to) { commit(0); return ::rename(path(from).c_str(), path(to).c_str()) == 0; }
+
+    void commit(size_t inlined) {
+        uint32_t pages = 1 + inlined / LFS_PROG_SIZE;
+        programs += pages;
+        metadataUsed += pages * LFS_PROG_SIZE;
+        if(metadataUsed > LFS_BLOCK_SIZE) {
+            erases++;
+            programs += 2;
+            metadataUsed = 2 * LFS_PROG_SIZE;
+        }
+    }
+
+    // A file closed after writing, from the size it had to the size it has
+    void closed(size_t from, size_t to) {
+        if(to <= LFS_INLINE_MAX) {
+            commit(to);
+            return;
+        }
+        if(from <= LFS_INLINE_MAX) from = 0;
+        for(size_t block = from - from % LFS_BLOCK_SIZE; block < to; block += LFS_BLOCK_SIZE) {
+            size_t end = to < block + LFS_BLOCK_SIZE ? to : block + LFS_BLOCK_SIZE;
+            erases++;
+            programs += (end - block + LFS_PROG_SIZE - 1) / LFS_PROG_SIZE;
+        }
+        commit(0);
+    }
+
+    bool format() {
+        erases = 0;
+        programs = 0;
+        metadataUsed = 0;
+        DIR* d = opendir(root.c_str());
+        if(d == NULL) return false;
+        struct dirent* e;
+        while((e = readdir(d)) != NULL) {
+            if(e->d_name[0] != '.') unlink((root + "/" + e->d_name).c_str());
+        }
+        closedir(d);
+        return true;
+    }
+    class File open(const char* name, const char* mode);
+};
+extern LittleFSClass LittleFS;
+
+class File {
+public:
+    std::shared_ptr<FILE> f;
+    File() {}
+    File(FILE* fp) : f(fp, [](FILE* p) { fclose(p); }) {}
+    // Opened for writing, the cost is counted when the last copy is closed
+    File(FILE* fp, size_t from) : f(fp, [from](FILE* p) { fseek(p, 0, SEEK_END); size_t to = ftell(p); fclose(p); LittleFS.closed(from, to); }) {}
+    operator bool() const { return (bool) f; }
+    size_t write(const uint8_t* b, size_t n) {
+        if(LittleFS.crashed) return 0;
+        if(LittleFS.crashAfter >= 0 && (long) n > LittleFS.crashAfter) {
+            n = LittleFS.crashAfter;
+            LittleFS.crashed = true;
+        }
+        if(LittleFS.crashAfter >= 0) LittleFS.crashAfter -= n;
+        size_t w = fwrite(b, 1, n, f.get());
+        fflush(f.get());
+        LittleFS.bytesWritten += w;
+        return w;
+    }
+    size_t write(uint8_t c) { return write(&c, 1); }
+    int read(uint8_t* b, size_t n) {
+        int r = fread(b, 1, n, f.get());
+        if(r > 0) LittleFS.bytesRead += r;
+        return r;
+    }
+    size_t readBytes(char* b, size_t n) { return read((uint8_t*) b, n); }
+    size_t size() {
+        long p = ftell(f.get());
+        fseek(f.get(), 0, SEEK_END);
+        long s = ftell(f.get());
+        fseek(f.get(), p, SEEK_SET);
+        return s;
+    }
+    bool seek(uint32_t pos) { return fseek(f.get(), pos, SEEK_SET) == 0; }
+    void close() { f.reset(); }
+};
+
+inline File LittleFSClass::open(const char* name, const char* mode) {
+    if(mode[0] == 'r') {
+        FILE* fp = fopen(path(name).c_str(), "rb");
+        return fp ? File(fp) : File();
+    }
+    opensForWrite++;
+    size_t from = mode[0] == 'a' ? size(name) : 0;
+    FILE* fp = fopen(path(name).c_str(), mode[0] == 'w' ? "wb" : "ab");
+    return fp ? File(fp, from) : File();
+}
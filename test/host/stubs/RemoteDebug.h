@@ -0,0 +1,8 @@
+#pragma once
+#include "Arduino.h"
+class RemoteDebug : public Print {
+public:
+  enum { ANY = 0, VERBOSE, DEBUG, INFO, WARNING, ERROR };
+  int level = WARNING;
+  bool isActive(int l) { return l >= level; }
+};
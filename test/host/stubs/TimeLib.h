@@ -0,0 +1,6 @@
+#pragma once
+#include <time.h>
+#include <stdint.h>
+typedef struct { uint8_t Second, Minute, Hour, Wday, Day, Month, Year; } tmElements_t;
+time_t makeTime(const tmElements_t& tm);
+void breakTime(time_t t, tmElements_t& tm);
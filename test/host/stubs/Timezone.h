@@ -0,0 +1,12 @@
+#pragma once
+#include "TimeLib.h"
+enum { Last = 0, First, Second, Third, Fourth };
+enum { Sun = 1 };
+enum { Jan = 1, Feb, Mar, Apr, May, Jun, Jul, Aug, Sep, Oct, Nov, Dec };
+struct TimeChangeRule { char abbrev[6]; uint8_t week, dow, month, hour; int offset; };
+class Timezone {
+public:
+  Timezone(TimeChangeRule, TimeChangeRule) {}
+  time_t toUTC(time_t t) { return t - 3600; }
+  time_t toLocal(time_t t) { return t + 3600; }
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+extern "C" {
+typedef enum { MBEDTLS_CIPHER_ID_NONE = 0, MBEDTLS_CIPHER_ID_NULL, MBEDTLS_CIPHER_ID_AES } mbedtls_cipher_id_t;
+typedef struct { alignas(16) unsigned char opaque[2048]; } mbedtls_gcm_context;
+#define MBEDTLS_GCM_ENCRYPT 1
+#define MBEDTLS_GCM_DECRYPT 0
+#define MBEDTLS_ERR_GCM_AUTH_FAILED -0x0012
+#define MBEDTLS_ERR_GCM_BAD_INPUT -0x0014
+void mbedtls_gcm_init(mbedtls_gcm_context*);
+int mbedtls_gcm_setkey(mbedtls_gcm_context*, mbedtls_cipher_id_t, const unsigned char*, unsigned int);
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context*, size_t, const unsigned char*, size_t, const unsigned char*, size_t, const unsigned char*, size_t, const unsigned char*, unsigned char*);
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context*, int, size_t, const unsigned char*, size_t, const unsigned char*, size_t, const unsigned char*, unsigned char*, size_t, unsigned char*);
+int mbedtls_gcm_starts(mbedtls_gcm_context*, int, const unsigned char*, size_t, const unsigned char*, size_t);
+int mbedtls_gcm_update(mbedtls_gcm_context*, size_t, const unsigned char*, unsigned char*);
+int mbedtls_gcm_finish(mbedtls_gcm_context*, unsigned char*, size_t);
+void mbedtls_gcm_free(mbedtls_gcm_context*);
+}